@@ -120,6 +120,7 @@
 
 static constexpr unsigned DEFAULT_BUFFER_SIZE = 4096;
 static constexpr unsigned DEFAULT_BUFFER_BEFORE_PLAY = 10;
+static constexpr unsigned MAX_DECODER_LOOKAHEAD = 2;
 
 #ifdef ANDROID
 Context *context;
@@ -310,7 +311,18 @@ initialize_decoder_and_player(const ReplayGainConfig &replay_gain_config)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size =
+		size_t(config_get_positive(ConfigOption::AUDIO_CHUNK_SIZE,
+					   DEFAULT_CHUNK_SIZE / 1024)) * 1024;
+	if (chunk_size > MAX_CHUNK_SIZE)
+		FormatFatalError("chunk size \"%lu\" is too big",
+				 (unsigned long)chunk_size);
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
+	if (buffered_chunks == 0)
+		FormatFatalError("buffer size \"%lu\" is smaller than the "
+				 "chunk size",
+				 (unsigned long)buffer_size);
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
@@ -334,6 +346,20 @@ initialize_decoder_and_player(const ReplayGainConfig &replay_gain_config)
 	if (buffered_before_play > buffered_chunks)
 		buffered_before_play = buffered_chunks;
 
+	const unsigned decoder_lookahead =
+		config_get_unsigned(ConfigOption::DECODER_LOOKAHEAD, 0);
+	if (decoder_lookahead > MAX_DECODER_LOOKAHEAD)
+		FormatFatalError("decoder_lookahead %u is too large, "
+				 "maximum is %u",
+				 decoder_lookahead, MAX_DECODER_LOOKAHEAD);
+
+	const unsigned history_chunks =
+		size_t(config_get_unsigned(ConfigOption::SEEK_HISTORY_SIZE, 0))
+		* 1024 / chunk_size;
+	if (history_chunks > buffered_chunks / 2)
+		FormatFatalError("seek_history_size is too large, "
+				 "maximum is half the audio_buffer_size");
+
 	const unsigned max_length =
 		config_get_positive(ConfigOption::MAX_PLAYLIST_LENGTH,
 				    DEFAULT_PLAYLIST_MAX_LENGTH);
@@ -352,8 +378,10 @@ initialize_decoder_and_player(const ReplayGainConfig &replay_gain_config)
 
 	instance->partition = new Partition(*instance,
 					    max_length,
-					    buffered_chunks,
+					    buffered_chunks, chunk_size,
 					    buffered_before_play,
+					    decoder_lookahead,
+					    history_chunks,
 					    configured_audio_format,
 					    replay_gain_config);
 
@@ -21,17 +21,125 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 
+#include <new>
+#include <thread>
+
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size)
+	:n_max(num_chunks), chunk_size(_chunk_size),
+	 chunks(num_chunks * sizeof(MusicChunk)),
+	 data(num_chunks * _chunk_size),
+	 next_free(new std::atomic<uint32_t>[num_chunks]),
+	 free_head(0), n_allocated(0) {
+	assert(n_max > 0);
+	assert(n_max < LOCKED);
+	assert(chunk_size > 0);
+	assert(chunk_size <= MAX_CHUNK_SIZE);
+
+	Reset();
+}
+
+MusicBuffer::~MusicBuffer()
+{
+	/* all chunks must be returned explicitly, and this
+	   assertion checks for leaks */
+	assert(n_allocated == 0);
+}
+
+void
+MusicBuffer::Reset()
+{
+	for (unsigned i = 0; i < n_max; ++i)
+		next_free[i].store(i + 1 < n_max ? i + 1 : NONE,
+				   std::memory_order_relaxed);
 }
 
 MusicChunk *
 MusicBuffer::Allocate()
 {
-	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	/* announce the allocation before popping, so Discard() does
+	   not pull the memory away from under us */
+	n_allocated.fetch_add(1);
+
+	uint64_t head = free_head.load();
+	uint32_t i;
+	while (true) {
+		i = GetIndex(head);
+		if (i == NONE) {
+			/* the buffer is full */
+			n_allocated.fetch_sub(1);
+			return nullptr;
+		}
+
+		if (i == LOCKED) {
+			/* Discard() is running */
+			std::this_thread::yield();
+			head = free_head.load();
+			continue;
+		}
+
+		/* if another thread pops "i" meanwhile, the
+		   modification counter makes this compare-and-swap
+		   fail, even if "i" is back on top */
+		const uint32_t next = next_free[i].load(std::memory_order_relaxed);
+		if (free_head.compare_exchange_weak(head, MakeHead(next, head)))
+			break;
+	}
+
+	return ::new(GetChunks() + i)
+		MusicChunk((uint8_t *)data.get() + size_t(i) * chunk_size,
+			   chunk_size);
+}
+
+inline void
+MusicBuffer::Free(MusicChunk *chunk)
+{
+	const size_t i = chunk - GetChunks();
+	assert(i < n_max);
+
+	chunk->~MusicChunk();
+
+	uint64_t head = free_head.load();
+	while (true) {
+		if (GetIndex(head) == LOCKED) {
+			std::this_thread::yield();
+			head = free_head.load();
+			continue;
+		}
+
+		next_free[i].store(GetIndex(head), std::memory_order_relaxed);
+		if (free_head.compare_exchange_weak(head, MakeHead(i, head)))
+			break;
+	}
+
+	if (n_allocated.fetch_sub(1) == 1)
+		Discard();
+}
+
+void
+MusicBuffer::Discard()
+{
+	uint64_t head = free_head.load();
+	do {
+		if (GetIndex(head) == LOCKED)
+			/* another thread is already doing it */
+			return;
+	} while (!free_head.compare_exchange_weak(head,
+						  MakeHead(LOCKED, head)));
+
+	/* nobody can pop or push now; Allocate() increments
+	   n_allocated before it looks at the stack, so if it is
+	   still zero, no chunk is in use */
+	uint32_t top = GetIndex(head);
+	if (n_allocated.load() == 0) {
+		chunks.Discard();
+		data.Discard();
+		Reset();
+		top = 0;
+	}
+
+	free_head.store(MakeHead(top, MakeHead(LOCKED, head)));
 }
 
 void
@@ -39,12 +147,10 @@ MusicBuffer::Return(MusicChunk *chunk)
 {
 	assert(chunk != nullptr);
 
-	const ScopeLock protect(mutex);
-
 	if (chunk->other != nullptr) {
 		assert(chunk->other->other == nullptr);
-		buffer.Free(chunk->other);
+		Free(chunk->other);
 	}
 
-	buffer.Free(chunk);
+	Free(chunk);
 }
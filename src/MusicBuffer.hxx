@@ -20,19 +20,67 @@
 #ifndef MPD_MUSIC_BUFFER_HXX
 #define MPD_MUSIC_BUFFER_HXX
 
-#include "util/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "MusicChunk.hxx"
+#include "util/HugeAllocator.hxx"
+#include "Compiler.h"
 
-struct MusicChunk;
+#include <atomic>
+#include <memory>
+
+#include <stddef.h>
+#include <stdint.h>
 
 /**
- * An allocator for #MusicChunk objects.
+ * An allocator for #MusicChunk objects.  The chunk headers and their
+ * #MusicChunk::data buffers live in two separate huge allocations,
+ * because the data size is only known at run time.
+ *
+ * Free chunks are kept in a lock-free stack (a "Treiber stack") of
+ * chunk indices; a modification counter next to the index of the
+ * top element protects against the ABA problem.  Only when the last
+ * chunk is returned, the stack is locked briefly to give the memory
+ * back to the kernel.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	Mutex mutex;
+	static constexpr uint32_t NONE = ~uint32_t(0);
+	static constexpr uint32_t LOCKED = NONE - 1;
+
+	const unsigned n_max;
+
+	/**
+	 * The size of each chunk's data buffer.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The #MusicChunk objects.
+	 */
+	HugeAllocation chunks;
+
+	/**
+	 * The data buffers of all chunks; the one of chunk i starts
+	 * at offset i * #chunk_size.
+	 */
+	HugeAllocation data;
+
+	/**
+	 * For each free chunk, the index of the next one in the free
+	 * stack, or #NONE.
+	 */
+	std::unique_ptr<std::atomic<uint32_t>[]> next_free;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The top of the free stack: the index of the first free
+	 * chunk (or #NONE or #LOCKED) in the lower 32 bits, and the
+	 * modification counter in the upper 32 bits.
+	 */
+	std::atomic<uint64_t> free_head;
+
+	/**
+	 * The number of chunks which are allocated or are about to be
+	 * allocated.
+	 */
+	std::atomic<unsigned> n_allocated;
 
 public:
 	/**
@@ -40,17 +88,25 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param _chunk_size the size of each chunk's data buffer in
+	 * bytes
 	 */
-	MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks,
+		    size_t _chunk_size=DEFAULT_CHUNK_SIZE);
+
+	~MusicBuffer();
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
 	 * Check whether the buffer is empty.  This call is not
-	 * protected with the mutex, and may only be used while this
-	 * object is inaccessible to other threads.
+	 * synchronized, and may only be used while this object is
+	 * inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
-		return buffer.IsEmpty();
+		return n_allocated.load(std::memory_order_relaxed) == 0;
 	}
 #endif
 
@@ -61,7 +117,14 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return buffer.GetCapacity();
+		return n_max;
+	}
+
+	/**
+	 * Returns the size of each chunk's data buffer in bytes.
+	 */
+	size_t GetChunkSize() const {
+		return chunk_size;
 	}
 
 	/**
@@ -78,6 +141,32 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk);
+
+private:
+	static constexpr uint32_t GetIndex(uint64_t head) {
+		return uint32_t(head);
+	}
+
+	static constexpr uint64_t MakeHead(uint32_t index, uint64_t old) {
+		return ((old >> 32) + 1) << 32 | index;
+	}
+
+	MusicChunk *GetChunks() {
+		return (MusicChunk *)chunks.get();
+	}
+
+	/**
+	 * Fill the free stack with all chunks, in ascending order.
+	 */
+	void Reset();
+
+	void Free(MusicChunk *chunk);
+
+	/**
+	 * Give the memory back to the kernel if no chunk is
+	 * allocated.
+	 */
+	void Discard();
 };
 
 #endif
@@ -28,10 +28,21 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <stdint.h>
 #include <stddef.h>
 
-static constexpr size_t CHUNK_SIZE = 4096;
+/**
+ * The default size of the #MusicChunk::data buffer, see
+ * #MusicBuffer.
+ */
+static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+
+/**
+ * The maximum size of the #MusicChunk::data buffer.
+ */
+static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
 
 struct AudioFormat;
 struct Tag;
@@ -41,8 +52,11 @@ struct Tag;
  * MusicPipe::Push() caller.
  */
 struct MusicChunk {
-	/** the next chunk in a linked list */
-	MusicChunk *next;
+	/**
+	 * The next chunk in a linked list.  This is written by
+	 * MusicPipe::Push() while other threads may be reading it.
+	 */
+	std::atomic<MusicChunk *> next;
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -57,7 +71,7 @@ struct MusicChunk {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -86,14 +100,21 @@ struct MusicChunk {
 	 */
 	unsigned replay_gain_serial = 0;
 
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
+	/**
+	 * The data (probably PCM).  This buffer is owned by the
+	 * #MusicBuffer which has allocated this chunk.
+	 */
+	uint8_t *const data;
+
+	/** the size of the #data buffer in bytes */
+	const size_t capacity;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
 #endif
 
-	MusicChunk() = default;
+	MusicChunk(uint8_t *_data, size_t _capacity)
+		:data(_data), capacity(_capacity) {}
 
 	MusicChunk(const MusicChunk &) = delete;
 
@@ -22,14 +22,15 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 
+#include <thread>
+
 #ifndef NDEBUG
 
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const
 {
-	const ScopeLock protect(mutex);
-
-	for (const MusicChunk *i = head; i != nullptr; i = i->next)
+	for (const MusicChunk *i = Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire))
 		if (i == chunk)
 			return true;
 
@@ -41,33 +42,46 @@ MusicPipe::Contains(const MusicChunk *chunk) const
 MusicChunk *
 MusicPipe::Shift()
 {
-	const ScopeLock protect(mutex);
-
-	MusicChunk *chunk = head;
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return nullptr;
 
-		head = chunk->next;
-		--size;
-
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this looks like the last chunk; try to detach it
+		   before Push() links a new one */
+		MusicChunk *expected = chunk;
+		if (tail.compare_exchange_strong(expected, nullptr)) {
+			/* Push() may already have installed a new
+			   head after seeing the empty tail; in that
+			   case, leave it alone */
+			expected = chunk;
+			head.compare_exchange_strong(expected, nullptr);
 		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+			/* Push() has replaced the tail, but has not
+			   linked our chunk to the new one yet; this
+			   is a matter of a few instructions */
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr)
+				std::this_thread::yield();
+
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
+
+	size.fetch_sub(1, std::memory_order_release);
 
 #ifndef NDEBUG
-		/* poison the "next" reference */
-		chunk->next = (MusicChunk *)(void *)0x01010101;
+	/* poison the "next" reference */
+	chunk->next.store((MusicChunk *)(void *)0x01010101,
+			  std::memory_order_relaxed);
 
-		if (size == 0)
-			audio_format.Clear();
+	const ScopeLock protect(format_mutex);
+	if (IsEmpty())
+		audio_format.Clear();
 #endif
-	}
 
 	return chunk;
 }
@@ -87,20 +101,27 @@ MusicPipe::Push(MusicChunk *chunk)
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const ScopeLock protect(mutex);
+#ifndef NDEBUG
+	{
+		const ScopeLock protect(format_mutex);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+		assert(!audio_format.IsDefined() ||
+		       chunk->CheckFormat(audio_format));
 
-#ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+		if (!audio_format.IsDefined() && chunk->length > 0)
+			audio_format = chunk->audio_format;
+	}
 #endif
 
-	chunk->next = nullptr;
-	*tail_r = chunk;
-	tail_r = &chunk->next;
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+
+	MusicChunk *prev = tail.exchange(chunk);
+	if (prev != nullptr)
+		/* Shift() cannot detach "prev" now, because the tail
+		   has moved on; it waits for this link instead */
+		prev->next.store(chunk, std::memory_order_release);
+	else
+		head.store(chunk, std::memory_order_release);
 
-	++size;
+	size.fetch_add(1, std::memory_order_release);
 }
@@ -20,13 +20,15 @@
 #ifndef MPD_PIPE_H
 #define MPD_PIPE_H
 
-#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
 #ifndef NDEBUG
+#include "thread/Mutex.hxx"
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
 struct MusicChunk;
@@ -34,22 +36,40 @@ class MusicBuffer;
 
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
- * tail, and the other consumes them from the head.
+ * tail, and the other consumes them from the head.  In addition,
+ * any number of threads may walk the queue with Peek() and
+ * #MusicChunk::next, as long as the chunks they visit are not
+ * shifted meanwhile.
+ *
+ * This class does not use a mutex.  It is an intrusive linked list
+ * where Push() atomically exchanges the #tail pointer and then
+ * links the previous tail to the new chunk; Shift() detaches the
+ * last chunk with a compare-and-swap on #tail, and in the rare case
+ * that it loses the race against Push(), waits for the (imminent)
+ * link.
+ *
+ * Push() must not be called concurrently with itself, and neither
+ * must Shift().
  */
 class MusicPipe {
 	/** the first chunk */
-	MusicChunk *head = nullptr;
+	std::atomic<MusicChunk *> head;
 
-	/** a pointer to the tail of the chunk */
-	MusicChunk **tail_r = &head;
+	/** the last chunk */
+	std::atomic<MusicChunk *> tail;
 
-	/** the current number of chunks */
-	unsigned size = 0;
-
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	/**
+	 * The current number of chunks.  Push() increments it only
+	 * after the chunk has been linked, so it may be too small
+	 * for a moment, and it is signed because Shift() may remove
+	 * that chunk before the increment.
+	 */
+	std::atomic<int> size;
 
 #ifndef NDEBUG
+	/** protects #audio_format */
+	mutable Mutex format_mutex;
+
 	AudioFormat audio_format = AudioFormat::Undefined();
 #endif
 
@@ -57,7 +77,8 @@ public:
 	/**
 	 * Creates a new #MusicPipe object.  It is empty.
 	 */
-	MusicPipe() = default;
+	MusicPipe()
+		:head(nullptr), tail(nullptr), size(0) {}
 
 	MusicPipe(const MusicPipe &) = delete;
 
@@ -66,7 +87,7 @@ public:
 	 */
 	~MusicPipe() {
 		assert(head == nullptr);
-		assert(tail_r == &head);
+		assert(tail == nullptr);
 	}
 
 	MusicPipe &operator=(const MusicPipe &) = delete;
@@ -78,6 +99,7 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const {
+		const ScopeLock protect(format_mutex);
 		return !audio_format.IsDefined() ||
 			audio_format == other;
 	}
@@ -95,7 +117,7 @@ public:
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const {
-		return head;
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -120,7 +142,8 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return size;
+		const int n = size.load(std::memory_order_acquire);
+		return n > 0 ? n : 0;
 	}
 
 	gcc_pure
@@ -27,14 +27,18 @@
 Partition::Partition(Instance &_instance,
 		     unsigned max_length,
 		     unsigned buffer_chunks,
+		     size_t chunk_size,
 		     unsigned buffered_before_play,
+		     unsigned decoder_lookahead,
+		     unsigned history_chunks,
 		     AudioFormat configured_audio_format,
 		     const ReplayGainConfig &replay_gain_config)
 	:instance(_instance),
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
 	 playlist(max_length, *this),
 	 outputs(*this),
-	 pc(*this, outputs, buffer_chunks, buffered_before_play,
+	 pc(*this, outputs, buffer_chunks, chunk_size,
+	    buffered_before_play, decoder_lookahead, history_chunks,
 	    configured_audio_format, replay_gain_config)
 {
 	UpdateEffectiveReplayGainMode();
@@ -58,7 +58,10 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	Partition(Instance &_instance,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
+		  size_t chunk_size,
 		  unsigned buffered_before_play,
+		  unsigned decoder_lookahead,
+		  unsigned history_chunks,
 		  AudioFormat configured_audio_format,
 		  const ReplayGainConfig &replay_gain_config);
 
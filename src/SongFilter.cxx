@@ -22,6 +22,7 @@
 #include "db/LightSong.hxx"
 #include "DetachedSong.hxx"
 #include "tag/Tag.hxx"
+#include "tag/TagPool.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StringAPI.hxx"
 #include "util/ASCII.hxx"
@@ -70,7 +71,7 @@ SongFilter::Item::Item(unsigned _tag, const char *_value, bool _fold_case)
 }
 
 SongFilter::Item::Item(unsigned _tag, time_t _time)
-	:tag(_tag), value(nullptr), time(_time)
+	:tag(_tag), fold_case(false), value(nullptr), time(_time)
 {
 }
 
@@ -93,11 +94,31 @@ SongFilter::Item::StringMatch(const char *s) const
 	}
 }
 
+bool
+SongFilter::Item::StringMatch(const TagItem &item) const
+{
+	assert(tag != LOCATE_TAG_MODIFIED_SINCE);
+
+	if (!fold_case)
+		return StringIsEqual(item.value, value.c_str());
+
+	/* fold each tag value only once, not again for each
+	   search */
+	const char *folded = tag_pool_get_folded(item);
+	if (folded == nullptr) {
+		auto f = IcuCaseFold(item.value);
+		assert(!f.IsNull());
+		folded = tag_pool_set_folded(item, std::move(f));
+	}
+
+	return StringFind(folded, value.c_str()) != nullptr;
+}
+
 bool
 SongFilter::Item::Match(const TagItem &item) const
 {
 	return (tag == LOCATE_TAG_ANY_TYPE || (unsigned)item.type == tag) &&
-		StringMatch(item.value);
+		StringMatch(item);
 }
 
 bool
@@ -128,7 +149,7 @@ SongFilter::Item::Match(const Tag &_tag) const
 			   only "artist" exists, use that */
 			for (const auto &item : _tag)
 				if (item.type == TAG_ARTIST &&
-				    StringMatch(item.value))
+				    StringMatch(item))
 					return true;
 		}
 	}
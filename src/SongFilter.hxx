@@ -23,7 +23,7 @@
 #include "util/AllocatedString.hxx"
 #include "Compiler.h"
 
-#include <list>
+#include <vector>
 
 #include <stdint.h>
 #include <time.h>
@@ -82,6 +82,13 @@ public:
 		gcc_pure gcc_nonnull(2)
 		bool StringMatch(const char *s) const;
 
+		/**
+		 * Like StringMatch(), but use the case-folded value
+		 * cached by the #TagPool.
+		 */
+		gcc_pure
+		bool StringMatch(const TagItem &tag_item) const;
+
 		gcc_pure
 		bool Match(const TagItem &tag_item) const;
 
@@ -96,7 +103,7 @@ public:
 	};
 
 private:
-	std::list<Item> items;
+	std::vector<Item> items;
 
 public:
 	SongFilter() = default;
@@ -120,7 +127,7 @@ public:
 	gcc_pure
 	bool Match(const LightSong &song) const;
 
-	const std::list<Item> &GetItems() const {
+	const std::vector<Item> &GetItems() const {
 		return items;
 	}
 
@@ -41,33 +41,13 @@
 
 #ifdef ENABLE_DATABASE
 
-Song *
-Song::LoadFile(Storage &storage, const char *path_utf8, Directory &parent)
-{
-	assert(!uri_has_scheme(path_utf8));
-	assert(strchr(path_utf8, '\n') == nullptr);
-
-	Song *song = NewFile(path_utf8, parent);
-	if (!song->UpdateFile(storage)) {
-		song->Free();
-		return nullptr;
-	}
-
-	return song;
-}
-
-#endif
-
-#ifdef ENABLE_DATABASE
-
 bool
-Song::UpdateFile(Storage &storage)
+Song::ScanFile(Storage &storage, const char *uri_utf8,
+	       time_t &mtime_r, Tag &tag_r)
 {
-	const auto &relative_uri = GetURI();
-
 	StorageFileInfo info;
 	try {
-		info = storage.GetInfo(relative_uri.c_str(), true);
+		info = storage.GetInfo(uri_utf8, true);
 	} catch (const std::runtime_error &) {
 		return false;
 	}
@@ -77,10 +57,9 @@ Song::UpdateFile(Storage &storage)
 
 	TagBuilder tag_builder;
 
-	const auto path_fs = storage.MapFS(relative_uri.c_str());
+	const auto path_fs = storage.MapFS(uri_utf8);
 	if (path_fs.IsNull()) {
-		const auto absolute_uri =
-			storage.MapUTF8(relative_uri.c_str());
+		const auto absolute_uri = storage.MapUTF8(uri_utf8);
 		if (!tag_stream_scan(absolute_uri.c_str(), tag_builder))
 			return false;
 	} else {
@@ -88,8 +67,8 @@ Song::UpdateFile(Storage &storage)
 			return false;
 	}
 
-	mtime = info.mtime;
-	tag_builder.Commit(tag);
+	mtime_r = info.mtime;
+	tag_builder.Commit(tag_r);
 	return true;
 }
 
@@ -115,7 +94,7 @@ Song::LoadFromArchive(ArchiveFile &archive, const char *name_utf8,
 }
 
 bool
-Song::UpdateFileInArchive(ArchiveFile &archive)
+Song::ScanFileInArchive(ArchiveFile &archive, Tag &tag_r) const
 {
 	assert(parent != nullptr);
 	assert(parent->device == DEVICE_INARCHIVE);
@@ -134,10 +113,16 @@ Song::UpdateFileInArchive(ArchiveFile &archive)
 	if (!tag_archive_scan(archive, path_utf8.c_str(), tag_builder))
 		return false;
 
-	tag_builder.Commit(tag);
+	tag_builder.Commit(tag_r);
 	return true;
 }
 
+bool
+Song::UpdateFileInArchive(ArchiveFile &archive)
+{
+	return ScanFileInArchive(archive, tag);
+}
+
 #endif
 
 bool
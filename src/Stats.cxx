@@ -26,6 +26,7 @@
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "tag/TagPool.hxx"
 #include "system/Clock.hxx"
 #include "Log.hxx"
 
@@ -134,4 +135,11 @@ stats_print(Response &r, const Partition &partition)
 	if (db != nullptr)
 		db_stats_print(r, *db);
 #endif
+
+	const auto pool = tag_pool_get_stats();
+	r.Format("tag_pool_items: %lu\n"
+		 "tag_pool_load: %.2f\n"
+		 "tag_pool_max_chain: %lu\n",
+		 (unsigned long)pool.items, pool.GetLoadFactor(),
+		 (unsigned long)pool.max_chain);
 }
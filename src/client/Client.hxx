@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "ClientMessage.hxx"
+#include "ResponseGenerator.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimeoutMonitor.hxx"
@@ -33,6 +34,7 @@
 #include <set>
 #include <string>
 #include <list>
+#include <memory>
 
 #include <stddef.h>
 #include <stdarg.h>
@@ -87,6 +89,27 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+	/**
+	 * The generator of a response which is not yet complete, see
+	 * CommandResult::BACKGROUND.  While it is set, no input is
+	 * processed.
+	 */
+	std::unique_ptr<ResponseGenerator> background;
+
+	/**
+	 * The command list index and the name of the command which
+	 * created #background, for error messages.
+	 */
+	unsigned background_list_index;
+	std::string background_command;
+
+	/**
+	 * Was the #background command part of a command list?  Then
+	 * #background_list contains the commands following it.
+	 */
+	bool background_in_list = false, background_list_ok;
+	std::list<std::string> background_list;
+
 	Client(EventLoop &loop, Partition &partition,
 	       int fd, int uid, int num);
 
@@ -114,6 +137,35 @@ public:
 	 */
 	bool Write(const char *data);
 
+	/**
+	 * Write a buffer which is owned by somebody else, without
+	 * copying it into the output buffer.
+	 *
+	 * @param owner keeps the buffer alive until it has been sent
+	 */
+	bool WriteExternal(ConstBuffer<void> data,
+			   std::shared_ptr<const void> owner);
+
+	/**
+	 * Has so much output been buffered that a
+	 * #ResponseGenerator should pause?
+	 */
+	gcc_pure
+	bool IsOutputFull() const;
+
+	/**
+	 * Let the generator finish the current command's response in
+	 * the background.  Called by Response::Generate().
+	 */
+	void SetBackground(std::unique_ptr<ResponseGenerator> &&generator,
+			   unsigned list_index, const char *command);
+
+	/**
+	 * Format a string and write it, without allocating heap
+	 * memory for it (unless it is very large).
+	 */
+	bool FormatV(const char *fmt, va_list args);
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -203,6 +255,9 @@ private:
 	void OnSocketError(std::exception_ptr ep) override;
 	virtual void OnSocketClosed() override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	virtual void OnSocketDrained() override;
+
 	/* virtual methods from class TimeoutMonitor */
 	virtual void OnTimeout() override;
 };
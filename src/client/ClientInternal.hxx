@@ -36,4 +36,15 @@ extern size_t client_max_output_buffer_size;
 CommandResult
 client_process_line(Client &client, char *line);
 
+/**
+ * Continue generating the response of the command which has
+ * returned CommandResult::BACKGROUND, and then process the rest of
+ * its command list.
+ *
+ * @return the result of the whole command (list), like
+ * client_process_line()
+ */
+CommandResult
+client_resume_background(Client &client);
+
 #endif
@@ -20,27 +20,44 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "protocol/Result.hxx"
+#include "Response.hxx"
 #include "command/AllCommands.hxx"
+#include "command/CommandError.hxx"
 #include "Log.hxx"
 #include "util/StringAPI.hxx"
 
+#include <iterator>
+
+#include <assert.h>
+
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
 #define CLIENT_LIST_MODE_END "command_list_end"
 
 static CommandResult
 client_process_command_list(Client &client, bool list_ok,
-			    std::list<std::string> &&list)
+			    std::list<std::string> &&list,
+			    unsigned num=0)
 {
 	CommandResult ret = CommandResult::OK;
-	unsigned num = 0;
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+	for (auto i = list.begin(); i != list.end(); ++i) {
+		char *cmd = &*i->begin();
 
 		FormatDebug(client_domain, "process command \"%s\"", cmd);
 		ret = command_process(client, num++, cmd);
 		FormatDebug(client_domain, "command returned %i", int(ret));
+
+		if (ret == CommandResult::BACKGROUND) {
+			/* save the remaining commands for
+			   client_resume_background() */
+			list.erase(list.begin(), std::next(i));
+			client.background_in_list = true;
+			client.background_list_ok = list_ok;
+			client.background_list = std::move(list);
+			break;
+		}
+
 		if (ret != CommandResult::OK || client.IsExpired())
 			break;
 		else if (list_ok)
@@ -50,6 +67,68 @@ client_process_command_list(Client &client, bool list_ok,
 	return ret;
 }
 
+void
+Client::SetBackground(std::unique_ptr<ResponseGenerator> &&generator,
+		      unsigned list_index, const char *command)
+{
+	assert(background == nullptr);
+	assert(!background_in_list);
+
+	background = std::move(generator);
+	background_list_index = list_index;
+	background_command = command;
+}
+
+CommandResult
+client_resume_background(Client &client)
+{
+	assert(client.background != nullptr);
+
+	CommandResult ret;
+
+	{
+		Response r(client, client.background_list_index);
+		r.SetCommand(client.background_command.c_str());
+
+		try {
+			if (!client.background->Generate(r))
+				return CommandResult::BACKGROUND;
+
+			ret = CommandResult::OK;
+		} catch (...) {
+			PrintError(r, std::current_exception());
+			ret = CommandResult::ERROR;
+		}
+	}
+
+	client.background.reset();
+
+	if (client.background_in_list) {
+		client.background_in_list = false;
+
+		auto list = std::move(client.background_list);
+		client.background_list.clear();
+
+		if (ret == CommandResult::OK) {
+			const bool list_ok = client.background_list_ok;
+			if (list_ok)
+				client_puts(client, "list_OK\n");
+
+			ret = client_process_command_list(client, list_ok,
+							  std::move(list),
+							  client.background_list_index + 1);
+		}
+	}
+
+	if (ret == CommandResult::CLOSE || client.IsExpired())
+		return CommandResult::CLOSE;
+
+	if (ret == CommandResult::OK)
+		command_success(client);
+
+	return ret;
+}
+
 CommandResult
 client_process_line(Client &client, char *line)
 {
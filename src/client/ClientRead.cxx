@@ -51,6 +51,16 @@ Client::OnSocketInput(void *data, size_t length)
 	case CommandResult::ERROR:
 		break;
 
+	case CommandResult::BACKGROUND:
+		if (IsExpired()) {
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		/* don't process more commands until OnSocketDrained()
+		   has finished the response */
+		return InputResult::PAUSE;
+
 	case CommandResult::KILL:
 		partition.instance.Shutdown();
 		Close();
@@ -73,3 +83,45 @@ Client::OnSocketInput(void *data, size_t length)
 
 	return InputResult::AGAIN;
 }
+
+void
+Client::OnSocketDrained()
+{
+	if (background == nullptr)
+		return;
+
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	CommandResult result = client_resume_background(*this);
+	switch (result) {
+	case CommandResult::BACKGROUND:
+		return;
+
+	case CommandResult::OK:
+	case CommandResult::IDLE:
+	case CommandResult::ERROR:
+		break;
+
+	case CommandResult::KILL:
+		partition.instance.Shutdown();
+		Close();
+		return;
+
+	case CommandResult::FINISH:
+		if (Flush())
+			Close();
+		return;
+
+	case CommandResult::CLOSE:
+		Close();
+		return;
+	}
+
+	if (IsExpired()) {
+		Close();
+		return;
+	}
+
+	/* process the commands which have been received meanwhile */
+	ResumeInput();
+}
@@ -18,9 +18,7 @@
  */
 
 #include "config.h"
-#include "Client.hxx"
-#include "util/FormatString.hxx"
-#include "util/AllocatedString.hxx"
+#include "ClientInternal.hxx"
 
 #include <string.h>
 
@@ -37,6 +35,30 @@ Client::Write(const char *data)
 	return Write(data, strlen(data));
 }
 
+bool
+Client::IsOutputFull() const
+{
+	/* pause at half of the limit, which leaves room for the rest
+	   of the item being generated and for other responses */
+	return GetOutputSize() >= client_max_output_buffer_size / 2;
+}
+
+bool
+Client::WriteExternal(ConstBuffer<void> data,
+		      std::shared_ptr<const void> owner)
+{
+	/* if the client is going to be closed, do nothing */
+	return !IsExpired() &&
+		FullyBufferedSocket::WriteExternal(data, std::move(owner));
+}
+
+bool
+Client::FormatV(const char *fmt, va_list args)
+{
+	/* if the client is going to be closed, do nothing */
+	return !IsExpired() && FullyBufferedSocket::FormatV(fmt, args);
+}
+
 void
 client_puts(Client &client, const char *s)
 {
@@ -46,7 +68,7 @@ client_puts(Client &client, const char *s)
 void
 client_vprintf(Client &client, const char *fmt, va_list args)
 {
-	client.Write(FormatStringV(fmt, args).c_str());
+	client.FormatV(fmt, args);
 }
 
 void
@@ -20,8 +20,7 @@
 #include "config.h"
 #include "Response.hxx"
 #include "Client.hxx"
-#include "util/FormatString.hxx"
-#include "util/AllocatedString.hxx"
+#include "ResponseGenerator.hxx"
 
 bool
 Response::Write(const void *data, size_t length)
@@ -35,10 +34,33 @@ Response::Write(const char *data)
 	return client.Write(data);
 }
 
+bool
+Response::WriteExternal(ConstBuffer<void> data,
+			std::shared_ptr<const void> owner)
+{
+	return client.WriteExternal(data, std::move(owner));
+}
+
+bool
+Response::IsFull() const
+{
+	return client.IsOutputFull();
+}
+
+CommandResult
+Response::Generate(std::unique_ptr<ResponseGenerator> &&generator)
+{
+	if (generator->Generate(*this))
+		return CommandResult::OK;
+
+	client.SetBackground(std::move(generator), list_index, command);
+	return CommandResult::BACKGROUND;
+}
+
 bool
 Response::FormatV(const char *fmt, va_list args)
 {
-	return Write(FormatStringV(fmt, args).c_str());
+	return client.FormatV(fmt, args);
 }
 
 bool
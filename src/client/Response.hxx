@@ -22,11 +22,17 @@
 
 #include "check.h"
 #include "protocol/Ack.hxx"
+#include "command/CommandResult.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <memory>
 
 #include <stddef.h>
 #include <stdarg.h>
 
 class Client;
+class ResponseGenerator;
 
 class Response {
 	Client &client;
@@ -53,11 +59,36 @@ public:
 		command = _command;
 	}
 
+	Client &GetClient() {
+		return client;
+	}
+
+	/**
+	 * Has so much output been buffered that a
+	 * #ResponseGenerator should pause?
+	 */
+	gcc_pure
+	bool IsFull() const;
+
 	bool Write(const void *data, size_t length);
 	bool Write(const char *data);
+	bool WriteExternal(ConstBuffer<void> data,
+			   std::shared_ptr<const void> owner);
 	bool FormatV(const char *fmt, va_list args);
 	bool Format(const char *fmt, ...);
 
+	/**
+	 * Generate the rest of the response with the given object.
+	 * If it does not finish before the output buffer is full, it
+	 * is handed to the #Client, and continues in the background.
+	 *
+	 * Throws on error.
+	 *
+	 * @return CommandResult::OK if the response is complete,
+	 * CommandResult::BACKGROUND otherwise
+	 */
+	CommandResult Generate(std::unique_ptr<ResponseGenerator> &&generator);
+
 	void Error(enum ack code, const char *msg);
 	void FormatError(enum ack code, const char *fmt, ...);
 };
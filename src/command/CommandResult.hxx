@@ -41,6 +41,14 @@ enum class CommandResult {
 	 */
 	IDLE,
 
+	/**
+	 * The command has succeeded so far, but its response is
+	 * incomplete; it will be finished by the #ResponseGenerator
+	 * which was passed to Response::Generate().  No "OK" shall be
+	 * sent, and no other commands shall be processed until then.
+	 */
+	BACKGROUND,
+
 	/**
 	 * There was an error.  The "ACK" response was sent to the
 	 * client.
@@ -28,12 +28,14 @@
 #include "CommandError.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseGenerator.hxx"
 #include "tag/Tag.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StringAPI.hxx"
 #include "SongFilter.hxx"
 #include "BulkEdit.hxx"
 
+#include <limits>
 #include <memory>
 
 CommandResult
@@ -66,18 +68,18 @@ handle_match(Client &client, Request args, Response &r, bool fold_case)
 	} else
 		window.SetAll();
 
-	SongFilter filter;
-	if (!filter.Parse(args, fold_case)) {
+	std::unique_ptr<SongFilter> filter(new SongFilter());
+	if (!filter->Parse(args, fold_case)) {
 		r.Error(ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
-	const DatabaseSelection selection("", true, &filter);
-
-	db_selection_print(r, client.partition,
-			   selection, true, false,
-			   window.start, window.end);
-	return CommandResult::OK;
+	return r.Generate(db_selection_print_generator(client.partition,
+						       "", true,
+						       std::move(filter),
+						       true, false,
+						       window.start,
+						       window.end));
 }
 
 CommandResult
@@ -171,10 +173,10 @@ handle_listall(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.partition,
-			   DatabaseSelection(uri, true),
-			   false, false);
-	return CommandResult::OK;
+	return r.Generate(db_selection_print_generator(client.partition,
+						       uri, true, nullptr,
+						       false, false,
+						       0, std::numeric_limits<int>::max()));
 }
 
 CommandResult
@@ -247,8 +249,8 @@ handle_listallinfo(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.partition,
-			   DatabaseSelection(uri, true),
-			   true, false);
-	return CommandResult::OK;
+	return r.Generate(db_selection_print_generator(client.partition,
+						       uri, true, nullptr,
+						       true, false,
+						       0, std::numeric_limits<int>::max()));
 }
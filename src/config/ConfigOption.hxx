@@ -58,7 +58,13 @@ enum class ConfigOption {
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_CHUNK_SIZE,
 	BUFFER_BEFORE_PLAY,
+	DECODER_LOOKAHEAD,
+	SEEK_HISTORY_SIZE,
+	INPUT_CACHE_DIR,
+	INPUT_CACHE_SIZE,
+	INPUT_CACHE_MAX_AGE,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
 	HTTP_PROXY_USER,
@@ -75,6 +81,7 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	UPDATE_THREADS,
 	DESPOTIFY_USER,
 	DESPOTIFY_PASSWORD,
 	DESPOTIFY_HIGH_BITRATE,
@@ -53,7 +53,13 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "audio_chunk_size" },
 	{ "buffer_before_play" },
+	{ "decoder_lookahead" },
+	{ "seek_history_size" },
+	{ "input_cache_directory" },
+	{ "input_cache_size" },
+	{ "input_cache_max_age" },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
 	{ "http_proxy_user", false, true },
@@ -70,6 +76,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback" },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "update_threads" },
 	{ "despotify_user", false, true },
 	{ "despotify_password", false, true },
 	{ "despotify_high_bitrate", false, true },
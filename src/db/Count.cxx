@@ -21,13 +21,14 @@
 #include "Count.hxx"
 #include "Selection.hxx"
 #include "Interface.hxx"
+#include "Helpers.hxx"
+#include "Stats.hxx"
 #include "Partition.hxx"
 #include "client/Response.hxx"
 #include "LightSong.hxx"
 #include "tag/Tag.hxx"
 
 #include <functional>
-#include <map>
 
 struct SearchStats {
 	unsigned n_songs;
@@ -37,9 +38,6 @@ struct SearchStats {
 		:n_songs(0), total_duration(0) {}
 };
 
-class TagCountMap : public std::map<std::string, SearchStats> {
-};
-
 static void
 PrintSearchStats(Response &r, const SearchStats &stats)
 {
@@ -52,14 +50,19 @@ PrintSearchStats(Response &r, const SearchStats &stats)
 }
 
 static void
-Print(Response &r, TagType group, const TagCountMap &m)
+PrintGroup(Response &r, TagType group,
+	   const char *value, const DatabaseStats &stats)
 {
 	assert(unsigned(group) < TAG_NUM_OF_ITEM_TYPES);
 
-	for (const auto &i : m) {
-		r.Format("%s: %s\n", tag_item_names[group], i.first.c_str());
-		PrintSearchStats(r, i.second);
-	}
+	unsigned total_duration_s =
+		std::chrono::duration_cast<std::chrono::seconds>(stats.total_duration).count();
+
+	r.Format("%s: %s\n"
+		 "songs: %u\n"
+		 "playtime: %u\n",
+		 tag_item_names[group], value,
+		 stats.song_count, total_duration_s);
 }
 
 static bool
@@ -74,39 +77,6 @@ stats_visitor_song(SearchStats &stats, const LightSong &song)
 	return true;
 }
 
-static bool
-CollectGroupCounts(TagCountMap &map, TagType group, const Tag &tag)
-{
-	bool found = false;
-	for (const auto &item : tag) {
-		if (item.type == group) {
-			auto r = map.insert(std::make_pair(item.value,
-							   SearchStats()));
-			SearchStats &s = r.first->second;
-			++s.n_songs;
-			if (!tag.duration.IsNegative())
-				s.total_duration += tag.duration;
-
-			found = true;
-		}
-	}
-
-	return found;
-}
-
-static bool
-GroupCountVisitor(TagCountMap &map, TagType group, const LightSong &song)
-{
-	assert(song.tag != nullptr);
-
-	const Tag &tag = *song.tag;
-	if (!CollectGroupCounts(map, group, tag) && group == TAG_ALBUM_ARTIST)
-		/* fall back to "Artist" if no "AlbumArtist" was found */
-		CollectGroupCounts(map, TAG_ARTIST, tag);
-
-	return true;
-}
-
 void
 PrintSongCount(Response &r, const Partition &partition, const char *name,
 	       const SongFilter *filter,
@@ -128,16 +98,12 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 
 		PrintSearchStats(r, stats);
 	} else {
-		/* group by the specified tag: store counts in a
-		   std::map */
-
-		TagCountMap map;
+		/* group by the specified tag */
 
 		using namespace std::placeholders;
-		const auto f = std::bind(GroupCountVisitor, std::ref(map),
-					 group, _1);
-		db.Visit(selection, f);
-
-		Print(r, group, map);
+		const auto f = std::bind(PrintGroup, std::ref(r), group,
+					 _1, _2);
+		if (!db.VisitGroupCounts(selection, group, f))
+			::VisitGroupCounts(db, selection, group, f);
 	}
 }
@@ -20,8 +20,11 @@
 #include "config.h"
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex;
+
+std::atomic<unsigned> db_modification_serial;
 
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
+thread_local bool db_mutex_shared;
 #endif
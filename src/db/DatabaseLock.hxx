@@ -27,12 +27,27 @@
 #define MPD_DB_LOCK_HXX
 
 #include "check.h"
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 #include "Compiler.h"
 
+#include <atomic>
+
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Readers (e.g. Database::Visit()) lock
+ * it shared, so they can run concurrently; modifications (by the
+ * update thread) require the exclusive lock.
+ */
+extern SharedMutex db_mutex;
+
+/**
+ * Incremented each time the exclusive lock is released, i.e. after
+ * each (potential) modification.  Readers which cannot keep the
+ * database locked for a long time compare it to find out whether the
+ * database may have been modified meanwhile.
+ */
+extern std::atomic<unsigned> db_modification_serial;
 
 #ifndef NDEBUG
 
@@ -41,11 +56,28 @@ extern Mutex db_mutex;
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold a shared lock on the #db_mutex?
+ */
+extern thread_local bool db_mutex_shared;
+
+/**
+ * Does the current thread hold the database lock (exclusive or
+ * shared)?  This is sufficient for reading.
  */
 gcc_pure
 static inline bool
 holding_db_lock(void)
+{
+	return db_mutex_holder.IsInside() || db_mutex_shared;
+}
+
+/**
+ * Does the current thread hold the exclusive database lock?  This is
+ * required for modifications.
+ */
+gcc_pure
+static inline bool
+holding_db_write_lock(void)
 {
 	return db_mutex_holder.IsInside();
 }
@@ -53,8 +85,8 @@ holding_db_lock(void)
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock exclusively.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
@@ -70,19 +102,50 @@ db_lock(void)
 }
 
 /**
- * Release the global database lock.
+ * Release the exclusive global database lock.
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::Null();
 #endif
 
+	++db_modification_serial;
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain a shared global database lock.  This is needed before
+ * dereferencing a #song or #directory.  It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	db_mutex.lock_shared();
+
+#ifndef NDEBUG
+	db_mutex_shared = true;
+#endif
+}
+
+/**
+ * Release a shared global database lock.
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(holding_db_lock() && !holding_db_write_lock());
+#ifndef NDEBUG
+	db_mutex_shared = false;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
 class ScopeDatabaseLock {
 	bool locked = true;
 
@@ -107,6 +170,33 @@ public:
 	}
 };
 
+/**
+ * Like #ScopeDatabaseLock, but obtain a shared lock for reading.
+ */
+class ScopeDatabaseSharedLock {
+	bool locked = true;
+
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		if (locked)
+			db_unlock_shared();
+	}
+
+	/**
+	 * Unlock the mutex now, making the destructor a no-op.
+	 */
+	void unlock() {
+		assert(locked);
+
+		db_unlock_shared();
+		locked = false;
+	}
+};
+
 /**
  * Unlock the database while in the current scope.
  */
@@ -121,4 +211,18 @@ public:
 	}
 };
 
+/**
+ * Release the shared database lock while in the current scope.
+ */
+class ScopeDatabaseSharedUnlock {
+public:
+	ScopeDatabaseSharedUnlock() {
+		db_unlock_shared();
+	}
+
+	~ScopeDatabaseSharedUnlock() {
+		db_lock_shared();
+	}
+};
+
 #endif
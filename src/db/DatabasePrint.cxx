@@ -24,15 +24,21 @@
 #include "SongPrint.hxx"
 #include "TimePrint.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseGenerator.hxx"
 #include "Partition.hxx"
+#include "Instance.hxx"
 #include "tag/Tag.hxx"
 #include "LightSong.hxx"
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "DatabaseLock.hxx"
+#include "update/Service.hxx"
 #include "fs/Traits.hxx"
 
 #include <functional>
+#include <limits>
+#include <string>
 
 static const char *
 ApplyBaseFlag(const char *uri, bool base)
@@ -148,28 +154,55 @@ PrintPlaylistFull(Response &r, bool base,
 	return true;
 }
 
-void
-db_selection_print(Response &r, Partition &partition,
-		   const DatabaseSelection &selection,
-		   bool full, bool base,
-		   unsigned window_start, unsigned window_end)
+/**
+ * Print the selection.
+ *
+ * @param check if set, it is invoked before each item is printed; if
+ * it returns false, the item is skipped
+ */
+static void
+PrintSelection(Response &r, Partition &partition,
+	       const DatabaseSelection &selection,
+	       bool full, bool base,
+	       unsigned window_start, unsigned window_end,
+	       const std::function<bool()> &check)
 {
 	const Database &db = partition.GetDatabaseOrThrow();
 
 	unsigned i = 0;
 
 	using namespace std::placeholders;
-	const auto d = selection.filter == nullptr
+	VisitDirectory d = selection.filter == nullptr
 		? std::bind(full ? PrintDirectoryFull : PrintDirectoryBrief,
 			    std::ref(r), base, _1)
 		: VisitDirectory();
 	VisitSong s = std::bind(full ? PrintSongFull : PrintSongBrief,
 				std::ref(r), std::ref(partition), base, _1);
-	const auto p = selection.filter == nullptr
+	VisitPlaylist p = selection.filter == nullptr
 		? std::bind(full ? PrintPlaylistFull : PrintPlaylistBrief,
 			    std::ref(r), base, _1, _2)
 		: VisitPlaylist();
 
+	if (check) {
+		if (d)
+			d = [d, &check](const LightDirectory &directory){
+				if (check())
+					d(directory);
+			};
+
+		s = [s, &check](const LightSong &song){
+			if (check())
+				s(song);
+		};
+
+		if (p)
+			p = [p, &check](const PlaylistInfo &playlist,
+					const LightDirectory &directory){
+				if (check())
+					p(playlist, directory);
+			};
+	}
+
 	if (window_start > 0 ||
 	    window_end < (unsigned)std::numeric_limits<int>::max())
 		s = [s, window_start, window_end, &i](const LightSong &song){
@@ -182,6 +215,16 @@ db_selection_print(Response &r, Partition &partition,
 	db.Visit(selection, d, s, p);
 }
 
+void
+db_selection_print(Response &r, Partition &partition,
+		   const DatabaseSelection &selection,
+		   bool full, bool base,
+		   unsigned window_start, unsigned window_end)
+{
+	PrintSelection(r, partition, selection, full, base,
+		       window_start, window_end, nullptr);
+}
+
 void
 db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
@@ -191,6 +234,127 @@ db_selection_print(Response &r, Partition &partition,
 			   0, std::numeric_limits<int>::max());
 }
 
+/**
+ * Thrown by the visitor to abort Database::Visit() when the output
+ * buffer is full.
+ */
+struct PauseVisit {};
+
+/**
+ * Prints a database selection in several steps.  The database cannot
+ * be locked between two steps, so each step visits it from the
+ * beginning again and skips the items which have already been
+ * printed.  This is only correct if the database has not been
+ * modified meanwhile (a modification may also reorder it).  While
+ * the database is being updated, and after it has been modified
+ * between two steps, the (rest of the) response is therefore printed
+ * in one step, like before responses were generated in the
+ * background.
+ */
+class DatabasePrintGenerator final : public ResponseGenerator {
+	Partition &partition;
+
+	const std::string uri;
+	const bool recursive;
+	const std::unique_ptr<SongFilter> filter;
+
+	const bool full, base;
+	const unsigned window_start, window_end;
+
+	/**
+	 * The number of directories, songs and playlists which have
+	 * already been printed.
+	 */
+	unsigned n_printed = 0;
+
+	/**
+	 * The #db_modification_serial and the update stamp at the
+	 * first step.
+	 */
+	unsigned modification_serial;
+	time_t update_stamp;
+
+	/**
+	 * Print everything in the next step, without pausing when
+	 * the output buffer is full?
+	 */
+	bool one_shot = false;
+
+public:
+	DatabasePrintGenerator(Partition &_partition,
+			       const char *_uri, bool _recursive,
+			       std::unique_ptr<SongFilter> &&_filter,
+			       bool _full, bool _base,
+			       unsigned _window_start, unsigned _window_end)
+		:partition(_partition), uri(_uri), recursive(_recursive),
+		 filter(std::move(_filter)),
+		 full(_full), base(_base),
+		 window_start(_window_start), window_end(_window_end) {}
+
+	/* virtual methods from class ResponseGenerator */
+	virtual bool Generate(Response &r) override;
+};
+
+bool
+DatabasePrintGenerator::Generate(Response &r)
+{
+	const Database &db = partition.GetDatabaseOrThrow();
+
+	if (n_printed == 0) {
+		modification_serial = db_modification_serial;
+		update_stamp = db.GetUpdateStamp();
+
+		/* the update thread modifies the database all the
+		   time; don't pause, because resuming would be
+		   inconsistent */
+		const UpdateService *update = partition.instance.update;
+		one_shot = update != nullptr && update->GetId() != 0;
+	} else if (db_modification_serial != modification_serial ||
+		   db.GetUpdateStamp() != update_stamp)
+		/* the items already printed cannot be located
+		   reliably anymore; don't pause again, so this
+		   happens at most once */
+		one_shot = true;
+
+	unsigned i = 0;
+	const std::function<bool()> check = [this, &r, &i](){
+		if (i++ < n_printed)
+			/* printed by a previous step */
+			return false;
+
+		if (!one_shot && r.IsFull())
+			throw PauseVisit();
+
+		++n_printed;
+		return true;
+	};
+
+	const DatabaseSelection selection(uri.c_str(), recursive,
+					  filter.get());
+
+	try {
+		PrintSelection(r, partition, selection, full, base,
+			       window_start, window_end, check);
+	} catch (const PauseVisit &) {
+		return false;
+	}
+
+	return true;
+}
+
+std::unique_ptr<ResponseGenerator>
+db_selection_print_generator(Partition &partition,
+			     const char *uri, bool recursive,
+			     std::unique_ptr<SongFilter> &&filter,
+			     bool full, bool base,
+			     unsigned window_start, unsigned window_end)
+{
+	return std::unique_ptr<ResponseGenerator>(
+		new DatabasePrintGenerator(partition, uri, recursive,
+					   std::move(filter), full, base,
+					   window_start, window_end));
+}
+
 static bool
 PrintSongURIVisitor(Response &r, Partition &partition, const LightSong &song)
 {
@@ -22,10 +22,13 @@
 
 #include "tag/Mask.hxx"
 
+#include <memory>
+
 class SongFilter;
 struct DatabaseSelection;
 struct Partition;
 class Response;
+class ResponseGenerator;
 
 /**
  * @param full print attributes/tags
@@ -42,6 +45,20 @@ db_selection_print(Response &r, Partition &partition,
 		   bool full, bool base,
 		   unsigned window_start, unsigned window_end);
 
+/**
+ * Create a #ResponseGenerator which prints a selection like
+ * db_selection_print(), but pauses whenever the client's output
+ * buffer is full.
+ *
+ * @param filter an optional song filter
+ */
+std::unique_ptr<ResponseGenerator>
+db_selection_print_generator(Partition &partition,
+			     const char *uri, bool recursive,
+			     std::unique_ptr<SongFilter> &&filter,
+			     bool full, bool base,
+			     unsigned window_start, unsigned window_end);
+
 void
 PrintUniqueTags(Response &r, Partition &partition,
 		unsigned type, tag_mask_t group_mask,
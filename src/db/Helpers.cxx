@@ -23,8 +23,12 @@
 #include "LightSong.hxx"
 #include "tag/Tag.hxx"
 
+#include <functional>
+#include <map>
 #include <set>
+#include <string>
 
+#include <assert.h>
 #include <string.h>
 
 struct StringLess {
@@ -95,3 +99,54 @@ GetStats(const Database &db, const DatabaseSelection &selection)
 	stats.album_count = albums.size();
 	return stats;
 }
+
+typedef std::map<std::string, DatabaseStats> GroupCountMap;
+
+static bool
+CollectGroupCounts(GroupCountMap &map, TagType group, const Tag &tag)
+{
+	bool found = false;
+	for (const auto &item : tag) {
+		if (item.type == group) {
+			auto r = map.insert(std::make_pair(item.value,
+							   DatabaseStats()));
+			DatabaseStats &s = r.first->second;
+			if (r.second)
+				s.Clear();
+
+			++s.song_count;
+			if (!tag.duration.IsNegative())
+				s.total_duration += tag.duration;
+
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static void
+GroupCountVisitor(GroupCountMap &map, TagType group, const LightSong &song)
+{
+	assert(song.tag != nullptr);
+
+	const Tag &tag = *song.tag;
+	if (!CollectGroupCounts(map, group, tag) && group == TAG_ALBUM_ARTIST)
+		/* fall back to "Artist" if no "AlbumArtist" was found */
+		CollectGroupCounts(map, TAG_ARTIST, tag);
+}
+
+void
+VisitGroupCounts(const Database &db, const DatabaseSelection &selection,
+		 TagType group, VisitGroupCount visit)
+{
+	GroupCountMap map;
+
+	using namespace std::placeholders;
+	const auto f = std::bind(GroupCountVisitor, std::ref(map),
+				 group, _1);
+	db.Visit(selection, f);
+
+	for (const auto &i : map)
+		visit(i.first.c_str(), i.second);
+}
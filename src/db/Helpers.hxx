@@ -20,6 +20,9 @@
 #ifndef MPD_MEMORY_DATABASE_PLUGIN_HXX
 #define MPD_MEMORY_DATABASE_PLUGIN_HXX
 
+#include "Visitor.hxx"
+#include "tag/TagType.h"
+
 class Database;
 struct DatabaseSelection;
 struct DatabaseStats;
@@ -27,4 +30,13 @@ struct DatabaseStats;
 DatabaseStats
 GetStats(const Database &db, const DatabaseSelection &selection);
 
+/**
+ * A generic implementation of Database::VisitGroupCounts() which
+ * visits all selected songs.  Songs without an "AlbumArtist" are
+ * counted by their "Artist".
+ */
+void
+VisitGroupCounts(const Database &db, const DatabaseSelection &selection,
+		 TagType group, VisitGroupCount visit);
+
 #endif
@@ -109,6 +109,19 @@ public:
 	gcc_pure
 	virtual DatabaseStats GetStats(const DatabaseSelection &selection) const = 0;
 
+	/**
+	 * Count the selected songs and their total duration, grouped
+	 * by the values of the given tag, in ascending order.
+	 *
+	 * @return false if not implemented; the caller then needs
+	 * to visit all songs, see ::VisitGroupCounts()
+	 */
+	virtual bool VisitGroupCounts(gcc_unused const DatabaseSelection &selection,
+				      gcc_unused TagType group,
+				      gcc_unused VisitGroupCount visit) const {
+		return false;
+	}
+
 	/**
 	 * Update the database.
 	 *
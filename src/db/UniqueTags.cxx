@@ -37,16 +37,25 @@ CollectTags(TagSet &set, TagType tag_type, tag_mask_t group_mask,
 }
 
 void
-VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
-		TagType tag_type, tag_mask_t group_mask,
-		VisitTag visit_tag)
+CollectUniqueTags(TagSet &set,
+		  const Database &db, const DatabaseSelection &selection,
+		  TagType tag_type, tag_mask_t group_mask)
 {
-	TagSet set;
+	set.clear();
 
 	using namespace std::placeholders;
 	const auto f = std::bind(CollectTags, std::ref(set),
 				 tag_type, group_mask, _1);
 	db.Visit(selection, f);
+}
+
+void
+VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
+		TagType tag_type, tag_mask_t group_mask,
+		VisitTag visit_tag)
+{
+	TagSet set;
+	CollectUniqueTags(set, db, selection, tag_type, group_mask);
 
 	for (const auto &value : set)
 		visit_tag(value);
@@ -25,8 +25,18 @@
 #include "tag/Mask.hxx"
 
 class Database;
+class TagSet;
 struct DatabaseSelection;
 
+/**
+ * Collect the unique tag values of all selected songs into a
+ * #TagSet, which is cleared first.
+ */
+void
+CollectUniqueTags(TagSet &set,
+		  const Database &db, const DatabaseSelection &selection,
+		  TagType tag_type, tag_mask_t group_mask);
+
 void
 VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
 		TagType tag_type, tag_mask_t group_mask,
@@ -26,6 +26,7 @@ struct LightDirectory;
 struct LightSong;
 struct PlaylistInfo;
 struct Tag;
+struct DatabaseStats;
 
 typedef std::function<void(const LightDirectory &)> VisitDirectory;
 typedef std::function<void(const LightSong &)> VisitSong;
@@ -34,4 +35,12 @@ typedef std::function<void(const PlaylistInfo &,
 
 typedef std::function<void(const Tag &)> VisitTag;
 
+/**
+ * Receives one group of "count group".  Only
+ * DatabaseStats::song_count and DatabaseStats::total_duration are
+ * set.
+ */
+typedef std::function<void(const char *value,
+			   const DatabaseStats &stats)> VisitGroupCount;
+
 #endif
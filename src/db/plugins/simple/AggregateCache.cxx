@@ -0,0 +1,135 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "AggregateCache.hxx"
+#include "tag/Set.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+/**
+ * Does one of the two URIs contain the other one?
+ */
+gcc_pure
+static bool
+IsRelated(const std::string &a, const char *b)
+{
+	const size_t a_length = a.length(), b_length = strlen(b);
+	const size_t length = std::min(a_length, b_length);
+
+	if (memcmp(a.data(), b, length) != 0)
+		return false;
+
+	const char *longer = a_length > b_length ? a.c_str() : b;
+	return length == 0 || longer[length] == 0 || longer[length] == '/';
+}
+
+template<typename M>
+static void
+EraseRelated(M &map, const char *uri)
+{
+	for (auto i = map.begin(); i != map.end();) {
+		if (IsRelated(i->first.uri, uri))
+			i = map.erase(i);
+		else
+			++i;
+	}
+}
+
+template<typename M>
+static typename M::mapped_type
+Get(const M &map, const typename M::key_type &key)
+{
+	auto i = map.find(key);
+	return i != map.end()
+		? i->second
+		: nullptr;
+}
+
+AggregateCache::AggregateCache() = default;
+AggregateCache::~AggregateCache() = default;
+
+std::shared_ptr<const TagSet>
+AggregateCache::GetUniqueTags(const char *uri, TagType type,
+			      tag_mask_t group_mask) const
+{
+	const ScopeLock protect(mutex);
+	return Get(unique_tags, UniqueTagsKey{uri, type, group_mask});
+}
+
+void
+AggregateCache::PutUniqueTags(unsigned _generation, const char *uri,
+			      TagType type, tag_mask_t group_mask,
+			      std::shared_ptr<const TagSet> value)
+{
+	const ScopeLock protect(mutex);
+
+	if (_generation == generation && unique_tags.size() < MAX_ENTRIES)
+		unique_tags[UniqueTagsKey{uri, type, group_mask}] =
+			std::move(value);
+}
+
+std::shared_ptr<const AggregateCache::GroupCounts>
+AggregateCache::GetGroupCounts(const char *uri, TagType group) const
+{
+	const ScopeLock protect(mutex);
+	return Get(group_counts, GroupCountsKey{uri, group});
+}
+
+void
+AggregateCache::PutGroupCounts(unsigned _generation, const char *uri,
+			       TagType group,
+			       std::shared_ptr<const GroupCounts> value)
+{
+	const ScopeLock protect(mutex);
+
+	if (_generation == generation && group_counts.size() < MAX_ENTRIES)
+		group_counts[GroupCountsKey{uri, group}] = std::move(value);
+}
+
+void
+AggregateCache::Invalidate(const char *uri)
+{
+	const ScopeLock protect(mutex);
+
+	++generation;
+
+	if (unique_tags.size() >= MAX_ENTRIES)
+		unique_tags.clear();
+	else
+		EraseRelated(unique_tags, uri);
+
+	if (group_counts.size() >= MAX_ENTRIES)
+		group_counts.clear();
+	else
+		EraseRelated(group_counts, uri);
+}
+
+void
+AggregateCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	++generation;
+	unique_tags.clear();
+	group_counts.clear();
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_AGGREGATE_CACHE_HXX
+#define MPD_AGGREGATE_CACHE_HXX
+
+#include "check.h"
+#include "db/Stats.hxx"
+#include "tag/TagType.h"
+#include "tag/Mask.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TagSet;
+
+/**
+ * Remembers the results of "list" and "count group" on a
+ * #SimpleDatabase, so clients browsing the library repeatedly don't
+ * make it visit all songs each time.  Only selections without a
+ * filter (other than "base") are cached.
+ *
+ * The #DatabaseEditor invalidates the results of the selections
+ * which overlap with each modified directory; results for unrelated
+ * parts of the tree are kept.
+ *
+ * All methods are thread-safe.
+ */
+class AggregateCache {
+public:
+	typedef std::vector<std::pair<std::string, DatabaseStats>> GroupCounts;
+
+private:
+	/**
+	 * Stop adding entries when there are this many; they are
+	 * all discarded with the next invalidation.
+	 */
+	static constexpr size_t MAX_ENTRIES = 64;
+
+	struct UniqueTagsKey {
+		std::string uri;
+		TagType type;
+		tag_mask_t group_mask;
+
+		gcc_pure
+		bool operator<(const UniqueTagsKey &other) const {
+			if (type != other.type)
+				return type < other.type;
+			if (group_mask != other.group_mask)
+				return group_mask < other.group_mask;
+			return uri < other.uri;
+		}
+	};
+
+	struct GroupCountsKey {
+		std::string uri;
+		TagType group;
+
+		gcc_pure
+		bool operator<(const GroupCountsKey &other) const {
+			if (group != other.group)
+				return group < other.group;
+			return uri < other.uri;
+		}
+	};
+
+	mutable Mutex mutex;
+
+	/**
+	 * Incremented by each invalidation.  A result which was
+	 * computed while the database was being modified must not be
+	 * stored.
+	 */
+	unsigned generation = 0;
+
+	std::map<UniqueTagsKey, std::shared_ptr<const TagSet>> unique_tags;
+	std::map<GroupCountsKey, std::shared_ptr<const GroupCounts>> group_counts;
+
+public:
+	AggregateCache();
+	~AggregateCache();
+
+	AggregateCache(const AggregateCache &) = delete;
+	AggregateCache &operator=(const AggregateCache &) = delete;
+
+	/**
+	 * Obtain the current generation before computing a result
+	 * which shall be passed to Put().
+	 */
+	gcc_pure
+	unsigned GetGeneration() const {
+		const ScopeLock protect(mutex);
+		return generation;
+	}
+
+	gcc_pure
+	std::shared_ptr<const TagSet> GetUniqueTags(const char *uri,
+						    TagType type,
+						    tag_mask_t group_mask) const;
+
+	void PutUniqueTags(unsigned generation, const char *uri,
+			   TagType type, tag_mask_t group_mask,
+			   std::shared_ptr<const TagSet> value);
+
+	gcc_pure
+	std::shared_ptr<const GroupCounts> GetGroupCounts(const char *uri,
+							  TagType group) const;
+
+	void PutGroupCounts(unsigned generation, const char *uri,
+			    TagType group,
+			    std::shared_ptr<const GroupCounts> value);
+
+	/**
+	 * Discard all results of selections which contain the given
+	 * directory (or song) or are contained in it.
+	 *
+	 * @param uri the URI of the modified directory; the empty
+	 * string is the root
+	 */
+	void Invalidate(const char *uri);
+
+	void Clear();
+};
+
+#endif
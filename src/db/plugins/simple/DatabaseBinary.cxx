@@ -0,0 +1,738 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/PlaylistVector.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagItem.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/Settings.hxx"
+#include "fs/Charset.hxx"
+#include "fs/Path.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/RuntimeError.hxx"
+
+#ifndef WIN32
+#include "system/Error.hxx"
+#endif
+
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+static constexpr char BINARY_DB_MAGIC[8] = {
+	'M', 'P', 'D', '-', 'D', 'B', '\0', '\x01',
+};
+
+static constexpr uint32_t BINARY_DB_VERSION = 1;
+
+/**
+ * The file is written in host byte order; this value detects a file
+ * which was written on a host with a different byte order.
+ */
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/**
+ * The #BinaryDirectory::parent value of the root directory.
+ */
+static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+/**
+ * Values for #BinaryDirectory::type.
+ */
+enum BinaryDirectoryType : uint32_t {
+	REGULAR,
+	ARCHIVE,
+	CONTAINER,
+};
+
+/**
+ * All "string" attributes are byte offsets into the string table,
+ * which is a sequence of null-terminated strings.  All other
+ * references are indexes into the respective record array.  Each
+ * array begins at an offset which is a multiple of 8.
+ */
+struct BinaryHeader {
+	char magic[sizeof(BINARY_DB_MAGIC)];
+	uint32_t version;
+	uint32_t byte_order;
+
+	/**
+	 * The tags which were enabled when the file was written
+	 * (bit mask of #TagType).
+	 */
+	uint64_t tag_mask;
+
+	/* strings */
+	uint32_t mpd_version, fs_charset;
+
+	uint32_t n_items, n_directories, n_songs, n_song_items;
+	uint32_t n_playlists, reserved;
+
+	uint64_t strings_offset, strings_size;
+	uint64_t items_offset, directories_offset, songs_offset;
+	uint64_t song_items_offset, playlists_offset;
+};
+
+struct BinaryItem {
+	uint32_t type;
+
+	/* string */
+	uint32_t value;
+};
+
+/**
+ * Directories are stored in pre-order, starting with the root
+ * directory, so each parent comes before its children.
+ */
+struct BinaryDirectory {
+	uint32_t parent;
+
+	/* string */
+	uint32_t name;
+
+	uint32_t type, reserved;
+
+	int64_t mtime;
+};
+
+struct BinarySong {
+	uint32_t directory;
+
+	/* string */
+	uint32_t uri;
+
+	/**
+	 * The song's items are song_items[first_item .. first_item +
+	 * n_items]; each of them is an index into the item table.
+	 */
+	uint32_t first_item;
+	uint16_t n_items;
+
+	uint8_t has_playlist, reserved;
+
+	int32_t duration_ms;
+	uint32_t start_ms, end_ms;
+	uint32_t reserved2;
+
+	int64_t mtime;
+};
+
+struct BinaryPlaylist {
+	uint32_t directory;
+
+	/* string */
+	uint32_t name;
+
+	int64_t mtime;
+};
+
+static constexpr size_t BINARY_ALIGN = 8;
+
+static_assert(sizeof(BinaryHeader) % BINARY_ALIGN == 0, "");
+static_assert(sizeof(BinaryDirectory) % BINARY_ALIGN == 0, "");
+static_assert(sizeof(BinarySong) % BINARY_ALIGN == 0, "");
+static_assert(sizeof(BinaryPlaylist) % BINARY_ALIGN == 0, "");
+
+bool
+db_is_binary(Path path)
+{
+	try {
+		FileReader reader(path);
+		char magic[sizeof(BINARY_DB_MAGIC)];
+		return reader.Read(magic, sizeof(magic)) == sizeof(magic) &&
+			memcmp(magic, BINARY_DB_MAGIC, sizeof(magic)) == 0;
+	} catch (const std::runtime_error &) {
+		return false;
+	}
+}
+
+/**
+ * Collects all records in memory, deduplicating strings and tag
+ * items, and then writes the file in one go.
+ */
+class BinaryDatabaseWriter {
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> string_ids;
+
+	/**
+	 * Maps #TagItem pointers (which are shared by the #TagPool)
+	 * and (type, string) pairs to item table indexes.
+	 */
+	std::unordered_map<const TagItem *, uint32_t> item_pointer_ids;
+	std::unordered_map<uint64_t, uint32_t> item_ids;
+
+	std::vector<BinaryItem> items;
+	std::vector<BinaryDirectory> directories;
+	std::vector<BinarySong> songs;
+	std::vector<uint32_t> song_items;
+	std::vector<BinaryPlaylist> playlists;
+
+public:
+	void AddDirectory(const Directory &directory, uint32_t parent);
+
+	void Write(OutputStream &os);
+
+private:
+	uint32_t String(const char *s);
+	uint32_t Item(const TagItem &item);
+
+	void AddSong(const Song &song, uint32_t directory);
+};
+
+uint32_t
+BinaryDatabaseWriter::String(const char *s)
+{
+	auto r = string_ids.emplace(s, strings.size());
+	if (r.second) {
+		if (strings.size() + strlen(s) >= UINT32_MAX)
+			throw std::runtime_error("Database too large");
+
+		strings.append(s);
+		strings.push_back('\0');
+	}
+
+	return r.first->second;
+}
+
+uint32_t
+BinaryDatabaseWriter::Item(const TagItem &item)
+{
+	auto i = item_pointer_ids.find(&item);
+	if (i != item_pointer_ids.end())
+		return i->second;
+
+	const uint32_t value = String(item.value);
+	auto r = item_ids.emplace((uint64_t(value) << 8) | item.type,
+				  items.size());
+	if (r.second)
+		items.push_back({uint32_t(item.type), value});
+
+	item_pointer_ids.emplace(&item, r.first->second);
+	return r.first->second;
+}
+
+inline void
+BinaryDatabaseWriter::AddSong(const Song &song, uint32_t directory)
+{
+	const Tag &tag = song.tag;
+
+	BinarySong s;
+	memset(&s, 0, sizeof(s));
+	s.directory = directory;
+	s.uri = String(song.uri);
+	s.first_item = song_items.size();
+	s.n_items = tag.num_items;
+	s.has_playlist = tag.has_playlist;
+	s.duration_ms = tag.duration.count();
+	s.start_ms = song.start_time.ToMS();
+	s.end_ms = song.end_time.ToMS();
+	s.mtime = song.mtime;
+	songs.push_back(s);
+
+	for (const auto &item : tag)
+		song_items.push_back(Item(item));
+}
+
+static constexpr uint32_t
+ToBinaryDirectoryType(unsigned device)
+{
+	return device == DEVICE_INARCHIVE
+		? ARCHIVE
+		: (device == DEVICE_CONTAINER
+		   ? CONTAINER
+		   : REGULAR);
+}
+
+void
+BinaryDatabaseWriter::AddDirectory(const Directory &directory,
+				   uint32_t parent)
+{
+	const uint32_t index = directories.size();
+
+	BinaryDirectory d;
+	memset(&d, 0, sizeof(d));
+	d.parent = parent;
+	d.name = String(directory.IsRoot() ? "" : directory.GetName());
+	d.type = ToBinaryDirectoryType(directory.device);
+	d.mtime = directory.mtime;
+	directories.push_back(d);
+
+	for (const auto &song : directory.songs)
+		AddSong(song, index);
+
+	for (const auto &playlist : directory.playlists)
+		playlists.push_back({index, String(playlist.name.c_str()),
+				     int64_t(playlist.mtime)});
+
+	/* mounted databases are not part of this file; their mount
+	   points are restored from the state file */
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			AddDirectory(child, index);
+}
+
+/**
+ * Round up to a multiple of #BINARY_ALIGN.
+ */
+static constexpr uint64_t
+AlignBinary(uint64_t offset)
+{
+	return (offset + BINARY_ALIGN - 1) & ~uint64_t(BINARY_ALIGN - 1);
+}
+
+/**
+ * Write a section and pad it to a multiple of #BINARY_ALIGN.
+ */
+static uint64_t
+WriteSection(OutputStream &os, uint64_t offset,
+	     const void *data, size_t size)
+{
+	static constexpr uint8_t padding[BINARY_ALIGN] = {};
+
+	os.Write(data, size);
+
+	const uint64_t end = offset + size;
+	const uint64_t aligned = AlignBinary(end);
+	os.Write(padding, aligned - end);
+	return aligned;
+}
+
+template<typename T>
+static uint64_t
+WriteSection(OutputStream &os, uint64_t offset, const std::vector<T> &v)
+{
+	return WriteSection(os, offset, v.data(), v.size() * sizeof(T));
+}
+
+void
+BinaryDatabaseWriter::Write(OutputStream &os)
+{
+	BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.version = BINARY_DB_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.tag_mask = global_tag_mask;
+	header.mpd_version = String(VERSION);
+	header.fs_charset = String(GetFSCharset());
+
+	header.n_items = items.size();
+	header.n_directories = directories.size();
+	header.n_songs = songs.size();
+	header.n_song_items = song_items.size();
+	header.n_playlists = playlists.size();
+
+	header.strings_offset = sizeof(header);
+	header.strings_size = strings.size();
+	header.items_offset = AlignBinary(header.strings_offset +
+					  header.strings_size);
+	header.directories_offset =
+		AlignBinary(header.items_offset +
+			    items.size() * sizeof(BinaryItem));
+	header.songs_offset =
+		AlignBinary(header.directories_offset +
+			    directories.size() * sizeof(BinaryDirectory));
+	header.song_items_offset =
+		AlignBinary(header.songs_offset +
+			    songs.size() * sizeof(BinarySong));
+	header.playlists_offset =
+		AlignBinary(header.song_items_offset +
+			    song_items.size() * sizeof(uint32_t));
+
+	uint64_t offset = WriteSection(os, 0, &header, sizeof(header));
+	offset = WriteSection(os, offset, strings.data(), strings.size());
+	offset = WriteSection(os, offset, items);
+	offset = WriteSection(os, offset, directories);
+	offset = WriteSection(os, offset, songs);
+	offset = WriteSection(os, offset, song_items);
+	WriteSection(os, offset, playlists);
+}
+
+void
+db_save_binary(OutputStream &os, const Directory &root)
+{
+	assert(root.IsRoot());
+
+	BinaryDatabaseWriter writer;
+	writer.AddDirectory(root, NO_PARENT);
+	writer.Write(os);
+}
+
+/**
+ * The whole database file in memory: mapped on POSIX, read into a
+ * buffer elsewhere.
+ */
+class BinaryDatabaseFile {
+	const uint8_t *data;
+	size_t size;
+
+#ifdef WIN32
+	std::unique_ptr<uint8_t[]> buffer;
+#endif
+
+public:
+	explicit BinaryDatabaseFile(Path path);
+
+#ifndef WIN32
+	~BinaryDatabaseFile() {
+		munmap(const_cast<uint8_t *>(data), size);
+	}
+#endif
+
+	BinaryDatabaseFile(const BinaryDatabaseFile &) = delete;
+	BinaryDatabaseFile &operator=(const BinaryDatabaseFile &) = delete;
+
+	const BinaryHeader &GetHeader() const {
+		return *(const BinaryHeader *)data;
+	}
+
+	/**
+	 * Returns an array of records, after checking that it lies
+	 * within the file.
+	 */
+	template<typename T>
+	ConstBuffer<T> GetArray(uint64_t offset, uint64_t n) const {
+		if (offset % BINARY_ALIGN != 0 || offset > size ||
+		    n > (size - offset) / sizeof(T))
+			throw std::runtime_error("Database corrupted");
+
+		return {(const T *)(data + offset), size_t(n)};
+	}
+};
+
+BinaryDatabaseFile::BinaryDatabaseFile(Path path)
+{
+	FileReader reader(path);
+
+	const uint64_t file_size = reader.GetSize();
+	if (file_size < sizeof(BinaryHeader) || file_size > SIZE_MAX)
+		throw std::runtime_error("Database corrupted");
+
+	size = file_size;
+
+#ifdef WIN32
+	buffer.reset(new uint8_t[size]);
+	for (size_t position = 0; position < size;) {
+		size_t nbytes = reader.Read(buffer.get() + position,
+					    size - position);
+		if (nbytes == 0)
+			throw std::runtime_error("Unexpected end of file");
+		position += nbytes;
+	}
+
+	data = buffer.get();
+#else
+	void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map the database file");
+
+	/* the whole file will be read exactly once */
+	madvise(p, size, MADV_SEQUENTIAL|MADV_WILLNEED);
+
+	data = (const uint8_t *)p;
+#endif
+}
+
+/**
+ * Create the directories, songs and playlists described by a
+ * #BinaryDatabaseFile.
+ */
+class BinaryDatabaseLoader {
+	const BinaryHeader &header;
+
+	ConstBuffer<char> strings;
+	ConstBuffer<BinaryItem> items;
+	ConstBuffer<BinaryDirectory> directories;
+	ConstBuffer<BinarySong> songs;
+	ConstBuffer<uint32_t> song_items;
+	ConstBuffer<BinaryPlaylist> playlists;
+
+	/**
+	 * The #Directory objects, indexed like #directories.
+	 */
+	std::vector<Directory *> directory_objects;
+
+	/**
+	 * A reference to a pooled #TagItem for each entry of
+	 * #items, or nullptr if its tag type is disabled.
+	 */
+	std::vector<TagItem *> item_objects;
+
+public:
+	explicit BinaryDatabaseLoader(const BinaryDatabaseFile &file);
+
+	void CheckInfo() const;
+
+	/**
+	 * Caller must lock the #db_mutex.
+	 */
+	void Load(Directory &root);
+
+private:
+	gcc_pure
+	const char *GetString(uint32_t id) const {
+		if (id >= strings.size)
+			throw std::runtime_error("Database corrupted");
+
+		return strings.data + id;
+	}
+
+	void LoadItems();
+	void ReleaseItems();
+
+	void LoadDirectories(Directory &root);
+
+	void LoadSongs();
+
+	void LoadPlaylists();
+};
+
+BinaryDatabaseLoader::BinaryDatabaseLoader(const BinaryDatabaseFile &file)
+	:header(file.GetHeader())
+{
+	if (memcmp(header.magic, BINARY_DB_MAGIC, sizeof(header.magic)) != 0)
+		throw std::runtime_error("Database corrupted");
+
+	if (header.byte_order != BYTE_ORDER_MARK)
+		throw std::runtime_error("Database byte order mismatch, "
+					 "discarding database file");
+
+	if (header.version != BINARY_DB_VERSION)
+		throw std::runtime_error("Database format mismatch, "
+					 "discarding database file");
+
+	strings = file.GetArray<char>(header.strings_offset,
+				      header.strings_size);
+	if (strings.IsEmpty() || strings.back() != 0)
+		/* the last string must be terminated */
+		throw std::runtime_error("Database corrupted");
+
+	items = file.GetArray<BinaryItem>(header.items_offset,
+					  header.n_items);
+	directories = file.GetArray<BinaryDirectory>(header.directories_offset,
+						     header.n_directories);
+	songs = file.GetArray<BinarySong>(header.songs_offset,
+					  header.n_songs);
+	song_items = file.GetArray<uint32_t>(header.song_items_offset,
+					     header.n_song_items);
+	playlists = file.GetArray<BinaryPlaylist>(header.playlists_offset,
+						  header.n_playlists);
+}
+
+void
+BinaryDatabaseLoader::CheckInfo() const
+{
+	const char *new_charset = GetString(header.fs_charset);
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0)
+		throw FormatRuntimeError("Existing database has charset "
+					 "\"%s\" instead of \"%s\"; "
+					 "discarding database file",
+					 new_charset, old_charset);
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i) && (header.tag_mask & (1u << i)) == 0)
+			throw std::runtime_error("Tag list mismatch, "
+						 "discarding database file");
+}
+
+inline void
+BinaryDatabaseLoader::LoadItems()
+{
+	item_objects.reserve(items.size);
+
+	for (const auto &i : items) {
+		if (i.type >= TAG_NUM_OF_ITEM_TYPES)
+			throw std::runtime_error("Database corrupted");
+
+		const TagType type = TagType(i.type);
+		const char *value = GetString(i.value);
+
+		item_objects.push_back(IsTagEnabled(type)
+				       ? tag_pool_get_item(type, value)
+				       : nullptr);
+	}
+}
+
+inline void
+BinaryDatabaseLoader::ReleaseItems()
+{
+	for (TagItem *item : item_objects)
+		if (item != nullptr)
+			tag_pool_put_item(item);
+
+	item_objects.clear();
+}
+
+static constexpr unsigned
+FromBinaryDirectoryType(uint32_t type)
+{
+	return type == ARCHIVE
+		? DEVICE_INARCHIVE
+		: (type == CONTAINER
+		   ? DEVICE_CONTAINER
+		   : 0);
+}
+
+inline void
+BinaryDatabaseLoader::LoadDirectories(Directory &root)
+{
+	if (directories.IsEmpty() || directories.front().parent != NO_PARENT)
+		throw std::runtime_error("Database corrupted");
+
+	directory_objects.reserve(directories.size);
+	directory_objects.push_back(&root);
+
+	for (size_t i = 1; i < directories.size; ++i) {
+		const auto &d = directories[i];
+
+		/* the parent must have been created already */
+		if (d.parent >= i)
+			throw std::runtime_error("Database corrupted");
+
+		Directory &parent = *directory_objects[d.parent];
+		const char *name = GetString(d.name);
+		if (*name == 0 || strchr(name, '/') != nullptr)
+			throw std::runtime_error("Database corrupted");
+
+		if (parent.FindChild(name) != nullptr)
+			throw FormatRuntimeError("Duplicate subdirectory '%s'",
+						 name);
+
+		Directory *directory = parent.CreateChild(name);
+		directory->device = FromBinaryDirectoryType(d.type);
+		directory->mtime = d.mtime;
+		directory_objects.push_back(directory);
+	}
+}
+
+inline void
+BinaryDatabaseLoader::LoadSongs()
+{
+	for (const auto &s : songs) {
+		if (s.directory >= directory_objects.size() ||
+		    s.first_item > song_items.size ||
+		    s.n_items > song_items.size - s.first_item ||
+		    s.n_items > std::numeric_limits<decltype(Tag::num_items)>::max())
+			throw std::runtime_error("Database corrupted");
+
+		Directory &directory = *directory_objects[s.directory];
+		const char *uri = GetString(s.uri);
+		if (*uri == 0)
+			throw std::runtime_error("Database corrupted");
+
+		if (directory.FindSong(uri) != nullptr)
+			throw FormatRuntimeError("Duplicate song '%s'", uri);
+
+		const uint32_t *item_ids = &song_items[s.first_item];
+
+		unsigned n_items = 0;
+		for (unsigned i = 0; i < s.n_items; ++i) {
+			if (item_ids[i] >= item_objects.size())
+				throw std::runtime_error("Database corrupted");
+
+			if (item_objects[item_ids[i]] != nullptr)
+				++n_items;
+		}
+
+		Song *song = Song::NewFile(uri, directory);
+		song->mtime = s.mtime;
+		song->start_time = SongTime::FromMS(s.start_ms);
+		song->end_time = SongTime::FromMS(s.end_ms);
+
+		Tag &tag = song->tag;
+		tag.duration = SignedSongTime::FromMS(s.duration_ms);
+		tag.has_playlist = s.has_playlist;
+
+		if (n_items > 0) {
+			tag.items = new TagItem *[n_items];
+			for (unsigned i = 0; i < s.n_items; ++i) {
+				TagItem *item = item_objects[item_ids[i]];
+				if (item != nullptr)
+					tag.items[tag.num_items++] =
+						tag_pool_dup_item(item);
+			}
+		}
+
+		directory.AddSong(song);
+	}
+}
+
+inline void
+BinaryDatabaseLoader::LoadPlaylists()
+{
+	for (const auto &p : playlists) {
+		if (p.directory >= directory_objects.size())
+			throw std::runtime_error("Database corrupted");
+
+		directory_objects[p.directory]->playlists
+			.push_back(PlaylistInfo(GetString(p.name),
+						time_t(p.mtime)));
+	}
+}
+
+void
+BinaryDatabaseLoader::Load(Directory &root)
+{
+	LoadDirectories(root);
+
+	{
+		/* LoadItems() may throw after having obtained some
+		   of the references */
+		AtScopeExit(this) { ReleaseItems(); };
+
+		LoadItems();
+		LoadSongs();
+	}
+
+	LoadPlaylists();
+}
+
+void
+db_load_binary(Path path, Directory &root)
+{
+	const BinaryDatabaseFile file(path);
+
+	BinaryDatabaseLoader loader(file);
+	loader.CheckInfo();
+
+	const ScopeDatabaseLock protect;
+	loader.Load(root);
+}
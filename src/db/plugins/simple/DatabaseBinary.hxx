@@ -0,0 +1,56 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+struct Directory;
+class Path;
+class OutputStream;
+
+/*
+ * A binary database format which can be loaded much faster than the
+ * text format (DatabaseSave.hxx): all strings are stored once in a
+ * string table, each distinct tag item is stored once in an item
+ * table, and directories, songs and playlists are arrays of
+ * fixed-size records which refer to those tables.  The file is
+ * mapped into memory and converted to #Directory and #Song objects
+ * without parsing.
+ */
+
+/**
+ * Does the specified file look like a database in the binary format?
+ * Returns false if the file cannot be read.
+ */
+bool
+db_is_binary(Path path);
+
+/**
+ * Throws std::exception on error.
+ */
+void
+db_save_binary(OutputStream &os, const Directory &root);
+
+/**
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_binary(Path path, Directory &root);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseJournal.hxx"
+#include "Directory.hxx"
+#include "DirectorySave.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/StringCompare.hxx"
+#include "util/NumberParser.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+#define JOURNAL_VERSION "journal: 1"
+#define JOURNAL_DB_SIZE "db_size: "
+#define JOURNAL_DB_MTIME "db_mtime: "
+#define JOURNAL_COMMIT_BEGIN "commit_begin"
+#define JOURNAL_COMMIT_END "commit_end"
+#define JOURNAL_DELETE "delete: "
+#define JOURNAL_UPDATE "update: "
+
+static constexpr Domain journal_domain("journal");
+
+DatabaseJournal::DatabaseJournal(Path db_path)
+	:path(AllocatedPath::FromFS(PathTraitsFS::string(db_path.c_str()) +
+				    PATH_LITERAL(".journal"))) {}
+
+/**
+ * Erase the given URI and all URIs below it from the set.
+ */
+static void
+EraseTree(std::set<std::string> &set, const std::string &uri)
+{
+	for (auto i = set.lower_bound(uri);
+	     i != set.end() && StringStartsWith(i->c_str(), uri.c_str());) {
+		if (i->length() == uri.length() || (*i)[uri.length()] == '/')
+			i = set.erase(i);
+		else
+			++i;
+	}
+}
+
+void
+DatabaseJournal::MarkModified(const Directory &directory)
+{
+	modified.emplace(directory.GetPath());
+}
+
+void
+DatabaseJournal::MarkDeleted(const Directory &directory)
+{
+	assert(!directory.IsRoot());
+
+	const std::string uri(directory.GetPath());
+	EraseTree(modified, uri);
+	EraseTree(deleted, uri);
+	deleted.emplace(uri);
+}
+
+void
+DatabaseJournal::Write(Directory &root, const FileInfo &db_info)
+{
+	/* look up the modified directories first; after that, the
+	   tree can be serialized without holding the lock, because
+	   only this (the update) thread modifies it */
+	std::vector<const Directory *> directories;
+	directories.reserve(modified.size());
+
+	{
+		const ScopeDatabaseSharedLock protect;
+
+		for (const auto &uri : modified) {
+			const auto r = root.LookupDirectory(uri.c_str());
+			if (r.uri == nullptr && !r.directory->IsMount())
+				directories.push_back(r.directory);
+		}
+	}
+
+	const bool create = !FileExists(path);
+
+	FileOutputStream fos(path, FileOutputStream::Mode::APPEND_OR_CREATE);
+	BufferedOutputStream os(fos);
+
+	if (create)
+		os.Format(JOURNAL_VERSION "\n"
+			  JOURNAL_DB_SIZE "%llu\n"
+			  JOURNAL_DB_MTIME "%lu\n",
+			  (unsigned long long)db_info.GetSize(),
+			  (unsigned long)db_info.GetModificationTime());
+
+	os.Write(JOURNAL_COMMIT_BEGIN "\n");
+
+	for (const auto &uri : deleted)
+		os.Format(JOURNAL_DELETE "%s\n", uri.c_str());
+
+	for (const Directory *directory : directories) {
+		os.Format(JOURNAL_UPDATE "%s\n", directory->GetPath());
+		directory_save_shallow(os, *directory);
+	}
+
+	os.Write(JOURNAL_COMMIT_END "\n");
+
+	os.Flush();
+	fos.Commit();
+
+	FormatDebug(journal_domain,
+		    "wrote %u modified and %u deleted directories",
+		    unsigned(directories.size()), unsigned(deleted.size()));
+
+	Clear();
+}
+
+/**
+ * Does the journal belong to the given database file?
+ */
+static bool
+CheckHeader(TextFile &file, const FileInfo &db_info)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || strcmp(line, JOURNAL_VERSION) != 0)
+		return false;
+
+	const char *p;
+	line = file.ReadLine();
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_DB_SIZE)) == nullptr ||
+	    ParseUint64(p) != db_info.GetSize())
+		return false;
+
+	line = file.ReadLine();
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_DB_MTIME)) == nullptr ||
+	    time_t(ParseUint64(p)) != db_info.GetModificationTime())
+		return false;
+
+	return true;
+}
+
+/**
+ * Count the complete commits in the journal.
+ */
+static unsigned
+CountCommits(Path path)
+{
+	TextFile file(path);
+
+	unsigned n = 0;
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr)
+		if (strcmp(line, JOURNAL_COMMIT_END) == 0)
+			++n;
+
+	return n;
+}
+
+/**
+ * Look up a directory by its URI, and create it (and its missing
+ * ancestors) if it does not exist.
+ */
+static Directory &
+MakeDirectory(Directory &root, const char *uri)
+{
+	Directory *directory = &root;
+
+	while (*uri != 0) {
+		const char *slash = strchr(uri, '/');
+		const std::string name = slash != nullptr
+			? std::string(uri, slash)
+			: std::string(uri);
+
+		directory = directory->MakeChild(name.c_str());
+
+		if (slash == nullptr)
+			break;
+
+		uri = slash + 1;
+	}
+
+	return *directory;
+}
+
+static void
+ReplayCommit(TextFile &file, Directory &root)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || strcmp(line, JOURNAL_COMMIT_BEGIN) != 0)
+		throw std::runtime_error("Malformed database journal");
+
+	while ((line = file.ReadLine()) != nullptr &&
+	       strcmp(line, JOURNAL_COMMIT_END) != 0) {
+		const char *p;
+		if ((p = StringAfterPrefix(line, JOURNAL_DELETE))) {
+			const auto r = root.LookupDirectory(p);
+			if (r.uri == nullptr && !r.directory->IsRoot())
+				r.directory->Delete();
+		} else if ((p = StringAfterPrefix(line, JOURNAL_UPDATE))) {
+			directory_load_shallow(file, MakeDirectory(root, p));
+		} else
+			throw FormatRuntimeError("Malformed line: %s", line);
+	}
+}
+
+bool
+DatabaseJournal::Replay(Directory &root, const FileInfo &db_info)
+{
+	if (!FileExists(path))
+		return true;
+
+	const unsigned n_commits = CountCommits(path);
+
+	TextFile file(path);
+
+	if (!CheckHeader(file, db_info)) {
+		LogDefault(journal_domain, "discarding stale database journal");
+		Delete();
+		return true;
+	}
+
+	for (unsigned i = 0; i < n_commits; ++i)
+		ReplayCommit(file, root);
+
+	if (n_commits > 0)
+		root.Sort();
+
+	FormatDebug(journal_domain, "replayed %u commits", n_commits);
+
+	if (file.ReadLine() != nullptr) {
+		LogWarning(journal_domain,
+			   "ignoring incomplete commit at the end of the database journal");
+		return false;
+	}
+
+	return true;
+}
+
+void
+DatabaseJournal::Delete()
+{
+	if (!FileExists(path))
+		return;
+
+	try {
+		RemoveFile(path);
+	} catch (const std::exception &e) {
+		LogError(e);
+	}
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+#include "check.h"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <set>
+#include <string>
+
+struct Directory;
+class FileInfo;
+
+/**
+ * An append-only log of changes to a #SimpleDatabase, which allows
+ * saving an update without rewriting the whole database file.
+ *
+ * Each commit lists the directories which were deleted, followed by
+ * the properties, songs and playlists of the directories which were
+ * modified (see directory_save_shallow()).  On startup, the commits
+ * are replayed on top of the database file; an incomplete commit at
+ * the end (e.g. after a crash) is ignored.  The journal starts with
+ * the size and modification time of the database file it belongs
+ * to, and if they don't match (because the database file was
+ * rewritten since), it is discarded.
+ *
+ * The pending changes are only accessed by the update thread.
+ */
+class DatabaseJournal {
+	const AllocatedPath path;
+
+	/**
+	 * The URIs of all directories which were modified since the
+	 * last commit.
+	 */
+	std::set<std::string> modified;
+
+	/**
+	 * The URIs of all directories which were deleted since the
+	 * last commit.  Their descendants are not listed.
+	 */
+	std::set<std::string> deleted;
+
+public:
+	/**
+	 * @param db_path the path of the database file; the journal
+	 * is stored next to it, with the suffix ".journal"
+	 */
+	explicit DatabaseJournal(Path db_path);
+
+	Path GetPath() const {
+		return path;
+	}
+
+	/**
+	 * Are there changes which have not been written yet?
+	 */
+	bool IsDirty() const {
+		return !modified.empty() || !deleted.empty();
+	}
+
+	void MarkModified(const Directory &directory);
+	void MarkDeleted(const Directory &directory);
+
+	/**
+	 * Forget all pending changes, e.g. because the whole database
+	 * has just been saved.
+	 */
+	void Clear() {
+		modified.clear();
+		deleted.clear();
+	}
+
+	/**
+	 * Append all pending changes as one commit.  If the journal
+	 * does not exist yet, it is created for the given database
+	 * file.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @param db_info information about the database file
+	 */
+	void Write(Directory &root, const FileInfo &db_info);
+
+	/**
+	 * Apply all complete commits to the given tree, which has just
+	 * been loaded from the database file.  A stale journal is
+	 * deleted.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @return false if the journal is damaged (its last commit is
+	 * incomplete) and should be compacted before anything is
+	 * appended to it
+	 */
+	bool Replay(Directory &root, const FileInfo &db_info);
+
+	/**
+	 * Delete the journal file (if it exists).
+	 */
+	void Delete();
+};
+
+#endif
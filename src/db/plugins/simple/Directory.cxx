@@ -38,7 +38,8 @@
 #include <stdlib.h>
 
 Directory::Directory(std::string &&_path_utf8, Directory *_parent)
-	:parent(_parent),
+	:n_children(0), n_songs(0),
+	 parent(_parent),
 	 mtime(0),
 	 inode(0), device(0),
 	 path(std::move(_path_utf8)),
@@ -57,9 +58,10 @@ Directory::~Directory()
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(parent != nullptr);
 
+	parent->UnindexChild(*this);
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -75,7 +77,7 @@ Directory::GetName() const
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
@@ -85,14 +87,42 @@ Directory::CreateChild(const char *name_utf8)
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	IndexChild(*child);
 	return child;
 }
 
+void
+Directory::IndexChild(Directory &child)
+{
+	++n_children;
+
+	if (child_index != nullptr) {
+		child_index->Insert(child.GetName(), child);
+	} else if (n_children > INDEX_THRESHOLD) {
+		child_index.reset(new NameIndex<Directory>());
+		for (auto &i : children)
+			child_index->Insert(i.GetName(), i);
+	}
+}
+
+void
+Directory::UnindexChild(const Directory &child)
+{
+	assert(n_children > 0);
+	--n_children;
+
+	if (child_index != nullptr)
+		child_index->Erase(child.GetName(), child);
+}
+
 const Directory *
 Directory::FindChild(const char *name) const
 {
 	assert(holding_db_lock());
 
+	if (child_index != nullptr)
+		return child_index->Find(name);
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -101,18 +131,22 @@ Directory::FindChild(const char *name) const
 }
 
 void
-Directory::PruneEmpty()
+Directory::PruneEmpty(const std::function<void(const Directory &)> &on_delete)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
-		child->PruneEmpty();
+		child->PruneEmpty(on_delete);
+
+		if (child->IsEmpty()) {
+			if (on_delete)
+				on_delete(*child);
 
-		if (child->IsEmpty())
+			UnindexChild(*child);
 			child = children.erase_and_dispose(child,
 							   DeleteDisposer());
-		else
+		} else
 			++child;
 	}
 }
@@ -165,29 +199,58 @@ Directory::LookupDirectory(const char *uri)
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+	IndexSong(*song);
 }
 
 void
 Directory::RemoveSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	UnindexSong(*song);
 	songs.erase(songs.iterator_to(*song));
 }
 
+void
+Directory::IndexSong(Song &song)
+{
+	++n_songs;
+
+	if (song_index != nullptr) {
+		song_index->Insert(song.uri, song);
+	} else if (n_songs > INDEX_THRESHOLD) {
+		song_index.reset(new NameIndex<Song>());
+		for (auto &i : songs)
+			song_index->Insert(i.uri, i);
+	}
+}
+
+void
+Directory::UnindexSong(const Song &song)
+{
+	assert(n_songs > 0);
+	--n_songs;
+
+	if (song_index != nullptr)
+		song_index->Erase(song.uri, song);
+}
+
 const Song *
 Directory::FindSong(const char *name_utf8) const
 {
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index != nullptr)
+		return song_index->Find(name_utf8);
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -208,7 +271,7 @@ directory_cmp(const Directory &a, const Directory &b)
 void
 Directory::Sort()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	children.sort(directory_cmp);
 	song_list_sort(songs);
@@ -228,7 +291,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		const ScopeDatabaseUnlock unlock;
+		const ScopeDatabaseSharedUnlock unlock;
 		WalkMount(GetPath(), *mounted_database,
 			  recursive, filter,
 			  visit_directory, visit_song,
@@ -260,6 +323,18 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 	}
 }
 
+void
+Directory::CollectSongs(std::vector<const Song *> &dest) const
+{
+	assert(holding_db_lock());
+
+	for (const auto &song : songs)
+		dest.push_back(&song);
+
+	for (const auto &child : children)
+		child.CollectSongs(dest);
+}
+
 LightDirectory
 Directory::Export() const
 {
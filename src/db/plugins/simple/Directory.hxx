@@ -25,10 +25,13 @@
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "Song.hxx"
+#include "NameIndex.hxx"
 
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
 #include <string>
+#include <vector>
 
 /**
  * Virtual directory that is really an archive file or a folder inside
@@ -82,6 +85,28 @@ struct Directory {
 	 */
 	SongList songs;
 
+	/**
+	 * The number of entries in #children and #songs.
+	 *
+	 * These attributes are protected with the global #db_mutex.
+	 */
+	unsigned n_children, n_songs;
+
+	/**
+	 * Lists with more entries than this get a #NameIndex;
+	 * shorter ones are searched linearly.
+	 */
+	static constexpr unsigned INDEX_THRESHOLD = 16;
+
+	/**
+	 * Hash indexes for FindChild() and FindSong(), created as
+	 * soon as the respective list grows beyond #INDEX_THRESHOLD.
+	 *
+	 * These attributes are protected with the global #db_mutex.
+	 */
+	std::unique_ptr<NameIndex<Directory>> child_index;
+	std::unique_ptr<NameIndex<Song>> song_index;
+
 	PlaylistVector playlists;
 
 	Directory *parent;
@@ -116,14 +141,14 @@ public:
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Delete();
 
 	/**
 	 * Create a new #Directory object as a child of the given one.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 *
 	 * @param name_utf8 the UTF-8 encoded name of the new sub directory
 	 */
@@ -146,7 +171,7 @@ public:
 	 * Look up a sub directory, and create the object if it does not
 	 * exist.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	Directory *MakeChild(const char *name_utf8) {
 		Directory *child = FindChild(name_utf8);
@@ -251,14 +276,19 @@ public:
 	void RemoveSong(Song *song);
 
 	/**
-	 * Caller must lock the #db_mutex.
+	 * Delete all empty child directories (recursively).
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 *
+	 * @param on_delete an optional function which is called for
+	 * each directory right before it gets deleted
 	 */
-	void PruneEmpty();
+	void PruneEmpty(const std::function<void(const Directory &)> &on_delete=nullptr);
 
 	/**
 	 * Sort all directory entries recursively.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Sort();
 
@@ -269,8 +299,23 @@ public:
 		  VisitDirectory visit_directory, VisitSong visit_song,
 		  VisitPlaylist visit_playlist) const;
 
+	/**
+	 * Append all songs of this directory and its descendants to
+	 * the vector, in the order in which Walk() visits them.
+	 * Mounted databases are skipped.
+	 *
+	 * Caller must lock #db_mutex.
+	 */
+	void CollectSongs(std::vector<const Song *> &dest) const;
+
 	gcc_pure
 	LightDirectory Export() const;
+
+private:
+	void IndexChild(Directory &child);
+	void UnindexChild(const Directory &child);
+	void IndexSong(Song &song);
+	void UnindexSong(const Song &song);
 };
 
 #endif
@@ -66,20 +66,34 @@ ParseTypeString(const char *type)
 		return 0;
 }
 
-void
-directory_save(BufferedOutputStream &os, const Directory &directory)
+static void
+directory_save_begin(BufferedOutputStream &os, const Directory &directory)
 {
-	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Format(DIRECTORY_TYPE "%s\n", type);
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Format(DIRECTORY_TYPE "%s\n", type);
 
-		if (directory.mtime != 0)
-			os.Format(DIRECTORY_MTIME "%lu\n",
-				  (unsigned long)directory.mtime);
+	if (directory.mtime != 0)
+		os.Format(DIRECTORY_MTIME "%lu\n",
+			  (unsigned long)directory.mtime);
 
-		os.Format("%s%s\n", DIRECTORY_BEGIN, directory.GetPath());
-	}
+	os.Format("%s%s\n", DIRECTORY_BEGIN, directory.GetPath());
+}
+
+static void
+directory_save_contents(BufferedOutputStream &os, const Directory &directory)
+{
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+}
+
+void
+directory_save(BufferedOutputStream &os, const Directory &directory)
+{
+	if (!directory.IsRoot())
+		directory_save_begin(os, directory);
 
 	for (const auto &child : directory.children) {
 		os.Format(DIRECTORY_DIR "%s\n", child.GetName());
@@ -88,15 +102,20 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 			directory_save(os, child);
 	}
 
-	for (const auto &song : directory.songs)
-		song_save(os, song);
-
-	playlist_vector_save(os, directory.playlists);
+	directory_save_contents(os, directory);
 
 	if (!directory.IsRoot())
 		os.Format(DIRECTORY_END "%s\n", directory.GetPath());
 }
 
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory)
+{
+	directory_save_begin(os, directory);
+	directory_save_contents(os, directory);
+	os.Format(DIRECTORY_END "%s\n", directory.GetPath());
+}
+
 static bool
 ParseLine(Directory &directory, const char *line)
 {
@@ -111,6 +130,28 @@ ParseLine(Directory &directory, const char *line)
 	return true;
 }
 
+/**
+ * Load the properties preceding the "begin" line, and then the
+ * contents.
+ */
+static void
+directory_load_begin(TextFile &file, Directory &directory)
+{
+	while (true) {
+		const char *line = file.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of file");
+
+		if (StringStartsWith(line, DIRECTORY_BEGIN))
+			break;
+
+		if (!ParseLine(directory, line))
+			throw FormatRuntimeError("Malformed line: %s", line);
+	}
+
+	directory_load(file, directory);
+}
+
 static Directory *
 directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 {
@@ -120,19 +161,7 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 	Directory *directory = parent.CreateChild(name);
 
 	try {
-		while (true) {
-			const char *line = file.ReadLine();
-			if (line == nullptr)
-				throw std::runtime_error("Unexpected end of file");
-
-			if (StringStartsWith(line, DIRECTORY_BEGIN))
-				break;
-
-			if (!ParseLine(*directory, line))
-				throw FormatRuntimeError("Malformed line: %s", line);
-		}
-
-		directory_load(file, *directory);
+		directory_load_begin(file, *directory);
 	} catch (...) {
 		directory->Delete();
 		throw;
@@ -170,3 +199,19 @@ directory_load(TextFile &file, Directory &directory)
 		}
 	}
 }
+
+void
+directory_load_shallow(TextFile &file, Directory &directory)
+{
+	directory.ForEachSongSafe([&directory](Song &song){
+			directory.RemoveSong(&song);
+			song.Free();
+		});
+
+	directory.playlists.erase(directory.playlists.begin(),
+				  directory.playlists.end());
+	directory.mtime = 0;
+	directory.device = 0;
+
+	directory_load_begin(file, directory);
+}
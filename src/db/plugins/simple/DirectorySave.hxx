@@ -27,10 +27,28 @@ class BufferedOutputStream;
 void
 directory_save(BufferedOutputStream &os, const Directory &directory);
 
+/**
+ * Save only the properties, songs and playlists of the given
+ * directory, but not its children.  Unlike directory_save(), this
+ * emits "begin" and "end" lines even for the root directory.
+ */
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory);
+
 /**
  * Throws #std::runtime_error on error.
  */
 void
 directory_load(TextFile &file, Directory &directory);
 
+/**
+ * Load a record written by directory_save_shallow(), replacing the
+ * properties, songs and playlists of the given directory.  Its
+ * children are left alone.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+directory_load_shallow(TextFile &file, Directory &directory);
+
 #endif
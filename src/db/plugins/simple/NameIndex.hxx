@@ -0,0 +1,81 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_NAME_INDEX_HXX
+#define MPD_NAME_INDEX_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <unordered_map>
+
+#include <string.h>
+
+/**
+ * A hash index which finds objects by their name.  The name strings
+ * are owned by the objects and must not change while they are in the
+ * index.  Duplicate names are allowed.
+ */
+template<typename T>
+class NameIndex {
+	struct Hash {
+		gcc_pure
+		size_t operator()(const char *p) const {
+			/* FNV-1a */
+			size_t hash = 2166136261u;
+			while (*p != 0)
+				hash = (hash ^ (unsigned char)*p++) * 16777619u;
+			return hash;
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const char *a, const char *b) const {
+			return strcmp(a, b) == 0;
+		}
+	};
+
+	std::unordered_multimap<const char *, T *, Hash, Equal> map;
+
+public:
+	void Insert(const char *name, T &object) {
+		map.emplace(name, &object);
+	}
+
+	void Erase(const char *name, const T &object) {
+		auto r = map.equal_range(name);
+		for (auto i = r.first; i != r.second; ++i) {
+			if (i->second == &object) {
+				map.erase(i);
+				break;
+			}
+		}
+	}
+
+	gcc_pure
+	T *Find(const char *name) const {
+		auto i = map.find(name);
+		return i != map.end()
+			? i->second
+			: nullptr;
+	}
+};
+
+#endif
@@ -26,9 +26,14 @@
 #include "db/Stats.hxx"
 #include "db/UniqueTags.hxx"
 #include "db/LightDirectory.hxx"
+#include "tag/Set.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
+#include "TagIndex.hxx"
+#include "DatabaseJournal.hxx"
+#include "AggregateCache.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "fs/io/TextFile.hxx"
@@ -37,7 +42,9 @@
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "thread/WorkerPool.hxx"
 #include "util/CharUtil.hxx"
+#include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -45,40 +52,123 @@
 #include "fs/io/GzipOutputStream.hxx"
 #endif
 
+#include <algorithm>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <errno.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * The default maximum for "query_threads".
+ */
+static constexpr unsigned MAX_QUERY_THREADS = 8;
+
+/**
+ * Visit() splits the songs into parts of at least this size for the
+ * #WorkerPool; smaller selections are matched by the calling thread.
+ */
+static constexpr size_t MIN_QUERY_PART = 4096;
+
+/**
+ * Create the #WorkerPool for the "query_threads" setting.
+ *
+ * @param n_threads the total number of threads (including the
+ * calling thread); 0 means automatic
+ * @return nullptr if only one thread shall be used
+ */
+static std::unique_ptr<WorkerPool>
+CreateQueryPool(unsigned n_threads)
+{
+	if (n_threads == 0)
+		n_threads = std::min(std::thread::hardware_concurrency(),
+				     MAX_QUERY_THREADS);
+
+	if (n_threads < 2)
+		return nullptr;
+
+	try {
+		return std::unique_ptr<WorkerPool>(new WorkerPool("query",
+								  n_threads - 1));
+	} catch (const std::exception &e) {
+		/* not fatal: run all queries in the calling thread */
+		LogError(e);
+		return nullptr;
+	}
+}
+
+/**
+ * Parse the "format" setting.
+ *
+ * @return true for the binary format
+ */
+static bool
+ParseFormat(const ConfigBlock &block)
+{
+	const char *format = block.GetBlockValue("format", "text");
+	if (strcmp(format, "text") == 0)
+		return false;
+	else if (strcmp(format, "binary") == 0)
+		return true;
+	else
+		throw FormatRuntimeError("Unrecognized database format: %s",
+					 format);
+}
+
 inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 	:Database(simple_db_plugin),
 	 path(block.GetPath("path")),
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
+	 binary(ParseFormat(block)),
+	 use_journal(block.GetBlockValue("journal", false)),
+	 aggregate_cache(new AggregateCache()),
+	 query_pool(CreateQueryPool(block.GetBlockValue("query_threads",
+							0u))),
 	 cache_path(block.GetPath("cache_directory")),
 	 prefixed_light_song(nullptr)
 {
+	if (block.GetBlockValue("tag_index", false))
+		tag_index.reset(new TagIndex());
+
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
 
 	path_utf8 = path.ToUTF8();
+	journal.reset(new DatabaseJournal(path));
 }
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef ENABLE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress)
+				      bool _compress, bool _binary,
+				      bool _tag_index, bool _journal)
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
+	 binary(_binary),
+	 use_journal(_journal),
+	 journal(new DatabaseJournal(path)),
+	 aggregate_cache(new AggregateCache()),
 	 cache_path(AllocatedPath::Null()),
-	 prefixed_light_song(nullptr) {
+	 prefixed_light_song(nullptr)
+{
+	if (_tag_index)
+		tag_index.reset(new TagIndex());
+}
+
+SimpleDatabase::~SimpleDatabase()
+{
+	/* this destructor exists here just so #TagIndex,
+	   #DatabaseJournal, #AggregateCache and #WorkerPool don't
+	   need to be complete types in the header */
 }
 
 Database *
@@ -142,21 +232,80 @@ SimpleDatabase::Check() const
 #endif
 }
 
-void
-SimpleDatabase::Load()
+bool
+SimpleDatabase::LoadFile()
 {
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path);
-
 	LogDebug(simple_db_domain, "reading DB");
 
-	db_load_internal(file, *root);
+	const bool is_binary = db_is_binary(path);
+	if (is_binary) {
+		db_load_binary(path, *root);
+	} else {
+		TextFile file(path);
+		db_load_internal(file, *root);
+	}
+
+	return is_binary;
+}
+
+bool
+SimpleDatabase::Load()
+{
+	const bool is_binary = LoadFile();
+
+	bool up_to_date = is_binary == binary;
+	if (!up_to_date)
+		FormatDefault(simple_db_domain,
+			      "converting database file to %s format",
+			      binary ? "binary" : "text");
 
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(path, fi)) {
 		mtime = fi.GetModificationTime();
+
+		bool replay_failed = false;
+
+		{
+			const ScopeDatabaseLock protect;
+
+			try {
+				if (!journal->Replay(*root, fi))
+					up_to_date = false;
+			} catch (const std::exception &e) {
+				LogError(e, "Failed to replay the database journal");
+				replay_failed = true;
+			}
+		}
+
+		if (replay_failed) {
+			/* the journal may have been applied partially;
+			   start over with just the database file, which
+			   is still good, and rewrite it */
+			journal->Delete();
+
+			delete root;
+			root = Directory::NewRoot();
+			LoadFile();
+
+			up_to_date = false;
+		}
+
+		FileInfo journal_fi;
+		if (GetFileInfo(journal->GetPath(), journal_fi)) {
+			mtime = journal_fi.GetModificationTime();
+
+			if (!use_journal)
+				/* left over from an earlier
+				   configuration; merge it into the
+				   database file */
+				up_to_date = false;
+		}
+	}
+
+	return up_to_date;
 }
 
 void
@@ -171,8 +320,10 @@ SimpleDatabase::Open()
 	borrowed_song_count = 0;
 #endif
 
+	bool up_to_date;
+
 	try {
-		Load();
+		up_to_date = Load();
 	} catch (const std::exception &e) {
 		LogError(e);
 
@@ -181,6 +332,24 @@ SimpleDatabase::Open()
 		Check();
 
 		root = Directory::NewRoot();
+		return;
+	}
+
+	if (tag_index != nullptr)
+		tag_index->Build(*root);
+
+	aggregate_cache->Clear();
+
+	if (!up_to_date) {
+		/* the file was written in the other format, or the
+		   journal must be merged into it; rewrite it right
+		   now, or else we'd have to deal with it again on the
+		   next startup if there's no update */
+		try {
+			Save();
+		} catch (const std::exception &e) {
+			LogError(e);
+		}
 	}
 }
 
@@ -191,6 +360,11 @@ SimpleDatabase::Close()
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	if (tag_index != nullptr)
+		tag_index->Clear();
+
+	aggregate_cache->Clear();
+
 	delete root;
 }
 
@@ -201,7 +375,7 @@ SimpleDatabase::GetSong(const char *uri) const
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	ScopeDatabaseLock protect;
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(uri);
 
@@ -261,13 +435,111 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const
 #endif
 }
 
+/**
+ * Is the song somewhere inside the given directory?
+ */
+gcc_pure
+static bool
+IsInside(const Song &song, const Directory &directory)
+{
+	for (const Directory *i = song.parent; i != nullptr; i = i->parent)
+		if (i == &directory)
+			return true;
+
+	return false;
+}
+
+inline bool
+SimpleDatabase::VisitIndexed(const Directory &directory,
+			     const DatabaseSelection &selection,
+			     VisitSong visit_song) const
+{
+	if (tag_index == nullptr || n_mounts > 0 ||
+	    !selection.recursive || selection.filter == nullptr)
+		return false;
+
+	std::vector<Song *> songs;
+	if (!tag_index->Find(*root, *selection.filter, songs))
+		return false;
+
+	std::vector<const Song *> inside;
+	if (directory.IsRoot())
+		inside.assign(songs.begin(), songs.end());
+	else
+		std::copy_if(songs.begin(), songs.end(),
+			     std::back_inserter(inside),
+			     [&directory](const Song *song){
+				     return IsInside(*song, directory);
+			     });
+
+	VisitMatching(inside, selection, visit_song);
+	return true;
+}
+
+inline bool
+SimpleDatabase::VisitParallel(const Directory &directory,
+			      const DatabaseSelection &selection,
+			      VisitSong visit_song) const
+{
+	if (query_pool == nullptr || n_mounts > 0 ||
+	    !selection.recursive || selection.filter == nullptr)
+		return false;
+
+	std::vector<const Song *> songs;
+	directory.CollectSongs(songs);
+
+	VisitMatching(songs, selection, visit_song);
+	return true;
+}
+
+void
+SimpleDatabase::VisitMatching(const std::vector<const Song *> &songs,
+			      const DatabaseSelection &selection,
+			      VisitSong visit_song) const
+{
+	const size_t n = songs.size();
+	const unsigned n_parts = query_pool != nullptr
+		? std::min<size_t>(query_pool->GetConcurrency() * 4,
+				   n / MIN_QUERY_PART)
+		: 0;
+
+	if (n_parts < 2) {
+		for (const Song *song : songs) {
+			const LightSong song2 = song->Export();
+			if (selection.Match(song2))
+				visit_song(song2);
+		}
+
+		return;
+	}
+
+	/* the worker threads only collect the matching songs; they
+	   are passed to the visitor by this thread afterwards, in
+	   their original order */
+	std::vector<std::vector<const Song *>> matches(n_parts);
+	query_pool->Run(n_parts, [&songs, &selection, &matches,
+				  n, n_parts](unsigned part){
+			const size_t begin = n * part / n_parts;
+			const size_t end = n * (part + 1) / n_parts;
+			auto &dest = matches[part];
+
+			for (size_t i = begin; i != end; ++i)
+				if (selection.Match(songs[i]->Export()))
+					dest.push_back(songs[i]);
+		});
+
+	for (const auto &part : matches)
+		for (const Song *song : part)
+			visit_song(song->Export());
+}
+
 void
 SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitDirectory visit_directory,
 		      VisitSong visit_song,
 		      VisitPlaylist visit_playlist) const
 {
-	ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 	if (r.uri == nullptr) {
@@ -276,6 +548,11 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    (VisitIndexed(*r.directory, selection, visit_song) ||
+		     VisitParallel(*r.directory, selection, visit_song)))
+			return;
+
 		r.directory->Walk(selection.recursive, selection.filter,
 				  visit_directory, visit_song,
 				  visit_playlist);
@@ -299,12 +576,44 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 			    "No such directory");
 }
 
+/**
+ * Can the result of this selection be stored in the
+ * #AggregateCache?  A "base" filter item is already contained in
+ * DatabaseSelection::uri.
+ */
+gcc_pure
+static bool
+IsCacheable(const DatabaseSelection &selection)
+{
+	return selection.recursive && !selection.HasOtherThanBase();
+}
+
 void
 SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				TagType tag_type, tag_mask_t group_mask,
 				VisitTag visit_tag) const
 {
-	::VisitUniqueTags(*this, selection, tag_type, group_mask, visit_tag);
+	if (n_mounts > 0 || !IsCacheable(selection)) {
+		::VisitUniqueTags(*this, selection, tag_type, group_mask,
+				  visit_tag);
+		return;
+	}
+
+	const char *uri = selection.uri.c_str();
+	auto set = aggregate_cache->GetUniqueTags(uri, tag_type, group_mask);
+	if (set == nullptr) {
+		const unsigned generation = aggregate_cache->GetGeneration();
+
+		auto new_set = std::make_shared<TagSet>();
+		CollectUniqueTags(*new_set, *this, selection,
+				  tag_type, group_mask);
+		aggregate_cache->PutUniqueTags(generation, uri,
+					       tag_type, group_mask, new_set);
+		set = std::move(new_set);
+	}
+
+	for (const auto &tag : *set)
+		visit_tag(tag);
 }
 
 DatabaseStats
@@ -313,23 +622,40 @@ SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 	return ::GetStats(*this, selection);
 }
 
-void
-SimpleDatabase::Save()
+bool
+SimpleDatabase::VisitGroupCounts(const DatabaseSelection &selection,
+				 TagType group,
+				 VisitGroupCount visit) const
 {
-	{
-		const ScopeDatabaseLock protect;
-
-		LogDebug(simple_db_domain, "removing empty directories from DB");
-		root->PruneEmpty();
+	if (n_mounts > 0 || !IsCacheable(selection))
+		return false;
 
-		LogDebug(simple_db_domain, "sorting DB");
-		root->Sort();
+	const char *uri = selection.uri.c_str();
+	auto counts = aggregate_cache->GetGroupCounts(uri, group);
+	if (counts == nullptr) {
+		const unsigned generation = aggregate_cache->GetGeneration();
+
+		auto new_counts = std::make_shared<AggregateCache::GroupCounts>();
+		::VisitGroupCounts(*this, selection, group,
+				   [&new_counts](const char *value,
+						 const DatabaseStats &stats){
+					   new_counts->emplace_back(value,
+								    stats);
+				   });
+		aggregate_cache->PutGroupCounts(generation, uri, group,
+						new_counts);
+		counts = std::move(new_counts);
 	}
 
-	LogDebug(simple_db_domain, "writing DB");
+	for (const auto &i : *counts)
+		visit(i.first.c_str(), i.second);
 
-	FileOutputStream fos(path);
+	return true;
+}
 
+void
+SimpleDatabase::SaveText(OutputStream &fos) const
+{
 	OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
@@ -352,9 +678,86 @@ SimpleDatabase::Save()
 		gzip.reset();
 	}
 #endif
+}
+
+void
+SimpleDatabase::PrepareSave()
+{
+	const ScopeDatabaseLock protect;
+
+	LogDebug(simple_db_domain, "removing empty directories from DB");
+	root->PruneEmpty([this](const Directory &directory){
+			journal->MarkDeleted(directory);
+			aggregate_cache->Invalidate(directory.GetPath());
+		});
+
+	LogDebug(simple_db_domain, "sorting DB");
+	root->Sort();
+
+	if (tag_index != nullptr)
+		tag_index->InvalidateOrder();
+}
+
+void
+SimpleDatabase::Save()
+{
+	PrepareSave();
+	SaveFile();
+}
+
+void
+SimpleDatabase::SaveChanges()
+{
+	FileInfo db_info, journal_info;
+	if (!use_journal || !FileExists() || !GetFileInfo(path, db_info) ||
+	    (GetFileInfo(journal->GetPath(), journal_info) &&
+	     journal_info.GetSize() > db_info.GetSize())) {
+		Save();
+		return;
+	}
+
+	PrepareSave();
+
+	if (!journal->IsDirty())
+		return;
+
+	LogDebug(simple_db_domain, "writing DB journal");
+
+	try {
+		journal->Write(*root, db_info);
+	} catch (const std::exception &e) {
+		/* the journal may end with an incomplete commit now,
+		   which must not be followed by another one; rewrite
+		   the database file instead */
+		LogError(e);
+		SaveFile();
+		return;
+	}
+
+	if (GetFileInfo(journal->GetPath(), journal_info))
+		mtime = journal_info.GetModificationTime();
+}
+
+void
+SimpleDatabase::SaveFile()
+{
+	LogDebug(simple_db_domain, "writing DB");
+
+	FileOutputStream fos(path);
+
+	if (binary)
+		db_save_binary(fos, *root);
+	else
+		SaveText(fos);
 
 	fos.Commit();
 
+	/* the journal is obsolete now; if deleting it fails, it is
+	   still discarded on the next startup, because it doesn't
+	   match the new file */
+	journal->Clear();
+	journal->Delete();
+
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
@@ -383,6 +786,9 @@ SimpleDatabase::Mount(const char *uri, Database *db)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	++n_mounts;
+
+	aggregate_cache->Invalidate(uri);
 }
 
 static constexpr bool
@@ -414,7 +820,8 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 #endif
 	auto db = new SimpleDatabase(AllocatedPath::Build(cache_path,
 							  name_fs.c_str()),
-				     compress);
+				     compress, binary, tag_index != nullptr,
+				     false);
 	try {
 		db->Open();
 	} catch (...) {
@@ -446,6 +853,11 @@ SimpleDatabase::LockUmountSteal(const char *uri)
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
 
+	assert(n_mounts > 0);
+	--n_mounts;
+
+	aggregate_cache->Invalidate(uri);
+
 	return db;
 }
 
@@ -27,13 +27,21 @@
 #include "Compiler.h"
 
 #include <cassert>
+#include <memory>
+#include <vector>
 
 struct ConfigBlock;
 struct Directory;
+struct Song;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
 class PrefixedLightSong;
+class TagIndex;
+class DatabaseJournal;
+class AggregateCache;
+class WorkerPool;
+class OutputStream;
 
 class SimpleDatabase : public Database {
 	AllocatedPath path;
@@ -43,6 +51,52 @@ class SimpleDatabase : public Database {
 	bool compress;
 #endif
 
+	/**
+	 * Use the binary file format (see DatabaseBinary.hxx) instead
+	 * of the text format?
+	 */
+	bool binary;
+
+	/**
+	 * The optional inverted tag index for Visit().  It is built by
+	 * Open() and kept up to date by the #DatabaseEditor.
+	 */
+	std::unique_ptr<TagIndex> tag_index;
+
+	/**
+	 * The number of databases mounted with Mount().  The
+	 * #tag_index only covers this database, so it is only used
+	 * while there are none.
+	 */
+	unsigned n_mounts = 0;
+
+	/**
+	 * Save updates incrementally to the #journal instead of
+	 * rewriting the whole database file?
+	 */
+	bool use_journal;
+
+	/**
+	 * The journal next to the database file.  It exists even if
+	 * #use_journal is false, so a journal left over from an
+	 * earlier configuration is still replayed.
+	 */
+	std::unique_ptr<DatabaseJournal> journal;
+
+	/**
+	 * Results of VisitUniqueTags() and VisitGroupCounts(), kept
+	 * up to date by the #DatabaseEditor.  Like the #tag_index, it
+	 * is only used while no database is mounted.
+	 */
+	std::unique_ptr<AggregateCache> aggregate_cache;
+
+	/**
+	 * Threads which help Visit() with matching the songs against
+	 * a #SongFilter (setting "query_threads").  It is nullptr if
+	 * only the calling thread shall be used.
+	 */
+	std::unique_ptr<WorkerPool> query_pool;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
@@ -69,9 +123,12 @@ class SimpleDatabase : public Database {
 
 	SimpleDatabase(const ConfigBlock &block);
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress);
+	SimpleDatabase(AllocatedPath &&_path, bool _compress, bool _binary,
+		       bool _tag_index, bool _journal);
 
 public:
+	~SimpleDatabase();
+
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
 				const ConfigBlock &block);
 
@@ -82,8 +139,43 @@ public:
 		return *root;
 	}
 
+	/**
+	 * Returns the #TagIndex which must be updated by all
+	 * modifications, or nullptr if it is disabled.
+	 */
+	TagIndex *GetTagIndex() {
+		return tag_index.get();
+	}
+
+	/**
+	 * Returns the #DatabaseJournal which must be notified about
+	 * all modifications, or nullptr if it is disabled.
+	 */
+	DatabaseJournal *GetJournal() {
+		return use_journal ? journal.get() : nullptr;
+	}
+
+	/**
+	 * Returns the #AggregateCache which must be notified about
+	 * all modifications.
+	 */
+	AggregateCache *GetAggregateCache() {
+		return aggregate_cache.get();
+	}
+
+	/**
+	 * Rewrite the whole database file.
+	 */
 	void Save();
 
+	/**
+	 * Save the modifications recorded by the #DatabaseJournal,
+	 * by appending them to the journal file.  Falls back to
+	 * Save() if the journal is disabled or has grown larger than
+	 * the database file (compaction).
+	 */
+	void SaveChanges();
+
 	/**
 	 * Returns true if there is a valid database file on the disk.
 	 */
@@ -125,6 +217,10 @@ public:
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
+	bool VisitGroupCounts(const DatabaseSelection &selection,
+			      TagType group,
+			      VisitGroupCount visit) const override;
+
 	virtual time_t GetUpdateStamp() const override {
 		return mtime;
 	}
@@ -135,9 +231,67 @@ private:
 	void Check() const;
 
 	/**
+	 * Load the database file (without the journal) into #root.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @return true if the file is in the binary format
+	 */
+	bool LoadFile();
+
+	/**
+	 * Load the database file, which may be in either format, and
+	 * replay the journal.  If the journal cannot be replayed, it
+	 * is deleted, and only the database file is loaded.
+	 *
 	 * Throws #std::runtime_error on error.
+	 *
+	 * @return true if the file is in the configured format and
+	 * the journal is intact, false if the file needs to be
+	 * rewritten
+	 */
+	bool Load();
+
+	/**
+	 * Remove empty directories and sort the tree before it is
+	 * saved.
+	 */
+	void PrepareSave();
+
+	void SaveFile();
+	void SaveText(OutputStream &os) const;
+
+	/**
+	 * Implementation of Visit() with the #tag_index.  Caller must
+	 * lock the #db_mutex.
+	 *
+	 * @return false if the selection cannot be evaluated with the
+	 * index
+	 */
+	bool VisitIndexed(const Directory &directory,
+			  const DatabaseSelection &selection,
+			  VisitSong visit_song) const;
+
+	/**
+	 * Implementation of Visit() which matches the songs in
+	 * parallel with the #query_pool.  Caller must lock the
+	 * #db_mutex.
+	 *
+	 * @return false if the selection is not suitable for this
+	 */
+	bool VisitParallel(const Directory &directory,
+			   const DatabaseSelection &selection,
+			   VisitSong visit_song) const;
+
+	/**
+	 * Pass all of the given songs which match the selection to
+	 * the visitor, in the given order.  Large lists are split
+	 * among the #query_pool threads.  Caller must lock the
+	 * #db_mutex.
 	 */
-	void Load();
+	void VisitMatching(const std::vector<const Song *> &songs,
+			   const DatabaseSelection &selection,
+			   VisitSong visit_song) const;
 
 	Database *LockUmountSteal(const char *uri);
 };
@@ -30,7 +30,8 @@
 
 inline Song::Song(const char *_uri, size_t uri_length, Directory &_parent)
 	:parent(&_parent), mtime(0),
-	 start_time(SongTime::zero()), end_time(SongTime::zero())
+	 start_time(SongTime::zero()), end_time(SongTime::zero()),
+	 order(0)
 {
 	memcpy(uri, _uri, uri_length + 1);
 }
@@ -83,6 +83,13 @@ struct Song {
 	 */
 	SongTime end_time;
 
+	/**
+	 * The position of this song in a Directory::Walk().  It is
+	 * maintained by #TagIndex, and is only valid while it says
+	 * so.
+	 */
+	unsigned order;
+
 	/**
 	 * The file name.
 	 */
@@ -98,24 +105,32 @@ struct Song {
 	gcc_malloc
 	static Song *NewFile(const char *path_utf8, Directory &parent);
 
-	/**
-	 * allocate a new song structure with a local file name and attempt to
-	 * load its metadata.  If all decoder plugin fail to read its meta
-	 * data, nullptr is returned.
-	 */
-	gcc_malloc
-	static Song *LoadFile(Storage &storage, const char *name_utf8,
-			      Directory &parent);
-
 	void Free();
 
-	bool UpdateFile(Storage &storage);
+	/**
+	 * Determine the modification time and scan the tags of the
+	 * specified file.  It does not need a #Song object; it may
+	 * be called in any thread.
+	 *
+	 * @param uri_utf8 the URI relative to the #Storage
+	 * @return false if the file is not a regular file or if no
+	 * decoder plugin recognizes it; the output parameters are
+	 * left untouched then
+	 */
+	static bool ScanFile(Storage &storage, const char *uri_utf8,
+			     time_t &mtime_r, Tag &tag_r);
 
 #ifdef ENABLE_ARCHIVE
 	static Song *LoadFromArchive(ArchiveFile &archive,
 				     const char *name_utf8,
 				     Directory &parent);
 	bool UpdateFileInArchive(ArchiveFile &archive);
+
+	/**
+	 * Scan the tags of this song in the given archive, without
+	 * modifying it.
+	 */
+	bool ScanFileInArchive(ArchiveFile &archive, Tag &tag_r) const;
 #endif
 
 	/**
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "tag/Tag.hxx"
+#include "lib/icu/Collate.hxx"
+#include "util/StringAPI.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+void
+TagIndex::Clear()
+{
+	for (auto &map : maps)
+		map.clear();
+
+	order_valid = false;
+}
+
+void
+TagIndex::AddTree(Directory &directory)
+{
+	for (auto &song : directory.songs)
+		Add(song);
+
+	for (auto &child : directory.children)
+		AddTree(child);
+}
+
+void
+TagIndex::Build(Directory &root)
+{
+	Clear();
+	AddTree(root);
+
+	Renumber(root, 0);
+	order_valid = true;
+}
+
+void
+TagIndex::Add(Song &song)
+{
+	for (const auto &item : song.tag) {
+		auto &songs = maps[item.type][item.value].songs;
+
+		/* a song may have the same value more than once */
+		if (songs.empty() || songs.back() != &song)
+			songs.push_back(&song);
+	}
+
+	order_valid = false;
+}
+
+void
+TagIndex::Remove(Song &song)
+{
+	for (const auto &item : song.tag) {
+		Map &map = maps[item.type];
+		auto i = map.find(item.value);
+		if (i == map.end())
+			/* a duplicate value which has already been
+			   removed */
+			continue;
+
+		auto &songs = i->second.songs;
+		auto j = std::find(songs.begin(), songs.end(), &song);
+		if (j == songs.end())
+			continue;
+
+		*j = songs.back();
+		songs.pop_back();
+
+		if (songs.empty())
+			map.erase(i);
+	}
+}
+
+unsigned
+TagIndex::Renumber(Directory &directory, unsigned order)
+{
+	for (auto &song : directory.songs)
+		song.order = order++;
+
+	for (auto &child : directory.children)
+		order = Renumber(child, order);
+
+	return order;
+}
+
+const char *
+TagIndex::GetFolded(const std::string &value, Entry &entry)
+{
+	if (entry.folded.IsNull())
+		entry.folded = IcuCaseFold(value.c_str());
+
+	return entry.folded.c_str();
+}
+
+size_t
+TagIndex::FindEntries(TagType type, const SongFilter::Item &item,
+		      std::vector<const Entry *> &entries)
+{
+	Map &map = maps[type];
+
+	if (item.GetFoldCase()) {
+		/* the filter value is already case-folded */
+		size_t n = 0;
+		for (auto &i : map) {
+			if (StringFind(GetFolded(i.first, i.second),
+				       item.GetValue()) != nullptr) {
+				entries.push_back(&i.second);
+				n += i.second.songs.size();
+			}
+		}
+
+		return n;
+	} else {
+		auto i = map.find(item.GetValue());
+		if (i == map.end())
+			return 0;
+
+		entries.push_back(&i->second);
+		return i->second.songs.size();
+	}
+}
+
+size_t
+TagIndex::FindEntries(const SongFilter::Item &item,
+		      std::vector<const Entry *> &entries)
+{
+	const unsigned tag = item.GetTag();
+
+	if (tag == LOCATE_TAG_ANY_TYPE) {
+		size_t n = 0;
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			n += FindEntries(TagType(i), item, entries);
+		return n;
+	}
+
+	assert(tag < TAG_NUM_OF_ITEM_TYPES);
+
+	size_t n = FindEntries(TagType(tag), item, entries);
+
+	if (tag == TAG_ALBUM_ARTIST)
+		/* SongFilter falls back to "artist" for songs without
+		   "album artist" */
+		n += FindEntries(TAG_ARTIST, item, entries);
+
+	return n;
+}
+
+/**
+ * Can this item be looked up in the #TagIndex?  An empty value
+ * matches songs which do not have the tag at all, and they are not
+ * in the index.
+ */
+gcc_pure
+static bool
+IsIndexable(const SongFilter::Item &item)
+{
+	const unsigned tag = item.GetTag();
+	return (tag < TAG_NUM_OF_ITEM_TYPES || tag == LOCATE_TAG_ANY_TYPE) &&
+		*item.GetValue() != 0;
+}
+
+bool
+TagIndex::Find(Directory &root, const SongFilter &filter,
+	       std::vector<Song *> &result)
+{
+	/* use the item with the fewest songs; the caller checks the
+	   others */
+	std::vector<const Entry *> best, entries;
+	size_t best_size = 0;
+	bool found = false;
+
+	const ScopeLock protect(find_mutex);
+
+	for (const auto &item : filter.GetItems()) {
+		if (!IsIndexable(item))
+			continue;
+
+		entries.clear();
+		const size_t n = FindEntries(item, entries);
+		if (!found || n < best_size) {
+			best.swap(entries);
+			best_size = n;
+			found = true;
+
+			if (n == 0)
+				break;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	if (!order_valid) {
+		Renumber(root, 0);
+		order_valid = true;
+	}
+
+	assert(result.empty());
+	result.reserve(best_size);
+	for (const Entry *entry : best)
+		result.insert(result.end(),
+			      entry->songs.begin(), entry->songs.end());
+
+	std::sort(result.begin(), result.end(),
+		  [](const Song *a, const Song *b){
+			  return a->order < b->order;
+		  });
+
+	if (best.size() > 1)
+		/* a song may be in more than one entry */
+		result.erase(std::unique(result.begin(), result.end()),
+			     result.end());
+
+	return true;
+}
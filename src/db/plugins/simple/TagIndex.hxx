@@ -0,0 +1,150 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "check.h"
+#include "SongFilter.hxx"
+#include "tag/TagType.h"
+#include "util/AllocatedString.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Directory;
+struct Song;
+
+/**
+ * An inverted index which maps tag values to the songs which have
+ * them.  It narrows down the songs which need to be checked by a
+ * #SongFilter: an equality filter ("find") becomes a hash lookup,
+ * and a case-folded substring filter ("search") only needs to look
+ * at each distinct value once.
+ *
+ * Find() may be called with a shared lock on the #db_mutex; all
+ * other methods require the exclusive lock.
+ */
+class TagIndex {
+	struct Entry {
+		/**
+		 * The songs which have this value, in no particular
+		 * order, each one only once.
+		 */
+		std::vector<Song *> songs;
+
+		/**
+		 * The case-folded value for "search"; initialized on
+		 * demand by GetFolded().
+		 */
+		AllocatedString<> folded = nullptr;
+	};
+
+	typedef std::unordered_map<std::string, Entry> Map;
+
+	std::array<Map, TAG_NUM_OF_ITEM_TYPES> maps;
+
+	/**
+	 * Is Song::order up to date?
+	 */
+	bool order_valid = false;
+
+	/**
+	 * Protects the state which Find() initializes on demand
+	 * (#order_valid, Song::order and Entry::folded) against
+	 * concurrent Find() calls by readers which share the
+	 * #db_mutex.
+	 */
+	Mutex find_mutex;
+
+public:
+	TagIndex() = default;
+
+	TagIndex(const TagIndex &) = delete;
+	TagIndex &operator=(const TagIndex &) = delete;
+
+	void Clear();
+
+	/**
+	 * Clear the index and add all songs of the given tree.
+	 */
+	void Build(Directory &root);
+
+	/**
+	 * Add a new song, or a song whose #Tag has been replaced.
+	 */
+	void Add(Song &song);
+
+	/**
+	 * Remove a song, before it is deleted or before its #Tag is
+	 * replaced.  The song's #Tag must be the one which was passed
+	 * to Add().
+	 */
+	void Remove(Song &song);
+
+	/**
+	 * The order of songs within the tree has changed (e.g. by
+	 * Directory::Sort()).
+	 */
+	void InvalidateOrder() {
+		order_valid = false;
+	}
+
+	/**
+	 * Find the songs which may match the given filter.  This is a
+	 * superset of the matching songs; the caller still needs to
+	 * call SongFilter::Match() on each of them.  They are
+	 * returned in the order of Directory::Walk().
+	 *
+	 * @param root the root of the tree which was passed to
+	 * Build()
+	 * @return false if the filter cannot be evaluated with the
+	 * index (e.g. because it only consists of "base" and "file"
+	 * items)
+	 */
+	bool Find(Directory &root, const SongFilter &filter,
+		  std::vector<Song *> &result);
+
+private:
+	void AddTree(Directory &directory);
+
+	/**
+	 * Assign Song::order in the order of Directory::Walk().
+	 */
+	static unsigned Renumber(Directory &directory, unsigned order);
+
+	static const char *GetFolded(const std::string &value, Entry &entry);
+
+	/**
+	 * Obtain all entries which match the given #SongFilter::Item.
+	 *
+	 * @return the total number of songs in these entries
+	 */
+	size_t FindEntries(const SongFilter::Item &item,
+			   std::vector<const Entry *> &entries);
+
+	size_t FindEntries(TagType type, const SongFilter::Item &item,
+			   std::vector<const Entry *> &entries);
+};
+
+#endif
@@ -41,7 +41,7 @@
 static Directory *
 LockFindChild(Directory &directory, const char *name)
 {
-	const ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 	return directory.FindChild(name);
 }
 
@@ -55,7 +55,7 @@ LockMakeChild(Directory &directory, const char *name)
 static Song *
 LockFindSong(Directory &directory, const char *name)
 {
-	const ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 	return directory.FindSong(name);
 }
 
@@ -70,6 +70,7 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		Directory *subdir = LockMakeChild(directory,
 						  child_name.c_str());
 		subdir->device = DEVICE_INARCHIVE;
+		editor.MarkModified(*subdir);
 
 		//create directories first
 		UpdateArchiveTree(archive, *subdir, tmp + 1);
@@ -85,21 +86,22 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		if (song == nullptr) {
 			song = Song::LoadFromArchive(archive, name, directory);
 			if (song != nullptr) {
-				{
-					const ScopeDatabaseLock protect;
-					directory.AddSong(song);
-				}
+				editor.LockAddSong(directory, song);
 
 				modified = true;
 				FormatDefault(update_domain, "added %s/%s",
 					      directory.GetPath(), name);
 			}
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			Tag tag;
+			if (!song->ScanFileInArchive(archive, tag)) {
 				FormatDebug(update_domain,
 					    "deleting unrecognized file %s/%s",
 					    directory.GetPath(), name);
 				editor.LockDeleteSong(directory, song);
+			} else {
+				const ScopeDatabaseLock protect;
+				editor.UpdateSongTag(*song, std::move(tag));
 			}
 		}
 	}
@@ -174,6 +176,7 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 	}
 
 	directory->mtime = info.mtime;
+	editor.MarkModified(*directory);
 
 	UpdateArchiveVisitor visitor(*this, *file, directory);
 	file->Visit(visitor);
@@ -54,6 +54,7 @@ UpdateWalk::MakeDirectoryIfModified(Directory &parent, const char *name,
 
 	directory = parent.MakeChild(name);
 	directory->mtime = info.mtime;
+	editor.MarkModified(*directory);
 	return directory;
 }
 
@@ -112,10 +113,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 			FormatDefault(update_domain, "added %s/%s",
 				      contdir->GetPath(), song->uri);
 
-			{
-				const ScopeDatabaseLock protect;
-				contdir->AddSong(song);
-			}
+			editor.LockAddSong(*contdir, song);
 
 			modified = true;
 		}
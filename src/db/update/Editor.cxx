@@ -24,9 +24,56 @@
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/plugins/simple/DatabaseJournal.hxx"
+#include "db/plugins/simple/AggregateCache.hxx"
 
 #include <assert.h>
 
+void
+DatabaseEditor::MarkModified(const Directory &directory)
+{
+	if (journal != nullptr)
+		journal->MarkModified(directory);
+
+	if (aggregate_cache != nullptr)
+		aggregate_cache->Invalidate(directory.GetPath());
+}
+
+void
+DatabaseEditor::AddSong(Directory &parent, Song *song)
+{
+	assert(song->parent == &parent);
+
+	parent.AddSong(song);
+
+	if (tag_index != nullptr)
+		tag_index->Add(*song);
+
+	MarkModified(parent);
+}
+
+void
+DatabaseEditor::LockAddSong(Directory &parent, Song *song)
+{
+	const ScopeDatabaseLock protect;
+	AddSong(parent, song);
+}
+
+void
+DatabaseEditor::UpdateSongTag(Song &song, Tag &&tag)
+{
+	if (tag_index != nullptr)
+		tag_index->Remove(song);
+
+	song.tag = std::move(tag);
+
+	if (tag_index != nullptr)
+		tag_index->Add(song);
+
+	MarkModified(*song.parent);
+}
+
 void
 DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 {
@@ -35,6 +82,11 @@ DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 	/* first, prevent traversers in main task from getting this */
 	dir.RemoveSong(del);
 
+	if (tag_index != nullptr)
+		tag_index->Remove(*del);
+
+	MarkModified(dir);
+
 	/* temporary unlock, because update_remove_song() blocks */
 	const ScopeDatabaseUnlock unlock;
 
@@ -78,6 +130,12 @@ DatabaseEditor::DeleteDirectory(Directory *directory)
 
 	ClearDirectory(*directory);
 
+	if (journal != nullptr)
+		journal->MarkDeleted(*directory);
+
+	if (aggregate_cache != nullptr)
+		aggregate_cache->Invalidate(directory->GetPath());
+
 	directory->Delete();
 }
 
@@ -108,7 +166,8 @@ DatabaseEditor::DeleteNameIn(Directory &parent, const char *name)
 		modified = true;
 	}
 
-	parent.playlists.erase(name);
+	if (parent.playlists.erase(name))
+		MarkModified(parent);
 
 	return modified;
 }
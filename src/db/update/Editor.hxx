@@ -26,13 +26,64 @@
 
 struct Directory;
 struct Song;
+struct Tag;
+class TagIndex;
+class DatabaseJournal;
+class AggregateCache;
 
 class DatabaseEditor final {
 	UpdateRemoveService remove;
 
+	/**
+	 * The index of the database being edited, which is kept in
+	 * sync with all modifications.  May be nullptr.
+	 */
+	TagIndex *const tag_index;
+
+	/**
+	 * The journal which records all modified directories for the
+	 * next incremental save.  May be nullptr.
+	 */
+	DatabaseJournal *const journal;
+
+	/**
+	 * The cached query results which are invalidated by all
+	 * modifications.  May be nullptr.
+	 */
+	AggregateCache *const aggregate_cache;
+
 public:
-	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
-		:remove(_loop, _listener) {}
+	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener,
+		       TagIndex *_tag_index, DatabaseJournal *_journal,
+		       AggregateCache *_aggregate_cache)
+		:remove(_loop, _listener), tag_index(_tag_index),
+		 journal(_journal), aggregate_cache(_aggregate_cache) {}
+
+	/**
+	 * Record that the properties or the playlists of the given
+	 * directory were modified, or that it was created.  The other
+	 * methods do this automatically.
+	 */
+	void MarkModified(const Directory &directory);
+
+	/**
+	 * Add a new song to the directory.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void AddSong(Directory &parent, Song *song);
+
+	/**
+	 * AddSong() with automatic locking.
+	 */
+	void LockAddSong(Directory &parent, Song *song);
+
+	/**
+	 * Replace the #Tag of an existing song.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void UpdateSongTag(Song &song, Tag &&tag);
 
 	/**
 	 * Caller must lock the #db_mutex.
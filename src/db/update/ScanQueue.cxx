@@ -0,0 +1,159 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ScanQueue.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <iterator>
+
+/**
+ * Push() blocks when this many jobs per thread have not been started
+ * yet.  This bounds the memory used by the queue, but gives the
+ * threads enough work while the update thread reads directories.
+ */
+static constexpr unsigned MAX_PENDING_PER_THREAD = 16;
+
+TagScanQueue::TagScanQueue(Storage &_storage, unsigned _n_threads)
+	:storage(_storage), threads(new Thread[_n_threads])
+{
+	try {
+		for (; n_threads < _n_threads; ++n_threads)
+			threads[n_threads].Start(WorkFunc, this);
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+	}
+}
+
+TagScanQueue::~TagScanQueue()
+{
+	StopThreads();
+}
+
+void
+TagScanQueue::StopThreads()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+	n_threads = 0;
+}
+
+inline void
+TagScanQueue::Scan(Job &job)
+{
+	job.success = Song::ScanFile(storage, job.uri.c_str(),
+				     job.mtime, job.tag);
+}
+
+void
+TagScanQueue::Push(Directory &directory, Song *song, const char *name,
+		   std::string &&uri)
+{
+	const ScopeLock protect(mutex);
+
+	if (n_threads == 0) {
+		/* no threads: scan right here */
+		finished.emplace_back(directory, song, name, std::move(uri));
+
+		const ScopeUnlock unlock(mutex);
+		Scan(finished.back());
+		return;
+	}
+
+	while (pending.size() >= n_threads * MAX_PENDING_PER_THREAD)
+		done_cond.wait(mutex);
+
+	pending.emplace_back(directory, song, name, std::move(uri));
+	cond.signal();
+}
+
+TagScanQueue::JobList
+TagScanQueue::Take(size_t min)
+{
+	JobList result;
+
+	const ScopeLock protect(mutex);
+	if (finished.size() >= min)
+		result.swap(finished);
+
+	return result;
+}
+
+void
+TagScanQueue::Cancel()
+{
+	const ScopeLock protect(mutex);
+	pending.clear();
+}
+
+TagScanQueue::JobList
+TagScanQueue::Flush()
+{
+	JobList result;
+
+	const ScopeLock protect(mutex);
+	while (!pending.empty() || !running.empty())
+		done_cond.wait(mutex);
+
+	result.swap(finished);
+	return result;
+}
+
+inline void
+TagScanQueue::Work()
+{
+	SetThreadName("scan");
+
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (pending.empty()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		/* move the job to the "running" list; list iterators
+		   are stable, so it remains valid while the mutex is
+		   unlocked */
+		running.splice(running.end(), pending, pending.begin());
+		const auto i = std::prev(running.end());
+
+		mutex.unlock();
+		Scan(*i);
+		mutex.lock();
+
+		finished.splice(finished.end(), running, i);
+		done_cond.broadcast();
+	}
+}
+
+void
+TagScanQueue::WorkFunc(void *ctx)
+{
+	TagScanQueue &queue = *(TagScanQueue *)ctx;
+	queue.Work();
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_SCAN_QUEUE_HXX
+#define MPD_UPDATE_SCAN_QUEUE_HXX
+
+#include "check.h"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include <time.h>
+
+struct Directory;
+struct Song;
+class Storage;
+
+/**
+ * Scans the tags of song files in a pool of threads, while the
+ * update thread continues walking the directory tree.  The update
+ * thread collects the finished jobs and commits them to the
+ * database.
+ *
+ * With zero threads, each job is finished right inside Push().
+ */
+class TagScanQueue {
+public:
+	struct Job {
+		Directory &directory;
+
+		/**
+		 * The existing song which shall be updated, or nullptr
+		 * if a new one shall be created.
+		 */
+		Song *const song;
+
+		/**
+		 * The file name within #directory.
+		 */
+		const std::string name;
+
+		/**
+		 * The URI relative to the #Storage.
+		 */
+		const std::string uri;
+
+		/**
+		 * The result: false if the file could not be scanned
+		 * (no decoder plugin recognized it).
+		 */
+		bool success;
+
+		time_t mtime;
+		Tag tag;
+
+		Job(Directory &_directory, Song *_song,
+		    const char *_name, std::string &&_uri)
+			:directory(_directory), song(_song),
+			 name(_name), uri(std::move(_uri)) {}
+	};
+
+	typedef std::list<Job> JobList;
+
+private:
+	Storage &storage;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a new job has been pushed or when the
+	 * threads shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job has been finished.
+	 */
+	Cond done_cond;
+
+	std::unique_ptr<Thread[]> threads;
+	unsigned n_threads = 0;
+
+	/**
+	 * Jobs which have not been started yet.
+	 */
+	JobList pending;
+
+	/**
+	 * Jobs which are being scanned right now.
+	 */
+	JobList running;
+
+	/**
+	 * Jobs which are waiting to be collected with Take().
+	 */
+	JobList finished;
+
+	bool quit = false;
+
+public:
+	/**
+	 * @param n_threads the number of worker threads; if a thread
+	 * cannot be created, the queue continues with fewer
+	 */
+	TagScanQueue(Storage &_storage, unsigned n_threads);
+	~TagScanQueue();
+
+	TagScanQueue(const TagScanQueue &) = delete;
+	TagScanQueue &operator=(const TagScanQueue &) = delete;
+
+	/**
+	 * Submit a new job.  If too many jobs are pending already,
+	 * this waits for a worker thread to pick one up.
+	 */
+	void Push(Directory &directory, Song *song, const char *name,
+		  std::string &&uri);
+
+	/**
+	 * Return the finished jobs, but only if there are at least
+	 * the specified number.
+	 */
+	JobList Take(size_t min);
+
+	/**
+	 * Discard all jobs which have not been started yet.
+	 */
+	void Cancel();
+
+	/**
+	 * Wait until all jobs have been finished and return them.
+	 */
+	JobList Flush();
+
+private:
+	void StopThreads();
+
+	void Scan(Job &job);
+
+	void Work();
+	static void WorkFunc(void *ctx);
+};
+
+#endif
@@ -26,6 +26,8 @@
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
 #include "Idle.hxx"
 #include "Log.hxx"
 #include "thread/Thread.hxx"
@@ -43,6 +45,8 @@ UpdateService::UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 	:DeferredMonitor(_loop),
 	 db(_db), storage(_storage),
 	 listener(_listener),
+	 scan_threads(config_get_unsigned(ConfigOption::UPDATE_THREADS,
+					  DEFAULT_SCAN_THREADS)),
 	 update_task_id(0),
 	 walk(nullptr)
 {
@@ -77,7 +81,7 @@ UpdateService::CancelMount(const char *uri)
 
 	Directory::LookupResult lr;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		lr = db.GetRoot().LookupDirectory(uri);
 	}
 
@@ -125,7 +129,7 @@ UpdateService::Task()
 
 	if (modified || !next.db->FileExists()) {
 		try {
-			next.db->Save();
+			next.db->SaveChanges();
 		} catch (const std::exception &e) {
 			LogError(e, "Failed to save database");
 		}
@@ -156,7 +160,10 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage);
+	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage,
+			      scan_threads, next.db->GetTagIndex(),
+			      next.db->GetJournal(),
+			      next.db->GetAggregateCache());
 
 	update_thread.Start(Task, this);
 
@@ -185,7 +192,7 @@ UpdateService::Enqueue(const char *path, bool discard)
 
 	Directory::LookupResult lr;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		lr = db.GetRoot().LookupDirectory(path);
 	}
 
@@ -40,6 +40,14 @@ class UpdateService final : DeferredMonitor {
 
 	DatabaseListener &listener;
 
+	static constexpr unsigned DEFAULT_SCAN_THREADS = 4;
+
+	/**
+	 * The number of threads which scan song tags during an
+	 * update, see #TagScanQueue.
+	 */
+	const unsigned scan_threads;
+
 	bool modified;
 
 	Thread update_thread;
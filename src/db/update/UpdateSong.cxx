@@ -26,6 +26,7 @@
 #include "db/plugins/simple/Song.hxx"
 #include "decoder/DecoderList.hxx"
 #include "storage/FileInfo.hxx"
+#include "fs/Traits.hxx"
 #include "Log.hxx"
 
 #include <unistd.h>
@@ -37,7 +38,7 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 {
 	Song *song;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		song = directory.FindSong(name);
 	}
 
@@ -63,33 +64,68 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
-		if (song == nullptr) {
-			FormatDebug(update_domain,
-				    "ignoring unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			return;
-		}
-
-		{
-			const ScopeDatabaseLock protect;
-			directory.AddSong(song);
-		}
-
-		modified = true;
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), name);
+		scan_queue->Push(directory, nullptr, name,
+				 PathTraitsUTF8::Build(directory.GetPath(),
+						       name));
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FormatDefault(update_domain, "updating %s/%s",
 			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
+		scan_queue->Push(directory, song, name, song->GetURI());
+	} else
+		return;
+
+	CommitScanned(scan_queue->Take(COMMIT_BATCH));
+}
+
+void
+UpdateWalk::CommitScanned(TagScanQueue::JobList &&jobs)
+{
+	if (jobs.empty())
+		return;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		for (auto &job : jobs) {
+			Directory &directory = job.directory;
+
+			if (job.song == nullptr) {
+				if (!job.success)
+					continue;
+
+				Song *song = Song::NewFile(job.name.c_str(),
+							   directory);
+				song->mtime = job.mtime;
+				song->tag = std::move(job.tag);
+				editor.AddSong(directory, song);
+			} else if (job.success) {
+				job.song->mtime = job.mtime;
+				editor.UpdateSongTag(*job.song,
+						     std::move(job.tag));
+			} else
+				editor.DeleteSong(directory, job.song);
+
+			modified = true;
 		}
+	}
 
-		modified = true;
+	/* log outside of the database lock */
+	for (const auto &job : jobs) {
+		const char *path = job.directory.GetPath();
+		const char *name = job.name.c_str();
+
+		if (job.song == nullptr) {
+			if (job.success)
+				FormatDefault(update_domain, "added %s/%s",
+					      path, name);
+			else
+				FormatDebug(update_domain,
+					    "ignoring unrecognized file %s/%s",
+					    path, name);
+		} else if (!job.success)
+			FormatDebug(update_domain,
+				    "deleting unrecognized file %s/%s",
+				    path, name);
 	}
 }
 
@@ -50,10 +50,14 @@
 #include <errno.h>
 
 UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage)
-	:cancel(false),
+		       Storage &_storage, unsigned _scan_threads,
+		       TagIndex *_tag_index, DatabaseJournal *_journal,
+		       AggregateCache *_aggregate_cache)
+	:scan_threads(_scan_threads),
+	 cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 editor(_loop, _listener, _tag_index, _journal, _aggregate_cache),
+	 scan_queue(nullptr)
 {
 #ifndef WIN32
 	follow_inside_symlinks =
@@ -128,6 +132,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory)
 						i->name.c_str())) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			editor.MarkModified(directory);
 		} else
 			++i;
 	}
@@ -195,8 +200,10 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		editor.MarkModified(directory);
 		modified = true;
+	}
 	return true;
 }
 
@@ -382,7 +389,10 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
 	}
 
-	directory.mtime = info.mtime;
+	if (directory.mtime != info.mtime) {
+		directory.mtime = info.mtime;
+		editor.MarkModified(directory);
+	}
 
 	return true;
 }
@@ -394,7 +404,7 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 {
 	Directory *directory;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		directory = parent.FindChild(name_utf8);
 	}
 
@@ -425,6 +435,7 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 	}
 
 	directory_set_stat(*directory, info);
+	editor.MarkModified(*directory);
 	return directory;
 }
 
@@ -487,17 +498,25 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 	walk_discard = discard;
 	modified = false;
 
+	TagScanQueue queue(storage, scan_threads);
+	scan_queue = &queue;
+
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
 		StorageFileInfo info;
-		if (!GetInfo(storage, "", info))
-			return false;
+		if (GetInfo(storage, "", info)) {
+			ExcludeList exclude_list;
 
-		ExcludeList exclude_list;
-
-		UpdateDirectory(root, exclude_list, info);
+			UpdateDirectory(root, exclude_list, info);
+		}
 	}
 
+	if (cancel)
+		queue.Cancel();
+
+	CommitScanned(queue.Flush());
+	scan_queue = nullptr;
+
 	return modified;
 }
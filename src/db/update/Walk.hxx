@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "Editor.hxx"
+#include "ScanQueue.hxx"
 #include "Compiler.h"
 
 struct StorageFileInfo;
@@ -44,6 +45,19 @@ class UpdateWalk final {
 	bool follow_outside_symlinks;
 #endif
 
+	/**
+	 * The number of threads which scan song tags in parallel to
+	 * the directory walk; zero means the update thread scans
+	 * them by itself.
+	 */
+	const unsigned scan_threads;
+
+	/**
+	 * Finished tag scans are committed to the database as soon
+	 * as this many have accumulated.
+	 */
+	static constexpr size_t COMMIT_BATCH = 64;
+
 	bool walk_discard;
 	bool modified;
 
@@ -58,9 +72,23 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * Scans song tags on behalf of UpdateSongFile2().  Only
+	 * valid during Walk().
+	 */
+	TagScanQueue *scan_queue;
+
 public:
+	/**
+	 * @param _tag_index the index of the database which will be
+	 * walked, to be kept in sync (may be nullptr)
+	 * @param _journal records the modified directories of the
+	 * database (may be nullptr)
+	 */
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage);
+		   Storage &_storage, unsigned _scan_threads,
+		   TagIndex *_tag_index, DatabaseJournal *_journal,
+		   AggregateCache *_aggregate_cache);
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -93,6 +121,12 @@ private:
 			    const char *name, const char *suffix,
 			    const StorageFileInfo &info);
 
+	/**
+	 * Apply the results of finished #TagScanQueue jobs to the
+	 * database, all while holding the #db_mutex once.
+	 */
+	void CommitScanned(TagScanQueue::JobList &&jobs);
+
 	bool UpdateContainerFile(Directory &directory,
 				 const char *name, const char *suffix,
 				 const StorageFileInfo &info);
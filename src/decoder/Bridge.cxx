@@ -73,8 +73,8 @@ DecoderBridge::CheckCancelRead() const
 }
 
 /**
- * All chunks are full of decoded data; wait for the player to free
- * one.
+ * All chunks are full of decoded data (or DecoderControl::pipe_limit
+ * has been reached); wait for the player to free one.
  */
 static DecoderCommand
 need_chunks(DecoderControl &dc)
@@ -101,7 +101,9 @@ DecoderBridge::GetChunk()
 		return current_chunk;
 
 	do {
-		current_chunk = dc.buffer->Allocate();
+		current_chunk = dc.IsPipeLimited() && dc.LockIsPipeFull()
+			? nullptr
+			: dc.buffer->Allocate();
 		if (current_chunk != nullptr) {
 			current_chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
@@ -74,6 +74,13 @@ DecoderControl::SetReady(const AudioFormat audio_format,
 	client_cond.signal();
 }
 
+bool
+DecoderControl::IsPipeFull() const
+{
+	return pipe_limit > 0 && pipe != nullptr &&
+		pipe->GetSize() >= pipe_limit;
+}
+
 bool
 DecoderControl::IsCurrentSong(const DetachedSong &_song) const
 {
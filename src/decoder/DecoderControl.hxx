@@ -30,6 +30,7 @@
 #include "ReplayGainConfig.hxx"
 #include "ReplayGainMode.hxx"
 
+#include <atomic>
 #include <exception>
 
 #include <utility>
@@ -163,6 +164,20 @@ struct DecoderControl {
 	 */
 	MusicPipe *pipe;
 
+	/**
+	 * If non-zero, then the decoder pauses as soon as #pipe
+	 * contains this number of chunks, until the limit is lifted
+	 * (and the object is signalled).  This is used by the player
+	 * to decode the beginning of upcoming songs in advance
+	 * without filling the whole #MusicBuffer.
+	 *
+	 * Modified only while #mutex is locked, but the decoder
+	 * thread may read it without the lock to avoid locking for
+	 * each chunk when there is no limit (see
+	 * IsPipeLimited()).
+	 */
+	std::atomic_uint pipe_limit{0};
+
 	const ReplayGainConfig replay_gain_config;
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
@@ -242,6 +257,32 @@ struct DecoderControl {
 		return IsStarting();
 	}
 
+	/**
+	 * Has the decoder reached #pipe_limit?
+	 *
+	 * Caller must lock the object.
+	 */
+	gcc_pure
+	bool IsPipeFull() const;
+
+	gcc_pure
+	bool LockIsPipeFull() const {
+		const ScopeLock protect(mutex);
+		return IsPipeFull();
+	}
+
+	/**
+	 * Is there a #pipe_limit?  This is a hint for the decoder
+	 * thread which does not need the lock: it is false for all
+	 * but look-ahead decoders, and the others don't need to lock for
+	 * IsPipeFull().  If the player sets a limit while the
+	 * decoder runs, the decoder may allocate a chunk too many.
+	 */
+	gcc_pure
+	bool IsPipeLimited() const {
+		return pipe_limit.load(std::memory_order_relaxed) > 0;
+	}
+
 	bool HasFailed() const {
 		assert(command == DecoderCommand::NONE);
 
@@ -20,15 +20,46 @@
 #include "config.h"
 #include "FullyBufferedSocket.hxx"
 #include "net/SocketError.hxx"
+#include "util/FormatString.hxx"
+#include "util/AllocatedString.hxx"
 #include "Compiler.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
+/**
+ * The maximum number of output buffer segments sent by one Flush()
+ * call.
+ */
+#ifdef WIN32
+static constexpr size_t MAX_SEGMENTS = 1;
+#else
+static constexpr size_t MAX_SEGMENTS = 32;
+#endif
+
 FullyBufferedSocket::ssize_t
-FullyBufferedSocket::DirectWrite(const void *data, size_t length)
+FullyBufferedSocket::DirectWrite(const ConstBuffer<void> *v, size_t n)
 {
-	const auto nbytes = SocketMonitor::Write((const char *)data, length);
+	assert(n > 0);
+	assert(n <= MAX_SEGMENTS);
+
+#ifdef WIN32
+	const auto nbytes = SocketMonitor::Write((const char *)v[0].data,
+						 v[0].size);
+#else
+	struct iovec iov[MAX_SEGMENTS];
+	for (size_t i = 0; i < n; ++i) {
+		iov[i].iov_base = const_cast<void *>(v[i].data);
+		iov[i].iov_len = v[i].size;
+	}
+
+	const auto nbytes = SocketMonitor::WriteV(iov, n);
+#endif
 	if (gcc_unlikely(nbytes < 0)) {
 		const auto code = GetSocketError();
 		if (IsSocketErrorAgain(code))
@@ -51,14 +82,15 @@ FullyBufferedSocket::Flush()
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.IsEmpty()) {
+	ConstBuffer<void> v[MAX_SEGMENTS];
+	const size_t n = output.Read(v, MAX_SEGMENTS);
+	if (n == 0) {
 		IdleMonitor::Cancel();
 		CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
+	auto nbytes = DirectWrite(v, n);
 	if (gcc_unlikely(nbytes <= 0))
 		return nbytes == 0;
 
@@ -92,6 +124,67 @@ FullyBufferedSocket::Write(const void *data, size_t length)
 	return true;
 }
 
+bool
+FullyBufferedSocket::WriteExternal(ConstBuffer<void> data,
+				   std::shared_ptr<const void> owner)
+{
+	assert(IsDefined());
+
+	if (data.IsEmpty())
+		return true;
+
+	const bool was_empty = output.IsEmpty();
+
+	output.AppendExternal(data, std::move(owner));
+
+	if (was_empty)
+		IdleMonitor::Schedule();
+	return true;
+}
+
+bool
+FullyBufferedSocket::FormatV(const char *fmt, va_list args)
+{
+	assert(IsDefined());
+
+	const bool was_empty = output.IsEmpty();
+
+	/* try to format right into the output buffer */
+	const auto w = output.Write();
+	if (!w.IsEmpty()) {
+		va_list tmp;
+		va_copy(tmp, args);
+		const int length = vsnprintf((char *)w.data, w.size, fmt, tmp);
+		va_end(tmp);
+
+		if (gcc_likely(length >= 0 && size_t(length) < w.size)) {
+			if (length == 0)
+				return true;
+
+			output.Append(length);
+
+			if (was_empty)
+				IdleMonitor::Schedule();
+			return true;
+		}
+	}
+
+	/* not enough contiguous space left: format into a temporary
+	   buffer and let Write() split it */
+
+	char buffer[1024];
+	va_list tmp;
+	va_copy(tmp, args);
+	const int length = vsnprintf(buffer, sizeof(buffer), fmt, tmp);
+	va_end(tmp);
+
+	if (gcc_likely(length >= 0 && size_t(length) < sizeof(buffer)))
+		return Write(buffer, length);
+
+	const auto s = FormatStringV(fmt, args);
+	return Write(s.c_str(), strlen(s.c_str()));
+}
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags)
 {
@@ -101,6 +194,11 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 
 		if (!Flush())
 			return false;
+
+		if (output.IsEmpty())
+			/* invoke OnSocketDrained() from OnIdle(), where
+			   it is allowed to destroy this object */
+			IdleMonitor::Schedule();
 	}
 
 	if (!BufferedSocket::OnSocketReady(flags))
@@ -112,6 +210,11 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 void
 FullyBufferedSocket::OnIdle()
 {
-	if (Flush() && !output.IsEmpty())
+	if (!Flush())
+		return;
+
+	if (!output.IsEmpty())
 		ScheduleWrite();
+	else
+		OnSocketDrained();
 }
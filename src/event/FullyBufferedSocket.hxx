@@ -25,6 +25,10 @@
 #include "IdleMonitor.hxx"
 #include "util/PeakBuffer.hxx"
 
+#include <memory>
+
+#include <stdarg.h>
+
 /**
  * A #BufferedSocket specialization that adds an output buffer.
  */
@@ -46,9 +50,21 @@ public:
 	}
 
 private:
-	ssize_t DirectWrite(const void *data, size_t length);
+	/**
+	 * Send the given output buffer segments with one system call.
+	 */
+	ssize_t DirectWrite(const ConstBuffer<void> *v, size_t n);
 
 protected:
+	/**
+	 * Returns the number of bytes in the output buffer which have
+	 * not yet been sent.
+	 */
+	gcc_pure
+	size_t GetOutputSize() const {
+		return output.GetSize();
+	}
+
 	/**
 	 * Send data from the output buffer to the socket.
 	 *
@@ -61,6 +77,33 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	/**
+	 * Append a buffer to the output without copying it.
+	 *
+	 * @param owner keeps the buffer alive until it has been sent
+	 * or the socket is destroyed
+	 * @return false if the socket has been closed
+	 */
+	bool WriteExternal(ConstBuffer<void> data,
+			   std::shared_ptr<const void> owner);
+
+	/**
+	 * Format a string with vsnprintf() and append it to the
+	 * output buffer.  Usually, the string is formatted right into
+	 * the buffer, without a temporary copy.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool FormatV(const char *fmt, va_list args);
+
+	/**
+	 * The output buffer has been sent completely.  This is a
+	 * chance to generate more output.  It is only invoked from
+	 * the #IdleMonitor callback, so the implementation may destroy
+	 * this object.
+	 */
+	virtual void OnSocketDrained() {}
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
@@ -129,3 +129,32 @@ SocketMonitor::Write(const void *data, size_t length)
 
 	return send(Get(), (const char *)data, length, flags);
 }
+
+#ifndef WIN32
+
+SocketMonitor::ssize_t
+SocketMonitor::WriteV(const struct iovec *v, size_t n)
+{
+	assert(IsDefined());
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	struct msghdr m;
+	m.msg_name = nullptr;
+	m.msg_namelen = 0;
+	m.msg_iov = const_cast<struct iovec *>(v);
+	m.msg_iovlen = n;
+	m.msg_control = nullptr;
+	m.msg_controllen = 0;
+	m.msg_flags = 0;
+
+	return sendmsg(Get(), &m, flags);
+}
+
+#endif
@@ -37,6 +37,9 @@
 #endif
 
 class EventLoop;
+#ifndef WIN32
+struct iovec;
+#endif
 
 /**
  * Monitor events on a socket.  Call Schedule() to announce events
@@ -136,6 +139,14 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+#ifndef WIN32
+	/**
+	 * Send the given buffers with one system call ("gather
+	 * write").
+	 */
+	ssize_t WriteV(const struct iovec *v, size_t n);
+#endif
+
 protected:
 	/**
 	 * @return false if the socket has been closed
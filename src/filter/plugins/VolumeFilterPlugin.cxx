@@ -34,7 +34,8 @@ class VolumeFilter final : public Filter {
 public:
 	explicit VolumeFilter(const AudioFormat &audio_format)
 		:Filter(audio_format) {
-		pv.Open(out_audio_format.format);
+		pv.Open(out_audio_format.format,
+			out_audio_format.channels);
 	}
 
 	unsigned GetVolume() const {
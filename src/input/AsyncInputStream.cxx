@@ -42,7 +42,9 @@ AsyncInputStream::AsyncInputStream(const char *_url,
 	 open(true),
 	 paused(false),
 	 seek_state(SeekState::NONE),
-	 tag(nullptr) {}
+	 tag(nullptr),
+	 tail_state(TailState::NONE),
+	 reading_tail(false) {}
 
 AsyncInputStream::~AsyncInputStream()
 {
@@ -92,7 +94,33 @@ bool
 AsyncInputStream::IsEOF()
 {
 	return (KnownSize() && offset >= size) ||
-		(!open && buffer.IsEmpty());
+		(!reading_tail && !open && buffer.IsEmpty());
+}
+
+inline bool
+AsyncInputStream::SeekTail(offset_type new_offset)
+{
+	while (tail_state == TailState::PENDING && new_offset >= tail_offset)
+		cond.wait(mutex);
+
+	if (tail_state == TailState::READY && new_offset >= tail_offset) {
+		if (!reading_tail) {
+			reading_tail = true;
+			resume_offset = offset;
+		}
+
+		offset = new_offset;
+		return true;
+	}
+
+	if (reading_tail) {
+		/* back to the main stream, where we left it */
+		reading_tail = false;
+		offset = resume_offset;
+		return new_offset == offset;
+	}
+
+	return false;
 }
 
 void
@@ -108,6 +136,9 @@ AsyncInputStream::Seek(offset_type new_offset)
 	if (!IsSeekable())
 		throw std::runtime_error("Not seekable");
 
+	if (SeekTail(new_offset))
+		return;
+
 	/* check if we can fast-forward the buffer */
 
 	while (new_offset > offset) {
@@ -155,6 +186,37 @@ AsyncInputStream::SeekDone()
 	cond.broadcast();
 }
 
+void
+AsyncInputStream::BeginTail(offset_type _tail_offset)
+{
+	assert(tail_state == TailState::NONE);
+	assert(size != UNKNOWN_SIZE);
+	assert(_tail_offset < size);
+
+	tail_state = TailState::PENDING;
+	tail_offset = _tail_offset;
+}
+
+void
+AsyncInputStream::CommitTail(AllocatedArray<uint8_t> &&data)
+{
+	assert(tail_state == TailState::PENDING);
+	assert(tail_offset + data.size() == size);
+
+	tail = std::move(data);
+	tail_state = TailState::READY;
+	cond.broadcast();
+}
+
+void
+AsyncInputStream::CancelTail()
+{
+	assert(tail_state == TailState::PENDING);
+
+	tail_state = TailState::NONE;
+	cond.broadcast();
+}
+
 Tag *
 AsyncInputStream::ReadTag()
 {
@@ -168,6 +230,7 @@ AsyncInputStream::IsAvailable()
 {
 	return postponed_exception ||
 		IsEOF() ||
+		reading_tail ||
 		!buffer.IsEmpty();
 }
 
@@ -176,6 +239,17 @@ AsyncInputStream::Read(void *ptr, size_t read_size)
 {
 	assert(!io_thread_inside());
 
+	if (reading_tail) {
+		assert(offset >= tail_offset);
+
+		const size_t position = offset - tail_offset;
+		const size_t nbytes = std::min(read_size,
+					       tail.size() - position);
+		memcpy(ptr, tail.begin() + position, nbytes);
+		offset += (offset_type)nbytes;
+		return nbytes;
+	}
+
 	/* wait for data */
 	CircularBuffer<uint8_t>::Range r;
 	while (true) {
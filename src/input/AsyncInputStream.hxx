@@ -24,6 +24,7 @@
 #include "event/DeferredCall.hxx"
 #include "util/HugeAllocator.hxx"
 #include "util/CircularBuffer.hxx"
+#include "util/AllocatedArray.hxx"
 
 #include <exception>
 
@@ -38,6 +39,10 @@ class AsyncInputStream : public InputStream {
 		NONE, SCHEDULED, PENDING
 	};
 
+	enum class TailState : uint8_t {
+		NONE, PENDING, READY
+	};
+
 	DeferredCall deferred_resume;
 	DeferredCall deferred_seek;
 
@@ -65,6 +70,22 @@ class AsyncInputStream : public InputStream {
 
 	offset_type seek_offset;
 
+	TailState tail_state;
+
+	/**
+	 * Is Read() currently being served from #tail?  If yes, then
+	 * #resume_offset is the position of #buffer in the stream.
+	 */
+	bool reading_tail;
+
+	/**
+	 * A copy of the end of the stream, beginning at
+	 * #tail_offset, see BeginTail().
+	 */
+	AllocatedArray<uint8_t> tail;
+
+	offset_type tail_offset, resume_offset;
+
 protected:
 	std::exception_ptr postponed_exception;
 
@@ -164,9 +185,50 @@ protected:
 	 */
 	void SeekDone();
 
+	/**
+	 * Announce that the implementation is fetching the end of
+	 * the stream (from the given offset up to InputStream::size)
+	 * with a separate request.  Decoders often seek there to
+	 * look for tags and then seek back; with a copy of the tail,
+	 * this does not disturb the main stream.  Until
+	 * CommitTail() or CancelTail() is called, Seek() into that
+	 * range waits for it.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void BeginTail(offset_type _tail_offset);
+
+	/**
+	 * The end of the stream has been fetched; reads in that
+	 * range will be served from it from now on.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void CommitTail(AllocatedArray<uint8_t> &&data);
+
+	/**
+	 * Fetching the end of the stream has failed; seeking there
+	 * seeks the main stream.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void CancelTail();
+
+	bool IsTailPending() const {
+		return tail_state == TailState::PENDING;
+	}
+
 private:
 	void Resume();
 
+	/**
+	 * Switch to (or away from) #tail if that can serve the new
+	 * offset.  Called by Seek().
+	 *
+	 * @return true if the seek is complete
+	 */
+	bool SeekTail(offset_type new_offset);
+
 	/* for DeferredCall */
 	void DeferredResume();
 	void DeferredSeek();
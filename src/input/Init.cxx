@@ -21,6 +21,7 @@
 #include "Init.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "cache/Manager.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "config/Block.hxx"
@@ -67,10 +68,18 @@ input_stream_global_init()
 								  plugin->name));
 		}
 	}
+
+	try {
+		input_cache_global_init();
+	} catch (const std::runtime_error &e) {
+		std::throw_with_nested(std::runtime_error("Failed to initialize the input cache"));
+	}
 }
 
 void input_stream_global_finish(void)
 {
+	input_cache_global_finish();
+
 	input_plugins_for_each_enabled(plugin)
 		if (plugin->finish != nullptr)
 			plugin->finish();
@@ -88,6 +88,14 @@ protected:
 	 */
 	offset_type offset;
 
+	/**
+	 * An opaque string which changes whenever the resource is
+	 * modified (e.g. the HTTP "ETag" or the modification time),
+	 * or empty if unknown.  The input cache uses it to detect
+	 * stale copies.
+	 */
+	std::string validator;
+
 private:
 	/**
 	 * the MIME content type of the resource, or empty if unknown.
@@ -214,6 +222,13 @@ public:
 		mime = std::move(_mime);
 	}
 
+	gcc_pure
+	const char *GetValidator() const {
+		assert(ready);
+
+		return validator.empty() ? nullptr : validator.c_str();
+	}
+
 	gcc_pure
 	bool KnownSize() const {
 		assert(ready);
@@ -24,6 +24,7 @@
 #include "LocalOpen.hxx"
 #include "Domain.hxx"
 #include "plugins/RewindInputPlugin.hxx"
+#include "cache/Manager.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
 
@@ -38,11 +39,14 @@ InputStream::Open(const char *url,
 		return OpenLocalInputStream(path, mutex, cond);
 	}
 
-	input_plugins_for_each_enabled(plugin) {
-		InputStream *is;
+	InputStream *is = input_cache_open(url, mutex, cond);
+	if (is != nullptr)
+		return InputStreamPtr(is);
 
+	input_plugins_for_each_enabled(plugin) {
 		is = plugin->open(url, mutex, cond);
 		if (is != nullptr) {
+			is = input_cache_wrap(is);
 			is = input_rewind_open(is);
 
 			return InputStreamPtr(is);
@@ -37,6 +37,9 @@ ProxyInputStream::CopyAttributes()
 			if (input.HasMimeType())
 				SetMimeType(input.GetMimeType());
 
+			if (input.GetValidator() != nullptr)
+				validator = input.GetValidator();
+
 			size = input.KnownSize()
 				? input.GetSize()
 				: UNKNOWN_SIZE;
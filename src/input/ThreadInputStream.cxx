@@ -23,25 +23,36 @@
 #include "util/CircularBuffer.hxx"
 #include "util/HugeAllocator.hxx"
 
+#include <stdexcept>
+
 #include <assert.h>
 #include <string.h>
 
 ThreadInputStream::~ThreadInputStream()
 {
-	{
-		const ScopeLock lock(mutex);
-		close = true;
-		wake_cond.signal();
-	}
+	Stop();
+}
 
-	Cancel();
+void
+ThreadInputStream::Stop()
+{
+	if (thread.IsDefined()) {
+		{
+			const ScopeLock lock(mutex);
+			close = true;
+			wake_cond.signal();
+		}
 
-	thread.Join();
+		Cancel();
+
+		thread.Join();
+	}
 
 	if (buffer != nullptr) {
 		buffer->Clear();
 		HugeFree(buffer->Write().data, buffer_size);
 		delete buffer;
+		buffer = nullptr;
 	}
 }
 
@@ -73,20 +84,53 @@ ThreadInputStream::ThreadFunc()
 	}
 
 	/* we're ready, tell it to our client */
-	SetReady();
+	if (!IsReady())
+		SetReady();
 
 	while (!close) {
 		assert(!postponed_exception);
 
+		if (seek_pending) {
+			/* discard the data which was read at the old
+			   offset */
+			buffer->Clear();
+			eof = false;
+			window = initial_window;
+			consumed = 0;
+
+			try {
+				const ScopeUnlock unlock(mutex);
+				ThreadSeek(seek_offset);
+			} catch (...) {
+				postponed_exception = std::current_exception();
+			}
+
+			seek_pending = false;
+			cond.broadcast();
+
+			if (postponed_exception)
+				break;
+
+			continue;
+		}
+
 		auto w = buffer->Write();
-		if (w.IsEmpty()) {
+		if (eof || w.IsEmpty() || buffer->GetSize() >= window) {
+			/* wait until the client consumes data, seeks
+			   or closes the stream */
 			wake_cond.wait(mutex);
 		} else {
+			/* read in portions of at most a quarter of
+			   the buffer, so the client doesn't have to
+			   wait for a huge read() to finish */
+			const size_t max_size =
+				std::min({w.size, window - buffer->GetSize(),
+					  buffer_size / 4});
 			size_t nbytes;
 
 			try {
 				const ScopeUnlock unlock(mutex);
-				nbytes = ThreadRead(w.data, w.size);
+				nbytes = ThreadRead(w.data, max_size);
 			} catch (...) {
 				postponed_exception = std::current_exception();
 				cond.broadcast();
@@ -97,16 +141,33 @@ ThreadInputStream::ThreadFunc()
 
 			if (nbytes == 0) {
 				eof = true;
-				break;
+
+				/* only a seekable stream needs the
+				   thread after the end */
+				if (!IsSeekable())
+					break;
+
+				continue;
 			}
 
 			buffer->Append(nbytes);
 		}
 	}
 
+	/* a seek which is still pending will never be done; don't
+	   let Seek() wait for it forever */
+	seek_pending = false;
+	cond.broadcast();
+
 	Close();
 }
 
+void
+ThreadInputStream::ThreadSeek(gcc_unused offset_type new_offset)
+{
+	throw std::runtime_error("Seeking is not implemented");
+}
+
 void
 ThreadInputStream::ThreadFunc(void *ctx)
 {
@@ -123,6 +184,52 @@ ThreadInputStream::Check()
 		std::rethrow_exception(postponed_exception);
 }
 
+void
+ThreadInputStream::Seek(offset_type new_offset)
+{
+	assert(!thread.IsInside());
+
+	if (!IsSeekable())
+		throw std::runtime_error("Not seekable");
+
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+
+	/* check if we can fast-forward the buffer */
+
+	while (new_offset > offset) {
+		auto r = buffer->Read();
+		if (r.IsEmpty())
+			break;
+
+		const size_t nbytes =
+			new_offset - offset < (offset_type)r.size
+					       ? new_offset - offset
+					       : r.size;
+
+		buffer->Consume(nbytes);
+		offset += nbytes;
+		wake_cond.signal();
+	}
+
+	if (new_offset == offset)
+		return;
+
+	/* no: ask the thread to seek */
+
+	seek_offset = new_offset;
+	seek_pending = true;
+	wake_cond.signal();
+
+	while (seek_pending && !postponed_exception)
+		cond.wait(mutex);
+
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+
+	offset = new_offset;
+}
+
 bool
 ThreadInputStream::IsAvailable()
 {
@@ -145,6 +252,11 @@ ThreadInputStream::Read(void *ptr, size_t read_size)
 			size_t nbytes = std::min(read_size, r.size);
 			memcpy(ptr, r.data, nbytes);
 			buffer->Consume(nbytes);
+
+			consumed += nbytes;
+			if (consumed >= window / 2 && window < buffer_size)
+				window = std::min(window * 2, buffer_size);
+
 			wake_cond.broadcast();
 			offset += nbytes;
 			return nbytes;
@@ -162,5 +274,9 @@ ThreadInputStream::IsEOF()
 {
 	assert(!thread.IsInside());
 
-	return eof;
+	/* the thread may have seen the end while there is still data
+	   in the buffer; only seekable streams check that, because
+	   they may still seek back, and the others keep the
+	   traditional behaviour */
+	return eof && (!IsSeekable() || buffer->IsEmpty());
 }
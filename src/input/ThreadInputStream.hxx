@@ -26,6 +26,7 @@
 #include "thread/Cond.hxx"
 
 #include <exception>
+#include <algorithm>
 
 #include <stdint.h>
 
@@ -38,7 +39,12 @@ template<typename T> class CircularBuffer;
  * another thread using the regular #InputStream API.  This class
  * manages the thread and the buffer.
  *
- * This works only for "streams": unknown length, no seeking, no tags.
+ * This works only for "streams" without tags.  Seeking is supported
+ * if the implementation sets #seekable and implements ThreadSeek();
+ * seeks within the buffered data don't need to wake up the thread.
+ * The thread of a seekable stream stays alive at the end of the file,
+ * because the client may seek back; the thread of other streams
+ * exits there.
  */
 class ThreadInputStream : public InputStream {
 	const char *const plugin;
@@ -57,6 +63,22 @@ class ThreadInputStream : public InputStream {
 	const size_t buffer_size;
 	CircularBuffer<uint8_t> *buffer = nullptr;
 
+	/**
+	 * The thread stops reading when this number of bytes is in
+	 * the buffer, see SetReadAheadWindow().
+	 */
+	size_t window;
+
+	/**
+	 * The initial value of #window after each seek.
+	 */
+	size_t initial_window;
+
+	/**
+	 * The number of bytes consumed since the last seek.
+	 */
+	size_t consumed = 0;
+
 	/**
 	 * Shall the stream be closed?
 	 */
@@ -67,13 +89,22 @@ class ThreadInputStream : public InputStream {
 	 */
 	bool eof = false;
 
+	/**
+	 * Shall the thread seek to #seek_offset?  It clears the flag
+	 * when done.
+	 */
+	bool seek_pending = false;
+
+	offset_type seek_offset;
+
 public:
 	ThreadInputStream(const char *_plugin,
 			  const char *_uri, Mutex &_mutex, Cond &_cond,
 			  size_t _buffer_size)
 		:InputStream(_uri, _mutex, _cond),
 		 plugin(_plugin),
-		 buffer_size(_buffer_size) {}
+		 buffer_size(_buffer_size),
+		 window(_buffer_size), initial_window(_buffer_size) {}
 
 	virtual ~ThreadInputStream();
 
@@ -84,11 +115,33 @@ public:
 
 	/* virtual methods from InputStream */
 	void Check() override final;
+	void Seek(offset_type new_offset) override final;
 	bool IsEOF() override final;
 	bool IsAvailable() override final;
 	size_t Read(void *ptr, size_t size) override final;
 
 protected:
+	/**
+	 * Stop the thread and free the buffer.  The destructor of the
+	 * implementing class must call this, because the thread calls
+	 * its virtual methods until it has exited.  May be called
+	 * more than once.
+	 */
+	void Stop();
+
+	/**
+	 * Don't fill the whole buffer right away; start with the
+	 * given number of bytes, and double it whenever the client
+	 * has consumed half of it.  This avoids reading far ahead
+	 * for clients which only look at a few bytes, e.g. to scan
+	 * tags.  Must be called before Start().
+	 */
+	void SetReadAheadWindow(size_t _window) {
+		assert(buffer == nullptr);
+
+		window = initial_window = std::min(_window, buffer_size);
+	}
+
 	void SetMimeType(const char *_mime) {
 		assert(thread.IsInside());
 
@@ -100,7 +153,8 @@ protected:
 	/**
 	 * Optional initialization after entering the thread.  After
 	 * this returns with success, the InputStream::ready flag is
-	 * set.
+	 * set (unless the implementation has already set it, because
+	 * it knew all attributes in advance).
 	 *
 	 * The #InputStream is locked.  Unlock/relock it if you do a
 	 * blocking operation.
@@ -121,6 +175,16 @@ protected:
 	 */
 	virtual size_t ThreadRead(void *ptr, size_t size) = 0;
 
+	/**
+	 * Seek to the given offset.  Must be implemented if the
+	 * implementation sets #seekable.
+	 *
+	 * The #InputStream is not locked.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	virtual void ThreadSeek(offset_type new_offset);
+
 	/**
 	 * Optional deinitialization before leaving the thread.
 	 *
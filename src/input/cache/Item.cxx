@@ -0,0 +1,263 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Item.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "system/Error.hxx"
+#include "util/StringCompare.hxx"
+#include "util/NumberParser.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <fcntl.h>
+
+#define ITEM_URI "uri: "
+#define ITEM_SIZE "size: "
+#define ITEM_MIME_TYPE "mime_type: "
+#define ITEM_VALIDATOR "validator: "
+#define ITEM_VALIDATED "validated: "
+#define ITEM_RANGE "range: "
+
+static AllocatedPath
+BuildItemPath(Path directory, const char *name, const char *suffix)
+{
+	return AllocatedPath::Build(directory,
+				    AllocatedPath::FromUTF8Throw((std::string(name) + suffix).c_str()));
+}
+
+/**
+ * Delete a file, ignoring errors (e.g. because it does not exist).
+ */
+static void
+RemoveFileQuietly(Path path)
+{
+	try {
+		RemoveFile(path);
+	} catch (const std::runtime_error &) {
+	}
+}
+
+InputCacheItem::InputCacheItem(Path directory, const char *_name,
+			       const char *_uri,
+			       offset_type _size, const char *_mime_type,
+			       const char *_validator)
+	:uri(_uri), name(_name),
+	 data_path(BuildItemPath(directory, _name, ".data")),
+	 meta_path(BuildItemPath(directory, _name, ".meta")),
+	 size(_size),
+	 mime_type(_mime_type != nullptr ? _mime_type : ""),
+	 validator(_validator != nullptr ? _validator : "")
+{
+}
+
+InputCacheItem *
+InputCacheItem::Load(Path directory, const char *_name)
+{
+	const auto path = BuildItemPath(directory, _name, ".meta");
+	TextFile file(path);
+
+	const char *line = file.ReadLine();
+	const char *_uri = line != nullptr
+		? StringAfterPrefix(line, ITEM_URI)
+		: nullptr;
+	if (_uri == nullptr)
+		throw FormatRuntimeError("Malformed cache file: %s",
+					 path.ToUTF8().c_str());
+
+	auto *item = new InputCacheItem(directory, _name, _uri,
+					offset_type(-1), nullptr, nullptr);
+
+	const char *p;
+	while ((line = file.ReadLine()) != nullptr) {
+		if ((p = StringAfterPrefix(line, ITEM_SIZE)) != nullptr) {
+			item->size = ParseUint64(p);
+		} else if ((p = StringAfterPrefix(line, ITEM_MIME_TYPE)) != nullptr) {
+			item->mime_type = p;
+		} else if ((p = StringAfterPrefix(line, ITEM_VALIDATOR)) != nullptr) {
+			item->validator = p;
+		} else if ((p = StringAfterPrefix(line, ITEM_VALIDATED)) != nullptr) {
+			item->validated = ParseUint64(p);
+		} else if ((p = StringAfterPrefix(line, ITEM_RANGE)) != nullptr) {
+			char *endptr;
+			offset_type start = ParseUint64(p, &endptr);
+			offset_type end = ParseUint64(endptr);
+			if (end <= item->size)
+				item->ranges.Add(start, end);
+		}
+	}
+
+	if (item->size == offset_type(-1)) {
+		delete item;
+		throw FormatRuntimeError("Malformed cache file: %s",
+					 path.ToUTF8().c_str());
+	}
+
+	FileInfo info;
+	if (GetFileInfo(path, info))
+		item->mtime = info.GetModificationTime();
+
+	return item;
+}
+
+void
+InputCacheItem::Open()
+{
+	assert(!fd.IsDefined());
+
+	fd.Set(OpenFile(data_path, O_RDWR|O_CREAT, 0666));
+	if (!fd.IsDefined())
+		throw FormatErrno("Failed to open %s",
+				  data_path.ToUTF8().c_str());
+}
+
+void
+InputCacheItem::Close()
+{
+	if (fd.IsDefined())
+		fd.Close();
+}
+
+bool
+InputCacheItem::Matches(offset_type _size, const char *_mime_type,
+			const char *_validator) const
+{
+	return size == _size &&
+		mime_type == (_mime_type != nullptr ? _mime_type : "") &&
+		validator == (_validator != nullptr ? _validator : "");
+}
+
+void
+InputCacheItem::Reset(offset_type _size, const char *_mime_type,
+		      const char *_validator)
+{
+	assert(references == 0);
+
+	size = _size;
+	mime_type = _mime_type != nullptr ? _mime_type : "";
+	validator = _validator != nullptr ? _validator : "";
+	ranges.clear();
+
+	try {
+		TruncateFile(data_path);
+	} catch (const std::runtime_error &) {
+		/* the file may not exist yet */
+	}
+}
+
+size_t
+InputCacheItem::Read(offset_type offset, void *dest, size_t length)
+{
+	const ScopeLock protect(mutex);
+	assert(fd.IsDefined());
+
+	const offset_type end = ranges.FindEnd(offset);
+	if (end == offset)
+		return 0;
+
+	if (offset_type(length) > end - offset)
+		length = end - offset;
+
+	if (fd.Seek(offset) != (off_t)offset)
+		throw FormatErrno("Failed to seek %s",
+				  data_path.ToUTF8().c_str());
+
+	ssize_t nbytes = fd.Read(dest, length);
+	if (nbytes <= 0) {
+		/* the file has been truncated behind our back;
+		   forget it */
+		ranges.clear();
+
+		if (nbytes < 0)
+			throw FormatErrno("Failed to read %s",
+					  data_path.ToUTF8().c_str());
+		throw FormatRuntimeError("Unexpected end of file: %s",
+					 data_path.ToUTF8().c_str());
+	}
+
+	return nbytes;
+}
+
+void
+InputCacheItem::Write(offset_type offset, const void *src, size_t length)
+{
+	const ScopeLock protect(mutex);
+	assert(fd.IsDefined());
+
+	if (ranges.Contains(offset, offset + length))
+		return;
+
+	if (fd.Seek(offset) != (off_t)offset)
+		throw FormatErrno("Failed to seek %s",
+				  data_path.ToUTF8().c_str());
+
+	ssize_t nbytes = fd.Write(src, length);
+	if (nbytes < 0)
+		throw FormatErrno("Failed to write %s",
+				  data_path.ToUTF8().c_str());
+
+	/* a short write (disk full?) is not an error; only the
+	   written part becomes valid */
+	ranges.Add(offset, offset + nbytes);
+}
+
+void
+InputCacheItem::Save()
+{
+	FileOutputStream fos(meta_path);
+	BufferedOutputStream bos(fos);
+
+	bos.Format(ITEM_URI "%s\n", uri.c_str());
+	bos.Format(ITEM_SIZE "%llu\n", (unsigned long long)size);
+	if (!mime_type.empty())
+		bos.Format(ITEM_MIME_TYPE "%s\n", mime_type.c_str());
+	if (!validator.empty())
+		bos.Format(ITEM_VALIDATOR "%s\n", validator.c_str());
+	bos.Format(ITEM_VALIDATED "%lu\n", (unsigned long)validated);
+
+	{
+		const ScopeLock protect(mutex);
+		for (const auto &i : ranges)
+			bos.Format(ITEM_RANGE "%llu %llu\n",
+				   (unsigned long long)i.first,
+				   (unsigned long long)i.second);
+	}
+
+	bos.Flush();
+	fos.Commit();
+
+	mtime = time(nullptr);
+}
+
+void
+InputCacheItem::Delete()
+{
+	assert(references == 0);
+
+	Close();
+
+	RemoveFileQuietly(meta_path);
+	RemoveFileQuietly(data_path);
+}
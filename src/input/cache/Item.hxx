@@ -0,0 +1,221 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_ITEM_HXX
+#define MPD_INPUT_CACHE_ITEM_HXX
+
+#include "check.h"
+#include "input/Offset.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "system/FileDescriptor.hxx"
+#include "thread/Mutex.hxx"
+#include "util/RangeSet.hxx"
+#include "Compiler.h"
+
+#include <boost/intrusive/list_hook.hpp>
+
+#include <string>
+
+#include <time.h>
+
+/**
+ * One remote resource in the #InputCacheManager.  It consists of a
+ * data file which contains the fetched byte ranges at their original
+ * offsets (holes are never read), and a text file describing the
+ * resource and the ranges which are valid.
+ *
+ * All attributes except for #ranges and #fd are protected by the
+ * #InputCacheManager's mutex.
+ */
+class InputCacheItem
+	: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	friend class InputCacheManager;
+
+	const std::string uri;
+
+	/**
+	 * The base name of both files (without suffix).
+	 */
+	const std::string name;
+
+	const AllocatedPath data_path, meta_path;
+
+	offset_type size;
+
+	std::string mime_type;
+
+	/**
+	 * See InputStream::validator; empty if the server didn't
+	 * provide one.
+	 */
+	std::string validator;
+
+	/**
+	 * The time when the remote resource was last found
+	 * unchanged.  A complete item is only served without
+	 * contacting the server for a limited time after that.
+	 */
+	time_t validated = 0;
+
+	/**
+	 * Protects #ranges and #fd.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * The parts of the resource which are stored in the data
+	 * file.
+	 */
+	RangeSet<offset_type> ranges;
+
+	/**
+	 * The data file; only open while #references is non-zero.
+	 */
+	FileDescriptor fd = FileDescriptor::Undefined();
+
+	/**
+	 * The number of #CacheInputStream instances using this item.
+	 * Items in use must not be evicted.
+	 */
+	unsigned references = 0;
+
+	/**
+	 * The number of bytes this item has been accounted for in
+	 * InputCacheManager::total_size.
+	 */
+	offset_type accounted = 0;
+
+	/**
+	 * The time of the last use, for sorting items loaded from
+	 * disk.
+	 */
+	time_t mtime = 0;
+
+public:
+	InputCacheItem(Path directory, const char *_name, const char *_uri,
+		       offset_type _size, const char *_mime_type,
+		       const char *_validator);
+
+	InputCacheItem(const InputCacheItem &) = delete;
+	InputCacheItem &operator=(const InputCacheItem &) = delete;
+
+	/**
+	 * Load the description of an item from the given directory.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @param _name the base name of the files
+	 */
+	static InputCacheItem *Load(Path directory, const char *_name);
+
+	const char *GetURI() const {
+		return uri.c_str();
+	}
+
+	offset_type GetSize() const {
+		return size;
+	}
+
+	const char *GetMimeType() const {
+		return mime_type.empty() ? nullptr : mime_type.c_str();
+	}
+
+	/**
+	 * Does the cached data belong to this version of the remote
+	 * resource?
+	 */
+	gcc_pure
+	bool Matches(offset_type _size, const char *_mime_type,
+		     const char *_validator) const;
+
+	/**
+	 * The number of bytes stored in the data file.
+	 */
+	gcc_pure
+	offset_type GetCachedSize() const {
+		const ScopeLock protect(mutex);
+		return ranges.GetTotal();
+	}
+
+	/**
+	 * Is the whole resource stored in the data file?
+	 */
+	gcc_pure
+	bool IsComplete() const {
+		const ScopeLock protect(mutex);
+		return ranges.Contains(0, size);
+	}
+
+	/**
+	 * Is the byte at the given offset stored in the data file?
+	 */
+	gcc_pure
+	bool IsCached(offset_type offset) const {
+		const ScopeLock protect(mutex);
+		return ranges.FindEnd(offset) > offset;
+	}
+
+	/**
+	 * Copy data from the data file, but not beyond the end of
+	 * the cached range containing the offset.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @return the number of bytes copied; 0 if the offset is not
+	 * cached
+	 */
+	size_t Read(offset_type offset, void *dest, size_t length);
+
+	/**
+	 * Store data fetched from the remote resource.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	void Write(offset_type offset, const void *src, size_t length);
+
+private:
+	/**
+	 * Open the data file.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	void Open();
+
+	void Close();
+
+	/**
+	 * Discard all cached data, because the resource has changed.
+	 */
+	void Reset(offset_type _size, const char *_mime_type,
+		   const char *_validator);
+
+	/**
+	 * Write the description file.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	void Save();
+
+	/**
+	 * Delete both files.
+	 */
+	void Delete();
+};
+
+#endif
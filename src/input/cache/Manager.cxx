@@ -0,0 +1,366 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Manager.hxx"
+#include "Stream.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+static constexpr Domain input_cache_domain("input_cache");
+
+/**
+ * The default for "input_cache_size" in MiB.
+ */
+static constexpr unsigned DEFAULT_INPUT_CACHE_SIZE = 256;
+
+/**
+ * The default for "input_cache_max_age" in seconds.
+ */
+static constexpr unsigned DEFAULT_INPUT_CACHE_MAX_AGE = 24 * 3600;
+
+static InputCacheManager *input_cache;
+
+/**
+ * Calculate the base name of the cache files of a URI: the 64 bit
+ * FNV-1a hash in hexadecimal.  Collisions are detected by comparing
+ * the URI stored in the item.
+ */
+static std::string
+MakeItemName(const char *uri)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const char *p = uri; *p != 0; ++p) {
+		hash ^= (unsigned char)*p;
+		hash *= 1099511628211ull;
+	}
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016" PRIx64, hash);
+	return buffer;
+}
+
+InputCacheManager::InputCacheManager(AllocatedPath &&_directory,
+				     offset_type _max_size,
+				     unsigned _max_age)
+	:directory(std::move(_directory)), max_size(_max_size),
+	 max_age(_max_age)
+{
+	const FileInfo info(directory);
+	if (!info.IsDirectory())
+		throw FormatRuntimeError("Not a directory: %s",
+					 directory.ToUTF8().c_str());
+
+	Load();
+}
+
+InputCacheManager::~InputCacheManager()
+{
+	assert(std::all_of(items.begin(), items.end(),
+			   [](const InputCacheItem &item){
+				   return item.references == 0;
+			   }));
+
+	items.clear_and_dispose(DeleteDisposer());
+}
+
+void
+InputCacheManager::Load()
+{
+	std::set<std::string> data_files;
+	std::vector<InputCacheItem *> loaded;
+
+	DirectoryReader reader(directory);
+	while (reader.ReadEntry()) {
+		const std::string name_utf8 = reader.GetEntry().ToUTF8();
+		const char *suffix = FindStringSuffix(name_utf8.c_str(),
+						      ".meta");
+		if (suffix != nullptr) {
+			const std::string name(name_utf8.c_str(), suffix);
+
+			try {
+				loaded.push_back(InputCacheItem::Load(directory,
+								      name.c_str()));
+			} catch (const std::runtime_error &e) {
+				LogError(e);
+			}
+		} else if ((suffix = FindStringSuffix(name_utf8.c_str(),
+						      ".data")) != nullptr)
+			data_files.emplace(name_utf8.c_str(), suffix);
+	}
+
+	/* most recently used first */
+	std::sort(loaded.begin(), loaded.end(),
+		  [](const InputCacheItem *a, const InputCacheItem *b){
+			  return a->mtime > b->mtime;
+		  });
+
+	for (auto *item : loaded) {
+		data_files.erase(item->name);
+
+		if (!names.emplace(item->name, item).second) {
+			delete item;
+			continue;
+		}
+
+		items.push_back(*item);
+		item->accounted = item->GetCachedSize();
+		total_size += item->accounted;
+	}
+
+	/* data files without a description cannot be used */
+	for (const auto &name : data_files) {
+		InputCacheItem orphan(directory, name.c_str(), "", 0,
+				      nullptr, nullptr);
+		orphan.Delete();
+	}
+
+	FormatDebug(input_cache_domain,
+		    "%u items, %llu bytes",
+		    unsigned(names.size()), (unsigned long long)total_size);
+
+	Evict();
+}
+
+inline void
+InputCacheManager::Use(InputCacheItem &item)
+{
+	if (item.references == 0)
+		item.Open();
+
+	++item.references;
+
+	items.erase(items.iterator_to(item));
+	items.push_front(item);
+}
+
+InputCacheItem *
+InputCacheManager::GetComplete(const char *uri)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = names.find(MakeItemName(uri));
+	if (i == names.end())
+		return nullptr;
+
+	InputCacheItem &item = *i->second;
+	if (item.uri != uri || !item.IsComplete())
+		return nullptr;
+
+	/* the difference is unsigned, so a clock which went
+	   backwards also leads to a new validation */
+	const time_t now = time(nullptr);
+	if ((unsigned long)(now - item.validated) >= max_age)
+		return nullptr;
+
+	try {
+		Use(item);
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return nullptr;
+	}
+
+	return &item;
+}
+
+InputCacheItem *
+InputCacheManager::Get(const char *uri, offset_type size,
+		       const char *mime_type, const char *validator)
+{
+	if (size > max_size)
+		/* would evict everything else */
+		return nullptr;
+
+	const ScopeLock protect(mutex);
+
+	const std::string name = MakeItemName(uri);
+	InputCacheItem *item;
+
+	auto i = names.find(name);
+	if (i != names.end()) {
+		item = i->second;
+		if (item->uri != uri)
+			/* hash collision */
+			return nullptr;
+
+		if (!item->Matches(size, mime_type, validator)) {
+			if (item->references > 0)
+				/* the resource has changed while
+				   another stream is using the old
+				   version */
+				return nullptr;
+
+			FormatDebug(input_cache_domain,
+				    "Resource has changed: %s", uri);
+			item->Reset(size, mime_type, validator);
+		}
+	} else {
+		item = new InputCacheItem(directory, name.c_str(), uri,
+					  size, mime_type, validator);
+		names.emplace(name, item);
+		items.push_front(*item);
+	}
+
+	item->validated = time(nullptr);
+
+	try {
+		Use(*item);
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return nullptr;
+	}
+
+	return item;
+}
+
+void
+InputCacheManager::Release(InputCacheItem &item)
+{
+	const ScopeLock protect(mutex);
+
+	assert(item.references > 0);
+
+	if (--item.references > 0)
+		return;
+
+	try {
+		item.Save();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+	}
+
+	item.Close();
+
+	const offset_type cached = item.GetCachedSize();
+	total_size += cached - item.accounted;
+	item.accounted = cached;
+
+	Evict();
+}
+
+void
+InputCacheManager::Remove(InputCacheItem &item)
+{
+	assert(item.references == 0);
+
+	total_size -= item.accounted;
+	names.erase(item.name);
+	items.erase(items.iterator_to(item));
+
+	item.Delete();
+	delete &item;
+}
+
+void
+InputCacheManager::Evict()
+{
+	auto i = items.end();
+	while (total_size > max_size && i != items.begin()) {
+		InputCacheItem &item = *--i;
+		if (item.references > 0)
+			continue;
+
+		FormatDebug(input_cache_domain, "Evicting %s",
+			    item.uri.c_str());
+
+		/* the successor stays valid */
+		i = std::next(i);
+		Remove(item);
+	}
+}
+
+void
+input_cache_global_init()
+{
+	auto path = config_get_path(ConfigOption::INPUT_CACHE_DIR);
+	if (path.IsNull())
+		return;
+
+	const offset_type max_size =
+		offset_type(config_get_positive(ConfigOption::INPUT_CACHE_SIZE,
+						DEFAULT_INPUT_CACHE_SIZE)) << 20;
+
+	const unsigned max_age =
+		config_get_unsigned(ConfigOption::INPUT_CACHE_MAX_AGE,
+				    DEFAULT_INPUT_CACHE_MAX_AGE);
+
+	input_cache = new InputCacheManager(std::move(path), max_size,
+					    max_age);
+}
+
+void
+input_cache_global_finish()
+{
+	delete input_cache;
+	input_cache = nullptr;
+}
+
+/**
+ * Which URIs shall be cached?  Local files and devices are fast
+ * enough, and other schemes are usually live streams.
+ */
+gcc_pure
+static bool
+IsCacheableURI(const char *uri)
+{
+	return StringStartsWith(uri, "http://") ||
+		StringStartsWith(uri, "https://") ||
+		StringStartsWith(uri, "nfs://") ||
+		StringStartsWith(uri, "smb://");
+}
+
+InputStream *
+input_cache_open(const char *uri, Mutex &mutex, Cond &cond)
+{
+	if (input_cache == nullptr || !IsCacheableURI(uri))
+		return nullptr;
+
+	auto *item = input_cache->GetComplete(uri);
+	if (item == nullptr)
+		return nullptr;
+
+	return new CacheInputStream(*input_cache, *item, mutex, cond);
+}
+
+InputStream *
+input_cache_wrap(InputStream *is)
+{
+	assert(is != nullptr);
+
+	if (input_cache == nullptr || !IsCacheableURI(is->GetURI()))
+		return is;
+
+	return new CacheInputStream(*input_cache, is);
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_MANAGER_HXX
+#define MPD_INPUT_CACHE_MANAGER_HXX
+
+#include "check.h"
+#include "Item.hxx"
+#include "input/Offset.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <map>
+#include <string>
+
+class Cond;
+class InputStream;
+
+/**
+ * Manages a directory which contains copies of remote resources
+ * (see #InputCacheItem).  When the total size of the cached data
+ * exceeds the configured limit, the least recently used items are
+ * deleted.  Complete items are served without contacting the server
+ * only for a limited time after they were last validated.
+ *
+ * This class is thread-safe.
+ */
+class InputCacheManager {
+	typedef boost::intrusive::list<InputCacheItem,
+				       boost::intrusive::constant_time_size<false>> ItemList;
+
+	const AllocatedPath directory;
+
+	const offset_type max_size;
+
+	/**
+	 * The number of seconds after which a complete item must be
+	 * validated again.
+	 */
+	const unsigned max_age;
+
+	Mutex mutex;
+
+	/**
+	 * All items, the most recently used one first.
+	 */
+	ItemList items;
+
+	/**
+	 * All items by their name.
+	 */
+	std::map<std::string, InputCacheItem *> names;
+
+	/**
+	 * The sum of all InputCacheItem::accounted values.
+	 */
+	offset_type total_size = 0;
+
+public:
+	/**
+	 * Throws #std::runtime_error if the directory is not usable.
+	 */
+	InputCacheManager(AllocatedPath &&_directory, offset_type _max_size,
+			  unsigned _max_age);
+
+	~InputCacheManager();
+
+	InputCacheManager(const InputCacheManager &) = delete;
+	InputCacheManager &operator=(const InputCacheManager &) = delete;
+
+	/**
+	 * Look up a resource which is stored completely and has been
+	 * validated recently.  If one is found, it must be released
+	 * with Release().
+	 */
+	InputCacheItem *GetComplete(const char *uri);
+
+	/**
+	 * Obtain the item for a remote resource, creating a new one
+	 * if necessary.  Cached data is discarded if the size, MIME
+	 * type or validator has changed; otherwise, the item is
+	 * marked as validated.  It must be released with Release().
+	 *
+	 * @param validator see InputStream::validator; nullptr if
+	 * unknown
+	 * @return the item, or nullptr if this resource cannot be
+	 * cached
+	 */
+	InputCacheItem *Get(const char *uri, offset_type size,
+			    const char *mime_type, const char *validator);
+
+	/**
+	 * Release an item obtained with Get() or GetComplete(); this
+	 * saves its description and possibly evicts other items.
+	 */
+	void Release(InputCacheItem &item);
+
+private:
+	void Load();
+
+	/**
+	 * Mark the item as being used.  Caller must lock the mutex.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	void Use(InputCacheItem &item);
+
+	/**
+	 * Delete the least recently used items which are not in use
+	 * until the total size fits into the limit.  Caller must
+	 * lock the mutex.
+	 */
+	void Evict();
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Remove(InputCacheItem &item);
+};
+
+void
+input_cache_global_init();
+
+void
+input_cache_global_finish();
+
+/**
+ * Open a resource which is stored completely in the cache, without
+ * contacting the server.
+ *
+ * @return the stream, or nullptr if the resource is not cached
+ */
+InputStream *
+input_cache_open(const char *uri, Mutex &mutex, Cond &cond);
+
+/**
+ * Wrap the stream of a remote resource, so fetched data is stored
+ * in the cache and served from there next time.  Returns the
+ * stream unmodified if the cache is disabled or the URI scheme is
+ * not cacheable.
+ */
+InputStream *
+input_cache_wrap(InputStream *is);
+
+#endif
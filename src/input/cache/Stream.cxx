@@ -0,0 +1,218 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Stream.hxx"
+#include "Manager.hxx"
+#include "Item.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+
+CacheInputStream::CacheInputStream(InputCacheManager &_manager,
+				   InputStream *_input)
+	:InputStream(_input->GetURI(), _input->mutex, _input->cond),
+	 manager(_manager), input(_input)
+{
+	CopyAttributes();
+}
+
+CacheInputStream::CacheInputStream(InputCacheManager &_manager,
+				   InputCacheItem &_item,
+				   Mutex &_mutex, Cond &_cond)
+	:InputStream(_item.GetURI(), _mutex, _cond),
+	 manager(_manager), input(nullptr), item(&_item)
+{
+	if (item->GetMimeType() != nullptr)
+		SetMimeType(item->GetMimeType());
+
+	size = item->GetSize();
+	seekable = true;
+	SetReady();
+}
+
+CacheInputStream::~CacheInputStream()
+{
+	if (item != nullptr)
+		manager.Release(*item);
+
+	delete input;
+}
+
+void
+CacheInputStream::CopyAttributes()
+{
+	assert(input != nullptr);
+
+	if (!input->IsReady())
+		return;
+
+	if (!IsReady()) {
+		const char *content_type = input->HasMimeType()
+			? input->GetMimeType()
+			: nullptr;
+		if (content_type != nullptr)
+			SetMimeType(content_type);
+
+		size = input->KnownSize()
+			? input->GetSize()
+			: UNKNOWN_SIZE;
+
+		seekable = input->IsSeekable();
+		SetReady();
+
+		/* only resources with a fixed size and random access
+		   can be stored in pieces */
+		if (seekable && size != UNKNOWN_SIZE)
+			item = manager.Get(GetURI(), size, content_type,
+					   input->GetValidator());
+	}
+
+	if (item == nullptr)
+		offset = input->GetOffset();
+}
+
+void
+CacheInputStream::Check()
+{
+	/* errors of the remote stream don't matter as long as we
+	   serve from the cache; they will be reported by the next
+	   ReadRemote() call */
+	if (input != nullptr && item == nullptr)
+		input->Check();
+}
+
+void
+CacheInputStream::Update()
+{
+	if (input != nullptr) {
+		input->Update();
+		CopyAttributes();
+	}
+}
+
+void
+CacheInputStream::Seek(offset_type new_offset)
+{
+	assert(IsReady());
+
+	if (item == nullptr) {
+		input->Seek(new_offset);
+		CopyAttributes();
+		return;
+	}
+
+	if (new_offset > size)
+		throw std::runtime_error("Invalid offset");
+
+	/* the remote stream is only seeked when the data is not in
+	   the cache, see ReadRemote() */
+	offset = new_offset;
+}
+
+bool
+CacheInputStream::IsEOF()
+{
+	if (item == nullptr)
+		return input->IsEOF();
+
+	return offset >= size;
+}
+
+Tag *
+CacheInputStream::ReadTag()
+{
+	return input != nullptr
+		? input->ReadTag()
+		: nullptr;
+}
+
+bool
+CacheInputStream::IsAvailable()
+{
+	if (item != nullptr) {
+		if (offset >= size || item->IsCached(offset))
+			return true;
+
+		if (input->GetOffset() != offset)
+			/* Read() will have to seek the remote stream,
+			   which blocks anyway */
+			return true;
+	}
+
+	return input->IsAvailable();
+}
+
+inline size_t
+CacheInputStream::ReadRemote(void *ptr, size_t read_size)
+{
+	assert(input != nullptr);
+	assert(item != nullptr);
+
+	if (input->GetOffset() != offset)
+		input->Seek(offset);
+
+	size_t nbytes = input->Read(ptr, read_size);
+	if (nbytes > 0 && store) {
+		try {
+			item->Write(offset, ptr, nbytes);
+		} catch (const std::runtime_error &e) {
+			LogError(e);
+			store = false;
+		}
+	}
+
+	return nbytes;
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size)
+{
+	if (item == nullptr) {
+		size_t nbytes = input->Read(ptr, read_size);
+		CopyAttributes();
+		return nbytes;
+	}
+
+	if (offset >= size)
+		return 0;
+
+	size_t nbytes;
+	try {
+		nbytes = item->Read(offset, ptr, read_size);
+	} catch (const std::runtime_error &e) {
+		if (input == nullptr)
+			throw;
+
+		LogError(e);
+		nbytes = 0;
+	}
+
+	if (nbytes == 0) {
+		if (input == nullptr)
+			throw std::runtime_error("Cached data is missing");
+
+		nbytes = ReadRemote(ptr, read_size);
+	}
+
+	offset += nbytes;
+	return nbytes;
+}
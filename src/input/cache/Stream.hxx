@@ -0,0 +1,102 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CACHE_INPUT_STREAM_HXX
+#define MPD_CACHE_INPUT_STREAM_HXX
+
+#include "check.h"
+#include "input/InputStream.hxx"
+
+class InputCacheManager;
+class InputCacheItem;
+
+/**
+ * An #InputStream which serves data from an #InputCacheItem where
+ * possible, and passes all other reads to the remote stream, storing
+ * the data it returns in the cache.
+ *
+ * Unlike #ProxyInputStream, the remote stream is optional: a
+ * resource which is cached completely is served without contacting
+ * the server.  Seeks are only passed to the remote stream when data
+ * is missing from the cache.
+ */
+class CacheInputStream final : public InputStream {
+	InputCacheManager &manager;
+
+	/**
+	 * The remote stream; nullptr if the whole resource is
+	 * served from #item.
+	 */
+	InputStream *const input;
+
+	/**
+	 * The cache item; nullptr until #input is ready, and if the
+	 * resource cannot be cached (e.g. a radio stream).  Then all
+	 * method calls are passed to #input.
+	 */
+	InputCacheItem *item = nullptr;
+
+	/**
+	 * Shall data read from #input be stored in #item?  This is
+	 * cleared after an I/O error on the cache file.
+	 */
+	bool store = true;
+
+public:
+	/**
+	 * Wrap a remote stream.
+	 */
+	gcc_nonnull_all
+	CacheInputStream(InputCacheManager &_manager, InputStream *_input);
+
+	/**
+	 * Serve a complete item without a remote stream.
+	 */
+	CacheInputStream(InputCacheManager &_manager, InputCacheItem &_item,
+			 Mutex &_mutex, Cond &_cond);
+
+	~CacheInputStream();
+
+	CacheInputStream(const CacheInputStream &) = delete;
+	CacheInputStream &operator=(const CacheInputStream &) = delete;
+
+	/* virtual methods from InputStream */
+	void Check() override;
+	void Update() override;
+	void Seek(offset_type new_offset) override;
+	bool IsEOF() override;
+	Tag *ReadTag() override;
+	bool IsAvailable() override;
+	size_t Read(void *ptr, size_t read_size) override;
+
+private:
+	/**
+	 * Copy attributes from #input after it has become ready, and
+	 * obtain the #item.
+	 */
+	void CopyAttributes();
+
+	/**
+	 * Read from #input at the current offset and store the data
+	 * in #item.
+	 */
+	size_t ReadRemote(void *ptr, size_t read_size);
+};
+
+#endif
@@ -29,8 +29,10 @@
 #include "event/TimeoutMonitor.hxx"
 #include "event/Call.hxx"
 #include "IOThread.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringUtil.hxx"
+#include "util/StringCompare.hxx"
 #include "util/NumberParser.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
@@ -47,16 +49,19 @@
 #endif
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The default for the "buffer_size" setting: do not buffer more than
+ * this number of bytes.  It should be a reasonable limit that doesn't
+ * make low-end machines suffer too much, but doesn't cause stuttering
+ * on high-latency lines.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t CURL_MAX_BUFFERED = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The default for the "prefetch_tail" setting: the number of bytes at
+ * the end of a seekable resource which are fetched with a separate
+ * request, because decoders like to look for tags there.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static constexpr size_t CURL_PREFETCH_TAIL = 64 * 1024;
 
 struct CurlInputStream final : public AsyncInputStream {
 	/* some buffers which were passed to libcurl, which we have
@@ -73,13 +78,43 @@ struct CurlInputStream final : public AsyncInputStream {
 	/** parser for icy-metadata */
 	IcyInputStream *icy;
 
-	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond)
+	/**
+	 * A second "easy" handle which fetches the end of the
+	 * resource (see AsyncInputStream::BeginTail()).
+	 */
+	CURL *tail_easy = nullptr;
+
+	char tail_range[32];
+
+	/**
+	 * Receives the response of #tail_easy; #tail_fill is the
+	 * number of bytes received so far.
+	 */
+	AllocatedArray<uint8_t> tail_data;
+	size_t tail_fill;
+
+	/**
+	 * Calls StartTail() in the I/O thread, but outside of libcurl
+	 * callbacks.
+	 */
+	DeferredCall deferred_tail;
+
+	/**
+	 * Has the first response been received, i.e. has
+	 * #deferred_tail been considered already?
+	 */
+	bool tail_checked = false;
+
+	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond,
+			size_t _buffer_size)
 		:AsyncInputStream(_url, _mutex, _cond,
-				  CURL_MAX_BUFFERED,
-				  CURL_RESUME_AT),
+				  _buffer_size,
+				  /* resume when 3/4 of the buffer are
+				     filled */
+				  _buffer_size / 4 * 3),
 		 request_headers(nullptr),
-		 icy(new IcyInputStream(this)) {
-		InitEasy();
+		 icy(new IcyInputStream(this)),
+		 deferred_tail(io_thread_get(), BIND_THIS_METHOD(StartTail)) {
 	}
 
 	~CurlInputStream();
@@ -107,6 +142,30 @@ struct CurlInputStream final : public AsyncInputStream {
 	 */
 	void FreeEasyIndirect();
 
+	/**
+	 * Start fetching the end of the resource with #tail_easy.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	void StartTail();
+
+	/**
+	 * Frees #tail_easy.  Its connection stays in libcurl's cache
+	 * and may be reused by the next request.
+	 *
+	 * Runs in the I/O thread.
+	 */
+	void FreeTail();
+
+	size_t TailDataReceived(const void *ptr, size_t size);
+
+	/**
+	 * The request of #tail_easy is finished.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	void TailDone(CURLcode result, long status);
+
 	/**
 	 * Called when a new response begins.  This is used to discard
 	 * headers from previous responses (for example authentication
@@ -202,8 +261,8 @@ public:
 		curl_multi_cleanup(multi);
 	}
 
-	void Add(CurlInputStream *c);
-	void Remove(CurlInputStream *c);
+	void Add(CURL *easy);
+	void Remove(CURL *easy);
 
 	/**
 	 * Check for finished HTTP responses.
@@ -252,8 +311,22 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
+/** the "buffer_size" and "prefetch_tail" settings in bytes */
+static size_t buffer_size, prefetch_tail;
+
 static CurlMulti *curl_multi;
 
+/**
+ * Caches shared by all "easy" handles.
+ */
+static CURLSH *curl_share;
+
+/**
+ * Protects the #curl_share data; handles are configured in the
+ * caller's thread and used in the I/O thread.
+ */
+static Mutex curl_share_mutex[CURL_LOCK_DATA_LAST];
+
 static constexpr Domain curl_domain("curl");
 static constexpr Domain curlm_domain("curlm");
 
@@ -359,13 +432,12 @@ CurlSocket::OnSocketReady(unsigned flags)
  * Throws std::runtime_error on error.
  */
 inline void
-CurlMulti::Add(CurlInputStream *c)
+CurlMulti::Add(CURL *easy)
 {
 	assert(io_thread_inside());
-	assert(c != nullptr);
-	assert(c->easy != nullptr);
+	assert(easy != nullptr);
 
-	CURLMcode mcode = curl_multi_add_handle(multi, c->easy);
+	CURLMcode mcode = curl_multi_add_handle(multi, easy);
 	if (mcode != CURLM_OK)
 		throw FormatRuntimeError("curl_multi_add_handle() failed: %s",
 					 curl_multi_strerror(mcode));
@@ -386,14 +458,14 @@ input_curl_easy_add_indirect(CurlInputStream *c)
 	assert(c->easy != nullptr);
 
 	BlockingCall(io_thread_get(), [c](){
-			curl_multi->Add(c);
+			curl_multi->Add(c->easy);
 		});
 }
 
 inline void
-CurlMulti::Remove(CurlInputStream *c)
+CurlMulti::Remove(CURL *easy)
 {
-	curl_multi_remove_handle(multi, c->easy);
+	curl_multi_remove_handle(multi, easy);
 }
 
 void
@@ -404,7 +476,7 @@ CurlInputStream::FreeEasy()
 	if (easy == nullptr)
 		return;
 
-	curl_multi->Remove(this);
+	curl_multi->Remove(easy);
 
 	curl_easy_cleanup(easy);
 	easy = nullptr;
@@ -424,6 +496,19 @@ CurlInputStream::FreeEasyIndirect()
 	assert(easy == nullptr);
 }
 
+void
+CurlInputStream::FreeTail()
+{
+	assert(io_thread_inside());
+
+	if (tail_easy == nullptr)
+		return;
+
+	curl_multi->Remove(tail_easy);
+	curl_easy_cleanup(tail_easy);
+	tail_easy = nullptr;
+}
+
 inline void
 CurlInputStream::RequestDone(CURLcode result, long status)
 {
@@ -451,6 +536,25 @@ CurlInputStream::RequestDone(CURLcode result, long status)
 		cond.broadcast();
 }
 
+inline void
+CurlInputStream::TailDone(CURLcode result, long status)
+{
+	assert(io_thread_inside());
+
+	FreeTail();
+
+	const ScopeLock protect(mutex);
+
+	/* accept only a complete "206 Partial Content" response; if
+	   the server has ignored the "Range" header, decoders will
+	   have to seek the main stream */
+	if (result == CURLE_OK && status == 206 &&
+	    tail_fill == tail_data.size())
+		CommitTail(std::move(tail_data));
+	else
+		CancelTail();
+}
+
 static void
 input_curl_handle_done(CURL *easy_handle, CURLcode result)
 {
@@ -460,7 +564,10 @@ input_curl_handle_done(CURL *easy_handle, CURLcode result)
 	long status = 0;
 	curl_easy_getinfo(easy_handle, CURLINFO_RESPONSE_CODE, &status);
 
-	c->RequestDone(result, status);
+	if (easy_handle == c->tail_easy)
+		c->TailDone(result, status);
+	else
+		c->RequestDone(result, status);
 }
 
 void
@@ -530,6 +637,19 @@ CurlMulti::OnTimeout()
  *
  */
 
+static void
+input_curl_share_lock(CURL *, curl_lock_data data, curl_lock_access,
+		      void *)
+{
+	curl_share_mutex[data].lock();
+}
+
+static void
+input_curl_share_unlock(CURL *, curl_lock_data data, void *)
+{
+	curl_share_mutex[data].unlock();
+}
+
 static void
 input_curl_init(const ConfigBlock &block)
 {
@@ -566,6 +686,15 @@ input_curl_init(const ConfigBlock &block)
 	verify_peer = block.GetBlockValue("verify_peer", true);
 	verify_host = block.GetBlockValue("verify_host", true);
 
+	buffer_size = block.GetBlockValue("buffer_size",
+					  unsigned(CURL_MAX_BUFFERED / 1024)) * 1024;
+	if (buffer_size == 0)
+		throw FormatRuntimeError("buffer_size must be positive, line %d",
+					 block.line);
+
+	prefetch_tail = block.GetBlockValue("prefetch_tail",
+					    unsigned(CURL_PREFETCH_TAIL / 1024)) * 1024;
+
 	CURLM *multi = curl_multi_init();
 	if (multi == nullptr) {
 		curl_slist_free_all(http_200_aliases);
@@ -574,6 +703,20 @@ input_curl_init(const ConfigBlock &block)
 	}
 
 	curl_multi = new CurlMulti(io_thread_get(), multi);
+
+	/* not fatal: without it, each request does its own DNS
+	   lookup and TLS handshake */
+	curl_share = curl_share_init();
+	if (curl_share != nullptr) {
+		curl_share_setopt(curl_share, CURLSHOPT_LOCKFUNC,
+				  input_curl_share_lock);
+		curl_share_setopt(curl_share, CURLSHOPT_UNLOCKFUNC,
+				  input_curl_share_unlock);
+		curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+				  CURL_LOCK_DATA_DNS);
+		curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+				  CURL_LOCK_DATA_SSL_SESSION);
+	}
 }
 
 static void
@@ -583,6 +726,11 @@ input_curl_finish(void)
 			delete curl_multi;
 		});
 
+	if (curl_share != nullptr) {
+		curl_share_cleanup(curl_share);
+		curl_share = nullptr;
+	}
+
 	curl_slist_free_all(http_200_aliases);
 	http_200_aliases = nullptr;
 
@@ -591,6 +739,11 @@ input_curl_finish(void)
 
 CurlInputStream::~CurlInputStream()
 {
+	BlockingCall(io_thread_get(), [this](){
+			deferred_tail.Cancel();
+			FreeTail();
+		});
+
 	FreeEasyIndirect();
 }
 
@@ -607,6 +760,7 @@ CurlInputStream::ResponseBoundary()
 	seekable = false;
 	size = UNKNOWN_SIZE;
 	ClearMimeType();
+	validator.clear();
 	ClearTag();
 
 	// TODO: reset the IcyInputStream?
@@ -627,6 +781,12 @@ CurlInputStream::HeaderReceived(const char *name, std::string &&value)
 		size = offset + ParseUint64(value.c_str());
 	} else if (StringEqualsCaseASCII(name, "content-type")) {
 		SetMimeType(std::move(value));
+	} else if (StringEqualsCaseASCII(name, "etag")) {
+		validator = "etag " + value;
+	} else if (StringEqualsCaseASCII(name, "last-modified")) {
+		/* the ETag is more precise */
+		if (!StringStartsWith(validator.c_str(), "etag "))
+			validator = "last-modified " + value;
 	} else if (StringEqualsCaseASCII(name, "icy-name") ||
 		   StringEqualsCaseASCII(name, "ice-name") ||
 		   StringEqualsCaseASCII(name, "x-audiocast-name")) {
@@ -702,6 +862,16 @@ CurlInputStream::DataReceived(const void *ptr, size_t received_size)
 	if (IsSeekPending())
 		SeekDone();
 
+	if (!tail_checked) {
+		/* now that the response headers are known, decide
+		   whether to fetch the end of the resource */
+		tail_checked = true;
+
+		if (prefetch_tail > 0 && seekable && size != UNKNOWN_SIZE &&
+		    size > offset_type(2 * prefetch_tail))
+			deferred_tail.Schedule();
+	}
+
 	if (received_size > GetBufferSpace()) {
 		AsyncInputStream::Pause();
 		return CURL_WRITEFUNC_PAUSE;
@@ -724,32 +894,58 @@ input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
 	return c.DataReceived(ptr, size);
 }
 
-void
-CurlInputStream::InitEasy()
+inline size_t
+CurlInputStream::TailDataReceived(const void *ptr, size_t received_size)
 {
-	easy = curl_easy_init();
-	if (easy == nullptr)
-		throw std::runtime_error("curl_easy_init() failed");
+	assert(io_thread_inside());
 
-	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)this);
+	if (received_size > tail_data.size() - tail_fill)
+		/* more than we asked for; abort the transfer */
+		return 0;
+
+	memcpy(tail_data.begin() + tail_fill, ptr, received_size);
+	tail_fill += received_size;
+	return received_size;
+}
+
+/** called by curl when new data for #CurlInputStream::tail_easy is
+    available */
+static size_t
+input_curl_tail_writefunction(void *ptr, size_t size, size_t nmemb,
+			      void *stream)
+{
+	CurlInputStream &c = *(CurlInputStream *)stream;
+
+	size *= nmemb;
+	if (size == 0)
+		return 0;
+
+	return c.TailDataReceived(ptr, size);
+}
+
+/**
+ * Apply the settings which are common to all requests.
+ */
+static void
+input_curl_setup_easy(CURL *easy)
+{
 	curl_easy_setopt(easy, CURLOPT_USERAGENT,
 			 "Music Player Daemon " VERSION);
-	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
-			 input_curl_headerfunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
-	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
-			 input_curl_writefunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
-	curl_easy_setopt(easy, CURLOPT_HTTP200ALIASES, http_200_aliases);
 	curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1l);
 	curl_easy_setopt(easy, CURLOPT_NETRC, 1l);
 	curl_easy_setopt(easy, CURLOPT_MAXREDIRS, 5l);
 	curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1l);
-	curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, error_buffer);
 	curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 1l);
 	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1l);
 	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10l);
 
+	/* share DNS and TLS session caches between requests, so the
+	   request after a seek can skip most of the handshake even
+	   if the previous connection had to be closed; connections
+	   are already shared by the "multi" handle */
+	if (curl_share != nullptr)
+		curl_easy_setopt(easy, CURLOPT_SHARE, curl_share);
+
 	if (proxy != nullptr)
 		curl_easy_setopt(easy, CURLOPT_PROXY, proxy);
 
@@ -766,6 +962,26 @@ CurlInputStream::InitEasy()
 
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
+}
+
+void
+CurlInputStream::InitEasy()
+{
+	easy = curl_easy_init();
+	if (easy == nullptr)
+		throw std::runtime_error("curl_easy_init() failed");
+
+	input_curl_setup_easy(easy);
+
+	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)this);
+	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
+			 input_curl_headerfunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_writefunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+	curl_easy_setopt(easy, CURLOPT_HTTP200ALIASES, http_200_aliases);
+	curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, error_buffer);
 
 	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, GetURI());
 	if (code != CURLE_OK)
@@ -824,10 +1040,56 @@ CurlInputStream::DoSeek(offset_type new_offset)
 	offset = new_offset;
 }
 
+void
+CurlInputStream::StartTail()
+{
+	assert(io_thread_inside());
+	assert(tail_easy == nullptr);
+
+	const offset_type new_tail_offset = size - prefetch_tail;
+
+	/* a second handle in the same "multi" handle, which lets
+	   libcurl reuse its cached connections */
+	tail_easy = curl_easy_init();
+	if (tail_easy == nullptr)
+		return;
+
+	input_curl_setup_easy(tail_easy);
+	curl_easy_setopt(tail_easy, CURLOPT_PRIVATE, (void *)this);
+	curl_easy_setopt(tail_easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_tail_writefunction);
+	curl_easy_setopt(tail_easy, CURLOPT_WRITEDATA, this);
+	curl_easy_setopt(tail_easy, CURLOPT_URL, GetURI());
+
+	sprintf(tail_range, "%lld-", (long long)new_tail_offset);
+	curl_easy_setopt(tail_easy, CURLOPT_RANGE, tail_range);
+
+	tail_data.ResizeDiscard(prefetch_tail);
+	tail_fill = 0;
+
+	{
+		const ScopeLock protect(mutex);
+		BeginTail(new_tail_offset);
+	}
+
+	try {
+		curl_multi->Add(tail_easy);
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+
+		curl_easy_cleanup(tail_easy);
+		tail_easy = nullptr;
+
+		const ScopeLock protect(mutex);
+		CancelTail();
+	}
+}
+
 inline InputStream *
 CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond)
 {
-	CurlInputStream *c = new CurlInputStream(url, mutex, cond);
+	CurlInputStream *c = new CurlInputStream(url, mutex, cond,
+						 buffer_size);
 
 	try {
 		c->InitEasy();
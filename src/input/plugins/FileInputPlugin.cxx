@@ -20,7 +20,9 @@
 #include "config.h" /* must be first for large file support */
 #include "FileInputPlugin.hxx"
 #include "../InputStream.hxx"
+#include "../ThreadInputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "fs/Path.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/io/FileReader.hxx"
@@ -30,6 +32,19 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+/**
+ * The first read-ahead window of #ReadAheadFileInputStream.  It is
+ * small, because most files opened only for scanning tags are
+ * closed after reading a few kilobytes.
+ */
+static constexpr size_t FILE_READ_AHEAD_WINDOW = 64 * 1024;
+
+/**
+ * The "read_ahead" setting in bytes; 0 disables the read-ahead
+ * thread.
+ */
+static size_t file_read_ahead;
+
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
@@ -53,6 +68,43 @@ public:
 	void Seek(offset_type offset) override;
 };
 
+/**
+ * Reads the file in a separate thread, so a slow disk doesn't stall
+ * the decoder as long as the buffer lasts.
+ */
+class ReadAheadFileInputStream final : public ThreadInputStream {
+	FileReader reader;
+
+public:
+	ReadAheadFileInputStream(const char *path, FileReader &&_reader,
+				 off_t _size,
+				 Mutex &_mutex, Cond &_cond)
+		:ThreadInputStream(input_plugin_file.name, path,
+				   _mutex, _cond, file_read_ahead),
+		 reader(std::move(_reader)) {
+		size = _size;
+		seekable = true;
+		SetReadAheadWindow(FILE_READ_AHEAD_WINDOW);
+
+		/* all attributes are known already; there's no need
+		   to wait for the thread */
+		SetReady();
+	}
+
+	~ReadAheadFileInputStream() {
+		Stop();
+	}
+
+protected:
+	size_t ThreadRead(void *ptr, size_t read_size) override {
+		return reader.Read(ptr, read_size);
+	}
+
+	void ThreadSeek(offset_type new_offset) override {
+		reader.Seek((off_t)new_offset);
+	}
+};
+
 InputStreamPtr
 OpenFileInputStream(Path path,
 		    Mutex &mutex, Cond &cond)
@@ -70,11 +122,26 @@ OpenFileInputStream(Path path,
 		      POSIX_FADV_SEQUENTIAL);
 #endif
 
+	if (file_read_ahead > 0) {
+		auto *is = new ReadAheadFileInputStream(path.ToUTF8().c_str(),
+							std::move(reader),
+							info.GetSize(),
+							mutex, cond);
+		is->Start();
+		return InputStreamPtr(is);
+	}
+
 	return InputStreamPtr(new FileInputStream(path.ToUTF8().c_str(),
 						  std::move(reader), info.GetSize(),
 						  mutex, cond));
 }
 
+static void
+input_file_init(const ConfigBlock &block)
+{
+	file_read_ahead = block.GetBlockValue("read_ahead", 0u) * 1024;
+}
+
 static InputStream *
 input_file_open(gcc_unused const char *filename,
 		gcc_unused Mutex &mutex, gcc_unused Cond &cond)
@@ -101,7 +168,7 @@ FileInputStream::Read(void *ptr, size_t read_size)
 
 const InputPlugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 };
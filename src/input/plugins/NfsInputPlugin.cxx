@@ -71,7 +71,7 @@ protected:
 
 private:
 	/* virtual methods from NfsFileReader */
-	void OnNfsFileOpen(uint64_t size) override;
+	void OnNfsFileOpen(uint64_t size, time_t mtime) override;
 	void OnNfsFileRead(const void *data, size_t size) override;
 	void OnNfsFileError(std::exception_ptr &&e) override;
 };
@@ -140,7 +140,7 @@ NfsInputStream::DoSeek(offset_type new_offset)
 }
 
 void
-NfsInputStream::OnNfsFileOpen(uint64_t _size)
+NfsInputStream::OnNfsFileOpen(uint64_t _size, time_t mtime)
 {
 	const ScopeLock protect(mutex);
 
@@ -154,6 +154,7 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size)
 
 	size = _size;
 	seekable = true;
+	validator = "mtime " + std::to_string(mtime);
 	next_offset = 0;
 	SetReady();
 	DoRead();
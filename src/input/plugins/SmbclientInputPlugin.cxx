@@ -43,6 +43,7 @@ public:
 		 ctx(_ctx), fd(_fd) {
 		seekable = true;
 		size = st.st_size;
+		validator = "mtime " + std::to_string(st.st_mtime);
 		SetReady();
 	}
 
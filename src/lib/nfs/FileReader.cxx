@@ -213,7 +213,7 @@ NfsFileReader::StatCallback(const struct stat *st)
 
 	state = State::IDLE;
 
-	OnNfsFileOpen(st->st_size);
+	OnNfsFileOpen(st->st_size, st->st_mtime);
 }
 
 void
@@ -31,6 +31,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <time.h>
 
 struct nfsfh;
 class NfsConnection;
@@ -78,7 +79,7 @@ public:
 	}
 
 protected:
-	virtual void OnNfsFileOpen(uint64_t size) = 0;
+	virtual void OnNfsFileOpen(uint64_t size, time_t mtime) = 0;
 	virtual void OnNfsFileRead(const void *data, size_t size) = 0;
 	virtual void OnNfsFileError(std::exception_ptr &&e) = 0;
 
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "FilterGroup.hxx"
+#include "pcm/PcmMix.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "MusicChunk.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+OutputFilterGroup::OutputFilterGroup(const ReplayGainConfig *replay_gain_config)
+{
+	if (replay_gain_config != nullptr) {
+		prepared_replay_gain_filter =
+			NewReplayGainFilter(*replay_gain_config);
+		prepared_other_replay_gain_filter =
+			NewReplayGainFilter(*replay_gain_config);
+	}
+}
+
+OutputFilterGroup::~OutputFilterGroup()
+{
+	CloseFilters();
+
+	delete prepared_replay_gain_filter;
+	delete prepared_other_replay_gain_filter;
+}
+
+void
+OutputFilterGroup::CloseFilters()
+{
+	delete replay_gain_filter;
+	replay_gain_filter = nullptr;
+
+	delete other_replay_gain_filter;
+	other_replay_gain_filter = nullptr;
+}
+
+void
+OutputFilterGroup::Open(AudioFormat _audio_format)
+{
+	assert(_audio_format.IsValid());
+
+	const ScopeLock protect(mutex);
+
+	if (_audio_format == audio_format)
+		return;
+
+	chunks.clear();
+	CloseFilters();
+	audio_format.Clear();
+
+	try {
+		AudioFormat format = _audio_format;
+		if (prepared_replay_gain_filter != nullptr)
+			replay_gain_filter =
+				prepared_replay_gain_filter->Open(format);
+
+		format = _audio_format;
+		if (prepared_other_replay_gain_filter != nullptr)
+			other_replay_gain_filter =
+				prepared_other_replay_gain_filter->Open(format);
+	} catch (...) {
+		CloseFilters();
+		throw;
+	}
+
+	replay_gain_serial = other_replay_gain_serial = 0;
+	audio_format = _audio_format;
+}
+
+void
+OutputFilterGroup::Close()
+{
+	const ScopeLock protect(mutex);
+
+	chunks.clear();
+	CloseFilters();
+	audio_format.Clear();
+}
+
+void
+OutputFilterGroup::SetReplayGainMode(ReplayGainMode mode)
+{
+	const ScopeLock protect(mutex);
+
+	if (mode == replay_gain_mode)
+		return;
+
+	replay_gain_mode = mode;
+
+	/* results computed with the old mode must not be played */
+	chunks.clear();
+}
+
+inline ConstBuffer<void>
+OutputFilterGroup::ApplyReplayGain(const MusicChunk &chunk,
+				   Filter *filter, unsigned &serial)
+{
+	assert(!chunk.IsEmpty());
+
+	ConstBuffer<void> data(chunk.data, chunk.length);
+
+	assert(data.size % audio_format.GetFrameSize() == 0);
+
+	if (!data.IsEmpty() && filter != nullptr) {
+		replay_gain_filter_set_mode(*filter, replay_gain_mode);
+
+		if (chunk.replay_gain_serial != serial) {
+			replay_gain_filter_set_info(*filter,
+						    chunk.replay_gain_serial != 0
+						    ? &chunk.replay_gain_info
+						    : nullptr);
+			serial = chunk.replay_gain_serial;
+		}
+
+		data = filter->FilterPCM(data);
+	}
+
+	return data;
+}
+
+ConstBuffer<void>
+OutputFilterGroup::Process(const MusicChunk &chunk,
+			   AllocatedArray<uint8_t> &buffer)
+{
+	ConstBuffer<void> data =
+		ApplyReplayGain(chunk, replay_gain_filter,
+				replay_gain_serial);
+	if (data.IsEmpty())
+		return data;
+
+	if (chunk.other != nullptr) {
+		ConstBuffer<void> other_data =
+			ApplyReplayGain(*chunk.other, other_replay_gain_filter,
+					other_replay_gain_serial);
+		if (!other_data.IsEmpty()) {
+			/* see ao_filter_chunk() for an explanation of
+			   the sizes and the mix ratio */
+
+			if (data.size > other_data.size)
+				data.size = other_data.size;
+
+			float mix_ratio = chunk.mix_ratio;
+			if (mix_ratio >= 0)
+				mix_ratio = 1.0 - mix_ratio;
+
+			buffer.ResizeDiscard(other_data.size);
+			memcpy(buffer.begin(), other_data.data,
+			       other_data.size);
+			if (!pcm_mix(cross_fade_dither, buffer.begin(),
+				     data.data, data.size,
+				     audio_format.format, mix_ratio))
+				throw FormatRuntimeError("Cannot cross-fade format %s",
+							 sample_format_to_string(audio_format.format));
+
+			return {buffer.begin(), buffer.size()};
+		}
+	}
+
+	if (data.data != chunk.data) {
+		/* the replay gain filter owns this buffer, and it
+		   will be reused for the next chunk */
+		buffer.ResizeDiscard(data.size);
+		memcpy(buffer.begin(), data.data, data.size);
+		data.data = buffer.begin();
+	}
+
+	return data;
+}
+
+FilteredChunkPtr
+OutputFilterGroup::Get(const MusicChunk &chunk)
+{
+	const ScopeLock protect(mutex);
+
+	if (!audio_format.IsDefined())
+		return nullptr;
+
+	auto i = chunks.find(&chunk);
+	if (i != chunks.end())
+		return i->second;
+
+	auto result = std::make_shared<FilteredChunk>();
+	result->data = Process(chunk, result->buffer);
+	chunks.emplace(&chunk, result);
+	return result;
+}
+
+void
+OutputFilterGroup::Release(const MusicChunk &chunk)
+{
+	const ScopeLock protect(mutex);
+
+	chunks.erase(&chunk);
+}
+
+void
+OutputFilterGroup::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	chunks.clear();
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_FILTER_GROUP_HXX
+#define MPD_OUTPUT_FILTER_GROUP_HXX
+
+#include "AudioFormat.hxx"
+#include "ReplayGainMode.hxx"
+#include "pcm/PcmDither.hxx"
+#include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <map>
+#include <memory>
+
+#include <stdint.h>
+
+class PreparedFilter;
+class Filter;
+struct MusicChunk;
+struct ReplayGainConfig;
+
+/**
+ * A #MusicChunk which has been processed by an #OutputFilterGroup.
+ * It is shared by all member outputs and must not be modified.
+ */
+struct FilteredChunk {
+	/**
+	 * Owns the processed data, unless it is the unmodified
+	 * payload of the #MusicChunk.
+	 */
+	AllocatedArray<uint8_t> buffer;
+
+	ConstBuffer<void> data;
+};
+
+typedef std::shared_ptr<const FilteredChunk> FilteredChunkPtr;
+
+/**
+ * A group of audio outputs which apply identical replay gain and
+ * cross-fading to each #MusicChunk.  Instead of letting each
+ * output thread repeat this work, the first one to arrive at a
+ * chunk computes it, and the others reuse the result.  Only the
+ * per-output filter chain (filters, software volume, format
+ * conversion) is still applied by each output.
+ *
+ * Results are kept while their chunk is in the #MusicPipe; the
+ * #MultipleOutputs object calls Release() when it removes a chunk
+ * from the pipe.
+ *
+ * This object is protected by its own mutex; it may be locked
+ * while holding the #AudioOutput mutex, but not the other way
+ * round.
+ */
+class OutputFilterGroup {
+	Mutex mutex;
+
+	PreparedFilter *prepared_replay_gain_filter = nullptr;
+	PreparedFilter *prepared_other_replay_gain_filter = nullptr;
+
+	Filter *replay_gain_filter = nullptr;
+	Filter *other_replay_gain_filter = nullptr;
+
+	/**
+	 * The serial numbers of the last replay gain info; see
+	 * #AudioOutput::replay_gain_serial.
+	 */
+	unsigned replay_gain_serial = 0, other_replay_gain_serial = 0;
+
+	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
+
+	/**
+	 * The format of all chunks in the pipe.  If this is
+	 * undefined, the group is closed, and each output has to
+	 * process the chunks on its own.
+	 */
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	/**
+	 * The dithering state for cross-fading two streams.
+	 */
+	PcmDither cross_fade_dither;
+
+	std::map<const MusicChunk *, FilteredChunkPtr> chunks;
+
+public:
+	/**
+	 * @param replay_gain_config the software replay gain
+	 * settings, or nullptr if the members do not apply replay
+	 * gain at all
+	 */
+	explicit OutputFilterGroup(const ReplayGainConfig *replay_gain_config);
+	~OutputFilterGroup();
+
+	OutputFilterGroup(const OutputFilterGroup &) = delete;
+	OutputFilterGroup &operator=(const OutputFilterGroup &) = delete;
+
+	/**
+	 * Prepare for chunks in the specified format.  This is a
+	 * no-op if the format has not changed.
+	 *
+	 * Throws #std::runtime_error on error (the group is closed
+	 * then).
+	 */
+	void Open(AudioFormat _audio_format);
+
+	/**
+	 * Close the group and forget all results.
+	 */
+	void Close();
+
+	void SetReplayGainMode(ReplayGainMode mode);
+
+	/**
+	 * Returns the processed data of the specified chunk,
+	 * computing it if no other member has done so yet.  The
+	 * caller must hold the returned reference while it accesses
+	 * the data.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @return the processed chunk, or nullptr if the group is
+	 * closed and the caller must process the chunk by itself
+	 */
+	FilteredChunkPtr Get(const MusicChunk &chunk);
+
+	/**
+	 * Forget the result of a chunk which is being removed from
+	 * the pipe.
+	 */
+	void Release(const MusicChunk &chunk);
+
+	/**
+	 * Forget all results, e.g. after the pipe has been cleared.
+	 */
+	void Clear();
+
+private:
+	void CloseFilters();
+
+	ConstBuffer<void> ApplyReplayGain(const MusicChunk &chunk,
+					  Filter *filter, unsigned &serial);
+
+	ConstBuffer<void> Process(const MusicChunk &chunk,
+				  AllocatedArray<uint8_t> &buffer);
+};
+
+#endif
@@ -250,10 +250,11 @@ audio_output_setup(EventLoop &event_loop,
 	/* use the hardware mixer for replay gain? */
 
 	if (strcmp(replay_gain_handler, "mixer") == 0) {
-		if (ao.mixer != nullptr)
+		if (ao.mixer != nullptr) {
 			replay_gain_filter_set_mixer(*ao.prepared_replay_gain_filter,
 						     ao.mixer, 100);
-		else
+			ao.mixer_replay_gain = true;
+		} else
 			FormatError(output_domain,
 				    "No such mixer for output '%s'", ao.name);
 	} else if (strcmp(replay_gain_handler, "software") != 0 &&
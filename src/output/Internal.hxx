@@ -32,6 +32,7 @@
 
 class PreparedFilter;
 class Filter;
+class OutputFilterGroup;
 class MusicPipe;
 class EventLoop;
 class Mixer;
@@ -227,6 +228,20 @@ struct AudioOutput {
 	 */
 	unsigned other_replay_gain_serial;
 
+	/**
+	 * Is replay gain applied by the #Mixer instead of scaling the
+	 * samples?  Such an output cannot join an #OutputFilterGroup.
+	 */
+	bool mixer_replay_gain = false;
+
+	/**
+	 * The group which applies replay gain and cross-fading on
+	 * behalf of this output and others with the same settings.
+	 * It is owned by #MultipleOutputs.  If nullptr, this output
+	 * does it on its own.
+	 */
+	OutputFilterGroup *filter_group = nullptr;
+
 	/**
 	 * The convert_filter_plugin instance of this audio output.
 	 * It is the last item in the filter chain, and is responsible
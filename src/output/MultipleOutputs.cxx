@@ -21,6 +21,7 @@
 #include "MultipleOutputs.hxx"
 #include "player/Control.hxx"
 #include "Internal.hxx"
+#include "FilterGroup.hxx"
 #include "Domain.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicPipe.hxx"
@@ -30,6 +31,7 @@
 #include "config/ConfigOption.hxx"
 #include "notify.hxx"
 #include "util/RuntimeError.hxx"
+#include "Log.hxx"
 
 #include <stdexcept>
 
@@ -91,6 +93,55 @@ MultipleOutputs::Configure(EventLoop &event_loop,
 					 pc, empty);
 		outputs.push_back(output);
 	}
+
+	CreateFilterGroups(replay_gain_config);
+}
+
+void
+MultipleOutputs::CreateFilterGroups(const ReplayGainConfig &replay_gain_config)
+{
+	/* one group for outputs with software replay gain, and one
+	   for outputs without replay gain; outputs which let the
+	   mixer do replay gain are not eligible */
+	for (bool software : {true, false}) {
+		std::vector<AudioOutput *> members;
+		for (auto ao : outputs)
+			if (!ao->mixer_replay_gain &&
+			    (ao->prepared_replay_gain_filter != nullptr) == software)
+				members.push_back(ao);
+
+		if (members.size() < 2)
+			/* nothing to share */
+			continue;
+
+		filter_groups.emplace_back(software
+					   ? &replay_gain_config
+					   : nullptr);
+
+		for (auto ao : members)
+			ao->filter_group = &filter_groups.back();
+	}
+}
+
+void
+MultipleOutputs::OpenFilterGroups()
+{
+	for (auto &group : filter_groups) {
+		try {
+			group.Open(input_audio_format);
+		} catch (const std::runtime_error &e) {
+			/* not fatal: each member output will process
+			   the chunks on its own */
+			LogError(e);
+		}
+	}
+}
+
+void
+MultipleOutputs::CloseFilterGroups()
+{
+	for (auto &group : filter_groups)
+		group.Close();
 }
 
 AudioOutput *
@@ -183,6 +234,9 @@ MultipleOutputs::SetReplayGainMode(ReplayGainMode mode)
 {
 	for (auto ao : outputs)
 		ao->SetReplayGainMode(mode);
+
+	for (auto &group : filter_groups)
+		group.SetReplayGainMode(mode);
 }
 
 void
@@ -227,6 +281,8 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 
 	input_audio_format = audio_format;
 
+	OpenFilterGroups();
+
 	ResetReopen();
 	EnableDisable();
 	Update();
@@ -356,13 +412,34 @@ MultipleOutputs::Check()
 				if (locked[i])
 					outputs[i]->mutex.unlock();
 
-		/* return the chunk to the buffer */
-		buffer->Return(shifted);
+		for (auto &group : filter_groups)
+			group.Release(*shifted);
+
+		ReleaseChunk(shifted);
 	}
 
 	return 0;
 }
 
+void
+MultipleOutputs::ReleaseChunk(MusicChunk *chunk)
+{
+	/* only chunks with music data of the current song can be
+	   played again; silence has no time stamp, and cross-faded
+	   chunks belong to two songs */
+	if (history == nullptr || chunk->length == 0 ||
+	    chunk->time.IsNegative() || chunk->other != nullptr) {
+		/* return the chunk to the buffer */
+		buffer->Return(chunk);
+		return;
+	}
+
+	history->Push(chunk);
+
+	while (history->GetSize() > max_history)
+		buffer->Return(history->Shift());
+}
+
 bool
 MultipleOutputs::Wait(PlayerControl &pc, unsigned threshold)
 {
@@ -373,6 +450,15 @@ MultipleOutputs::Wait(PlayerControl &pc, unsigned threshold)
 		return true;
 	}
 
+	if (pc.command != PlayerCommand::NONE) {
+		/* a command has arrived while the player thread was
+		   not waiting; the next signal from the outputs may
+		   be far away (they signal only after they have
+		   played all chunks), so don't wait for it */
+		pc.Unlock();
+		return false;
+	}
+
 	pc.Wait();
 	pc.Unlock();
 
@@ -409,10 +495,17 @@ MultipleOutputs::Cancel()
 
 	WaitAll();
 
-	/* clear the music pipe and return all chunks to the buffer */
+	/* clear the music pipe and return all chunks to the buffer
+	   (or move them to the history) */
 
-	if (pipe != nullptr)
-		pipe->Clear(*buffer);
+	if (pipe != nullptr) {
+		MusicChunk *chunk;
+		while ((chunk = pipe->Shift()) != nullptr)
+			ReleaseChunk(chunk);
+	}
+
+	for (auto &group : filter_groups)
+		group.Clear();
 
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
@@ -440,6 +533,7 @@ MultipleOutputs::Close()
 
 	buffer = nullptr;
 
+	CloseFilterGroups();
 	input_audio_format.Clear();
 
 	elapsed_time = SignedSongTime::Negative();
@@ -461,6 +555,7 @@ MultipleOutputs::Release()
 
 	buffer = nullptr;
 
+	CloseFilterGroups();
 	input_audio_format.Clear();
 
 	elapsed_time = SignedSongTime::Negative();
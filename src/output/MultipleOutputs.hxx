@@ -31,6 +31,7 @@
 #include "Chrono.hxx"
 #include "Compiler.h"
 
+#include <list>
 #include <vector>
 
 #include <assert.h>
@@ -43,12 +44,19 @@ struct MusicChunk;
 struct PlayerControl;
 struct AudioOutput;
 struct ReplayGainConfig;
+class OutputFilterGroup;
 
 class MultipleOutputs {
 	MixerListener &mixer_listener;
 
 	std::vector<AudioOutput *> outputs;
 
+	/**
+	 * Groups of outputs which share the replay gain and
+	 * cross-fade stage.  See #OutputFilterGroup.
+	 */
+	std::list<OutputFilterGroup> filter_groups;
+
 	AudioFormat input_audio_format = AudioFormat::Undefined();
 
 	/**
@@ -62,6 +70,18 @@ class MultipleOutputs {
 	 */
 	MusicPipe *pipe = nullptr;
 
+	/**
+	 * If not nullptr, then consumed chunks which may be played
+	 * again are moved to this pipe instead of being returned to
+	 * #buffer.  See SetHistory().
+	 */
+	MusicPipe *history = nullptr;
+
+	/**
+	 * The maximum number of chunks in #history.
+	 */
+	unsigned max_history = 0;
+
 	/**
 	 * The "elapsed_time" stamp of the most recently finished
 	 * chunk.
@@ -151,6 +171,23 @@ public:
 	 */
 	void Play(MusicChunk *chunk);
 
+	/**
+	 * Keep the most recently played chunks in the specified pipe
+	 * instead of returning them to the #MusicBuffer, so the player
+	 * can play them again after a short backwards seek.  When the
+	 * pipe is full, its oldest chunks are returned to the buffer.
+	 * Chunks which are being cancelled are moved there, too.
+	 *
+	 * The caller owns the pipe and the chunks in it.  Pass nullptr
+	 * to disable this.
+	 *
+	 * @param _max the maximum number of chunks in the pipe
+	 */
+	void SetHistory(MusicPipe *_history, unsigned _max=0) {
+		history = _history;
+		max_history = _max;
+	}
+
 	/**
 	 * Checks if the output devices have drained their music pipe, and
 	 * returns the consumed music chunks to the #music_buffer.
@@ -162,7 +199,8 @@ public:
 	/**
 	 * Checks if the size of the #MusicPipe is below the #threshold.  If
 	 * not, it attempts to synchronize with all output threads, and waits
-	 * until another #MusicChunk is finished.
+	 * until another #MusicChunk is finished (unless a #PlayerCommand
+	 * is pending).
 	 *
 	 * @param threshold the maximum number of chunks in the pipe
 	 * @return true if there are less than #threshold chunks in the pipe
@@ -232,6 +270,20 @@ public:
 	void SetSoftwareVolume(unsigned volume);
 
 private:
+	/**
+	 * Put outputs with identical replay gain settings into
+	 * #OutputFilterGroup objects.
+	 */
+	void CreateFilterGroups(const ReplayGainConfig &replay_gain_config);
+
+	/**
+	 * Prepare all #OutputFilterGroup objects for the new input
+	 * audio format.
+	 */
+	void OpenFilterGroups();
+
+	void CloseFilterGroups();
+
 	/**
 	 * Determine if all (active) outputs have finished the current
 	 * command.
@@ -272,6 +324,12 @@ private:
 	 * reference.
 	 */
 	void ClearTailChunk(const MusicChunk *chunk, bool *locked);
+
+	/**
+	 * Dispose of a chunk which has been removed from #pipe: move
+	 * it to #history or return it to #buffer.
+	 */
+	void ReleaseChunk(MusicChunk *chunk);
 };
 
 #endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "FilterGroup.hxx"
 #include "OutputAPI.hxx"
 #include "Domain.hxx"
 #include "pcm/PcmMix.hxx"
@@ -372,8 +373,12 @@ ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
 	return data;
 }
 
+/**
+ * Apply replay gain and cross-fading to the chunk.  This is the part
+ * which an #OutputFilterGroup may share among several outputs.
+ */
 static ConstBuffer<void>
-ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
+ao_mix_chunk(AudioOutput *ao, const MusicChunk *chunk)
 {
 	ConstBuffer<void> data =
 		ao_chunk_data(ao, chunk, ao->replay_gain_filter_instance,
@@ -426,6 +431,41 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 		data.size = other_data.size;
 	}
 
+	return data;
+}
+
+/**
+ * @param shared receives the reference to the data shared by the
+ * #OutputFilterGroup; the caller must hold it while it accesses the
+ * return value, because the filter chain may pass it through
+ */
+static ConstBuffer<void>
+ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk,
+		FilteredChunkPtr &shared)
+{
+	ConstBuffer<void> data = nullptr;
+
+	if (ao->filter_group != nullptr) {
+		try {
+			shared = ao->filter_group->Get(*chunk);
+		} catch (const std::runtime_error &e) {
+			FormatError(e, "\"%s\" [%s] failed to filter",
+				    ao->name, ao->plugin.name);
+			return nullptr;
+		}
+
+		if (shared != nullptr)
+			data = shared->data;
+	}
+
+	if (data.IsNull())
+		/* not shared with other outputs (or the group is
+		   closed): do it here */
+		data = ao_mix_chunk(ao, chunk);
+
+	if (data.IsEmpty())
+		return data;
+
 	/* apply filter chain */
 
 	try {
@@ -452,7 +492,9 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		}
 	}
 
-	auto data = ConstBuffer<char>::FromVoid(ao_filter_chunk(this, chunk));
+	FilteredChunkPtr shared;
+	auto data = ConstBuffer<char>::FromVoid(ao_filter_chunk(this, chunk,
+								 shared));
 	if (data.IsNull()) {
 		Close(false);
 
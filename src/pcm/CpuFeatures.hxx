@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_CPU_FEATURES_HXX
+#define MPD_PCM_CPU_FEATURES_HXX
+
+#include "Compiler.h"
+
+/*
+ * Run-time detection of the instruction set extensions used by the
+ * vectorized PCM code.  On x86, the compiler is allowed to emit
+ * SSE2/AVX2 code only in functions declared with the matching
+ * #PCM_TARGET_SSE2 / #PCM_TARGET_AVX2 attribute, and those may only
+ * be called after checking CpuHasSse2() / CpuHasAvx2().  NEON is a
+ * compile-time decision (see #PCM_SIMD_NEON), because there is no
+ * portable way to detect it at run time.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define PCM_SIMD_X86
+#define PCM_TARGET_SSE2 __attribute__((target("sse2")))
+#define PCM_TARGET_AVX2 __attribute__((target("avx2")))
+
+gcc_const
+static inline bool
+CpuHasSse2()
+{
+#ifdef __SSE2__
+	return true;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+gcc_const
+static inline bool
+CpuHasAvx2()
+{
+#ifdef __AVX2__
+	return true;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#define PCM_SIMD_NEON
+
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_DITHER_LANES_HXX
+#define MPD_PCM_DITHER_LANES_HXX
+
+/*
+ * Helpers for the callers of the block variant of
+ * PcmDither::DitherShift().  This header is internal to the PCM
+ * library.
+ *
+ * The noise shaping filter of each lane must see consecutive
+ * samples, or else it shapes the noise into the audible range.  So a
+ * buffer is split into #PcmDither::LANES runs of equal length, and
+ * lane j dithers run j from start to end.  The runs are interleaved
+ * into a small "tile" (sample k of run j at index k*LANES+j), so each
+ * block of the tile holds one sample of each run.
+ */
+
+#include "PcmDither.hxx"
+
+#include <stddef.h>
+
+/**
+ * Buffers with shorter runs than this are dithered sample by sample,
+ * because each run starts with the state its lane had at the end of
+ * the previous buffer.
+ */
+static constexpr size_t DITHER_LANES_MIN_RUN = 32;
+
+/**
+ * The number of samples per run in one tile.
+ */
+static constexpr size_t DITHER_LANES_TILE = 32;
+
+/**
+ * Determine the length of each run.
+ *
+ * @param n the number of samples in the buffer
+ * @return the length of each run; the remaining n-LANES*run samples
+ * at the end are not part of any run; 0 if the buffer is too small
+ */
+static inline size_t
+DitherLanesRunLength(size_t n)
+{
+	const size_t run = n / PcmDither::LANES;
+	return run >= DITHER_LANES_MIN_RUN ? run : 0;
+}
+
+/**
+ * Copy samples [k, k+count) of each run into a tile.
+ *
+ * @param src the buffer plus k
+ */
+template<typename T>
+static inline void
+DitherLanesGather(T *tile, const T *src, size_t run, size_t count)
+{
+	for (size_t k = 0; k < count; ++k)
+		for (unsigned j = 0; j < PcmDither::LANES; ++j)
+			*tile++ = src[j * run + k];
+}
+
+/**
+ * The reverse of DitherLanesGather().
+ */
+template<typename T>
+static inline void
+DitherLanesScatter(T *dest, const T *tile, size_t run, size_t count)
+{
+	for (size_t k = 0; k < count; ++k)
+		for (unsigned j = 0; j < PcmDither::LANES; ++j)
+			dest[j * run + k] = *tile++;
+}
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DsdSimd.hxx"
+#include "CpuFeatures.hxx"
+#include "util/bit_reverse.h"
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#ifdef PCM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+static DsdTables
+MakeDsdTables()
+{
+	const float *ctables = dsd2pcm_get_ctables();
+
+	DsdTables tables;
+	for (unsigned i = 0; i < DSD_CTABLES; ++i) {
+		for (unsigned b = 0; b < 256; ++b) {
+			tables.forward[i][b] = ctables[i * 256 + b];
+			tables.reverse[i][b] = ctables[i * 256 + bit_reverse(b)];
+		}
+	}
+
+	return tables;
+}
+
+/* initialized before main(), because MPD is built with
+   -fno-threadsafe-statics */
+static const DsdTables dsd_tables = MakeDsdTables();
+
+const DsdTables &
+GetDsdTables()
+{
+	return dsd_tables;
+}
+
+#ifdef PCM_SIMD_X86
+
+/*
+ * SSE2 has no gather instruction, and emulating it with scalar
+ * loads is not faster than the portable code; only AVX2 is
+ * implemented.
+ */
+
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_load_octets(const uint8_t *src)
+{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+}
+
+PCM_TARGET_AVX2
+static size_t
+avx2_dsd_to_float(const DsdTables &tables, float *dest, const uint8_t *src,
+		  size_t n)
+{
+	size_t done = 0;
+	for (; done + 8 <= n; done += 8) {
+		const uint8_t *s = src + done;
+
+		__m256 acc = _mm256_setzero_ps();
+		for (unsigned i = 0; i < DSD_CTABLES; ++i) {
+			const __m256 a =
+				_mm256_i32gather_ps(tables.forward[i],
+						    avx2_load_octets(s + DSD_HISTORY - i),
+						    sizeof(float));
+			const __m256 b =
+				_mm256_i32gather_ps(tables.reverse[i],
+						    avx2_load_octets(s + i),
+						    sizeof(float));
+			acc = _mm256_add_ps(acc, _mm256_add_ps(a, b));
+		}
+
+		_mm256_storeu_ps(dest + done, acc);
+	}
+
+	return done;
+}
+
+#endif /* PCM_SIMD_X86 */
+
+#ifdef PCM_SIMD_NEON
+
+/**
+ * Look up four consecutive octets in a table.  NEON has no gather
+ * instruction, but filling the lanes one by one still saves the
+ * scalar additions.
+ */
+static inline float32x4_t
+neon_lookup(const float *table, const uint8_t *src)
+{
+	float32x4_t v = vdupq_n_f32(0);
+	v = vld1q_lane_f32(table + src[0], v, 0);
+	v = vld1q_lane_f32(table + src[1], v, 1);
+	v = vld1q_lane_f32(table + src[2], v, 2);
+	v = vld1q_lane_f32(table + src[3], v, 3);
+	return v;
+}
+
+static size_t
+neon_dsd_to_float(const DsdTables &tables, float *dest, const uint8_t *src,
+		  size_t n)
+{
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4) {
+		const uint8_t *s = src + done;
+
+		float32x4_t acc = vdupq_n_f32(0);
+		for (unsigned i = 0; i < DSD_CTABLES; ++i)
+			acc = vaddq_f32(acc,
+					vaddq_f32(neon_lookup(tables.forward[i],
+							      s + DSD_HISTORY - i),
+						  neon_lookup(tables.reverse[i],
+							      s + i)));
+
+		vst1q_f32(dest + done, acc);
+	}
+
+	return done;
+}
+
+#endif /* PCM_SIMD_NEON */
+
+size_t
+DsdToFloatSimd(gcc_unused const DsdTables &tables,
+	       gcc_unused float *dest, gcc_unused const uint8_t *src,
+	       gcc_unused size_t n)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_dsd_to_float(tables, dest, src, n);
+#elif defined(PCM_SIMD_NEON)
+	return neon_dsd_to_float(tables, dest, src, n);
+#endif
+	return 0;
+}
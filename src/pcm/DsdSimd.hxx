@@ -0,0 +1,101 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_DSD_SIMD_HXX
+#define MPD_PCM_DSD_SIMD_HXX
+
+#include "Compiler.h"
+#include "dsd2pcm/dsd2pcm.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * The dsd2pcm filter, reformulated for vectorization across
+ * consecutive samples of one channel.
+ *
+ * dsd2pcm keeps a FIFO of octets per channel and bit-reverses each
+ * octet when it reaches the middle of the filter.  Here, the input
+ * of a channel is a linear array of octets in their original bit
+ * order, preceded by #DSD_HISTORY octets of the previous call, and
+ * the second half of the filter uses tables which are indexed by
+ * the unreversed octet.  Each sample is thus a sum of table lookups
+ * at fixed offsets, and neighbouring samples can be computed
+ * independently.
+ */
+
+static constexpr unsigned DSD_CTABLES = DSD2PCM_CTABLES;
+
+/**
+ * The number of octets preceding each new octet which contribute to
+ * its sample.
+ */
+static constexpr unsigned DSD_HISTORY = 2 * DSD_CTABLES - 1;
+
+struct DsdTables {
+	/**
+	 * The dsd2pcm lookup tables for the octets of age 0 ..
+	 * #DSD_CTABLES-1.
+	 */
+	float forward[DSD_CTABLES][256];
+
+	/**
+	 * The same tables, indexed by the bit-reversed octet, for the
+	 * octets of age #DSD_HISTORY .. #DSD_CTABLES.
+	 */
+	float reverse[DSD_CTABLES][256];
+};
+
+gcc_const
+const DsdTables &
+GetDsdTables();
+
+/**
+ * Calculate one sample.
+ *
+ * @param src the #DSD_HISTORY octets preceding the sample's octet,
+ * followed by that octet (MSB first)
+ */
+static inline float
+DsdToFloatSample(const DsdTables &tables, const uint8_t *src)
+{
+	float acc = 0;
+	for (unsigned i = 0; i < DSD_CTABLES; ++i)
+		acc += tables.forward[i][src[DSD_HISTORY - i]] +
+			tables.reverse[i][src[i]];
+	return acc;
+}
+
+/**
+ * Vectorized variant of DsdToFloatSample() for n consecutive
+ * samples of one channel, selected at run time according to the
+ * CPU's capabilities.  Its results equal those of
+ * DsdToFloatSample(), except for rounding.
+ *
+ * @param src the #DSD_HISTORY octets preceding the first new octet,
+ * followed by n new octets
+ * @return the number of leading samples which have been written
+ * (whole blocks only; the caller is responsible for the rest), or
+ * 0 if no suitable instruction set is available
+ */
+size_t
+DsdToFloatSimd(const DsdTables &tables, float *dest, const uint8_t *src,
+	       size_t n);
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DsdVolume.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/*
+ * The noise transfer function of the modulator is (1-z^-1)^5 / D(z);
+ * the poles are those of a Butterworth high-pass filter, placed so
+ * the gain of the NTF never exceeds 1.5, which keeps a single-bit
+ * modulator stable (Lee's rule).  These are the coefficients of
+ * NTF(z) - 1 = B(z) / D(z), without the leading 1 of D(z).
+ */
+
+static constexpr double ntf_b[] = {
+	-0.807717848861496,
+	2.9142085842917176,
+	-3.9703926164888976,
+	2.4187920610366516,
+	-0.5555555559879044,
+};
+
+static constexpr double ntf_a[] = {
+	-4.192282151138504,
+	7.0857914157082824,
+	-6.0296073835111024,
+	2.5812079389633484,
+	-0.4444444440120956,
+};
+
+/**
+ * If the quantizer input exceeds this magnitude, the modulator has
+ * become unstable, and its state is cleared.
+ */
+static constexpr double UNSTABLE = 16;
+
+/**
+ * The DSD "silence pattern"; see PcmSilence().
+ */
+static constexpr uint8_t DSD_SILENCE = 0x69;
+
+void
+DsdVolume::Channel::Reset()
+{
+	bits = DSD_SILENCE | (DSD_SILENCE << 8);
+
+	sum1 = 0;
+	for (unsigned i = 0; i < AVERAGE; ++i)
+		sum1 += (bits >> i) & 1;
+
+	history.fill(sum1);
+	sum2 = AVERAGE * sum1;
+	state.fill(0);
+}
+
+void
+DsdVolume::Reset()
+{
+	position = 0;
+
+	for (auto &i : channels)
+		i.Reset();
+}
+
+/**
+ * Apply the volume to a group of N channels.  Their state is kept in
+ * local variables for the duration of the call, and their bits are
+ * processed in lockstep, which lets the CPU work on the independent
+ * feedback loops in parallel.
+ */
+template<unsigned N>
+inline void
+DsdVolume::ApplyChannels(Channel *channels, unsigned position,
+			 uint8_t *dest, const uint8_t *src, size_t n_frames,
+			 size_t stride, double volume)
+{
+	/* maps Channel::sum2 to the range -volume..+volume */
+	const double scale = 2 * volume / (AVERAGE * AVERAGE);
+
+	Channel ch[N];
+	std::copy_n(channels, N, ch);
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		uint8_t out[N] = {};
+
+		for (unsigned shift = 8; shift-- > 0;) {
+			const unsigned old_position =
+				(position - AVERAGE) % 16;
+
+			for (unsigned c = 0; c < N; ++c) {
+				const unsigned x = (src[c] >> shift) & 1;
+				ch[c].bits = (ch[c].bits << 1) | x;
+				ch[c].sum1 += x - ((ch[c].bits >> AVERAGE) & 1);
+				ch[c].sum2 += ch[c].sum1 - ch[c].history[old_position];
+				ch[c].history[position] = ch[c].sum1;
+
+				const double u = ch[c].sum2 * scale - volume;
+				const double r = ch[c].state[0];
+				const double w = u + r;
+				const bool y = !signbit(w);
+				const double q = copysign(1., w) - w;
+
+				for (unsigned k = 0; k < ORDER - 1; ++k)
+					ch[c].state[k] = ch[c].state[k + 1]
+						+ ntf_b[k] * q - ntf_a[k] * r;
+				ch[c].state[ORDER - 1] =
+					ntf_b[ORDER - 1] * q
+					- ntf_a[ORDER - 1] * r;
+
+				if (gcc_unlikely(fabs(w) > UNSTABLE))
+					ch[c].state.fill(0);
+
+				out[c] = (out[c] << 1) | y;
+			}
+
+			position = (position + 1) % 16;
+		}
+
+		for (unsigned c = 0; c < N; ++c)
+			dest[c] = out[c];
+
+		src += stride;
+		dest += stride;
+	}
+
+	std::copy_n(ch, N, channels);
+}
+
+void
+DsdVolume::Apply(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		 unsigned n_channels, double volume)
+{
+	static_assert(sizeof(ntf_b) / sizeof(ntf_b[0]) == ORDER, "");
+	static_assert(sizeof(ntf_a) / sizeof(ntf_a[0]) == ORDER, "");
+
+	assert(n_channels <= channels.size());
+	assert(volume >= 0 && volume <= 1);
+
+	unsigned c = 0;
+	for (; c + 4 <= n_channels; c += 4)
+		ApplyChannels<4>(&channels[c], position, dest + c, src + c,
+				 n_frames, n_channels, volume);
+	for (; c + 2 <= n_channels; c += 2)
+		ApplyChannels<2>(&channels[c], position, dest + c, src + c,
+				 n_frames, n_channels, volume);
+	for (; c < n_channels; ++c)
+		ApplyChannels<1>(&channels[c], position, dest + c, src + c,
+				 n_frames, n_channels, volume);
+
+	position = (position + n_frames * 8) % 16;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_DSD_VOLUME_HXX
+#define MPD_PCM_DSD_VOLUME_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+
+#include <array>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Software volume for DSD_U8, without converting to PCM.
+ *
+ * The one-bit stream of each channel is smoothed by two cascaded
+ * moving averages of 9 bits (which remove most of its ultrasonic
+ * noise, but leave the audio band intact), scaled, and then
+ * requantized to one bit by a 5th order sigma-delta modulator.  The
+ * output is delayed by one octet.
+ */
+class DsdVolume {
+	/**
+	 * The length of each moving average in bits.
+	 */
+	static constexpr unsigned AVERAGE = 9;
+
+	/**
+	 * The order of the sigma-delta modulator.
+	 */
+	static constexpr unsigned ORDER = 5;
+
+	struct Channel {
+		/**
+		 * The most recent input bits; the newest one is bit
+		 * 0.
+		 */
+		unsigned bits;
+
+		/**
+		 * The number of "1" bits among the last #AVERAGE
+		 * input bits (the first moving average).
+		 */
+		unsigned sum1;
+
+		/**
+		 * The sum of the last #AVERAGE values of #sum1 (the
+		 * second moving average).
+		 */
+		unsigned sum2;
+
+		/**
+		 * The last values of #sum1, indexed by #position.
+		 */
+		std::array<uint8_t, 16> history;
+
+		/**
+		 * The state of the modulator's noise shaping filter
+		 * (transposed direct form II).
+		 */
+		std::array<double, ORDER> state;
+
+		void Reset();
+	};
+
+	/**
+	 * The ring buffer position in Channel::history.
+	 */
+	unsigned position;
+
+	std::array<Channel, MAX_CHANNELS> channels;
+
+public:
+	DsdVolume() {
+		Reset();
+	}
+
+	/**
+	 * Forget the state of all channels, e.g. because the volume
+	 * has not been applied to the previous data.
+	 */
+	void Reset();
+
+	/**
+	 * @param volume the volume level in the range [0..1]
+	 */
+	void Apply(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		   unsigned n_channels, double volume);
+
+private:
+	template<unsigned N>
+	static void ApplyChannels(Channel *ch, unsigned position,
+				  uint8_t *dest, const uint8_t *src,
+				  size_t n_frames, size_t stride,
+				  double volume);
+};
+
+#endif
@@ -0,0 +1,599 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MixSimd.hxx"
+#include "Simd.hxx"
+
+#ifdef PCM_SIMD_X86
+
+template<class K>
+PCM_TARGET_SSE2
+static size_t
+sse2_add_volume(PcmDither::Lanes &lanes,
+		typename K::value_type *a,
+		const typename K::value_type *b, size_t n,
+		int volume1, int volume2)
+{
+	typedef typename K::Range R;
+
+	Sse2Dither dither;
+	dither.Load(lanes);
+
+	const __m128i v1 = _mm_set1_epi32(volume1);
+	const __m128i v2 = _mm_set1_epi32(volume2);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		__m128i x[2], y[2];
+		K::Load(a + done, x[0], x[1]);
+		K::Load(b + done, y[0], y[1]);
+
+		for (unsigned i = 0; i < 2; ++i) {
+			const __m128i c =
+				_mm_add_epi32(sse2_mullo_epi32(x[i], v1),
+					      sse2_mullo_epi32(y[i], v2));
+			x[i] = dither.Dither<R::MIN, R::MAX>(c, i);
+		}
+
+		K::Store(a + done, x[0], x[1]);
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+PCM_TARGET_SSE2
+static size_t
+sse_add_volume_float(float *a, const float *b, size_t n,
+		     float volume1, float volume2)
+{
+	const __m128 v1 = _mm_set1_ps(volume1);
+	const __m128 v2 = _mm_set1_ps(volume2);
+
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4) {
+		const __m128 x = _mm_mul_ps(_mm_loadu_ps(a + done), v1);
+		const __m128 y = _mm_mul_ps(_mm_loadu_ps(b + done), v2);
+		_mm_storeu_ps(a + done, _mm_add_ps(x, y));
+	}
+
+	return done;
+}
+
+/**
+ * Saturating addition of signed 32 bit integers.
+ */
+PCM_TARGET_SSE2
+static inline __m128i
+sse2_adds_epi32(__m128i a, __m128i b)
+{
+	const __m128i sum = _mm_add_epi32(a, b);
+
+	/* overflow if both operands have the same sign and the sum
+	   has a different one */
+	const __m128i overflow =
+		_mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, sum),
+					     _mm_xor_si128(b, sum)), 31);
+
+	/* INT32_MAX for positive operands, INT32_MIN for negative
+	   ones */
+	const __m128i saturated =
+		_mm_xor_si128(_mm_srai_epi32(a, 31),
+			      _mm_set1_epi32(0x7fffffff));
+
+	return sse2_select(overflow, saturated, sum);
+}
+
+struct Sse2AddS8 {
+	PCM_TARGET_SSE2
+	static __m128i Add(__m128i a, __m128i b) {
+		return _mm_adds_epi8(a, b);
+	}
+};
+
+struct Sse2AddS16 {
+	PCM_TARGET_SSE2
+	static __m128i Add(__m128i a, __m128i b) {
+		return _mm_adds_epi16(a, b);
+	}
+};
+
+struct Sse2AddS24 {
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+
+	PCM_TARGET_SSE2
+	static __m128i Add(__m128i a, __m128i b) {
+		const __m128i min = _mm_set1_epi32(Traits::MIN);
+		const __m128i max = _mm_set1_epi32(Traits::MAX);
+		const __m128i sum = _mm_add_epi32(a, b);
+		return sse2_select(_mm_cmpgt_epi32(sum, max), max,
+				   sse2_select(_mm_cmplt_epi32(sum, min), min,
+					       sum));
+	}
+};
+
+struct Sse2AddS32 {
+	PCM_TARGET_SSE2
+	static __m128i Add(__m128i a, __m128i b) {
+		return sse2_adds_epi32(a, b);
+	}
+};
+
+template<class Op, typename T>
+PCM_TARGET_SSE2
+static size_t
+sse2_add(T *a, const T *b, size_t n)
+{
+	constexpr size_t step = sizeof(__m128i) / sizeof(T);
+
+	size_t done = 0;
+	for (; done + step <= n; done += step) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + done));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + done));
+		_mm_storeu_si128((__m128i *)(a + done), Op::Add(x, y));
+	}
+
+	return done;
+}
+
+PCM_TARGET_SSE2
+static size_t
+sse_add_float(float *a, const float *b, size_t n)
+{
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4)
+		_mm_storeu_ps(a + done, _mm_add_ps(_mm_loadu_ps(a + done),
+						   _mm_loadu_ps(b + done)));
+
+	return done;
+}
+
+template<class K>
+PCM_TARGET_AVX2
+static size_t
+avx2_add_volume32(PcmDither::Lanes &lanes,
+		  typename K::value_type *a,
+		  const typename K::value_type *b, size_t n,
+		  int volume1, int volume2)
+{
+	typedef typename K::Range R;
+
+	Avx2Dither32 dither;
+	dither.Load(lanes);
+
+	const __m256i v1 = _mm256_set1_epi32(volume1);
+	const __m256i v2 = _mm256_set1_epi32(volume2);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		const __m256i c =
+			_mm256_add_epi32(_mm256_mullo_epi32(K::Load(a + done), v1),
+					 _mm256_mullo_epi32(K::Load(b + done), v2));
+		K::Store(a + done, dither.Dither<R::MIN, R::MAX>(c));
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+template<SampleFormat F>
+PCM_TARGET_AVX2
+static size_t
+avx2_add_volume64(PcmDither::Lanes &lanes,
+		  int32_t *a, const int32_t *b, size_t n,
+		  int volume1, int volume2)
+{
+	typedef DitherRange<F> R;
+
+	Avx2Dither64 dither;
+	dither.Load(lanes);
+
+	const __m256i v1 = _mm256_set1_epi64x(volume1);
+	const __m256i v2 = _mm256_set1_epi64x(volume2);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		__m256i x[2], y[2];
+		avx2_widen_epi32(_mm256_loadu_si256((const __m256i *)(a + done)),
+				 x[0], x[1]);
+		avx2_widen_epi32(_mm256_loadu_si256((const __m256i *)(b + done)),
+				 y[0], y[1]);
+
+		for (unsigned i = 0; i < 2; ++i)
+			x[i] = _mm256_add_epi64(_mm256_mul_epi32(x[i], v1),
+						_mm256_mul_epi32(y[i], v2));
+
+		_mm256_storeu_si256((__m256i *)(a + done),
+				    dither.Dither<R::MIN, R::MAX>(x[0], x[1]));
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+PCM_TARGET_AVX2
+static size_t
+avx_add_volume_float(float *a, const float *b, size_t n,
+		     float volume1, float volume2)
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	size_t done = 0;
+	for (; done + 8 <= n; done += 8) {
+		const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(a + done), v1);
+		const __m256 y = _mm256_mul_ps(_mm256_loadu_ps(b + done), v2);
+		_mm256_storeu_ps(a + done, _mm256_add_ps(x, y));
+	}
+
+	return done;
+}
+
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_adds_epi32(__m256i a, __m256i b)
+{
+	const __m256i sum = _mm256_add_epi32(a, b);
+	const __m256i overflow =
+		_mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, sum),
+						   _mm256_xor_si256(b, sum)),
+				  31);
+	const __m256i saturated =
+		_mm256_xor_si256(_mm256_srai_epi32(a, 31),
+				 _mm256_set1_epi32(0x7fffffff));
+
+	return avx2_select(overflow, saturated, sum);
+}
+
+struct Avx2AddS8 {
+	PCM_TARGET_AVX2
+	static __m256i Add(__m256i a, __m256i b) {
+		return _mm256_adds_epi8(a, b);
+	}
+};
+
+struct Avx2AddS16 {
+	PCM_TARGET_AVX2
+	static __m256i Add(__m256i a, __m256i b) {
+		return _mm256_adds_epi16(a, b);
+	}
+};
+
+struct Avx2AddS24 {
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+
+	PCM_TARGET_AVX2
+	static __m256i Add(__m256i a, __m256i b) {
+		return _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(a, b),
+							 _mm256_set1_epi32(Traits::MIN)),
+					_mm256_set1_epi32(Traits::MAX));
+	}
+};
+
+struct Avx2AddS32 {
+	PCM_TARGET_AVX2
+	static __m256i Add(__m256i a, __m256i b) {
+		return avx2_adds_epi32(a, b);
+	}
+};
+
+template<class Op, typename T>
+PCM_TARGET_AVX2
+static size_t
+avx2_add(T *a, const T *b, size_t n)
+{
+	constexpr size_t step = sizeof(__m256i) / sizeof(T);
+
+	size_t done = 0;
+	for (; done + step <= n; done += step) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(a + done));
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + done));
+		_mm256_storeu_si256((__m256i *)(a + done), Op::Add(x, y));
+	}
+
+	return done;
+}
+
+PCM_TARGET_AVX2
+static size_t
+avx_add_float(float *a, const float *b, size_t n)
+{
+	size_t done = 0;
+	for (; done + 8 <= n; done += 8)
+		_mm256_storeu_ps(a + done,
+				 _mm256_add_ps(_mm256_loadu_ps(a + done),
+					       _mm256_loadu_ps(b + done)));
+
+	return done;
+}
+
+#endif /* PCM_SIMD_X86 */
+
+#ifdef PCM_SIMD_NEON
+
+template<class K>
+static size_t
+neon_add_volume(PcmDither::Lanes &lanes,
+		typename K::value_type *a,
+		const typename K::value_type *b, size_t n,
+		int volume1, int volume2)
+{
+	typedef typename K::Range R;
+
+	NeonDither dither;
+	dither.Load(lanes);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		int32x4_t x[2], y[2];
+		K::Load(a + done, x[0], x[1]);
+		K::Load(b + done, y[0], y[1]);
+
+		for (unsigned i = 0; i < 2; ++i) {
+			const int32x4_t c = vaddq_s32(vmulq_n_s32(x[i], volume1),
+						      vmulq_n_s32(y[i], volume2));
+			x[i] = dither.Dither<R::MIN, R::MAX>(c, i);
+		}
+
+		K::Store(a + done, x[0], x[1]);
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+static size_t
+neon_add_volume_float(float *a, const float *b, size_t n,
+		      float volume1, float volume2)
+{
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4) {
+		/* no vmlaq_f32(), which may be fused on some CPUs and
+		   would then round differently */
+		const float32x4_t x = vmulq_n_f32(vld1q_f32(a + done), volume1);
+		const float32x4_t y = vmulq_n_f32(vld1q_f32(b + done), volume2);
+		vst1q_f32(a + done, vaddq_f32(x, y));
+	}
+
+	return done;
+}
+
+static size_t
+neon_add8(int8_t *a, const int8_t *b, size_t n)
+{
+	size_t done = 0;
+	for (; done + 16 <= n; done += 16)
+		vst1q_s8(a + done, vqaddq_s8(vld1q_s8(a + done),
+					     vld1q_s8(b + done)));
+
+	return done;
+}
+
+static size_t
+neon_add16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t done = 0;
+	for (; done + 8 <= n; done += 8)
+		vst1q_s16(a + done, vqaddq_s16(vld1q_s16(a + done),
+					       vld1q_s16(b + done)));
+
+	return done;
+}
+
+static size_t
+neon_add24(int32_t *a, const int32_t *b, size_t n)
+{
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+	const int32x4_t min = vdupq_n_s32(Traits::MIN);
+	const int32x4_t max = vdupq_n_s32(Traits::MAX);
+
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4) {
+		const int32x4_t sum = vaddq_s32(vld1q_s32(a + done),
+						vld1q_s32(b + done));
+		vst1q_s32(a + done, vminq_s32(vmaxq_s32(sum, min), max));
+	}
+
+	return done;
+}
+
+static size_t
+neon_add32(int32_t *a, const int32_t *b, size_t n)
+{
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4)
+		vst1q_s32(a + done, vqaddq_s32(vld1q_s32(a + done),
+					       vld1q_s32(b + done)));
+
+	return done;
+}
+
+static size_t
+neon_add_float(float *a, const float *b, size_t n)
+{
+	size_t done = 0;
+	for (; done + 4 <= n; done += 4)
+		vst1q_f32(a + done, vaddq_f32(vld1q_f32(a + done),
+					      vld1q_f32(b + done)));
+
+	return done;
+}
+
+#endif /* PCM_SIMD_NEON */
+
+size_t
+PcmAddVolumeSimd8(gcc_unused PcmDither::Lanes &lanes,
+		  gcc_unused int8_t *a, gcc_unused const int8_t *b,
+		  gcc_unused size_t n,
+		  gcc_unused int volume1, gcc_unused int volume2)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add_volume32<Avx2S8>(lanes, a, b, n,
+						 volume1, volume2);
+	if (CpuHasSse2())
+		return sse2_add_volume<Sse2S8>(lanes, a, b, n,
+					       volume1, volume2);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add_volume<NeonS8>(lanes, a, b, n, volume1, volume2);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddVolumeSimd16(gcc_unused PcmDither::Lanes &lanes,
+		   gcc_unused int16_t *a, gcc_unused const int16_t *b,
+		   gcc_unused size_t n,
+		   gcc_unused int volume1, gcc_unused int volume2)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add_volume32<Avx2S16>(lanes, a, b, n,
+						  volume1, volume2);
+	if (CpuHasSse2())
+		return sse2_add_volume<Sse2S16>(lanes, a, b, n,
+						volume1, volume2);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add_volume<NeonS16>(lanes, a, b, n, volume1, volume2);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddVolumeSimd24(gcc_unused PcmDither::Lanes &lanes,
+		   gcc_unused int32_t *a, gcc_unused const int32_t *b,
+		   gcc_unused size_t n,
+		   gcc_unused int volume1, gcc_unused int volume2)
+{
+	/* 64 bit lanes are only implemented for AVX2; SSE2 lacks
+	   64 bit comparisons */
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add_volume64<SampleFormat::S24_P32>(lanes, a, b, n,
+								volume1,
+								volume2);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddVolumeSimd32(gcc_unused PcmDither::Lanes &lanes,
+		   gcc_unused int32_t *a, gcc_unused const int32_t *b,
+		   gcc_unused size_t n,
+		   gcc_unused int volume1, gcc_unused int volume2)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add_volume64<SampleFormat::S32>(lanes, a, b, n,
+							    volume1, volume2);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddVolumeSimdFloat(gcc_unused float *a, gcc_unused const float *b,
+		      gcc_unused size_t n,
+		      gcc_unused float volume1, gcc_unused float volume2)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx_add_volume_float(a, b, n, volume1, volume2);
+	if (CpuHasSse2())
+		return sse_add_volume_float(a, b, n, volume1, volume2);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add_volume_float(a, b, n, volume1, volume2);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddSimd8(gcc_unused int8_t *a, gcc_unused const int8_t *b,
+	    gcc_unused size_t n)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add<Avx2AddS8>(a, b, n);
+	if (CpuHasSse2())
+		return sse2_add<Sse2AddS8>(a, b, n);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add8(a, b, n);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddSimd16(gcc_unused int16_t *a, gcc_unused const int16_t *b,
+	     gcc_unused size_t n)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add<Avx2AddS16>(a, b, n);
+	if (CpuHasSse2())
+		return sse2_add<Sse2AddS16>(a, b, n);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add16(a, b, n);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddSimd24(gcc_unused int32_t *a, gcc_unused const int32_t *b,
+	     gcc_unused size_t n)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add<Avx2AddS24>(a, b, n);
+	if (CpuHasSse2())
+		return sse2_add<Sse2AddS24>(a, b, n);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add24(a, b, n);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddSimd32(gcc_unused int32_t *a, gcc_unused const int32_t *b,
+	     gcc_unused size_t n)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_add<Avx2AddS32>(a, b, n);
+	if (CpuHasSse2())
+		return sse2_add<Sse2AddS32>(a, b, n);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add32(a, b, n);
+#endif
+	return 0;
+}
+
+size_t
+PcmAddSimdFloat(gcc_unused float *a, gcc_unused const float *b,
+		gcc_unused size_t n)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx_add_float(a, b, n);
+	if (CpuHasSse2())
+		return sse_add_float(a, b, n);
+#elif defined(PCM_SIMD_NEON)
+	return neon_add_float(a, b, n);
+#endif
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_MIX_SIMD_HXX
+#define MPD_PCM_MIX_SIMD_HXX
+
+#include "PcmDither.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorized mixing kernels for pcm_mix(), selected at run time
+ * according to the CPU's capabilities.
+ *
+ * Each function processes as many leading samples as it can in whole
+ * blocks and returns the number of samples it has written to "a";
+ * the caller is responsible for the rest.  The PcmAddVolumeSimd*()
+ * functions work on blocks of #PcmDither::LANES samples and produce
+ * exactly the same output as the block variant of
+ * PcmDither::DitherShift().  The PcmAddSimd*() functions (used by
+ * MixRamp) produce exactly the same output as the portable clamped
+ * addition.  If no suitable instruction set is available, they
+ * return 0.
+ */
+
+size_t
+PcmAddVolumeSimd8(PcmDither::Lanes &lanes,
+		  int8_t *a, const int8_t *b, size_t n,
+		  int volume1, int volume2);
+
+size_t
+PcmAddVolumeSimd16(PcmDither::Lanes &lanes,
+		   int16_t *a, const int16_t *b, size_t n,
+		   int volume1, int volume2);
+
+size_t
+PcmAddVolumeSimd24(PcmDither::Lanes &lanes,
+		   int32_t *a, const int32_t *b, size_t n,
+		   int volume1, int volume2);
+
+size_t
+PcmAddVolumeSimd32(PcmDither::Lanes &lanes,
+		   int32_t *a, const int32_t *b, size_t n,
+		   int volume1, int volume2);
+
+size_t
+PcmAddVolumeSimdFloat(float *a, const float *b, size_t n,
+		      float volume1, float volume2);
+
+size_t
+PcmAddSimd8(int8_t *a, const int8_t *b, size_t n);
+
+size_t
+PcmAddSimd16(int16_t *a, const int16_t *b, size_t n);
+
+size_t
+PcmAddSimd24(int32_t *a, const int32_t *b, size_t n);
+
+size_t
+PcmAddSimd32(int32_t *a, const int32_t *b, size_t n);
+
+size_t
+PcmAddSimdFloat(float *a, const float *b, size_t n);
+
+#endif
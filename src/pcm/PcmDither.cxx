@@ -24,15 +24,16 @@
 
 template<typename T, T MIN, T MAX, unsigned scale_bits>
 inline T
-PcmDither::Dither(T sample)
+PcmDither::Dither(T sample, int32_t &error0, int32_t &error1,
+		  int32_t &error2, int32_t &random)
 {
 	constexpr T round = 1 << (scale_bits - 1);
 	constexpr T mask = (1 << scale_bits) - 1;
 
-	sample += error[0] - error[1] + error[2];
+	sample += error0 - error1 + error2;
 
-	error[2] = error[1];
-	error[1] = error[0] / 2;
+	error2 = error1;
+	error1 = error0 / 2;
 
 	/* round */
 	T output = sample + round;
@@ -57,11 +58,19 @@ PcmDither::Dither(T sample)
 
 	output &= ~mask;
 
-	error[0] = sample - output;
+	error0 = sample - output;
 
 	return output >> scale_bits;
 }
 
+template<typename T, T MIN, T MAX, unsigned scale_bits>
+inline T
+PcmDither::Dither(T sample)
+{
+	return Dither<T, MIN, MAX, scale_bits>(sample, error[0], error[1],
+					       error[2], random);
+}
+
 template<typename ST, unsigned SBITS, unsigned DBITS>
 inline ST
 PcmDither::DitherShift(ST sample)
@@ -75,6 +84,24 @@ PcmDither::DitherShift(ST sample)
 	return Dither<ST, MIN, MAX, SBITS - DBITS>(sample);
 }
 
+template<typename ST, unsigned SBITS, unsigned DBITS>
+inline void
+PcmDither::DitherShift(ST *samples)
+{
+	static_assert(sizeof(ST) * 8 > SBITS, "Source type too small");
+	static_assert(SBITS > DBITS, "Non-positive scale_bits");
+
+	static constexpr ST MIN = -(ST(1) << (SBITS - 1));
+	static constexpr ST MAX = (ST(1) << (SBITS - 1)) - 1;
+
+	for (unsigned i = 0; i < LANES; ++i)
+		samples[i] = Dither<ST, MIN, MAX, SBITS - DBITS>(samples[i],
+								 lanes.error[0][i],
+								 lanes.error[1][i],
+								 lanes.error[2][i],
+								 lanes.random[i]);
+}
+
 template<typename ST, typename DT>
 inline typename DT::value_type
 PcmDither::DitherConvert(typename ST::value_type sample)
@@ -25,12 +25,50 @@
 enum class SampleFormat : uint8_t;
 
 class PcmDither {
+public:
+	/**
+	 * The number of independent dither channels used by the
+	 * block variant of DitherShift().  Each lane has its own
+	 * error feedback and PRNG state, which allows vectorized
+	 * implementations to process that many samples in parallel
+	 * and still produce exactly the same result as the portable
+	 * code.
+	 *
+	 * The error feedback of a lane is meant for the next sample
+	 * it processes, so each lane must be given consecutive
+	 * samples of one run (see DitherLanes.hxx); feeding it every
+	 * #LANES'th sample would move the noise shaping to lower
+	 * frequencies.
+	 */
+	static constexpr unsigned LANES = 8;
+
+	struct Lanes {
+		int32_t error[3][LANES];
+		int32_t random[LANES];
+	};
+
+private:
 	int32_t error[3];
 	int32_t random;
 
+	Lanes lanes;
+
 public:
 	constexpr PcmDither()
-		:error{0, 0, 0}, random(0) {}
+		:error{0, 0, 0}, random(0),
+		 lanes{{{0}, {0}, {0}},
+		       /* different seeds to avoid correlated noise
+			  in adjacent runs */
+		       {0x00000000, 0x1e3779b9, 0x3c6ef372, 0x5aa66d2b,
+			0x78dde6e4, 0x1715609d, 0x354cda56, 0x5384540f}} {}
+
+	/**
+	 * Grants access to the lane state for vectorized
+	 * implementations of DitherShift().
+	 */
+	Lanes &GetLanes() {
+		return lanes;
+	}
 
 	/**
 	 * Shift the given sample by #SBITS-#DBITS to the right, and
@@ -44,6 +82,16 @@ public:
 	template<typename ST, unsigned SBITS, unsigned DBITS>
 	ST DitherShift(ST sample);
 
+	/**
+	 * Block variant of DitherShift(): shift #LANES samples in
+	 * place, each one with the dither state of its lane.
+	 *
+	 * @param samples an array of exactly #LANES samples, one of
+	 * each run
+	 */
+	template<typename ST, unsigned SBITS, unsigned DBITS>
+	void DitherShift(ST *samples);
+
 	void Dither24To16(int16_t *dest, const int32_t *src,
 			  const int32_t *src_end);
 
@@ -64,6 +112,13 @@ private:
 	template<typename T, T MIN, T MAX, unsigned scale_bits>
 	T Dither(T sample);
 
+	/**
+	 * The dither algorithm, operating on the given state.
+	 */
+	template<typename T, T MIN, T MAX, unsigned scale_bits>
+	static T Dither(T sample, int32_t &error0, int32_t &error1,
+			int32_t &error2, int32_t &random);
+
 	/**
 	 * Convert the given sample from one sample format to another,
 	 * discarding bits.
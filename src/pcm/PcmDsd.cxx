@@ -19,29 +19,116 @@
 
 #include "config.h"
 #include "PcmDsd.hxx"
-#include "dsd2pcm/dsd2pcm.h"
+#include "Interleave.hxx"
+#include "thread/WorkerPool.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/bit_reverse.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
 
 #include <assert.h>
 
-PcmDsd::PcmDsd()
+/**
+ * Parts of a block which are smaller than this number of octets are
+ * cheaper to convert than to hand over to another thread.
+ */
+static constexpr size_t MIN_PART_SIZE = 2048;
+
+/**
+ * The maximum number of worker threads, in addition to the calling
+ * thread.
+ */
+static constexpr unsigned MAX_WORKER_THREADS = 3;
+
+/**
+ * The dsd2pcm "silence pattern"; see dsd2pcm_reset().
+ */
+static constexpr uint8_t DSD_SILENCE = 0x69;
+
+static std::unique_ptr<WorkerPool>
+CreateWorkerPool()
+{
+	const unsigned n_cpus = std::thread::hardware_concurrency();
+	if (n_cpus < 2)
+		return nullptr;
+
+	try {
+		return std::unique_ptr<WorkerPool>(new WorkerPool("dsd",
+								  std::min(n_cpus - 1,
+									   MAX_WORKER_THREADS)));
+	} catch (...) {
+		/* not fatal: convert everything in the calling
+		   thread */
+		return nullptr;
+	}
+}
+
+static Mutex worker_pool_mutex;
+static std::unique_ptr<WorkerPool> worker_pool;
+static bool worker_pool_initialized;
+
+/**
+ * Returns the worker pool shared by all #PcmDsd instances, or
+ * nullptr if there is only one CPU.  It is created on the first
+ * call.
+ */
+static WorkerPool *
+GetWorkerPool()
 {
-	dsd2pcm.fill(nullptr);
+	const ScopeLock protect(worker_pool_mutex);
+
+	if (!worker_pool_initialized) {
+		worker_pool = CreateWorkerPool();
+		worker_pool_initialized = true;
+	}
+
+	return worker_pool.get();
 }
 
-PcmDsd::~PcmDsd()
+PcmDsd::PcmDsd()
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_destroy(i);
+	Reset();
 }
 
 void
 PcmDsd::Reset()
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_reset(i);
+	/* this is the state after dsd2pcm_reset(): its FIFO is filled
+	   with the silence pattern, and the octets which would have
+	   been bit-reversed already appear unreversed to the reverse
+	   tables */
+	for (auto &h : history) {
+		std::fill_n(h.begin(), DSD_CTABLES - 1,
+			    bit_reverse(DSD_SILENCE));
+		std::fill(h.begin() + DSD_CTABLES - 1, h.end(),
+			  DSD_SILENCE);
+	}
+}
+
+void
+PcmDsd::ChannelToFloat(unsigned channels, unsigned channel,
+		       ConstBuffer<uint8_t> src,
+		       uint8_t *planar_src, float *planar_dest)
+{
+	const size_t n = src.size / channels;
+	auto &h = history[channel];
+
+	std::copy(h.begin(), h.end(), planar_src);
+
+	uint8_t *p = planar_src + DSD_HISTORY;
+	for (size_t i = 0; i < n; ++i)
+		p[i] = src.data[i * channels + channel];
+
+	const auto &tables = GetDsdTables();
+	size_t done = DsdToFloatSimd(tables, planar_dest, planar_src, n);
+	for (; done < n; ++done)
+		planar_dest[done] = DsdToFloatSample(tables,
+						     planar_src + done);
+
+	std::copy_n(planar_src + n, DSD_HISTORY, h.begin());
 }
 
 ConstBuffer<float>
@@ -50,23 +137,49 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src)
 	assert(!src.IsNull());
 	assert(!src.IsEmpty());
 	assert(src.size % channels == 0);
-	assert(channels <= dsd2pcm.max_size());
+	assert(channels <= history.max_size());
 
-	const unsigned num_samples = src.size;
-	const unsigned num_frames = src.size / channels;
+	const size_t num_samples = src.size;
+	const size_t num_frames = src.size / channels;
+	const size_t planar_src_size = num_frames + DSD_HISTORY;
 
 	float *dest = buffer.GetT<float>(num_samples);
+	uint8_t *planar_src =
+		planar_src_buffer.GetT<uint8_t>(channels * planar_src_size);
+	float *planar_dest = channels > 1
+		? planar_dest_buffer.GetT<float>(num_samples)
+		: dest;
+
+	auto convert = [=](unsigned channel){
+		ChannelToFloat(channels, channel, src,
+			       planar_src + channel * planar_src_size,
+			       planar_dest + channel * num_frames);
+	};
+
+	unsigned n_parts = std::min<size_t>(channels,
+					    src.size / MIN_PART_SIZE);
+	WorkerPool *pool = n_parts > 1
+		? GetWorkerPool()
+		: nullptr;
+	if (pool != nullptr) {
+		n_parts = std::min(n_parts, pool->GetConcurrency());
+		pool->Run(n_parts, [=](unsigned part){
+				for (unsigned c = part; c < channels;
+				     c += n_parts)
+					convert(c);
+			});
+	} else {
+		for (unsigned c = 0; c < channels; ++c)
+			convert(c);
+	}
 
-	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
-		}
+	if (channels > 1) {
+		std::array<const float *, MAX_CHANNELS> planes;
+		for (unsigned c = 0; c < channels; ++c)
+			planes[c] = planar_dest + c * num_frames;
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
+		PcmInterleaveFloat(dest, {planes.data(), channels},
+				   num_frames);
 	}
 
 	return { dest, num_samples };
@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "PcmBuffer.hxx"
+#include "DsdSimd.hxx"
 #include "AudioFormat.hxx"
 
 #include <array>
@@ -31,21 +32,41 @@
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD to float with the dsd2pcm filter.  All channels are
+ * vectorized (see DsdToFloatSimd()), and large blocks of
+ * multi-channel data are split among a few worker threads.
  */
 class PcmDsd {
 	PcmBuffer buffer;
 
-	std::array<struct dsd2pcm_ctx_s *, MAX_CHANNELS> dsd2pcm;
+	/**
+	 * The input of each channel, deinterleaved and preceded by
+	 * its history.
+	 */
+	PcmBuffer planar_src_buffer;
+
+	/**
+	 * The output of each channel before interleaving.
+	 */
+	PcmBuffer planar_dest_buffer;
+
+	/**
+	 * The last #DSD_HISTORY octets of each channel.
+	 */
+	std::array<std::array<uint8_t, DSD_HISTORY>, MAX_CHANNELS> history;
 
 public:
 	PcmDsd();
-	~PcmDsd();
 
 	void Reset();
 
 	ConstBuffer<float> ToFloat(unsigned channels,
 				   ConstBuffer<uint8_t> src);
+
+private:
+	void ChannelToFloat(unsigned channels, unsigned channel,
+			    ConstBuffer<uint8_t> src,
+			    uint8_t *planar_src, float *planar_dest);
 };
 
 /**
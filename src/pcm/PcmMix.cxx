@@ -19,6 +19,8 @@
 
 #include "config.h"
 #include "PcmMix.hxx"
+#include "MixSimd.hxx"
+#include "DitherLanes.hxx"
 #include "Volume.hxx"
 #include "PcmUtils.hxx"
 #include "AudioFormat.hxx"
@@ -27,9 +29,69 @@
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#include <algorithm>
+
 #include <assert.h>
 #include <math.h>
 
+/**
+ * Maps a #SampleFormat to its vectorized kernels in MixSimd.cxx.
+ */
+template<SampleFormat F>
+struct MixSimd;
+
+template<>
+struct MixSimd<SampleFormat::S8> {
+	static size_t AddVolume(PcmDither::Lanes &lanes,
+				int8_t *a, const int8_t *b, size_t n,
+				int volume1, int volume2) {
+		return PcmAddVolumeSimd8(lanes, a, b, n, volume1, volume2);
+	}
+
+	static size_t Add(int8_t *a, const int8_t *b, size_t n) {
+		return PcmAddSimd8(a, b, n);
+	}
+};
+
+template<>
+struct MixSimd<SampleFormat::S16> {
+	static size_t AddVolume(PcmDither::Lanes &lanes,
+				int16_t *a, const int16_t *b, size_t n,
+				int volume1, int volume2) {
+		return PcmAddVolumeSimd16(lanes, a, b, n, volume1, volume2);
+	}
+
+	static size_t Add(int16_t *a, const int16_t *b, size_t n) {
+		return PcmAddSimd16(a, b, n);
+	}
+};
+
+template<>
+struct MixSimd<SampleFormat::S24_P32> {
+	static size_t AddVolume(PcmDither::Lanes &lanes,
+				int32_t *a, const int32_t *b, size_t n,
+				int volume1, int volume2) {
+		return PcmAddVolumeSimd24(lanes, a, b, n, volume1, volume2);
+	}
+
+	static size_t Add(int32_t *a, const int32_t *b, size_t n) {
+		return PcmAddSimd24(a, b, n);
+	}
+};
+
+template<>
+struct MixSimd<SampleFormat::S32> {
+	static size_t AddVolume(PcmDither::Lanes &lanes,
+				int32_t *a, const int32_t *b, size_t n,
+				int volume1, int volume2) {
+		return PcmAddVolumeSimd32(lanes, a, b, n, volume1, volume2);
+	}
+
+	static size_t Add(int32_t *a, const int32_t *b, size_t n) {
+		return PcmAddSimd32(a, b, n);
+	}
+};
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static typename Traits::value_type
 PcmAddVolume(PcmDither &dither,
@@ -44,6 +106,45 @@ PcmAddVolume(PcmDither &dither,
 				  Traits::BITS>(c);
 }
 
+/**
+ * Mix whole blocks of #PcmDither::LANES samples (i.e. one sample of
+ * each run in a tile, see DitherLanes.hxx), using the block variant
+ * of PcmDither::DitherShift().  This is the portable
+ * equivalent of the kernels in MixSimd.cxx.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static size_t
+PcmAddVolumeBlocks(PcmDither &dither,
+		   typename Traits::pointer_type a,
+		   typename Traits::const_pointer_type b,
+		   size_t n, int volume1, int volume2)
+{
+	typedef typename Traits::long_type long_type;
+	constexpr unsigned LANES = PcmDither::LANES;
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		long_type block[LANES];
+		for (unsigned i = 0; i < LANES; ++i)
+			block[i] = long_type(a[done + i]) * volume1 +
+				long_type(b[done + i]) * volume2;
+
+		dither.DitherShift<long_type,
+				   Traits::BITS + PCM_VOLUME_BITS,
+				   Traits::BITS>(block);
+
+		for (unsigned i = 0; i < LANES; ++i)
+			a[done + i] = block[i];
+	}
+
+	return done;
+}
+
+/**
+ * Mix the runs of the buffers (see DitherLanes.hxx) tile by tile,
+ * with the vectorized kernel if possible, and the remaining samples
+ * one by one.
+ */
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
 PcmAddVolume(PcmDither &dither,
@@ -51,7 +152,32 @@ PcmAddVolume(PcmDither &dither,
 	     typename Traits::const_pointer_type b,
 	     size_t n, int volume1, int volume2)
 {
-	for (size_t i = 0; i != n; ++i)
+	constexpr unsigned LANES = PcmDither::LANES;
+
+	const size_t run = DitherLanesRunLength(n);
+
+	typename Traits::value_type tile_a[DITHER_LANES_TILE * LANES];
+	typename Traits::value_type tile_b[DITHER_LANES_TILE * LANES];
+	for (size_t k = 0; k < run; k += DITHER_LANES_TILE) {
+		const size_t count = std::min(run - k, DITHER_LANES_TILE);
+		const size_t tile_n = count * LANES;
+
+		DitherLanesGather(tile_a, a + k, run, count);
+		DitherLanesGather(tile_b, b + k, run, count);
+
+		const size_t done =
+			MixSimd<F>::AddVolume(dither.GetLanes(),
+					      tile_a, tile_b, tile_n,
+					      volume1, volume2);
+		PcmAddVolumeBlocks<F, Traits>(dither,
+					      tile_a + done, tile_b + done,
+					      tile_n - done,
+					      volume1, volume2);
+
+		DitherLanesScatter(a + k, tile_a, run, count);
+	}
+
+	for (size_t i = run * LANES; i != n; ++i)
 		a[i] = PcmAddVolume<F, Traits>(dither, a[i], b[i],
 					       volume1, volume2);
 }
@@ -64,17 +190,24 @@ PcmAddVolumeVoid(PcmDither &dither,
 	constexpr size_t sample_size = Traits::SAMPLE_SIZE;
 	assert(size % sample_size == 0);
 
-	PcmAddVolume<F, Traits>(dither,
-				typename Traits::pointer_type(a),
-				typename Traits::const_pointer_type(b),
-				size / sample_size,
-				volume1, volume2);
+	const auto _a = typename Traits::pointer_type(a);
+	const auto _b = typename Traits::const_pointer_type(b);
+	const size_t n = size / sample_size;
+
+	PcmAddVolume<F, Traits>(dither, _a, _b, n, volume1, volume2);
 }
 
 static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2)
 {
+	const size_t done = PcmAddVolumeSimdFloat(buffer1, buffer2,
+						  num_samples,
+						  volume1, volume2);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -147,7 +280,7 @@ PcmAdd(typename Traits::pointer_type a,
        typename Traits::const_pointer_type b,
        size_t n)
 {
-	for (size_t i = 0; i != n; ++i)
+	for (size_t i = MixSimd<F>::Add(a, b, n); i != n; ++i)
 		a[i] = PcmAdd<F, Traits>(a[i], b[i]);
 }
 
@@ -166,6 +299,11 @@ PcmAddVoid(void *a, const void *b, size_t size)
 static void
 pcm_add_float(float *buffer1, const float *buffer2, unsigned num_samples)
 {
+	const size_t done = PcmAddSimdFloat(buffer1, buffer2, num_samples);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
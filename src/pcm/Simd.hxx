@@ -0,0 +1,594 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SIMD_HXX
+#define MPD_PCM_SIMD_HXX
+
+/*
+ * Building blocks for the vectorized PCM kernels.  This header is
+ * internal to the PCM library; it is only meant to be included by
+ * the source files implementing such kernels.
+ *
+ * The dither functions implement the algorithm of
+ * PcmDither::Dither() on #PcmDither::LANES independent lanes,
+ * discarding #PCM_VOLUME_BITS bits.
+ */
+
+#include "CpuFeatures.hxx"
+#include "PcmDither.hxx"
+#include "Volume.hxx"
+#include "Traits.hxx"
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#ifdef PCM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+static constexpr unsigned LANES = PcmDither::LANES;
+static constexpr unsigned SCALE_BITS = PCM_VOLUME_BITS;
+static constexpr int32_t DITHER_ROUND = 1 << (SCALE_BITS - 1);
+static constexpr int32_t DITHER_MASK = (1 << SCALE_BITS) - 1;
+
+/* the parameters of pcm_prng() */
+static constexpr int32_t PRNG_MUL = 0x0019660d;
+static constexpr int32_t PRNG_ADD = 0x3c6ef35f;
+
+/**
+ * The range of the intermediate (scaled) sample value of the given
+ * format, which gets dithered down to the format's bit depth.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct DitherRange {
+	typedef typename Traits::long_type T;
+	static constexpr unsigned SBITS = Traits::BITS + PCM_VOLUME_BITS;
+
+	static constexpr T MIN = -(T(1) << (SBITS - 1));
+	static constexpr T MAX = (T(1) << (SBITS - 1)) - 1;
+};
+
+#ifdef PCM_SIMD_X86
+
+/*
+ * SSE2: two registers of four 32 bit lanes; used for S8 and S16.
+ */
+
+/**
+ * SSE2 has no instruction for the low 32 bits of a 32 bit
+ * multiplication; emulate it with two 64 bit multiplications.
+ */
+PCM_TARGET_SSE2
+static inline __m128i
+sse2_mullo_epi32(__m128i a, __m128i b)
+{
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+					  _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+				  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+PCM_TARGET_SSE2
+static inline __m128i
+sse2_select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a),
+			    _mm_andnot_si128(mask, b));
+}
+
+template<int32_t MIN, int32_t MAX>
+PCM_TARGET_SSE2
+static inline __m128i
+sse2_dither(__m128i sample, __m128i &error0, __m128i &error1,
+	    __m128i &error2, __m128i &random)
+{
+	const __m128i min = _mm_set1_epi32(MIN), max = _mm_set1_epi32(MAX);
+	const __m128i mask = _mm_set1_epi32(DITHER_MASK);
+
+	sample = _mm_add_epi32(sample, _mm_add_epi32(_mm_sub_epi32(error0,
+								   error1),
+						     error2));
+
+	error2 = error1;
+	/* signed division by 2, rounding towards zero */
+	error1 = _mm_srai_epi32(_mm_add_epi32(error0,
+					      _mm_srli_epi32(error0, 31)), 1);
+
+	__m128i output = _mm_add_epi32(sample, _mm_set1_epi32(DITHER_ROUND));
+
+	const __m128i rnd = _mm_add_epi32(sse2_mullo_epi32(random,
+							   _mm_set1_epi32(PRNG_MUL)),
+					  _mm_set1_epi32(PRNG_ADD));
+	output = _mm_add_epi32(output,
+			       _mm_sub_epi32(_mm_and_si128(rnd, mask),
+					     _mm_and_si128(random, mask)));
+	random = rnd;
+
+	const __m128i above = _mm_cmpgt_epi32(output, max);
+	const __m128i below = _mm_cmplt_epi32(output, min);
+
+	sample = sse2_select(_mm_and_si128(above,
+					   _mm_cmpgt_epi32(sample, max)),
+			     max, sample);
+	sample = sse2_select(_mm_and_si128(below,
+					   _mm_cmplt_epi32(sample, min)),
+			     min, sample);
+	output = sse2_select(above, max, sse2_select(below, min, output));
+
+	output = _mm_andnot_si128(mask, output);
+
+	error0 = _mm_sub_epi32(sample, output);
+
+	return _mm_srai_epi32(output, SCALE_BITS);
+}
+
+/**
+ * The #PcmDither::Lanes state in SSE2 registers.
+ */
+struct Sse2Dither {
+	__m128i error0[2], error1[2], error2[2], random[2];
+
+	PCM_TARGET_SSE2
+	void Load(const PcmDither::Lanes &lanes) {
+		for (unsigned i = 0; i < 2; ++i) {
+			error0[i] = _mm_loadu_si128((const __m128i *)&lanes.error[0][i * 4]);
+			error1[i] = _mm_loadu_si128((const __m128i *)&lanes.error[1][i * 4]);
+			error2[i] = _mm_loadu_si128((const __m128i *)&lanes.error[2][i * 4]);
+			random[i] = _mm_loadu_si128((const __m128i *)&lanes.random[i * 4]);
+		}
+	}
+
+	PCM_TARGET_SSE2
+	void Save(PcmDither::Lanes &lanes) const {
+		for (unsigned i = 0; i < 2; ++i) {
+			_mm_storeu_si128((__m128i *)&lanes.error[0][i * 4], error0[i]);
+			_mm_storeu_si128((__m128i *)&lanes.error[1][i * 4], error1[i]);
+			_mm_storeu_si128((__m128i *)&lanes.error[2][i * 4], error2[i]);
+			_mm_storeu_si128((__m128i *)&lanes.random[i * 4], random[i]);
+		}
+	}
+
+	/**
+	 * Dither lanes 0..3 (i=0) or 4..7 (i=1).
+	 */
+	template<int32_t MIN, int32_t MAX>
+	PCM_TARGET_SSE2
+	__m128i Dither(__m128i sample, unsigned i) {
+		return sse2_dither<MIN, MAX>(sample, error0[i], error1[i],
+					     error2[i], random[i]);
+	}
+};
+
+struct Sse2S8 {
+	typedef int8_t value_type;
+	typedef DitherRange<SampleFormat::S8> Range;
+
+	PCM_TARGET_SSE2
+	static void Load(const int8_t *src, __m128i &a, __m128i &b) {
+		__m128i v = _mm_loadl_epi64((const __m128i *)src);
+		v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+		a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+	}
+
+	PCM_TARGET_SSE2
+	static void Store(int8_t *dest, __m128i a, __m128i b) {
+		const __m128i v = _mm_packs_epi32(a, b);
+		_mm_storel_epi64((__m128i *)dest, _mm_packs_epi16(v, v));
+	}
+};
+
+struct Sse2S16 {
+	typedef int16_t value_type;
+	typedef DitherRange<SampleFormat::S16> Range;
+
+	PCM_TARGET_SSE2
+	static void Load(const int16_t *src, __m128i &a, __m128i &b) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)src);
+		a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+	}
+
+	PCM_TARGET_SSE2
+	static void Store(int16_t *dest, __m128i a, __m128i b) {
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(a, b));
+	}
+};
+
+/*
+ * AVX2: one register of eight 32 bit lanes (S8, S16) or two
+ * registers of four 64 bit lanes (S24_P32, S32).
+ */
+
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_select(__m256i mask, __m256i a, __m256i b)
+{
+	return _mm256_blendv_epi8(b, a, mask);
+}
+
+/**
+ * Generate the dither noise for all eight lanes and advance the
+ * PRNG.
+ */
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_noise(__m256i &random)
+{
+	const __m256i mask = _mm256_set1_epi32(DITHER_MASK);
+	const __m256i rnd =
+		_mm256_add_epi32(_mm256_mullo_epi32(random,
+						    _mm256_set1_epi32(PRNG_MUL)),
+				 _mm256_set1_epi32(PRNG_ADD));
+	const __m256i noise = _mm256_sub_epi32(_mm256_and_si256(rnd, mask),
+					       _mm256_and_si256(random, mask));
+	random = rnd;
+	return noise;
+}
+
+template<int32_t MIN, int32_t MAX>
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_dither32(__m256i sample, __m256i &error0, __m256i &error1,
+	      __m256i &error2, __m256i &random)
+{
+	const __m256i min = _mm256_set1_epi32(MIN);
+	const __m256i max = _mm256_set1_epi32(MAX);
+
+	sample = _mm256_add_epi32(sample,
+				  _mm256_add_epi32(_mm256_sub_epi32(error0,
+								    error1),
+						   error2));
+
+	error2 = error1;
+	error1 = _mm256_srai_epi32(_mm256_add_epi32(error0,
+						    _mm256_srli_epi32(error0, 31)),
+				   1);
+
+	__m256i output = _mm256_add_epi32(sample,
+					  _mm256_set1_epi32(DITHER_ROUND));
+	output = _mm256_add_epi32(output, avx2_noise(random));
+
+	const __m256i above = _mm256_cmpgt_epi32(output, max);
+	const __m256i below = _mm256_cmpgt_epi32(min, output);
+
+	sample = avx2_select(_mm256_and_si256(above,
+					      _mm256_cmpgt_epi32(sample, max)),
+			     max, sample);
+	sample = avx2_select(_mm256_and_si256(below,
+					      _mm256_cmpgt_epi32(min, sample)),
+			     min, sample);
+	output = avx2_select(above, max, avx2_select(below, min, output));
+
+	output = _mm256_andnot_si256(_mm256_set1_epi32(DITHER_MASK), output);
+
+	error0 = _mm256_sub_epi32(sample, output);
+
+	return _mm256_srai_epi32(output, SCALE_BITS);
+}
+
+/**
+ * The #PcmDither::Lanes state in AVX2 registers, for samples with
+ * 32 bit intermediate values.
+ */
+struct Avx2Dither32 {
+	__m256i error0, error1, error2, random;
+
+	PCM_TARGET_AVX2
+	void Load(const PcmDither::Lanes &lanes) {
+		error0 = _mm256_loadu_si256((const __m256i *)lanes.error[0]);
+		error1 = _mm256_loadu_si256((const __m256i *)lanes.error[1]);
+		error2 = _mm256_loadu_si256((const __m256i *)lanes.error[2]);
+		random = _mm256_loadu_si256((const __m256i *)lanes.random);
+	}
+
+	PCM_TARGET_AVX2
+	void Save(PcmDither::Lanes &lanes) const {
+		_mm256_storeu_si256((__m256i *)lanes.error[0], error0);
+		_mm256_storeu_si256((__m256i *)lanes.error[1], error1);
+		_mm256_storeu_si256((__m256i *)lanes.error[2], error2);
+		_mm256_storeu_si256((__m256i *)lanes.random, random);
+	}
+
+	template<int32_t MIN, int32_t MAX>
+	PCM_TARGET_AVX2
+	__m256i Dither(__m256i sample) {
+		return avx2_dither32<MIN, MAX>(sample, error0, error1,
+					       error2, random);
+	}
+};
+
+struct Avx2S8 {
+	typedef int8_t value_type;
+	typedef DitherRange<SampleFormat::S8> Range;
+
+	PCM_TARGET_AVX2
+	static __m256i Load(const int8_t *src) {
+		return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)src));
+	}
+
+	PCM_TARGET_AVX2
+	static void Store(int8_t *dest, __m256i v) {
+		const __m128i v16 =
+			_mm_packs_epi32(_mm256_castsi256_si128(v),
+					_mm256_extracti128_si256(v, 1));
+		_mm_storel_epi64((__m128i *)dest, _mm_packs_epi16(v16, v16));
+	}
+};
+
+struct Avx2S16 {
+	typedef int16_t value_type;
+	typedef DitherRange<SampleFormat::S16> Range;
+
+	PCM_TARGET_AVX2
+	static __m256i Load(const int16_t *src) {
+		return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+	}
+
+	PCM_TARGET_AVX2
+	static void Store(int16_t *dest, __m256i v) {
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_packs_epi32(_mm256_castsi256_si128(v),
+						 _mm256_extracti128_si256(v, 1)));
+	}
+};
+
+/**
+ * AVX2 has no 64 bit arithmetic shift; emulate it with a logical
+ * shift and sign extension.
+ */
+template<unsigned n>
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_srai_epi64(__m256i v)
+{
+	const __m256i sign = _mm256_set1_epi64x(int64_t(1) << (63 - n));
+	return _mm256_sub_epi64(_mm256_xor_si256(_mm256_srli_epi64(v, n),
+						 sign),
+				sign);
+}
+
+/**
+ * Truncate eight 64 bit integers (in two registers) to 32 bit.
+ */
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_narrow_epi64(__m256i a, __m256i b)
+{
+	const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	a = _mm256_permutevar8x32_epi32(a, even);
+	b = _mm256_permutevar8x32_epi32(b, even);
+	return _mm256_permute2x128_si256(a, b, 0x20);
+}
+
+PCM_TARGET_AVX2
+static inline void
+avx2_widen_epi32(__m256i v, __m256i &a, __m256i &b)
+{
+	a = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v));
+	b = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1));
+}
+
+template<int64_t MIN, int64_t MAX>
+PCM_TARGET_AVX2
+static inline __m256i
+avx2_dither64(__m256i sample, __m256i noise,
+	      __m256i &error0, __m256i &error1, __m256i &error2)
+{
+	const __m256i min = _mm256_set1_epi64x(MIN);
+	const __m256i max = _mm256_set1_epi64x(MAX);
+
+	sample = _mm256_add_epi64(sample,
+				  _mm256_add_epi64(_mm256_sub_epi64(error0,
+								    error1),
+						   error2));
+
+	error2 = error1;
+	error1 = avx2_srai_epi64<1>(_mm256_add_epi64(error0,
+						     _mm256_srli_epi64(error0, 63)));
+
+	__m256i output = _mm256_add_epi64(sample,
+					  _mm256_set1_epi64x(DITHER_ROUND));
+	output = _mm256_add_epi64(output, noise);
+
+	const __m256i above = _mm256_cmpgt_epi64(output, max);
+	const __m256i below = _mm256_cmpgt_epi64(min, output);
+
+	sample = avx2_select(_mm256_and_si256(above,
+					      _mm256_cmpgt_epi64(sample, max)),
+			     max, sample);
+	sample = avx2_select(_mm256_and_si256(below,
+					      _mm256_cmpgt_epi64(min, sample)),
+			     min, sample);
+	output = avx2_select(above, max, avx2_select(below, min, output));
+
+	output = _mm256_andnot_si256(_mm256_set1_epi64x(DITHER_MASK), output);
+
+	error0 = _mm256_sub_epi64(sample, output);
+
+	return avx2_srai_epi64<SCALE_BITS>(output);
+}
+
+/**
+ * The #PcmDither::Lanes state in AVX2 registers, for samples with
+ * 64 bit intermediate values (lanes 0..3 in the first register,
+ * lanes 4..7 in the second one).
+ */
+struct Avx2Dither64 {
+	__m256i error0[2], error1[2], error2[2], random;
+
+	PCM_TARGET_AVX2
+	void Load(const PcmDither::Lanes &lanes) {
+		/* the error values are small enough to be stored in
+		   32 bit */
+		avx2_widen_epi32(_mm256_loadu_si256((const __m256i *)lanes.error[0]),
+				 error0[0], error0[1]);
+		avx2_widen_epi32(_mm256_loadu_si256((const __m256i *)lanes.error[1]),
+				 error1[0], error1[1]);
+		avx2_widen_epi32(_mm256_loadu_si256((const __m256i *)lanes.error[2]),
+				 error2[0], error2[1]);
+		random = _mm256_loadu_si256((const __m256i *)lanes.random);
+	}
+
+	PCM_TARGET_AVX2
+	void Save(PcmDither::Lanes &lanes) const {
+		_mm256_storeu_si256((__m256i *)lanes.error[0],
+				    avx2_narrow_epi64(error0[0], error0[1]));
+		_mm256_storeu_si256((__m256i *)lanes.error[1],
+				    avx2_narrow_epi64(error1[0], error1[1]));
+		_mm256_storeu_si256((__m256i *)lanes.error[2],
+				    avx2_narrow_epi64(error2[0], error2[1]));
+		_mm256_storeu_si256((__m256i *)lanes.random, random);
+	}
+
+	/**
+	 * @return the eight dithered samples, truncated to 32 bit
+	 */
+	template<int64_t MIN, int64_t MAX>
+	PCM_TARGET_AVX2
+	__m256i Dither(__m256i a, __m256i b) {
+		__m256i noise[2];
+		avx2_widen_epi32(avx2_noise(random), noise[0], noise[1]);
+
+		a = avx2_dither64<MIN, MAX>(a, noise[0],
+					    error0[0], error1[0], error2[0]);
+		b = avx2_dither64<MIN, MAX>(b, noise[1],
+					    error0[1], error1[1], error2[1]);
+		return avx2_narrow_epi64(a, b);
+	}
+};
+
+#endif /* PCM_SIMD_X86 */
+
+#ifdef PCM_SIMD_NEON
+
+/*
+ * NEON: two registers of four 32 bit lanes; used for S8 and S16.
+ */
+
+template<int32_t MIN, int32_t MAX>
+static inline int32x4_t
+neon_dither(int32x4_t sample, int32x4_t &error0, int32x4_t &error1,
+	    int32x4_t &error2, int32x4_t &random)
+{
+	const int32x4_t min = vdupq_n_s32(MIN), max = vdupq_n_s32(MAX);
+	const int32x4_t mask = vdupq_n_s32(DITHER_MASK);
+
+	sample = vaddq_s32(sample, vaddq_s32(vsubq_s32(error0, error1),
+					     error2));
+
+	error2 = error1;
+	error1 = vshrq_n_s32(vaddq_s32(error0,
+				       vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(error0),
+									 31))),
+			     1);
+
+	int32x4_t output = vaddq_s32(sample, vdupq_n_s32(DITHER_ROUND));
+
+	const int32x4_t rnd = vmlaq_s32(vdupq_n_s32(PRNG_ADD), random,
+					vdupq_n_s32(PRNG_MUL));
+	output = vaddq_s32(output, vsubq_s32(vandq_s32(rnd, mask),
+					     vandq_s32(random, mask)));
+	random = rnd;
+
+	const uint32x4_t above = vcgtq_s32(output, max);
+	const uint32x4_t below = vcltq_s32(output, min);
+
+	sample = vbslq_s32(vandq_u32(above, vcgtq_s32(sample, max)),
+			   max, sample);
+	sample = vbslq_s32(vandq_u32(below, vcltq_s32(sample, min)),
+			   min, sample);
+	output = vbslq_s32(above, max, vbslq_s32(below, min, output));
+
+	output = vbicq_s32(output, mask);
+
+	error0 = vsubq_s32(sample, output);
+
+	return vshrq_n_s32(output, SCALE_BITS);
+}
+
+/**
+ * The #PcmDither::Lanes state in NEON registers.
+ */
+struct NeonDither {
+	int32x4_t error0[2], error1[2], error2[2], random[2];
+
+	void Load(const PcmDither::Lanes &lanes) {
+		for (unsigned i = 0; i < 2; ++i) {
+			error0[i] = vld1q_s32(&lanes.error[0][i * 4]);
+			error1[i] = vld1q_s32(&lanes.error[1][i * 4]);
+			error2[i] = vld1q_s32(&lanes.error[2][i * 4]);
+			random[i] = vld1q_s32(&lanes.random[i * 4]);
+		}
+	}
+
+	void Save(PcmDither::Lanes &lanes) const {
+		for (unsigned i = 0; i < 2; ++i) {
+			vst1q_s32(&lanes.error[0][i * 4], error0[i]);
+			vst1q_s32(&lanes.error[1][i * 4], error1[i]);
+			vst1q_s32(&lanes.error[2][i * 4], error2[i]);
+			vst1q_s32(&lanes.random[i * 4], random[i]);
+		}
+	}
+
+	/**
+	 * Dither lanes 0..3 (i=0) or 4..7 (i=1).
+	 */
+	template<int32_t MIN, int32_t MAX>
+	int32x4_t Dither(int32x4_t sample, unsigned i) {
+		return neon_dither<MIN, MAX>(sample, error0[i], error1[i],
+					     error2[i], random[i]);
+	}
+};
+
+struct NeonS8 {
+	typedef int8_t value_type;
+	typedef DitherRange<SampleFormat::S8> Range;
+
+	static void Load(const int8_t *src, int32x4_t &a, int32x4_t &b) {
+		const int16x8_t v = vmovl_s8(vld1_s8(src));
+		a = vmovl_s16(vget_low_s16(v));
+		b = vmovl_s16(vget_high_s16(v));
+	}
+
+	static void Store(int8_t *dest, int32x4_t a, int32x4_t b) {
+		vst1_s8(dest, vqmovn_s16(vcombine_s16(vqmovn_s32(a),
+						      vqmovn_s32(b))));
+	}
+};
+
+struct NeonS16 {
+	typedef int16_t value_type;
+	typedef DitherRange<SampleFormat::S16> Range;
+
+	static void Load(const int16_t *src, int32x4_t &a, int32x4_t &b) {
+		a = vmovl_s16(vld1_s16(src));
+		b = vmovl_s16(vld1_s16(src + 4));
+	}
+
+	static void Store(int16_t *dest, int32x4_t a, int32x4_t b) {
+		vst1q_s16(dest, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+};
+
+#endif /* PCM_SIMD_NEON */
+
+#endif
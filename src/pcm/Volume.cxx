@@ -19,6 +19,8 @@
 
 #include "config.h"
 #include "Volume.hxx"
+#include "VolumeSimd.hxx"
+#include "DitherLanes.hxx"
 #include "Silence.hxx"
 #include "Traits.hxx"
 #include "util/ConstBuffer.hxx"
@@ -27,6 +29,8 @@
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#include <algorithm>
+
 #include <stdint.h>
 #include <string.h>
 
@@ -43,15 +47,77 @@ pcm_volume_sample(PcmDither &dither,
 				  Traits::BITS>(sample * volume);
 }
 
+/**
+ * Apply the volume to whole blocks of #PcmDither::LANES samples
+ * (i.e. one sample of each run in a tile, see DitherLanes.hxx),
+ * using the block variant of PcmDither::DitherShift().  This is the
+ * portable equivalent of the kernels in VolumeSimd.cxx.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static size_t
+pcm_volume_change_blocks(PcmDither &dither,
+			 typename Traits::pointer_type dest,
+			 typename Traits::const_pointer_type src,
+			 size_t n,
+			 int volume)
+{
+	constexpr unsigned LANES = PcmDither::LANES;
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		typename Traits::long_type block[LANES];
+		for (unsigned i = 0; i < LANES; ++i)
+			block[i] = typename Traits::long_type(src[done + i]) * volume;
+
+		dither.DitherShift<typename Traits::long_type,
+				   Traits::BITS + PCM_VOLUME_BITS,
+				   Traits::BITS>(block);
+
+		for (unsigned i = 0; i < LANES; ++i)
+			dest[done + i] = block[i];
+	}
+
+	return done;
+}
+
+/**
+ * Apply the volume to the runs of the buffer (see DitherLanes.hxx)
+ * tile by tile, with the given vectorized kernel if possible, and to
+ * the remaining samples one by one.
+ */
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
 pcm_volume_change(PcmDither &dither,
 		  typename Traits::pointer_type dest,
 		  typename Traits::const_pointer_type src,
 		  size_t n,
-		  int volume)
+		  int volume,
+		  size_t (*simd)(PcmDither::Lanes &lanes,
+				 typename Traits::pointer_type dest,
+				 typename Traits::const_pointer_type src,
+				 size_t n, int volume))
 {
-	for (size_t i = 0; i != n; ++i)
+	constexpr unsigned LANES = PcmDither::LANES;
+
+	const size_t run = DitherLanesRunLength(n);
+
+	typename Traits::value_type tile[DITHER_LANES_TILE * LANES];
+	for (size_t k = 0; k < run; k += DITHER_LANES_TILE) {
+		const size_t count = std::min(run - k, DITHER_LANES_TILE);
+		const size_t tile_n = count * LANES;
+
+		DitherLanesGather(tile, src + k, run, count);
+
+		const size_t done = simd(dither.GetLanes(),
+					 tile, tile, tile_n, volume);
+		pcm_volume_change_blocks<F, Traits>(dither, tile + done,
+						    tile + done,
+						    tile_n - done, volume);
+
+		DitherLanesScatter(dest + k, tile, run, count);
+	}
+
+	for (size_t i = run * LANES; i != n; ++i)
 		dest[i] = pcm_volume_sample<F, Traits>(dither, src[i], volume);
 }
 
@@ -60,7 +126,8 @@ pcm_volume_change_8(PcmDither &dither,
 		    int8_t *dest, const int8_t *src, size_t n,
 		    int volume)
 {
-	pcm_volume_change<SampleFormat::S8>(dither, dest, src, n, volume);
+	pcm_volume_change<SampleFormat::S8>(dither, dest, src, n, volume,
+					    PcmVolumeChangeSimd8);
 }
 
 static void
@@ -68,7 +135,8 @@ pcm_volume_change_16(PcmDither &dither,
 		     int16_t *dest, const int16_t *src, size_t n,
 		     int volume)
 {
-	pcm_volume_change<SampleFormat::S16>(dither, dest, src, n, volume);
+	pcm_volume_change<SampleFormat::S16>(dither, dest, src, n, volume,
+					     PcmVolumeChangeSimd16);
 }
 
 static void
@@ -77,7 +145,8 @@ pcm_volume_change_24(PcmDither &dither,
 		     int volume)
 {
 	pcm_volume_change<SampleFormat::S24_P32>(dither, dest, src, n,
-						 volume);
+						 volume,
+						 PcmVolumeChangeSimd24);
 }
 
 static void
@@ -85,19 +154,21 @@ pcm_volume_change_32(PcmDither &dither,
 		     int32_t *dest, const int32_t *src, size_t n,
 		     int volume)
 {
-	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume);
+	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume,
+					     PcmVolumeChangeSimd32);
 }
 
 static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume)
 {
-	for (size_t i = 0; i != n; ++i)
+	for (size_t i = PcmVolumeChangeSimdFloat(dest, src, n, volume);
+	     i != n; ++i)
 		dest[i] = src[i] * volume;
 }
 
 void
-PcmVolume::Open(SampleFormat _format)
+PcmVolume::Open(SampleFormat _format, unsigned _channels)
 {
 	assert(format == SampleFormat::UNDEFINED);
 
@@ -114,22 +185,32 @@ PcmVolume::Open(SampleFormat _format)
 		break;
 
 	case SampleFormat::DSD:
-		// TODO: implement this; currently, it's a no-op
+		dsd.Reset();
 		break;
 	}
 
 	format = _format;
+	channels = _channels;
 }
 
 ConstBuffer<void>
 PcmVolume::Apply(ConstBuffer<void> src)
 {
+	if (volume >= PCM_VOLUME_1 && format == SampleFormat::DSD) {
+		/* a one-bit signal cannot be amplified */
+		dsd.Reset();
+		return src;
+	}
+
 	if (volume == PCM_VOLUME_1)
 		return src;
 
 	void *data = buffer.Get(src.size);
 
 	if (volume == 0) {
+		if (format == SampleFormat::DSD)
+			dsd.Reset();
+
 		/* optimized special case: 0% volume = memset(0) */
 		PcmSilence({data, src.size}, format);
 		return { data, src.size };
@@ -176,8 +257,12 @@ PcmVolume::Apply(ConstBuffer<void> src)
 		break;
 
 	case SampleFormat::DSD:
-		// TODO: implement this; currently, it's a no-op
-		return src;
+		assert(src.size % channels == 0);
+
+		dsd.Apply((uint8_t *)data, (const uint8_t *)src.data,
+			  src.size / channels, channels,
+			  pcm_volume_to_float(volume));
+		break;
 	}
 
 	return { data, src.size };
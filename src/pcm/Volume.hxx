@@ -23,6 +23,7 @@
 #include "AudioFormat.hxx"
 #include "PcmBuffer.hxx"
 #include "PcmDither.hxx"
+#include "DsdVolume.hxx"
 
 #ifndef NDEBUG
 #include <assert.h>
@@ -63,11 +64,15 @@ pcm_volume_to_float(int volume)
 class PcmVolume {
 	SampleFormat format;
 
+	unsigned channels;
+
 	unsigned volume;
 
 	PcmBuffer buffer;
 	PcmDither dither;
 
+	DsdVolume dsd;
+
 public:
 	PcmVolume()
 		:volume(PCM_VOLUME_1) {
@@ -95,8 +100,10 @@ public:
 	 * Throws std::runtime_error on error.
 	 *
 	 * @param format the sample format
+	 * @param channels the number of channels (only needed for
+	 * DSD, which is processed per channel)
 	 */
-	void Open(SampleFormat format);
+	void Open(SampleFormat format, unsigned channels);
 
 	/**
 	 * Closes the object.  After that, you may call Open() again.
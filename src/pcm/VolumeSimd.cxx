@@ -0,0 +1,272 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "VolumeSimd.hxx"
+#include "Simd.hxx"
+
+#ifdef PCM_SIMD_X86
+
+template<class K>
+PCM_TARGET_SSE2
+static size_t
+sse2_volume_change(PcmDither::Lanes &lanes,
+		   typename K::value_type *dest,
+		   const typename K::value_type *src, size_t n,
+		   int volume)
+{
+	typedef typename K::Range R;
+
+	Sse2Dither dither;
+	dither.Load(lanes);
+
+	const __m128i v = _mm_set1_epi32(volume);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		__m128i s[2];
+		K::Load(src + done, s[0], s[1]);
+
+		for (unsigned i = 0; i < 2; ++i)
+			s[i] = dither.Dither<R::MIN, R::MAX>(sse2_mullo_epi32(s[i], v),
+							     i);
+
+		K::Store(dest + done, s[0], s[1]);
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+PCM_TARGET_SSE2
+static size_t
+sse_volume_change_float(float *dest, const float *src, size_t n,
+			float volume)
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		_mm_storeu_ps(dest + done,
+			      _mm_mul_ps(_mm_loadu_ps(src + done), v));
+		_mm_storeu_ps(dest + done + 4,
+			      _mm_mul_ps(_mm_loadu_ps(src + done + 4), v));
+	}
+
+	return done;
+}
+
+template<class K>
+PCM_TARGET_AVX2
+static size_t
+avx2_volume_change32(PcmDither::Lanes &lanes,
+		     typename K::value_type *dest,
+		     const typename K::value_type *src, size_t n,
+		     int volume)
+{
+	typedef typename K::Range R;
+
+	Avx2Dither32 dither;
+	dither.Load(lanes);
+
+	const __m256i v = _mm256_set1_epi32(volume);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		const __m256i s = _mm256_mullo_epi32(K::Load(src + done), v);
+		K::Store(dest + done, dither.Dither<R::MIN, R::MAX>(s));
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+template<SampleFormat F>
+PCM_TARGET_AVX2
+static size_t
+avx2_volume_change64(PcmDither::Lanes &lanes,
+		     int32_t *dest, const int32_t *src, size_t n,
+		     int volume)
+{
+	typedef DitherRange<F> R;
+
+	Avx2Dither64 dither;
+	dither.Load(lanes);
+
+	const __m256i v = _mm256_set1_epi64x(volume);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		__m256i s[2];
+		avx2_widen_epi32(_mm256_loadu_si256((const __m256i *)(src + done)),
+				 s[0], s[1]);
+
+		_mm256_storeu_si256((__m256i *)(dest + done),
+				    dither.Dither<R::MIN, R::MAX>(_mm256_mul_epi32(s[0], v),
+								  _mm256_mul_epi32(s[1], v)));
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+PCM_TARGET_AVX2
+static size_t
+avx_volume_change_float(float *dest, const float *src, size_t n,
+			float volume)
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES)
+		_mm256_storeu_ps(dest + done,
+				 _mm256_mul_ps(_mm256_loadu_ps(src + done), v));
+
+	return done;
+}
+
+#endif /* PCM_SIMD_X86 */
+
+#ifdef PCM_SIMD_NEON
+
+template<class K>
+static size_t
+neon_volume_change(PcmDither::Lanes &lanes,
+		   typename K::value_type *dest,
+		   const typename K::value_type *src, size_t n,
+		   int volume)
+{
+	typedef typename K::Range R;
+
+	NeonDither dither;
+	dither.Load(lanes);
+
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		int32x4_t s[2];
+		K::Load(src + done, s[0], s[1]);
+
+		for (unsigned i = 0; i < 2; ++i)
+			s[i] = dither.Dither<R::MIN, R::MAX>(vmulq_n_s32(s[i], volume),
+							     i);
+
+		K::Store(dest + done, s[0], s[1]);
+	}
+
+	dither.Save(lanes);
+	return done;
+}
+
+static size_t
+neon_volume_change_float(float *dest, const float *src, size_t n,
+			 float volume)
+{
+	size_t done = 0;
+	for (; done + LANES <= n; done += LANES) {
+		vst1q_f32(dest + done,
+			  vmulq_n_f32(vld1q_f32(src + done), volume));
+		vst1q_f32(dest + done + 4,
+			  vmulq_n_f32(vld1q_f32(src + done + 4), volume));
+	}
+
+	return done;
+}
+
+#endif /* PCM_SIMD_NEON */
+
+size_t
+PcmVolumeChangeSimd8(gcc_unused PcmDither::Lanes &lanes,
+		     gcc_unused int8_t *dest, gcc_unused const int8_t *src,
+		     gcc_unused size_t n, gcc_unused int volume)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_volume_change32<Avx2S8>(lanes, dest, src, n,
+						    volume);
+	if (CpuHasSse2())
+		return sse2_volume_change<Sse2S8>(lanes, dest, src, n,
+						  volume);
+#elif defined(PCM_SIMD_NEON)
+	return neon_volume_change<NeonS8>(lanes, dest, src, n, volume);
+#endif
+	return 0;
+}
+
+size_t
+PcmVolumeChangeSimd16(gcc_unused PcmDither::Lanes &lanes,
+		      gcc_unused int16_t *dest, gcc_unused const int16_t *src,
+		      gcc_unused size_t n, gcc_unused int volume)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_volume_change32<Avx2S16>(lanes, dest, src, n,
+						     volume);
+	if (CpuHasSse2())
+		return sse2_volume_change<Sse2S16>(lanes, dest, src, n,
+						   volume);
+#elif defined(PCM_SIMD_NEON)
+	return neon_volume_change<NeonS16>(lanes, dest, src, n, volume);
+#endif
+	return 0;
+}
+
+size_t
+PcmVolumeChangeSimd24(gcc_unused PcmDither::Lanes &lanes,
+		      gcc_unused int32_t *dest, gcc_unused const int32_t *src,
+		      gcc_unused size_t n, gcc_unused int volume)
+{
+	/* 64 bit lanes are only implemented for AVX2; SSE2 lacks
+	   64 bit comparisons */
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_volume_change64<SampleFormat::S24_P32>(lanes, dest,
+								   src, n,
+								   volume);
+#endif
+	return 0;
+}
+
+size_t
+PcmVolumeChangeSimd32(gcc_unused PcmDither::Lanes &lanes,
+		      gcc_unused int32_t *dest, gcc_unused const int32_t *src,
+		      gcc_unused size_t n, gcc_unused int volume)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx2_volume_change64<SampleFormat::S32>(lanes, dest,
+							       src, n, volume);
+#endif
+	return 0;
+}
+
+size_t
+PcmVolumeChangeSimdFloat(gcc_unused float *dest,
+			 gcc_unused const float *src,
+			 gcc_unused size_t n, gcc_unused float volume)
+{
+#ifdef PCM_SIMD_X86
+	if (CpuHasAvx2())
+		return avx_volume_change_float(dest, src, n, volume);
+	if (CpuHasSse2())
+		return sse_volume_change_float(dest, src, n, volume);
+#elif defined(PCM_SIMD_NEON)
+	return neon_volume_change_float(dest, src, n, volume);
+#endif
+	return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_VOLUME_SIMD_HXX
+#define MPD_PCM_VOLUME_SIMD_HXX
+
+#include "PcmDither.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorized software volume kernels, selected at run time according
+ * to the CPU's capabilities.
+ *
+ * Each function processes as many leading samples as it can in whole
+ * blocks of #PcmDither::LANES samples and returns the number of
+ * samples it has written; the caller is responsible for the rest.
+ * The integer kernels produce exactly the same output as the block
+ * variant of PcmDither::DitherShift().  If no suitable instruction
+ * set is available, they return 0.
+ */
+
+size_t
+PcmVolumeChangeSimd8(PcmDither::Lanes &lanes,
+		     int8_t *dest, const int8_t *src, size_t n,
+		     int volume);
+
+size_t
+PcmVolumeChangeSimd16(PcmDither::Lanes &lanes,
+		      int16_t *dest, const int16_t *src, size_t n,
+		      int volume);
+
+size_t
+PcmVolumeChangeSimd24(PcmDither::Lanes &lanes,
+		      int32_t *dest, const int32_t *src, size_t n,
+		      int volume);
+
+size_t
+PcmVolumeChangeSimd32(PcmDither::Lanes &lanes,
+		      int32_t *dest, const int32_t *src, size_t n,
+		      int volume);
+
+size_t
+PcmVolumeChangeSimdFloat(float *dest, const float *src, size_t n,
+			 float volume);
+
+#endif
@@ -44,6 +44,10 @@ or implied, of Sebastian Gesemann.
 #error "FIFOSIZE too small"
 #endif
 
+#if CTABLES != DSD2PCM_CTABLES
+#error "DSD2PCM_CTABLES is wrong"
+#endif
+
 /*
  * Properties of this 96-tap lowpass filter when applied on a signal
  * with sampling rate of 44100*64 Hz:
@@ -180,6 +184,12 @@ extern void dsd2pcm_reset(dsd2pcm_ctx* ptr)
 	 */
 }
 
+extern const float *dsd2pcm_get_ctables(void)
+{
+	if (!precalculated) precalc();
+	return ctables[0];
+}
+
 extern void dsd2pcm_translate(
 	dsd2pcm_ctx* ptr,
 	size_t samples,
@@ -86,6 +86,22 @@ extern void dsd2pcm_translate(dsd2pcm_ctx *ctx,
 	int lsbitfirst,
 	float *dst, ptrdiff_t dst_stride);
 
+/**
+ * the number of lookup tables returned by dsd2pcm_get_ctables()
+ */
+#define DSD2PCM_CTABLES 6
+
+/**
+ * returns the lookup tables used by dsd2pcm_translate():
+ * DSD2PCM_CTABLES tables of 256 floats each; table i maps the
+ * octet of age i and the bit-reversed octet of age
+ * 2*DSD2PCM_CTABLES-1-i to their contribution to the output
+ *
+ * Like dsd2pcm_init(), this is not thread-safe when called for the
+ * first time.
+ */
+extern const float *dsd2pcm_get_ctables(void);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
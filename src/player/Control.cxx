@@ -29,12 +29,18 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
+			     size_t _chunk_size,
 			     unsigned _buffered_before_play,
+			     unsigned _lookahead,
+			     unsigned _history_chunks,
 			     AudioFormat _configured_audio_format,
 			     const ReplayGainConfig &_replay_gain_config)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 chunk_size(_chunk_size),
 	 buffered_before_play(_buffered_before_play),
+	 lookahead(_lookahead),
+	 history_chunks(_history_chunks),
 	 configured_audio_format(_configured_audio_format),
 	 replay_gain_config(_replay_gain_config)
 {
@@ -240,6 +246,15 @@ PlayerControl::LockSeek(DetachedSong *song, SongTime t)
 	idle_add(IDLE_PLAYER);
 }
 
+void
+PlayerControl::LockSetLookahead(std::vector<DetachedSong> &&songs)
+{
+	const ScopeLock protect(mutex);
+	lookahead_songs = std::move(songs);
+	lookahead_modified = true;
+	Signal();
+}
+
 void
 PlayerControl::SetCrossFade(float _cross_fade_seconds)
 {
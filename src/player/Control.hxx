@@ -28,14 +28,16 @@
 #include "Chrono.hxx"
 #include "ReplayGainConfig.hxx"
 #include "ReplayGainMode.hxx"
+#include "DetachedSong.hxx"
 
 #include <exception>
+#include <vector>
 
+#include <stddef.h>
 #include <stdint.h>
 
 class PlayerListener;
 class MultipleOutputs;
-class DetachedSong;
 
 enum class PlayerState : uint8_t {
 	STOP,
@@ -103,8 +105,27 @@ struct PlayerControl {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The size of each #MusicChunk in bytes.
+	 */
+	const size_t chunk_size;
+
 	const unsigned buffered_before_play;
 
+	/**
+	 * The number of upcoming songs which the player thread
+	 * decodes in advance (the "decoder_lookahead" setting).  0
+	 * disables this feature.
+	 */
+	const unsigned lookahead;
+
+	/**
+	 * The number of played chunks which the player thread keeps
+	 * for serving seeks without the decoder (the
+	 * "seek_history_size" setting).  0 disables the history.
+	 */
+	const unsigned history_chunks;
+
 	/**
 	 * The "audio_output_format" setting.
 	 */
@@ -172,6 +193,25 @@ struct PlayerControl {
 
 	SongTime seek_time;
 
+	/**
+	 * The songs which will be played after the current one, in
+	 * playback order (at most #lookahead items).  The player
+	 * thread opens them and decodes their beginning in advance,
+	 * so a skip to one of them can start playback immediately.
+	 *
+	 * Protected by #mutex.  Set by the main thread with
+	 * LockSetLookahead().
+	 */
+	std::vector<DetachedSong> lookahead_songs;
+
+	/**
+	 * Has #lookahead_songs been modified since the player thread
+	 * has last looked at it?
+	 *
+	 * Protected by #mutex.
+	 */
+	bool lookahead_modified = false;
+
 	CrossFadeSettings cross_fade;
 
 	const ReplayGainConfig replay_gain_config;
@@ -191,7 +231,10 @@ struct PlayerControl {
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
+		      size_t chunk_size,
 		      unsigned buffered_before_play,
+		      unsigned lookahead,
+		      unsigned history_chunks,
 		      AudioFormat _configured_audio_format,
 		      const ReplayGainConfig &_replay_gain_config);
 	~PlayerControl();
@@ -457,6 +500,11 @@ public:
 	 */
 	void LockSeek(DetachedSong *song, SongTime t);
 
+	/**
+	 * Replace #lookahead_songs and wake up the player thread.
+	 */
+	void LockSetLookahead(std::vector<DetachedSong> &&songs);
+
 	void SetCrossFade(float cross_fade_seconds);
 
 	float GetCrossFade() const {
@@ -37,6 +37,9 @@
 #include "Log.hxx"
 
 #include <stdexcept>
+#include <algorithm>
+#include <list>
+#include <vector>
 
 #include <string.h>
 
@@ -45,12 +48,41 @@ static constexpr Domain player_domain("player");
 class Player {
 	PlayerControl &pc;
 
-	DecoderControl &dc;
+	/**
+	 * The decoder which works on the current song (or on the next
+	 * one, see IsDecoderAtNextSong()).  It may be exchanged with
+	 * an item of #lookahead.
+	 */
+	DecoderControl *dc;
+
+	/**
+	 * Decoders which work on upcoming songs (see
+	 * PlayerControl::lookahead_songs).  An item whose
+	 * DecoderControl::pipe is nullptr is unused.  An item is
+	 * exchanged with #dc when the player switches to a song which
+	 * has been decoded in advance.
+	 */
+	std::vector<DecoderControl *> lookahead;
 
 	MusicBuffer &buffer;
 
 	MusicPipe *pipe;
 
+	/**
+	 * Chunks of the current song which have already been sent to
+	 * the audio outputs (or skipped by a seek), oldest first.
+	 * They are filled by MultipleOutputs (see
+	 * MultipleOutputs::SetHistory()), and allow SeekBuffered() to
+	 * serve short backwards seeks without restarting the decoder.
+	 */
+	MusicPipe history;
+
+	/**
+	 * Chunks which shall be played before the ones in #pipe.
+	 * SeekBuffered() moves chunks from #history here.
+	 */
+	MusicPipe replay;
+
 	/**
 	 * are we waiting for buffered_before_play?
 	 */
@@ -148,8 +180,9 @@ class Player {
 
 public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
+	       std::list<DecoderControl> &_lookahead,
 	       MusicBuffer &_buffer)
-		:pc(_pc), dc(_dc), buffer(_buffer),
+		:pc(_pc), dc(&_dc), buffer(_buffer),
 		 buffering(true),
 		 decoder_starting(false),
 		 decoder_woken(false),
@@ -160,7 +193,10 @@ public:
 		 xfade_state(CrossFadeState::UNKNOWN),
 		 cross_fade_chunks(0),
 		 cross_fade_tag(nullptr),
-		 elapsed_time(SongTime::zero()) {}
+		 elapsed_time(SongTime::zero()) {
+		for (auto &i : _lookahead)
+			lookahead.push_back(&i);
+	}
 
 private:
 	/**
@@ -188,6 +224,61 @@ private:
 		pipe = _pipe;
 	}
 
+	/**
+	 * Let the audio outputs collect played chunks in #history.
+	 * This is only useful while the decoder works on the current
+	 * song; as soon as it starts decoding the next one, call
+	 * DisableHistory(), because the chunks are needed for that.
+	 *
+	 * Player lock is not held.
+	 */
+	void EnableHistory() {
+		if (GetMaxHistory() > 0)
+			pc.outputs.SetHistory(&history, GetMaxHistory());
+	}
+
+	/**
+	 * The maximum number of chunks in #history.  These are taken
+	 * away from the decoder, therefore this is configurable and
+	 * disabled by default.
+	 */
+	gcc_pure
+	unsigned GetMaxHistory() const {
+		return pc.history_chunks;
+	}
+
+	/**
+	 * Player lock is not held.
+	 */
+	void DisableHistory() {
+		pc.outputs.SetHistory(nullptr);
+		history.Clear(buffer);
+	}
+
+	/**
+	 * Return all chunks of #history and #replay to the buffer.
+	 */
+	void ClearHistory() {
+		history.Clear(buffer);
+		replay.Clear(buffer);
+	}
+
+	gcc_pure
+	bool IsPipeEmpty() const {
+		return replay.IsEmpty() && pipe->IsEmpty();
+	}
+
+	/**
+	 * Shift the next chunk to be played, first from #replay,
+	 * then from #pipe.
+	 */
+	MusicChunk *ShiftChunk() {
+		MusicChunk *chunk = replay.Shift();
+		if (chunk == nullptr)
+			chunk = pipe->Shift();
+		return chunk;
+	}
+
 	/**
 	 * Start the decoder.
 	 *
@@ -228,6 +319,15 @@ private:
 		return true;
 	}
 
+	/**
+	 * Start decoding PlayerControl::next_song after the decoder
+	 * has finished the current song.  If the song has already
+	 * been decoded in advance, that decoder is adopted.
+	 *
+	 * Player lock is not held.
+	 */
+	void StartNextDecoder();
+
 	/**
 	 * Stop the decoder and clears (and frees) its music pipe.
 	 *
@@ -235,6 +335,68 @@ private:
 	 */
 	void StopDecoder();
 
+	/**
+	 * The decoder works on a "next" song which is being
+	 * cancelled.  Instead of stopping it, move it to an unused
+	 * #lookahead item, because the song may still be played
+	 * soon.
+	 *
+	 * Player lock is not held.
+	 *
+	 * @return false if that was not possible (and nothing has
+	 * been modified)
+	 */
+	bool DemoteDecoder();
+
+	/**
+	 * Find the #lookahead item which decodes the specified song.
+	 */
+	gcc_pure
+	DecoderControl **FindLookahead(const DetachedSong &_song);
+
+	/**
+	 * Find an unused #lookahead item.
+	 */
+	gcc_pure
+	DecoderControl **FindIdleLookahead();
+
+	/**
+	 * The number of chunks held by all #lookahead pipes.
+	 */
+	gcc_pure
+	unsigned GetLookaheadSize() const;
+
+	/**
+	 * Player lock is not held.
+	 */
+	void StartLookahead(DecoderControl &l, const DetachedSong &_song);
+
+	/**
+	 * Stop the #lookahead decoder and free its pipe.
+	 *
+	 * Player lock is not held.
+	 */
+	void StopLookahead(DecoderControl &l);
+
+	/**
+	 * Start and stop #lookahead decoders according to the new
+	 * PlayerControl::lookahead_songs.
+	 *
+	 * Player lock is not held.
+	 */
+	void UpdateLookahead(const std::vector<DetachedSong> &songs);
+
+	/**
+	 * If the specified song has been decoded in advance, make
+	 * that #lookahead decoder the new #dc.  The current #dc must
+	 * be idle and must not own a pipe.
+	 *
+	 * Player lock is not held.
+	 *
+	 * @return true if a #lookahead decoder has been adopted
+	 */
+	bool AdoptLookahead(const DetachedSong &_song);
+
 	/**
 	 * Is the decoder still busy on the same song as the player?
 	 *
@@ -245,7 +407,7 @@ private:
 	bool IsDecoderAtCurrentSong() const {
 		assert(pipe != nullptr);
 
-		return dc.pipe == pipe;
+		return dc->pipe == pipe;
 	}
 
 	/**
@@ -255,7 +417,7 @@ private:
 	 */
 	gcc_pure
 	bool IsDecoderAtNextSong() const {
-		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
+		return dc->pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
 	/**
@@ -265,6 +427,25 @@ private:
 	 */
 	bool SeekDecoder();
 
+	/**
+	 * Attempt to serve a seek from chunks which have already
+	 * been decoded, i.e. from #history, #replay and #pipe,
+	 * without touching the decoder.  The audio outputs must have
+	 * been cancelled already.
+	 *
+	 * The player lock is not held.
+	 *
+	 * @return true on success, false if the position is not
+	 * buffered (nothing has been modified then)
+	 */
+	bool SeekBuffered(SongTime where);
+
+	/**
+	 * Move the first chunks of the specified pipe to #history,
+	 * because a seek skips them.
+	 */
+	void SkipChunks(MusicPipe &src, unsigned n=~0u);
+
 	/**
 	 * Check if the decoder has reported an error, and forward it
 	 * to PlayerControl::SetError().
@@ -345,30 +526,44 @@ Player::StartDecoder(MusicPipe &_pipe)
 	{
 		/* copy ReplayGain parameters to the decoder */
 		const ScopeLock protect(pc.mutex);
-		dc.replay_gain_mode = pc.replay_gain_mode;
+		dc->replay_gain_mode = pc.replay_gain_mode;
 	}
 
 	SongTime start_time = pc.next_song->GetStartTime() + pc.seek_time;
 
-	dc.Start(new DetachedSong(*pc.next_song),
+	dc->Start(new DetachedSong(*pc.next_song),
 		 start_time, pc.next_song->GetEndTime(),
 		 buffer, _pipe);
 }
 
+void
+Player::StartNextDecoder()
+{
+	assert(queued);
+	assert(pc.next_song != nullptr);
+
+	/* the decoder has finished the current song (or has been
+	   stopped); the player keeps its pipe */
+	dc->pipe = nullptr;
+
+	if (!AdoptLookahead(*pc.next_song))
+		StartDecoder(*new MusicPipe());
+}
+
 void
 Player::StopDecoder()
 {
-	dc.Stop();
+	dc->Stop();
 
-	if (dc.pipe != nullptr) {
+	if (dc->pipe != nullptr) {
 		/* clear and free the decoder pipe */
 
-		dc.pipe->Clear(buffer);
+		dc->pipe->Clear(buffer);
 
-		if (dc.pipe != pipe)
-			delete dc.pipe;
+		if (dc->pipe != pipe)
+			delete dc->pipe;
 
-		dc.pipe = nullptr;
+		dc->pipe = nullptr;
 
 		/* just in case we've been cross-fading: cancel it
 		   now, because we just deleted the new song's decoder
@@ -377,11 +572,169 @@ Player::StopDecoder()
 	}
 }
 
+bool
+Player::DemoteDecoder()
+{
+	assert(IsDecoderAtNextSong());
+
+	if (xfade_state == CrossFadeState::ACTIVE)
+		/* cross-fading has already consumed the beginning of
+		   the next song */
+		return false;
+
+	DecoderControl **l = FindIdleLookahead();
+	if (l == nullptr)
+		return false;
+
+	std::swap(dc, *l);
+
+	{
+		const ScopeLock protect(pc.mutex);
+		(*l)->pipe_limit = std::max(pc.buffered_before_play, 1u);
+	}
+
+	ResetCrossFade();
+	return true;
+}
+
+/**
+ * Does the decoder for song "a" produce the same audio as the one for
+ * song "b"?
+ */
+gcc_pure
+static bool
+IsSameSong(const DetachedSong &a, const DetachedSong &b)
+{
+	return a.IsSame(b) &&
+		a.GetStartTime() == b.GetStartTime() &&
+		a.GetEndTime() == b.GetEndTime();
+}
+
+DecoderControl **
+Player::FindLookahead(const DetachedSong &_song)
+{
+	for (auto &l : lookahead)
+		if (l->pipe != nullptr && IsSameSong(*l->song, _song))
+			return &l;
+
+	return nullptr;
+}
+
+DecoderControl **
+Player::FindIdleLookahead()
+{
+	for (auto &l : lookahead)
+		if (l->pipe == nullptr)
+			return &l;
+
+	return nullptr;
+}
+
+unsigned
+Player::GetLookaheadSize() const
+{
+	unsigned n = 0;
+	for (const auto *l : lookahead)
+		if (l->pipe != nullptr)
+			n += l->pipe->GetSize();
+
+	return n;
+}
+
+void
+Player::StartLookahead(DecoderControl &l, const DetachedSong &_song)
+{
+	assert(l.pipe == nullptr);
+
+	{
+		const ScopeLock protect(pc.mutex);
+		l.replay_gain_mode = pc.replay_gain_mode;
+
+		/* decode only as much as is needed to start playback
+		   without buffering */
+		l.pipe_limit = std::max(pc.buffered_before_play, 1u);
+	}
+
+	l.Start(new DetachedSong(_song),
+		_song.GetStartTime(), _song.GetEndTime(),
+		buffer, *new MusicPipe());
+}
+
+void
+Player::StopLookahead(DecoderControl &l)
+{
+	assert(l.pipe != nullptr);
+
+	l.Stop();
+
+	{
+		const ScopeLock protect(pc.mutex);
+		l.pipe_limit = 0;
+	}
+
+	l.pipe->Clear(buffer);
+	delete l.pipe;
+	l.pipe = nullptr;
+}
+
+void
+Player::UpdateLookahead(const std::vector<DetachedSong> &songs)
+{
+	/* stop decoders of songs which are not upcoming anymore */
+	for (auto *l : lookahead)
+		if (l->pipe != nullptr &&
+		    std::none_of(songs.begin(), songs.end(),
+				 [l](const DetachedSong &i){
+					 return IsSameSong(i, *l->song);
+				 }))
+			StopLookahead(*l);
+
+	for (const auto &i : songs) {
+		if (IsDecoderAtNextSong() && IsSameSong(*dc->song, i))
+			/* already being decoded by #dc */
+			continue;
+
+		if (FindLookahead(i) != nullptr)
+			continue;
+
+		DecoderControl **l = FindIdleLookahead();
+		if (l == nullptr)
+			break;
+
+		StartLookahead(**l, i);
+	}
+}
+
+bool
+Player::AdoptLookahead(const DetachedSong &_song)
+{
+	assert(dc->pipe == nullptr);
+
+	DecoderControl **l = FindLookahead(_song);
+	if (l == nullptr)
+		return false;
+
+	const DecoderControl &previous = *dc;
+	std::swap(dc, *l);
+
+	const ScopeLock protect(pc.mutex);
+
+	/* the adopted decoder has not seen the previous song; copy
+	   what the cross-fader needs to know about it */
+	dc->previous_mix_ramp = previous.mix_ramp;
+	dc->replay_gain_prev_db = previous.replay_gain_db;
+
+	/* lift the limit and let it continue decoding */
+	dc->pipe_limit = 0;
+	dc->Signal();
+	return true;
+}
+
 bool
 Player::ForwardDecoderError()
 {
 	try {
-		dc.CheckRethrowError();
+		dc->CheckRethrowError();
 	} catch (...) {
 		pc.SetError(PlayerError::DECODER, std::current_exception());
 		return false;
@@ -495,7 +848,7 @@ Player::CheckDecoderStartup()
 		pc.Unlock();
 
 		return false;
-	} else if (!dc.IsStarting()) {
+	} else if (!dc->IsStarting()) {
 		/* the decoder is ready and ok */
 
 		pc.Unlock();
@@ -507,20 +860,20 @@ Player::CheckDecoderStartup()
 			return true;
 
 		pc.Lock();
-		pc.total_time = real_song_duration(*dc.song, dc.total_time);
-		pc.audio_format = dc.in_audio_format;
+		pc.total_time = real_song_duration(*dc->song, dc->total_time);
+		pc.audio_format = dc->in_audio_format;
 		pc.Unlock();
 
 		idle_add(IDLE_PLAYER);
 
-		play_audio_format = dc.out_audio_format;
+		play_audio_format = dc->out_audio_format;
 		decoder_starting = false;
 
 		if (!paused && !OpenOutput()) {
 			FormatError(player_domain,
 				    "problems opening audio device "
 				    "while playing \"%s\"",
-				    dc.song->GetURI());
+				    dc->song->GetURI());
 			return true;
 		}
 
@@ -528,7 +881,7 @@ Player::CheckDecoderStartup()
 	} else {
 		/* the decoder is not yet ready; wait
 		   some more */
-		dc.WaitForDecoder();
+		dc->WaitForDecoder();
 		pc.Unlock();
 
 		return true;
@@ -558,7 +911,7 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = chunk->capacity / frame_size;
 
 	chunk->time = SignedSongTime::Negative(); /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -575,16 +928,182 @@ Player::SendSilence()
 	return true;
 }
 
+/**
+ * Does the chunk contain music data for the specified time stamp?
+ */
+gcc_pure
+static bool
+ChunkContains(const MusicChunk &chunk, SongTime t, AudioFormat format)
+{
+	if (chunk.length == 0 || chunk.time.IsNegative() ||
+	    SongTime(chunk.time) > t)
+		return false;
+
+	const SongTime end = SongTime(chunk.time) +
+		SongTime::FromS(double(chunk.length) / format.GetTimeToSize());
+	return t < end;
+}
+
+/**
+ * Find the chunk which contains the specified time stamp.
+ *
+ * @return the number of chunks before it, or -1 if there is none
+ */
+gcc_pure
+static int
+FindChunk(const MusicPipe &pipe, SongTime t, AudioFormat format)
+{
+	int n = 0;
+	for (const MusicChunk *i = pipe.Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire), ++n)
+		if (ChunkContains(*i, t, format))
+			return n;
+
+	return -1;
+}
+
+/**
+ * Remove the data before the specified time stamp from the chunk.
+ */
+static void
+SkipChunkTo(MusicChunk &chunk, SongTime t, AudioFormat format)
+{
+	assert(ChunkContains(chunk, t, format));
+
+	const double rate = format.GetTimeToSize();
+	size_t offset = (t - SongTime(chunk.time)).ToDoubleS() * rate;
+	offset -= offset % format.GetFrameSize();
+	if (offset == 0 || offset >= chunk.length)
+		return;
+
+	memmove(chunk.data, chunk.data + offset, chunk.length - offset);
+	chunk.length -= offset;
+	chunk.time = SongTime(chunk.time) + SongTime::FromS(offset / rate);
+}
+
+/**
+ * Move chunks from the head of one pipe to the tail of another one.
+ */
+static void
+MoveChunks(MusicPipe &dest, MusicPipe &src, unsigned n=~0u)
+{
+	MusicChunk *chunk;
+	while (n-- > 0 && (chunk = src.Shift()) != nullptr)
+		dest.Push(chunk);
+}
+
+void
+Player::SkipChunks(MusicPipe &src, unsigned n)
+{
+	MoveChunks(history, src, n);
+
+	const unsigned max_history = GetMaxHistory();
+	while (history.GetSize() > max_history)
+		buffer.Return(history.Shift());
+}
+
+bool
+Player::SeekBuffered(SongTime where)
+{
+	if (song == nullptr || !song->IsSame(*pc.next_song) ||
+	    song->GetStartTime() != pc.next_song->GetStartTime() ||
+	    song->GetEndTime() != pc.next_song->GetEndTime() ||
+	    /* the playlist may already have queued the next song,
+	       and #pipe might be cross-faded into it */
+	    IsDecoderAtNextSong() ||
+	    xfade_state == CrossFadeState::ACTIVE ||
+	    decoder_starting || !play_audio_format.IsDefined())
+		return false;
+
+	const AudioFormat format = play_audio_format;
+
+	int n = FindChunk(history, where, format);
+	if (n >= 0) {
+		/* a backwards seek: play the chunks from here again,
+		   followed by the ones which were already in
+		   #replay */
+		MusicPipe older;
+		MoveChunks(older, history, n);
+
+		MusicChunk *chunk = history.Shift();
+		SkipChunkTo(*chunk, where, format);
+
+		MusicPipe tmp;
+		tmp.Push(chunk);
+		MoveChunks(tmp, history);
+		MoveChunks(tmp, replay);
+		MoveChunks(replay, tmp);
+		MoveChunks(history, older);
+		return true;
+	}
+
+	n = FindChunk(replay, where, format);
+	if (n >= 0) {
+		/* a forward seek into chunks which were played before
+		   an earlier backwards seek */
+		SkipChunks(replay, n);
+
+		MusicChunk *chunk = replay.Shift();
+		SkipChunkTo(*chunk, where, format);
+
+		MusicPipe tmp;
+		tmp.Push(chunk);
+		MoveChunks(tmp, replay);
+		MoveChunks(replay, tmp);
+		return true;
+	}
+
+	n = FindChunk(*pipe, where, format);
+	if (n >= 0) {
+		/* a forward seek into chunks which the decoder has
+		   already finished; the decoder continues to append
+		   to #pipe meanwhile, but only the player shifts
+		   from it */
+		SkipChunks(replay);
+		SkipChunks(*pipe, n);
+
+		MusicChunk *chunk = pipe->Shift();
+		SkipChunkTo(*chunk, where, format);
+		replay.Push(chunk);
+		return true;
+	}
+
+	return false;
+}
+
 inline bool
 Player::SeekDecoder()
 {
 	assert(pc.next_song != nullptr);
 
+	/* this moves the chunks which were not played yet to
+	   #history */
 	pc.outputs.Cancel();
 
+	{
+		SongTime where = pc.seek_time;
+		if (!pc.total_time.IsNegative() &&
+		    where > SongTime(pc.total_time))
+			where = SongTime(pc.total_time);
+
+		if (SeekBuffered(where)) {
+			delete pc.next_song;
+			pc.next_song = nullptr;
+			queued = false;
+
+			elapsed_time = where;
+
+			pc.LockCommandFinished();
+			return true;
+		}
+	}
+
+	/* the decoder has to seek; forget all buffered chunks */
+	ClearHistory();
+
 	const SongTime start_time = pc.next_song->GetStartTime();
 
-	if (!dc.LockIsCurrentSong(*pc.next_song)) {
+	if (!dc->LockIsCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
 
@@ -594,8 +1113,14 @@ Player::SeekDecoder()
 		   pipe */
 		pipe->Clear(buffer);
 
-		/* re-start the decoder */
-		StartDecoder(*pipe);
+		if (pc.seek_time == SongTime::zero() &&
+		    AdoptLookahead(*pc.next_song))
+			/* the song has been decoded in advance */
+			ReplacePipe(dc->pipe);
+		else
+			/* re-start the decoder */
+			StartDecoder(*pipe);
+
 		ActivateDecoder();
 
 		if (!WaitDecoderStartup())
@@ -604,7 +1129,7 @@ Player::SeekDecoder()
 		if (!IsDecoderAtCurrentSong()) {
 			/* the decoder is already decoding the "next" song,
 			   but it is the same song file; exchange the pipe */
-			ClearAndReplacePipe(dc.pipe);
+			ClearAndReplacePipe(dc->pipe);
 		}
 
 		delete pc.next_song;
@@ -628,7 +1153,7 @@ Player::SeekDecoder()
 		}
 
 		try {
-			dc.Seek(where + start_time);
+			dc->Seek(where + start_time);
 		} catch (...) {
 			/* decoder failure */
 			pc.SetError(PlayerError::DECODER,
@@ -640,6 +1165,9 @@ Player::SeekDecoder()
 		elapsed_time = where;
 	}
 
+	/* the decoder works on the current song again */
+	EnableHistory();
+
 	pc.LockCommandFinished();
 
 	assert(xfade_state == CrossFadeState::UNKNOWN);
@@ -676,8 +1204,13 @@ Player::ProcessCommand()
 		pc.CommandFinished();
 
 		pc.Unlock();
-		if (dc.LockIsIdle())
-			StartDecoder(*new MusicPipe());
+		/* not while the decoder of the current song is still
+		   starting: CheckDecoderStartup() needs it; the main
+		   loop will start the next decoder later */
+		if (!decoder_starting && dc->LockIsIdle()) {
+			DisableHistory();
+			StartNextDecoder();
+		}
 		pc.Lock();
 
 		break;
@@ -723,9 +1256,11 @@ Player::ProcessCommand()
 
 		if (IsDecoderAtNextSong()) {
 			/* the decoder is already decoding the song -
-			   stop it and reset the position */
+			   stop it and reset the position (or keep it
+			   for a later skip to that song) */
 			pc.Unlock();
-			StopDecoder();
+			if (!DemoteDecoder())
+				StopDecoder();
 			pc.Lock();
 		}
 
@@ -816,7 +1351,7 @@ Player::PlayNextChunk()
 
 	/* activate cross-fading? */
 	if (xfade_state == CrossFadeState::ENABLED &&
-	    IsDecoderAtNextSong() &&
+	    IsDecoderAtNextSong() && replay.IsEmpty() &&
 	    pipe->GetSize() <= cross_fade_chunks) {
 		/* beginning of the cross fade - adjust
 		   cross_fade_chunks which might be bigger than the
@@ -834,7 +1369,7 @@ Player::PlayNextChunk()
 		unsigned cross_fade_position = pipe->GetSize();
 		assert(cross_fade_position <= cross_fade_chunks);
 
-		MusicChunk *other_chunk = dc.pipe->Shift();
+		MusicChunk *other_chunk = dc->pipe->Shift();
 		if (other_chunk != nullptr) {
 			chunk = pipe->Shift();
 			assert(chunk != nullptr);
@@ -873,7 +1408,7 @@ Player::PlayNextChunk()
 
 			pc.Lock();
 
-			if (dc.IsIdle()) {
+			if (dc->IsIdle()) {
 				/* the decoder isn't running, abort
 				   cross fading */
 				pc.Unlock();
@@ -881,8 +1416,8 @@ Player::PlayNextChunk()
 				xfade_state = CrossFadeState::DISABLED;
 			} else {
 				/* wait for the decoder */
-				dc.Signal();
-				dc.WaitForDecoder();
+				dc->Signal();
+				dc->WaitForDecoder();
 				pc.Unlock();
 
 				return true;
@@ -891,7 +1426,7 @@ Player::PlayNextChunk()
 	}
 
 	if (chunk == nullptr)
-		chunk = pipe->Shift();
+		chunk = ShiftChunk();
 
 	assert(chunk != nullptr);
 
@@ -929,14 +1464,18 @@ Player::PlayNextChunk()
 
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
-	   larger block at a time */
+	   larger block at a time; the chunks held by #history and
+	   #replay and the #lookahead decoders are not available to
+	   the decoder */
+	const unsigned available = buffer.GetSize() -
+		history.GetSize() - replay.GetSize() - GetLookaheadSize();
 	pc.Lock();
-	if (!dc.IsIdle() &&
-	    dc.pipe->GetSize() <= (pc.buffered_before_play +
-				   buffer.GetSize() * 3) / 4) {
+	if (!dc->IsIdle() &&
+	    dc->pipe->GetSize() <= (pc.buffered_before_play +
+				   available * 3) / 4) {
 		if (!decoder_woken) {
 			decoder_woken = true;
-			dc.Signal();
+			dc->Signal();
 		}
 	} else
 		decoder_woken = false;
@@ -950,7 +1489,13 @@ Player::SongBorder()
 {
 	FormatDefault(player_domain, "played \"%s\"", song->GetURI());
 
-	ReplacePipe(dc.pipe);
+	assert(replay.IsEmpty());
+
+	ReplacePipe(dc->pipe);
+
+	/* all chunks of the previous song have been played; the
+	   decoder now works on the current song */
+	EnableHistory();
 
 	pc.outputs.SongBorder();
 
@@ -977,6 +1522,7 @@ Player::Run()
 
 	StartDecoder(*pipe);
 	ActivateDecoder();
+	EnableHistory();
 
 	pc.Lock();
 	pc.state = PlayerState::PLAY;
@@ -993,6 +1539,17 @@ Player::Run()
 			break;
 		}
 
+		if (pc.lookahead_modified) {
+			pc.lookahead_modified = false;
+
+			/* copy the list, because the lock is released
+			   while the decoders are being started */
+			const std::vector<DetachedSong> songs(pc.lookahead_songs);
+			pc.Unlock();
+			UpdateLookahead(songs);
+			pc.Lock();
+		}
+
 		pc.Unlock();
 
 		if (buffering) {
@@ -1000,8 +1557,9 @@ Player::Run()
 			   until the buffer is large enough, to
 			   prevent stuttering on slow machines */
 
-			if (pipe->GetSize() < pc.buffered_before_play &&
-			    !dc.LockIsIdle()) {
+			if (replay.GetSize() + pipe->GetSize() <
+			    pc.buffered_before_play &&
+			    !dc->LockIsIdle()) {
 				/* not enough decoded buffer space yet */
 
 				if (!paused && output_open &&
@@ -1010,8 +1568,16 @@ Player::Run()
 					break;
 
 				pc.Lock();
-				/* XXX race condition: check decoder again */
-				dc.WaitForDecoder();
+
+				/* check again while locked: the decoder
+				   may have finished or a command may
+				   have arrived meanwhile, and their
+				   signals would be lost */
+				if (pc.command == PlayerCommand::NONE &&
+				    replay.GetSize() + pipe->GetSize() <
+				    pc.buffered_before_play &&
+				    !dc->IsIdle())
+					dc->WaitForDecoder();
 				continue;
 			} else {
 				/* buffering is complete */
@@ -1033,17 +1599,18 @@ Player::Run()
 		/*
 		music_pipe_check_format(&play_audio_format,
 					next_song_chunk,
-					&dc.out_audio_format);
+					&dc->out_audio_format);
 		*/
 #endif
 
-		if (dc.LockIsIdle() && queued && dc.pipe == pipe) {
+		if (dc->LockIsIdle() && queued && dc->pipe == pipe) {
 			/* the decoder has finished the current song;
 			   make it decode the next song */
 
-			assert(dc.pipe == nullptr || dc.pipe == pipe);
+			assert(dc->pipe == nullptr || dc->pipe == pipe);
 
-			StartDecoder(*new MusicPipe());
+			DisableHistory();
+			StartNextDecoder();
 		}
 
 		if (/* no cross-fading if MPD is going to pause at the
@@ -1051,18 +1618,19 @@ Player::Run()
 		    !pc.border_pause &&
 		    IsDecoderAtNextSong() &&
 		    xfade_state == CrossFadeState::UNKNOWN &&
-		    !dc.LockIsStarting()) {
+		    !dc->LockIsStarting()) {
 			/* enable cross fading in this song?  if yes,
 			   calculate how many chunks will be required
 			   for it */
 			cross_fade_chunks =
-				pc.cross_fade.Calculate(dc.total_time,
-							dc.replay_gain_db,
-							dc.replay_gain_prev_db,
-							dc.GetMixRampStart(),
-							dc.GetMixRampPreviousEnd(),
-							dc.out_audio_format,
+				pc.cross_fade.Calculate(dc->total_time,
+							dc->replay_gain_db,
+							dc->replay_gain_prev_db,
+							dc->GetMixRampStart(),
+							dc->GetMixRampPreviousEnd(),
+							dc->out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							pc.buffered_before_play);
 			if (cross_fade_chunks > 0)
@@ -1079,7 +1647,7 @@ Player::Run()
 			if (pc.command == PlayerCommand::NONE)
 				pc.Wait();
 			continue;
-		} else if (!pipe->IsEmpty()) {
+		} else if (!IsPipeEmpty()) {
 			/* at least one music chunk is ready - send it
 			   to the audio output */
 
@@ -1094,14 +1662,14 @@ Player::Run()
 			/* wake up the decoder (just in case it's
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
-			dc.Signal();
-			dc.WaitForDecoder();
+			dc->Signal();
+			dc->WaitForDecoder();
 			continue;
 		} else if (IsDecoderAtNextSong()) {
 			/* at the beginning of a new song */
 
 			SongBorder();
-		} else if (dc.LockIsIdle()) {
+		} else if (dc->LockIsIdle()) {
 			/* check the size of the pipe again, because
 			   the decoder thread may have added something
 			   since we last checked */
@@ -1124,6 +1692,12 @@ Player::Run()
 
 	StopDecoder();
 
+	for (auto *l : lookahead)
+		if (l->pipe != nullptr)
+			StopLookahead(*l);
+
+	DisableHistory();
+	replay.Clear(buffer);
 	ClearAndDeletePipe();
 
 	delete cross_fade_tag;
@@ -1137,6 +1711,9 @@ Player::Run()
 
 	pc.ClearTaggedSong();
 
+	pc.lookahead_songs.clear();
+	pc.lookahead_modified = false;
+
 	if (queued) {
 		assert(pc.next_song != nullptr);
 		delete pc.next_song;
@@ -1150,9 +1727,10 @@ Player::Run()
 
 static void
 do_play(PlayerControl &pc, DecoderControl &dc,
+	std::list<DecoderControl> &lookahead,
 	MusicBuffer &buffer)
 {
-	Player player(pc, dc, buffer);
+	Player player(pc, dc, lookahead, buffer);
 	player.Run();
 }
 
@@ -1168,7 +1746,16 @@ player_task(void *arg)
 			  pc.replay_gain_config);
 	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	/* additional decoders for PlayerControl::lookahead_songs */
+	std::list<DecoderControl> lookahead;
+	for (unsigned i = 0; i < pc.lookahead; ++i) {
+		lookahead.emplace_back(pc.mutex, pc.cond,
+				       pc.configured_audio_format,
+				       pc.replay_gain_config);
+		decoder_thread_start(lookahead.back());
+	}
+
+	MusicBuffer buffer(pc.buffer_chunks, pc.chunk_size);
 
 	pc.Lock();
 
@@ -1179,7 +1766,7 @@ player_task(void *arg)
 			assert(pc.next_song != nullptr);
 
 			pc.Unlock();
-			do_play(pc, dc, buffer);
+			do_play(pc, dc, lookahead, buffer);
 			pc.listener.OnPlayerSync();
 			pc.Lock();
 			break;
@@ -1221,6 +1808,8 @@ player_task(void *arg)
 			pc.Unlock();
 
 			dc.Quit();
+			for (auto &l : lookahead)
+				l.Quit();
 
 			pc.outputs.Close();
 
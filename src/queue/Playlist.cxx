@@ -149,6 +149,27 @@ playlist::UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev)
 		else
 			queued = next_order;
 	}
+
+	if (pc.lookahead > 0)
+		UpdateLookahead(pc, next_order);
+}
+
+void
+playlist::UpdateLookahead(PlayerControl &pc, const int order)
+{
+	std::vector<DetachedSong> songs;
+
+	for (int i = order; i >= 0 && songs.size() < pc.lookahead;) {
+		songs.push_back(queue.GetOrder(i));
+
+		i = queue.GetNextOrder(i);
+		if (i == order)
+			/* repeat mode with a short queue: don't
+			   decode the same song twice */
+			break;
+	}
+
+	pc.LockSetLookahead(std::move(songs));
 }
 
 void
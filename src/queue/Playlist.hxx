@@ -162,6 +162,14 @@ protected:
 	 */
 	void UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev);
 
+	/**
+	 * Tell the player which songs will be played next (see
+	 * PlayerControl::lookahead_songs), beginning with the one
+	 * with the specified order number (or none if it is
+	 * negative).
+	 */
+	void UpdateLookahead(PlayerControl &pc, int order);
+
 	/**
 	 * Queue a song, addressed by its order number.
 	 */
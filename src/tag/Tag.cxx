@@ -62,10 +62,8 @@ Tag::Clear()
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0; i < num_items; ++i)
 		tag_pool_put_item(items[i]);
-	tag_pool_lock.unlock();
 
 	delete[] items;
 	items = nullptr;
@@ -80,10 +78,8 @@ Tag::Tag(const Tag &other)
 	if (num_items > 0) {
 		items = new TagItem *[num_items];
 
-		tag_pool_lock.lock();
 		for (unsigned i = 0; i < num_items; i++)
 			items[i] = tag_pool_dup_item(other.items[i]);
-		tag_pool_lock.unlock();
 	}
 }
 
@@ -36,10 +36,8 @@ TagBuilder::TagBuilder(const Tag &other)
 {
 	items.reserve(other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
-	tag_pool_lock.unlock();
 }
 
 TagBuilder::TagBuilder(Tag &&other)
@@ -66,10 +64,8 @@ TagBuilder::operator=(const TagBuilder &other)
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_dup_item(i);
-	tag_pool_lock.unlock();
 
 	return *this;
 }
@@ -179,13 +175,11 @@ TagBuilder::Complement(const Tag &other)
 
 	items.reserve(items.size() + other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!present[item->type])
 			items.push_back(tag_pool_dup_item(item));
 	}
-	tag_pool_lock.unlock();
 }
 
 inline void
@@ -197,9 +191,7 @@ TagBuilder::AddItemInternal(TagType type, StringView value)
 	if (!f.IsNull())
 		value = { f.data, f.size };
 
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, value);
-	tag_pool_lock.unlock();
 
 	free(f.data);
 
@@ -229,9 +221,7 @@ TagBuilder::AddItem(TagType type, const char *value)
 void
 TagBuilder::AddEmptyItem(TagType type)
 {
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, StringView::Empty());
-	tag_pool_lock.unlock();
 
 	items.push_back(i);
 }
@@ -239,10 +229,8 @@ TagBuilder::AddEmptyItem(TagType type)
 void
 TagBuilder::RemoveAll()
 {
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_put_item(i);
-	tag_pool_lock.unlock();
 
 	items.clear();
 }
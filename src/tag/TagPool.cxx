@@ -20,51 +20,147 @@
 #include "config.h"
 #include "TagPool.hxx"
 #include "TagItem.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 #include "util/StringView.hxx"
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
-Mutex tag_pool_lock;
+/**
+ * The number of shards; must be a power of two.
+ */
+static constexpr size_t NUM_SHARDS = 16;
 
-static constexpr size_t NUM_SLOTS = 4093;
+/**
+ * The minimum (and initial) number of hash buckets per shard; must
+ * be a power of two.
+ */
+static constexpr size_t MIN_BUCKETS = 256;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
-	unsigned char ref;
+
+	/**
+	 * The full hash of this item, which selects the shard and the
+	 * bucket, and which allows rehashing without looking at the
+	 * value.
+	 */
+	unsigned hash;
+
+	/**
+	 * The reference counter.  It used to be a single byte, but
+	 * the #hash leaves room for a full integer, and a frequent
+	 * value (e.g. a genre) would otherwise be split over many
+	 * slots in the same hash chain.
+	 */
+	unsigned ref;
+
+	/**
+	 * The case-folded value, see tag_pool_set_folded().  It is
+	 * set at most once, without holding the shard lock.
+	 */
+	mutable std::atomic<char *> folded;
+
 	TagItem item;
 
 	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(TagPoolSlot *_next, unsigned _hash, TagType type,
 		    StringView value)
-		:next(_next), ref(1) {
+		:next(_next), hash(_hash), ref(1), folded(nullptr) {
 		item.type = type;
 		memcpy(item.value, value.data, value.size);
 		item.value[value.size] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
-				   StringView value);
+	~TagPoolSlot() {
+		delete[] folded.load(std::memory_order_relaxed);
+	}
+
+	static TagPoolSlot *Create(TagPoolSlot *_next, unsigned hash,
+				   TagType type, StringView value);
 };
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(TagPoolSlot *_next, unsigned hash, TagType type,
 		    StringView value)
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       value.size + 1,
-				       _next, type,
+				       _next, hash, type,
 				       value);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+/**
+ * One part of the pool with its own lock and hash table.  The table
+ * doubles its size when there are more items than buckets, and is
+ * halved when it is less than 1/8 full.
+ */
+class TagPoolShard {
+	Mutex mutex;
+
+	/**
+	 * The hash table, allocated on the first insertion.
+	 */
+	TagPoolSlot **buckets = nullptr;
+
+	/**
+	 * The number of elements in #buckets; zero or a power of two.
+	 */
+	size_t n_buckets = 0;
+
+	size_t n_items = 0;
+
+public:
+	Mutex &GetMutex() {
+		return mutex;
+	}
+
+	/**
+	 * Caller must lock #mutex.
+	 */
+	TagItem *Get(unsigned hash, TagType type, StringView value);
+
+	/**
+	 * Caller must lock #mutex.
+	 */
+	void Remove(TagPoolSlot *slot);
+
+	/**
+	 * Caller must lock #mutex.
+	 */
+	void CollectStats(TagPoolStats &stats) const;
+
+private:
+	gcc_pure
+	TagPoolSlot **GetBucket(unsigned hash) const {
+		/* the lower bits have already selected the shard */
+		return &buckets[(hash / NUM_SHARDS) & (n_buckets - 1)];
+	}
+
+	void Resize(size_t new_n_buckets);
+};
+
+static TagPoolShard shards[NUM_SHARDS];
+
+static inline unsigned
+finish_hash(unsigned hash, TagType type)
+{
+	hash ^= type;
+
+	/* mix the upper bits into the lower ones, which select the
+	   shard and the bucket */
+	hash *= 0x9e3779b1u;
+	return hash ^ (hash >> 16);
+}
 
 static inline unsigned
 calc_hash(TagType type, StringView p)
@@ -74,7 +170,7 @@ calc_hash(TagType type, StringView p)
 	for (auto ch : p)
 		hash = (hash << 5) + hash + ch;
 
-	return hash ^ type;
+	return finish_hash(hash, type);
 }
 
 static inline unsigned
@@ -87,7 +183,13 @@ calc_hash(TagType type, const char *p)
 	while (*p != 0)
 		hash = (hash << 5) + hash + *p++;
 
-	return hash ^ type;
+	return finish_hash(hash, type);
+}
+
+static inline TagPoolShard &
+hash_to_shard(unsigned hash)
+{
+	return shards[hash % NUM_SHARDS];
 }
 
 #if CLANG_OR_GCC_VERSION(4,7)
@@ -99,41 +201,122 @@ tag_item_to_slot(TagItem *item)
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, StringView value)
+#if CLANG_OR_GCC_VERSION(4,7)
+	constexpr
+#endif
+static inline const TagPoolSlot *
+tag_item_to_slot(const TagItem *item)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
+void
+TagPoolShard::Resize(size_t new_n_buckets)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	assert(new_n_buckets >= MIN_BUCKETS);
+	assert((new_n_buckets & (new_n_buckets - 1)) == 0);
+
+	TagPoolSlot **const old_buckets = buckets;
+	const size_t old_n_buckets = n_buckets;
+
+	buckets = new TagPoolSlot *[new_n_buckets];
+	n_buckets = new_n_buckets;
+	std::fill_n(buckets, n_buckets, nullptr);
+
+	for (size_t i = 0; i < old_n_buckets; ++i) {
+		for (TagPoolSlot *slot = old_buckets[i], *next;
+		     slot != nullptr; slot = next) {
+			next = slot->next;
+
+			TagPoolSlot **bucket = GetBucket(slot->hash);
+			slot->next = *bucket;
+			*bucket = slot;
+		}
+	}
+
+	delete[] old_buckets;
 }
 
 TagItem *
-tag_pool_get_item(TagType type, StringView value)
+TagPoolShard::Get(unsigned hash, TagType type, StringView value)
 {
-	auto slot_p = tag_value_slot_p(type, value);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
-		    value.Equals(slot->item.value) &&
-		    slot->ref < TagPoolSlot::MAX_REF) {
-			assert(slot->ref > 0);
-			++slot->ref;
-			return &slot->item;
+	if (n_buckets > 0) {
+		for (auto slot = *GetBucket(hash); slot != nullptr;
+		     slot = slot->next) {
+			if (slot->hash == hash &&
+			    slot->item.type == type &&
+			    value.Equals(slot->item.value) &&
+			    slot->ref < TagPoolSlot::MAX_REF) {
+				assert(slot->ref > 0);
+				++slot->ref;
+				return &slot->item;
+			}
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value);
-	*slot_p = slot;
+	if (n_items >= n_buckets)
+		Resize(std::max(n_buckets * 2, MIN_BUCKETS));
+
+	auto bucket = GetBucket(hash);
+	auto slot = TagPoolSlot::Create(*bucket, hash, type, value);
+	*bucket = slot;
+	++n_items;
 	return &slot->item;
 }
 
+void
+TagPoolShard::Remove(TagPoolSlot *slot)
+{
+	assert(n_items > 0);
+
+	TagPoolSlot **slot_p;
+	for (slot_p = GetBucket(slot->hash);
+	     *slot_p != slot;
+	     slot_p = &(*slot_p)->next) {
+		assert(*slot_p != nullptr);
+	}
+
+	*slot_p = slot->next;
+	DeleteVarSize(slot);
+	--n_items;
+
+	if (n_buckets > MIN_BUCKETS && n_items < n_buckets / 8)
+		Resize(n_buckets / 2);
+}
+
+void
+TagPoolShard::CollectStats(TagPoolStats &stats) const
+{
+	stats.items += n_items;
+	stats.buckets += n_buckets;
+
+	for (size_t i = 0; i < n_buckets; ++i) {
+		size_t length = 0;
+		for (auto slot = buckets[i]; slot != nullptr;
+		     slot = slot->next)
+			++length;
+
+		stats.max_chain = std::max(stats.max_chain, length);
+	}
+}
+
+TagItem *
+tag_pool_get_item(TagType type, StringView value)
+{
+	const unsigned hash = calc_hash(type, value);
+	auto &shard = hash_to_shard(hash);
+
+	const ScopeLock protect(shard.GetMutex());
+	return shard.Get(hash, type, value);
+}
+
 TagItem *
 tag_pool_dup_item(TagItem *item)
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
+	auto &shard = hash_to_shard(slot->hash);
+
+	const ScopeLock protect(shard.GetMutex());
 
 	assert(slot->ref > 0);
 
@@ -144,28 +327,58 @@ tag_pool_dup_item(TagItem *item)
 		/* the reference counter overflows above MAX_REF;
 		   obtain a reference to a different TagPoolSlot which
 		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
+		return shard.Get(slot->hash, item->type, item->value);
 	}
 }
 
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
+	auto &shard = hash_to_shard(slot->hash);
+
+	const ScopeLock protect(shard.GetMutex());
 
-	slot = tag_item_to_slot(item);
 	assert(slot->ref > 0);
 	--slot->ref;
 
-	if (slot->ref > 0)
-		return;
+	if (slot->ref == 0)
+		shard.Remove(slot);
+}
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+TagPoolStats
+tag_pool_get_stats()
+{
+	TagPoolStats stats{0, 0, 0};
+
+	for (auto &shard : shards) {
+		const ScopeLock protect(shard.GetMutex());
+		shard.CollectStats(stats);
 	}
 
-	*slot_p = slot->next;
-	DeleteVarSize(slot);
+	return stats;
+}
+
+const char *
+tag_pool_get_folded(const TagItem &item)
+{
+	const TagPoolSlot *slot = tag_item_to_slot(&item);
+	return slot->folded.load(std::memory_order_acquire);
+}
+
+const char *
+tag_pool_set_folded(const TagItem &item, AllocatedString<> &&folded)
+{
+	const TagPoolSlot *slot = tag_item_to_slot(&item);
+
+	char *expected = nullptr;
+	char *value = folded.Steal();
+	if (!slot->folded.compare_exchange_strong(expected, value,
+						  std::memory_order_acq_rel)) {
+		/* another thread was faster */
+		delete[] value;
+		return expected;
+	}
+
+	return value;
 }
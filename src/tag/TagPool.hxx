@@ -21,13 +21,20 @@
 #define MPD_TAG_POOL_HXX
 
 #include "TagType.h"
-#include "thread/Mutex.hxx"
+#include "util/AllocatedString.hxx"
+#include "Compiler.h"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
 
 struct TagItem;
 struct StringView;
 
+/*
+ * The tag pool is split into shards (selected by the hash of the
+ * item), each with its own lock and a hash table which grows and
+ * shrinks with the number of items.  All functions are thread-safe.
+ */
+
 TagItem *
 tag_pool_get_item(TagType type, StringView value);
 
@@ -37,4 +44,59 @@ tag_pool_dup_item(TagItem *item);
 void
 tag_pool_put_item(TagItem *item);
 
+struct TagPoolStats {
+	/**
+	 * The number of distinct items in the pool.
+	 */
+	size_t items;
+
+	/**
+	 * The total number of hash buckets in all shards.
+	 */
+	size_t buckets;
+
+	/**
+	 * The length of the longest hash chain.
+	 */
+	size_t max_chain;
+
+	double GetLoadFactor() const {
+		return buckets > 0
+			? double(items) / double(buckets)
+			: 0.;
+	}
+};
+
+/**
+ * Collect statistics about the pool.  This walks all hash buckets,
+ * locking one shard at a time.
+ */
+TagPoolStats
+tag_pool_get_stats();
+
+/**
+ * Returns the case-folded value of the given item which was stored
+ * by tag_pool_set_folded(), or nullptr if there is none yet.
+ *
+ * This function does not lock the pool, but the caller must hold a
+ * reference to the item.
+ */
+gcc_pure
+const char *
+tag_pool_get_folded(const TagItem &item);
+
+/**
+ * Store the case-folded value of the given item, to be reused by
+ * all later tag_pool_get_folded() calls.  It is freed together with
+ * the item.  If another thread has stored one meanwhile, that one is
+ * kept.
+ *
+ * This function does not lock the pool, but the caller must hold a
+ * reference to the item.
+ *
+ * @return the stored case-folded value
+ */
+const char *
+tag_pool_set_folded(const TagItem &item, AllocatedString<> &&folded);
+
 #endif
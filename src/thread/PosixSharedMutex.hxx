@@ -0,0 +1,71 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef THREAD_POSIX_SHARED_MUTEX_HXX
+#define THREAD_POSIX_SHARED_MUTEX_HXX
+
+#include <pthread.h>
+
+/**
+ * Low-level wrapper for a pthread_rwlock_t.
+ *
+ * Where supported (glibc), waiting writers take precedence over new
+ * readers, so a steady stream of readers cannot starve a writer.
+ */
+class PosixSharedMutex {
+	pthread_rwlock_t rwlock;
+
+public:
+#if defined(__GLIBC__) && defined(PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP)
+	constexpr PosixSharedMutex()
+		:rwlock(PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP) {}
+#elif defined(__GLIBC__)
+	constexpr PosixSharedMutex():rwlock(PTHREAD_RWLOCK_INITIALIZER) {}
+#else
+	PosixSharedMutex() {
+		pthread_rwlock_init(&rwlock, nullptr);
+	}
+
+	~PosixSharedMutex() {
+		pthread_rwlock_destroy(&rwlock);
+	}
+#endif
+
+	PosixSharedMutex(const PosixSharedMutex &other) = delete;
+	PosixSharedMutex &operator=(const PosixSharedMutex &other) = delete;
+
+	void lock() {
+		pthread_rwlock_wrlock(&rwlock);
+	}
+
+	void unlock() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+
+	void lock_shared() {
+		pthread_rwlock_rdlock(&rwlock);
+	}
+
+	void unlock_shared() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+};
+
+#endif
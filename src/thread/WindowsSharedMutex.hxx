@@ -0,0 +1,57 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef THREAD_WINDOWS_SHARED_MUTEX_HXX
+#define THREAD_WINDOWS_SHARED_MUTEX_HXX
+
+#include <windows.h>
+
+/**
+ * Wrapper for a SRWLOCK, backend for the SharedMutex class.
+ */
+class WindowsSharedMutex {
+	SRWLOCK srwlock;
+
+public:
+	WindowsSharedMutex() {
+		::InitializeSRWLock(&srwlock);
+	}
+
+	WindowsSharedMutex(const WindowsSharedMutex &other) = delete;
+	WindowsSharedMutex &operator=(const WindowsSharedMutex &other) = delete;
+
+	void lock() {
+		::AcquireSRWLockExclusive(&srwlock);
+	}
+
+	void unlock() {
+		::ReleaseSRWLockExclusive(&srwlock);
+	}
+
+	void lock_shared() {
+		::AcquireSRWLockShared(&srwlock);
+	}
+
+	void unlock_shared() {
+		::ReleaseSRWLockShared(&srwlock);
+	}
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "WorkerPool.hxx"
+#include "Name.hxx"
+
+#include <assert.h>
+
+WorkerPool::WorkerPool(const char *_name, unsigned _n_threads)
+	:name(_name), threads(new Thread[_n_threads])
+{
+	try {
+		for (; n_threads < _n_threads; ++n_threads)
+			threads[n_threads].Start(WorkFunc, this);
+	} catch (...) {
+		StopThreads();
+		throw;
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	StopThreads();
+}
+
+void
+WorkerPool::StopThreads()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+	n_threads = 0;
+}
+
+void
+WorkerPool::Run(unsigned n, const std::function<void(unsigned)> &f)
+{
+	mutex.lock();
+
+	if (job != nullptr || n_threads == 0 || n < 2) {
+		/* busy or pointless: do it all here */
+		mutex.unlock();
+
+		for (unsigned i = 0; i < n; ++i)
+			f(i);
+		return;
+	}
+
+	job = &f;
+	n_parts = pending = n;
+	next_part = 0;
+	cond.broadcast();
+
+	while (next_part < n_parts) {
+		const unsigned i = next_part++;
+
+		mutex.unlock();
+		f(i);
+		mutex.lock();
+
+		--pending;
+	}
+
+	while (pending > 0)
+		done_cond.wait(mutex);
+
+	job = nullptr;
+	mutex.unlock();
+}
+
+inline void
+WorkerPool::Work()
+{
+	SetThreadName(name);
+
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (job == nullptr || next_part >= n_parts) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		const unsigned i = next_part++;
+		const auto &f = *job;
+
+		mutex.unlock();
+		f(i);
+		mutex.lock();
+
+		assert(pending > 0);
+		if (--pending == 0)
+			done_cond.signal();
+	}
+}
+
+void
+WorkerPool::WorkFunc(void *ctx)
+{
+	WorkerPool &pool = *(WorkerPool *)ctx;
+	pool.Work();
+}
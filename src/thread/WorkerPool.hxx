@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_WORKER_POOL_HXX
+#define MPD_THREAD_WORKER_POOL_HXX
+
+#include "check.h"
+#include "Mutex.hxx"
+#include "Cond.hxx"
+#include "Thread.hxx"
+
+#include <functional>
+#include <memory>
+
+/**
+ * A small pool of threads which help the calling thread with
+ * splitting a job into several parts and running them in parallel.
+ *
+ * Only one job runs at a time.  If the pool is busy with another
+ * caller's job, Run() does all the work in the calling thread
+ * instead of waiting.
+ */
+class WorkerPool {
+	const char *const name;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a new job has been submitted or when the
+	 * threads shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when the last part of the job has been finished.
+	 */
+	Cond done_cond;
+
+	std::unique_ptr<Thread[]> threads;
+	unsigned n_threads = 0;
+
+	/**
+	 * The current job, or nullptr if the pool is idle.
+	 */
+	const std::function<void(unsigned)> *job = nullptr;
+
+	/**
+	 * The number of parts of the current job, the index of the
+	 * next part to be started and the number of parts which have
+	 * not been finished yet.
+	 */
+	unsigned n_parts, next_part, pending;
+
+	bool quit = false;
+
+public:
+	/**
+	 * Throws #std::system_error if a thread cannot be created.
+	 *
+	 * @param name the name of the worker threads
+	 * @param n_threads the number of additional threads; the
+	 * calling thread is always the first worker
+	 */
+	WorkerPool(const char *_name, unsigned n_threads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/**
+	 * Returns the maximum number of parts which can be run in
+	 * parallel (including the calling thread).
+	 */
+	unsigned GetConcurrency() const {
+		return n_threads + 1;
+	}
+
+	/**
+	 * Invoke f(0) .. f(n-1), distributed over the calling thread
+	 * and the worker threads, and return when all of them have
+	 * finished.  The function must not throw.
+	 */
+	void Run(unsigned n, const std::function<void(unsigned)> &f);
+
+private:
+	void StopThreads();
+
+	void Work();
+	static void WorkFunc(void *ctx);
+};
+
+#endif
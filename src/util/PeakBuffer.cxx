@@ -34,44 +34,128 @@ PeakBuffer::~PeakBuffer()
 bool
 PeakBuffer::IsEmpty() const
 {
-	return (normal_buffer == nullptr || normal_buffer->IsEmpty()) &&
-		(peak_buffer == nullptr || peak_buffer->IsEmpty());
+	return consumed == appended && externals.empty();
 }
 
-WritableBuffer<void>
-PeakBuffer::Read() const
+size_t
+PeakBuffer::GetSize() const
 {
-	if (normal_buffer != nullptr) {
-		const auto p = normal_buffer->Read();
-		if (!p.IsEmpty())
-			return p.ToVoid();
+	size_t size = appended - consumed;
+	for (const auto &e : externals)
+		size += e.data.size;
+	return size;
+}
+
+size_t
+PeakBuffer::ReadCopied(size_t offset, size_t end,
+		       ConstBuffer<void> *v, size_t n) const
+{
+	/* the data in the normal buffer is always older than the data
+	   in the peak buffer */
+
+	size_t i = 0, start = 0;
+	for (const auto *buffer : {normal_buffer, peak_buffer}) {
+		if (buffer == nullptr)
+			continue;
+
+		const auto r = buffer->Read();
+		const size_t a = std::max(offset, start);
+		const size_t b = std::min(end, start + r.size);
+		if (a < b) {
+			if (i == n)
+				break;
+
+			v[i++] = ConstBuffer<void>(r.data + (a - start), b - a);
+		}
+
+		start += r.size;
 	}
 
-	if (peak_buffer != nullptr) {
-		const auto p = peak_buffer->Read();
-		if (!p.IsEmpty())
-			return p.ToVoid();
+	return i;
+}
+
+size_t
+PeakBuffer::Read(ConstBuffer<void> *v, size_t n) const
+{
+	size_t i = 0, position = consumed;
+
+	for (const auto &e : externals) {
+		i += ReadCopied(position - consumed, e.position - consumed,
+				v + i, n - i);
+		if (i == n)
+			return i;
+
+		v[i++] = e.data;
+		position = e.position;
 	}
 
-	return nullptr;
+	i += ReadCopied(position - consumed, appended - consumed,
+			v + i, n - i);
+	return i;
+}
+
+ConstBuffer<void>
+PeakBuffer::Read() const
+{
+	ConstBuffer<void> result;
+	if (Read(&result, 1) == 0)
+		return nullptr;
+
+	return result;
 }
 
 void
-PeakBuffer::Consume(size_t length)
+PeakBuffer::ConsumeCopied(size_t length)
 {
-	if (normal_buffer != nullptr && !normal_buffer->IsEmpty()) {
-		normal_buffer->Consume(length);
-		return;
+	assert(length <= appended - consumed);
+
+	consumed += length;
+
+	if (normal_buffer != nullptr) {
+		const size_t nbytes =
+			std::min(length, normal_buffer->GetAvailable());
+		if (nbytes > 0) {
+			normal_buffer->Consume(nbytes);
+			length -= nbytes;
+		}
 	}
 
-	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
+	if (length > 0) {
+		assert(peak_buffer != nullptr);
+
 		peak_buffer->Consume(length);
 		if (peak_buffer->IsEmpty()) {
 			delete peak_buffer;
 			peak_buffer = nullptr;
 		}
+	}
+}
 
-		return;
+void
+PeakBuffer::Consume(size_t length)
+{
+	while (length > 0) {
+		const size_t copied = (externals.empty()
+				       ? appended
+				       : externals.front().position) - consumed;
+		if (copied > 0) {
+			const size_t nbytes = std::min(length, copied);
+			ConsumeCopied(nbytes);
+			length -= nbytes;
+			continue;
+		}
+
+		assert(!externals.empty());
+
+		auto &e = externals.front();
+		if (length < e.data.size) {
+			e.data.data = (const uint8_t *)e.data.data + length;
+			e.data.size -= length;
+			return;
+		}
+
+		length -= e.data.size;
+		externals.pop_front();
 	}
 }
 
@@ -108,6 +192,7 @@ PeakBuffer::Append(const void *data, size_t length)
 
 	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
 		size_t nbytes = AppendTo(*peak_buffer, data, length);
+		appended += nbytes;
 		return nbytes == length;
 	}
 
@@ -116,6 +201,7 @@ PeakBuffer::Append(const void *data, size_t length)
 
 	size_t nbytes = AppendTo(*normal_buffer, data, length);
 	if (nbytes > 0) {
+		appended += nbytes;
 		data = (const uint8_t *)data + nbytes;
 		length -= nbytes;
 		if (length == 0)
@@ -130,5 +216,42 @@ PeakBuffer::Append(const void *data, size_t length)
 	}
 
 	nbytes = AppendTo(*peak_buffer, data, length);
+	appended += nbytes;
 	return nbytes == length;
 }
+
+void
+PeakBuffer::AppendExternal(ConstBuffer<void> data,
+			   std::shared_ptr<const void> owner)
+{
+	if (data.IsEmpty())
+		return;
+
+	externals.push_back(External{data, appended, std::move(owner)});
+}
+
+WritableBuffer<void>
+PeakBuffer::Write()
+{
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty())
+		return peak_buffer->Write().ToVoid();
+
+	if (normal_buffer == nullptr)
+		normal_buffer = new DynamicFifoBuffer<uint8_t>(normal_size);
+
+	return normal_buffer->Write().ToVoid();
+}
+
+void
+PeakBuffer::Append(size_t length)
+{
+	appended += length;
+
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
+		peak_buffer->Append(length);
+		return;
+	}
+
+	assert(normal_buffer != nullptr);
+	normal_buffer->Append(length);
+}
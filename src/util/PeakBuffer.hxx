@@ -21,6 +21,10 @@
 #define MPD_PEAK_BUFFER_HXX
 
 #include "Compiler.h"
+#include "ConstBuffer.hxx"
+
+#include <list>
+#include <memory>
 
 #include <stddef.h>
 #include <stdint.h>
@@ -32,12 +36,45 @@ template<typename T> class DynamicFifoBuffer;
  * A FIFO-like buffer that will allocate more memory on demand to
  * allow large peaks.  This second buffer will be given back to the
  * kernel when it has been consumed.
+ *
+ * In addition to data copied into the buffer, it may refer to
+ * "external" buffers owned by somebody else, which are read at
+ * their position in the stream without being copied.
  */
 class PeakBuffer {
 	size_t normal_size, peak_size;
 
 	DynamicFifoBuffer<uint8_t> *normal_buffer, *peak_buffer;
 
+	/**
+	 * The total number of bytes which have been copied into this
+	 * object and the number of them which have been consumed.
+	 * These are used to determine the stream position of each
+	 * #External.
+	 */
+	size_t appended = 0, consumed = 0;
+
+	struct External {
+		/**
+		 * The part of the buffer which has not yet been
+		 * consumed.
+		 */
+		ConstBuffer<void> data;
+
+		/**
+		 * The value of #appended when this buffer was added,
+		 * i.e. it is read after this many copied bytes.
+		 */
+		size_t position;
+
+		/**
+		 * Keeps the buffer alive.
+		 */
+		std::shared_ptr<const void> owner;
+	};
+
+	std::list<External> externals;
+
 public:
 	PeakBuffer(size_t _normal_size, size_t _peak_size)
 		:normal_size(_normal_size), peak_size(_peak_size),
@@ -46,7 +83,9 @@ public:
 	PeakBuffer(PeakBuffer &&other)
 		:normal_size(other.normal_size), peak_size(other.peak_size),
 		 normal_buffer(other.normal_buffer),
-		 peak_buffer(other.peak_buffer) {
+		 peak_buffer(other.peak_buffer),
+		 appended(other.appended), consumed(other.consumed),
+		 externals(std::move(other.externals)) {
 		other.normal_buffer = nullptr;
 		other.peak_buffer = nullptr;
 	}
@@ -59,12 +98,68 @@ public:
 	gcc_pure
 	bool IsEmpty() const;
 
+	/**
+	 * Returns the number of bytes which have not yet been
+	 * consumed, including those in external buffers.
+	 */
 	gcc_pure
-	WritableBuffer<void> Read() const;
+	size_t GetSize() const;
 
+	/**
+	 * Returns the first contiguous segment of the pending data.
+	 */
+	gcc_pure
+	ConstBuffer<void> Read() const;
+
+	/**
+	 * Fill the array with up to n contiguous segments of the
+	 * pending data, in the order they shall be read.
+	 *
+	 * @return the number of segments
+	 */
+	size_t Read(ConstBuffer<void> *v, size_t n) const;
+
+	/**
+	 * Remove data from the beginning; the length may span
+	 * several segments returned by Read().
+	 */
 	void Consume(size_t length);
 
 	bool Append(const void *data, size_t length);
+
+	/**
+	 * Append a reference to a buffer which is not copied.
+	 *
+	 * @param owner a reference which keeps the buffer alive; it
+	 * is released as soon as the buffer has been consumed (or
+	 * this object is destroyed)
+	 */
+	void AppendExternal(ConstBuffer<void> data,
+			    std::shared_ptr<const void> owner);
+
+	/**
+	 * Returns the contiguous free space at the end of the buffer
+	 * which would receive the next Append() call.  The returned
+	 * buffer may be empty even though Append(const void *,
+	 * size_t) would succeed by allocating the peak buffer.
+	 */
+	WritableBuffer<void> Write();
+
+	/**
+	 * Expands the tail of the buffer, after data has been written
+	 * to the buffer returned by Write().
+	 */
+	void Append(size_t length);
+
+private:
+	/**
+	 * Append the copied data between the stream positions
+	 * #consumed+offset and #consumed+end to the array.
+	 */
+	size_t ReadCopied(size_t offset, size_t end,
+			  ConstBuffer<void> *v, size_t n) const;
+
+	void ConsumeCopied(size_t length);
 };
 
 #endif
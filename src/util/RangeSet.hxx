@@ -0,0 +1,118 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RANGE_SET_HXX
+#define MPD_RANGE_SET_HXX
+
+#include "Compiler.h"
+
+#include <map>
+#include <algorithm>
+
+/**
+ * A set of half-open ranges [start, end).  Adjacent and overlapping
+ * ranges are merged, so the set is always as small as possible.
+ */
+template<typename T>
+class RangeSet {
+	/**
+	 * Maps the start of each range to its end.  Ranges never
+	 * overlap or touch each other.
+	 */
+	std::map<T, T> ranges;
+
+public:
+	typedef typename std::map<T, T>::const_iterator const_iterator;
+
+	bool empty() const {
+		return ranges.empty();
+	}
+
+	void clear() {
+		ranges.clear();
+	}
+
+	const_iterator begin() const {
+		return ranges.begin();
+	}
+
+	const_iterator end() const {
+		return ranges.end();
+	}
+
+	/**
+	 * The total size of all ranges.
+	 */
+	gcc_pure
+	T GetTotal() const {
+		T total = 0;
+		for (const auto &i : ranges)
+			total += i.second - i.first;
+		return total;
+	}
+
+	void Add(T start, T end) {
+		if (start >= end)
+			return;
+
+		auto i = ranges.upper_bound(start);
+		if (i != ranges.begin()) {
+			auto prev = std::prev(i);
+			if (prev->second >= start) {
+				/* merge with the preceding range */
+				start = prev->first;
+				end = std::max(end, prev->second);
+				i = ranges.erase(prev);
+			}
+		}
+
+		/* swallow all following ranges which overlap or
+		   touch the new one */
+		while (i != ranges.end() && i->first <= end) {
+			end = std::max(end, i->second);
+			i = ranges.erase(i);
+		}
+
+		ranges.emplace_hint(i, start, end);
+	}
+
+	/**
+	 * If the given position is inside a range, return the end of
+	 * that range; if not, return the position.
+	 */
+	gcc_pure
+	T FindEnd(T position) const {
+		auto i = ranges.upper_bound(position);
+		if (i == ranges.begin())
+			return position;
+
+		--i;
+		return std::max(i->second, position);
+	}
+
+	/**
+	 * Is [start, end) completely covered by this set?
+	 */
+	gcc_pure
+	bool Contains(T start, T end) const {
+		return FindEnd(start) >= end;
+	}
+};
+
+#endif
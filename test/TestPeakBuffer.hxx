@@ -0,0 +1,140 @@
+/*
+ * Unit tests for class PeakBuffer.
+ */
+
+#include "check.h"
+#include "util/PeakBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <string>
+
+#include <string.h>
+
+class TestPeakBuffer : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestPeakBuffer);
+	CPPUNIT_TEST(TestPeak);
+	CPPUNIT_TEST(TestExternal);
+	CPPUNIT_TEST(TestWrite);
+	CPPUNIT_TEST_SUITE_END();
+
+	static void Append(PeakBuffer &buffer, const char *s) {
+		CPPUNIT_ASSERT(buffer.Append(s, strlen(s)));
+	}
+
+	/**
+	 * Concatenate all segments, separated by '|'.
+	 */
+	static std::string ReadAll(const PeakBuffer &buffer) {
+		ConstBuffer<void> v[8];
+		const size_t n = buffer.Read(v, 8);
+
+		std::string result;
+		for (size_t i = 0; i < n; ++i) {
+			CPPUNIT_ASSERT(!v[i].IsEmpty());
+			if (i > 0)
+				result.push_back('|');
+			result.append((const char *)v[i].data, v[i].size);
+		}
+
+		return result;
+	}
+
+public:
+	void TestPeak() {
+		PeakBuffer buffer(8, 64);
+		CPPUNIT_ASSERT(buffer.IsEmpty());
+		CPPUNIT_ASSERT(buffer.Read().IsEmpty());
+
+		/* overflow into the peak buffer */
+		Append(buffer, "0123456789ab");
+		CPPUNIT_ASSERT(!buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(std::string("01234567|89ab"),
+				     ReadAll(buffer));
+		CPPUNIT_ASSERT_EQUAL(size_t(8), buffer.Read().size);
+
+		/* new data goes to the peak buffer while it is in
+		   use */
+		buffer.Consume(8);
+		Append(buffer, "cd");
+		CPPUNIT_ASSERT_EQUAL(std::string("89abcd"), ReadAll(buffer));
+
+		/* consume across segments */
+		Append(buffer, "efghijk");
+		buffer.Consume(3);
+		CPPUNIT_ASSERT_EQUAL(std::string("bcdefghijk"),
+				     ReadAll(buffer));
+		buffer.Consume(10);
+		CPPUNIT_ASSERT(buffer.IsEmpty());
+	}
+
+	void TestExternal() {
+		PeakBuffer buffer(8, 0);
+
+		auto a = std::make_shared<std::string>("ABC");
+		auto b = std::make_shared<std::string>("XYZ");
+
+		Append(buffer, "01");
+		buffer.AppendExternal({a->data(), a->size()}, a);
+		buffer.AppendExternal({b->data(), b->size()}, b);
+		Append(buffer, "23");
+		CPPUNIT_ASSERT_EQUAL(std::string("01|ABC|XYZ|23"),
+				     ReadAll(buffer));
+		CPPUNIT_ASSERT_EQUAL(2l, a.use_count());
+
+		/* the array is too small for all segments */
+		ConstBuffer<void> v[2];
+		CPPUNIT_ASSERT_EQUAL(size_t(2), buffer.Read(v, 2));
+		CPPUNIT_ASSERT_EQUAL(size_t(3), v[1].size);
+
+		/* the first external buffer is released as soon as it
+		   has been consumed */
+		buffer.Consume(3);
+		CPPUNIT_ASSERT_EQUAL(std::string("BC|XYZ|23"),
+				     ReadAll(buffer));
+		buffer.Consume(2);
+		CPPUNIT_ASSERT_EQUAL(1l, a.use_count());
+		CPPUNIT_ASSERT_EQUAL(std::string("XYZ|23"), ReadAll(buffer));
+
+		buffer.Consume(4);
+		CPPUNIT_ASSERT_EQUAL(1l, b.use_count());
+		CPPUNIT_ASSERT_EQUAL(std::string("3"), ReadAll(buffer));
+
+		/* an external buffer at the very beginning */
+		buffer.Consume(1);
+		CPPUNIT_ASSERT(buffer.IsEmpty());
+		buffer.AppendExternal({a->data(), a->size()}, a);
+		Append(buffer, "4");
+		CPPUNIT_ASSERT_EQUAL(std::string("ABC|4"), ReadAll(buffer));
+		buffer.Consume(4);
+		CPPUNIT_ASSERT(buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(1l, a.use_count());
+	}
+
+	void TestWrite() {
+		PeakBuffer buffer(8, 16);
+
+		auto w = buffer.Write();
+		CPPUNIT_ASSERT_EQUAL(size_t(8), w.size);
+		memcpy(w.data, "0123", 4);
+		buffer.Append(size_t(4));
+		CPPUNIT_ASSERT_EQUAL(std::string("0123"), ReadAll(buffer));
+
+		/* fill the normal buffer; Write() returns nothing,
+		   but Append() still works with the peak buffer */
+		Append(buffer, "4567");
+		CPPUNIT_ASSERT(buffer.Write().IsEmpty());
+		Append(buffer, "89");
+
+		/* now Write() returns the peak buffer */
+		w = buffer.Write();
+		CPPUNIT_ASSERT_EQUAL(size_t(14), w.size);
+		memcpy(w.data, "a", 1);
+		buffer.Append(size_t(1));
+		CPPUNIT_ASSERT_EQUAL(std::string("01234567|89a"),
+				     ReadAll(buffer));
+	}
+};
@@ -0,0 +1,101 @@
+/*
+ * Unit tests for class RangeSet.
+ */
+
+#include "check.h"
+#include "util/RangeSet.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdio.h>
+
+class TestRangeSet : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestRangeSet);
+	CPPUNIT_TEST(TestAdd);
+	CPPUNIT_TEST(TestFind);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * Format all ranges as "start-end", separated by ','.
+	 */
+	static std::string ToString(const RangeSet<unsigned> &set) {
+		std::string result;
+		for (const auto &i : set) {
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "%u-%u",
+				 i.first, i.second);
+			if (!result.empty())
+				result.push_back(',');
+			result.append(buffer);
+		}
+
+		return result;
+	}
+
+public:
+	void TestAdd() {
+		RangeSet<unsigned> set;
+		CPPUNIT_ASSERT(set.empty());
+
+		/* empty ranges are ignored */
+		set.Add(5, 5);
+		CPPUNIT_ASSERT(set.empty());
+
+		set.Add(10, 20);
+		set.Add(30, 40);
+		CPPUNIT_ASSERT_EQUAL(std::string("10-20,30-40"), ToString(set));
+		CPPUNIT_ASSERT_EQUAL(20u, set.GetTotal());
+
+		/* already covered */
+		set.Add(12, 18);
+		CPPUNIT_ASSERT_EQUAL(std::string("10-20,30-40"), ToString(set));
+
+		/* touching ranges are merged */
+		set.Add(20, 25);
+		set.Add(0, 10);
+		CPPUNIT_ASSERT_EQUAL(std::string("0-25,30-40"), ToString(set));
+
+		/* overlapping with the preceding range */
+		set.Add(35, 45);
+		CPPUNIT_ASSERT_EQUAL(std::string("0-25,30-45"), ToString(set));
+
+		/* new range after all others */
+		set.Add(50, 60);
+		set.Add(70, 80);
+		CPPUNIT_ASSERT_EQUAL(std::string("0-25,30-45,50-60,70-80"),
+				     ToString(set));
+
+		/* swallow several ranges */
+		set.Add(28, 75);
+		CPPUNIT_ASSERT_EQUAL(std::string("0-25,28-80"), ToString(set));
+		CPPUNIT_ASSERT_EQUAL(77u, set.GetTotal());
+
+		set.clear();
+		CPPUNIT_ASSERT(set.empty());
+		CPPUNIT_ASSERT_EQUAL(0u, set.GetTotal());
+	}
+
+	void TestFind() {
+		RangeSet<unsigned> set;
+		CPPUNIT_ASSERT_EQUAL(3u, set.FindEnd(3));
+
+		set.Add(10, 20);
+		set.Add(30, 40);
+
+		CPPUNIT_ASSERT_EQUAL(5u, set.FindEnd(5));
+		CPPUNIT_ASSERT_EQUAL(20u, set.FindEnd(10));
+		CPPUNIT_ASSERT_EQUAL(20u, set.FindEnd(19));
+		CPPUNIT_ASSERT_EQUAL(20u, set.FindEnd(20));
+		CPPUNIT_ASSERT_EQUAL(25u, set.FindEnd(25));
+		CPPUNIT_ASSERT_EQUAL(40u, set.FindEnd(35));
+		CPPUNIT_ASSERT_EQUAL(50u, set.FindEnd(50));
+
+		CPPUNIT_ASSERT(set.Contains(10, 20));
+		CPPUNIT_ASSERT(set.Contains(12, 15));
+		CPPUNIT_ASSERT(!set.Contains(15, 25));
+		CPPUNIT_ASSERT(!set.Contains(0, 1));
+	}
+};
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program loads a text database file, writes it in the binary
+ * format (see DatabaseBinary.hxx), and then compares the time it
+ * takes to load each of them.  Finally, it verifies that both
+ * produce the same #Directory tree.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/DatabaseBinary.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/Path.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	virtual void Write(const void *data, size_t size) override {
+		value.append((const char *)data, size);
+	}
+};
+
+static void
+LoadText(Path path, Directory &root)
+{
+	TextFile file(path);
+	db_load_internal(file, root);
+}
+
+/**
+ * Serialize the tree in the text format, for comparing.
+ */
+static std::string
+ToText(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_internal(bos, root);
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+template<typename F>
+static double
+Measure(F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "Usage: bench_dbload TEXTDB BINARYDB [ROUNDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path text_path = Path::FromFS(argv[1]);
+	const Path binary_path = Path::FromFS(argv[2]);
+	const unsigned rounds = argc > 3 ? strtoul(argv[3], nullptr, 10) : 5;
+
+	std::string expected;
+
+	{
+		std::unique_ptr<Directory> root(Directory::NewRoot());
+		LoadText(text_path, *root);
+		expected = ToText(*root);
+
+		FileOutputStream fos(binary_path);
+		db_save_binary(fos, *root);
+		fos.Commit();
+	}
+
+	for (unsigned i = 0; i < rounds; ++i) {
+		for (const bool binary : {false, true}) {
+			std::unique_ptr<Directory> root(Directory::NewRoot());
+
+			const double seconds = Measure([&](){
+					if (binary)
+						db_load_binary(binary_path,
+							       *root);
+					else
+						LoadText(text_path, *root);
+				});
+
+			printf("%-6s %8.3f s\n",
+			       binary ? "binary" : "text", seconds);
+
+			if (ToText(*root) != expected)
+				throw std::runtime_error("Mismatch");
+		}
+	}
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
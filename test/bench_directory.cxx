@@ -0,0 +1,161 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program fills a flat #Directory with many songs and sub
+ * directories and measures the cost of looking them up by name.  For
+ * comparison, it also runs a linear search through the lists (which
+ * is what Directory::FindSong() does for small directories).
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+gcc_pure
+static const Song *
+LinearFindSong(const Directory &directory, const char *name)
+{
+	for (const auto &song : directory.songs)
+		if (strcmp(song.uri, name) == 0)
+			return &song;
+
+	return nullptr;
+}
+
+template<typename F>
+static double
+Measure(unsigned n, F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < n; ++i)
+		f(i);
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+static void
+Run(unsigned n_entries, unsigned n_lookups)
+{
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	std::vector<std::string> song_names, child_uris;
+	song_names.reserve(n_entries);
+	child_uris.reserve(n_entries);
+
+	for (unsigned i = 0; i < n_entries; ++i) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "track%07u.flac", i);
+		song_names.emplace_back(buffer);
+
+		snprintf(buffer, sizeof(buffer), "flat/album%07u", i);
+		child_uris.emplace_back(buffer);
+	}
+
+	const ScopeDatabaseLock protect;
+
+	/* this is what the update thread and the database loader
+	   do: look up each name before adding it */
+	Directory *flat = root->CreateChild("flat");
+	const double add_ns = Measure(n_entries, [&](unsigned i){
+			const char *name = song_names[i].c_str();
+			if (flat->FindSong(name) != nullptr)
+				throw std::runtime_error("Duplicate song");
+			flat->AddSong(Song::NewFile(name, *flat));
+
+			flat->MakeChild(child_uris[i].c_str() + 5);
+		});
+
+	/* the lookups, in random order */
+	std::mt19937 random(42);
+	std::uniform_int_distribution<unsigned> dist(0, n_entries - 1);
+	std::vector<unsigned> order(n_lookups);
+	for (auto &i : order)
+		i = dist(random);
+
+	const double song_ns = Measure(n_lookups, [&](unsigned i){
+			const char *name = song_names[order[i]].c_str();
+			const Song *song = flat->FindSong(name);
+			if (song == nullptr || strcmp(song->uri, name) != 0)
+				throw std::runtime_error("Wrong song");
+		});
+
+	const double miss_ns = Measure(n_lookups, [&](unsigned){
+			if (flat->FindSong("nonexistent.flac") != nullptr)
+				throw std::runtime_error("Wrong song");
+		});
+
+	const double lookup_ns = Measure(n_lookups, [&](unsigned i){
+			const char *uri = child_uris[order[i]].c_str();
+			const auto r = root->LookupDirectory(uri);
+			if (r.uri != nullptr ||
+			    strcmp(r.directory->GetPath(), uri) != 0)
+				throw std::runtime_error("Wrong directory");
+		});
+
+	/* the linear search is O(n), so do fewer of them */
+	const unsigned n_linear = std::max(std::min(n_lookups,
+						    100000000u / n_entries),
+					   1u);
+	const double linear_ns = Measure(n_linear, [&](unsigned i){
+			const char *name = song_names[order[i]].c_str();
+			if (LinearFindSong(*flat, name) == nullptr)
+				throw std::runtime_error("Wrong song");
+		});
+
+	printf("%7u entries: add %7.0f ns  FindSong %6.0f ns"
+	       "  miss %6.0f ns  LookupDirectory %6.0f ns"
+	       "  linear %10.0f ns\n",
+	       n_entries, add_ns, song_ns, miss_ns, lookup_ns, linear_ns);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_directory [LOOKUPS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_lookups = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 1000000;
+
+	for (const unsigned n : {10, 100, 1000, 10000, 100000})
+		Run(n, n_lookups);
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the DSD to PCM conversion
+ * for DSD64 to DSD512, comparing the original dsd2pcm code (one
+ * channel after another) with #PcmDsd.  It reports the wall-clock
+ * time needed to convert one second of audio.
+ *
+ */
+
+#include "config.h"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The number of octets converted per call.
+ */
+static constexpr size_t BLOCK_SIZE = 16384;
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+RunDsd2pcm(const uint8_t *src, size_t size, unsigned channels)
+{
+	dsd2pcm_ctx *ctx[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c)
+		ctx[c] = dsd2pcm_init();
+
+	std::unique_ptr<float[]> dest(new float[BLOCK_SIZE]);
+
+	const auto start = Clock::now();
+
+	for (size_t i = 0; i < size; i += BLOCK_SIZE)
+		for (unsigned c = 0; c < channels; ++c)
+			dsd2pcm_translate(ctx[c], BLOCK_SIZE / channels,
+					  src + i + c, channels, false,
+					  dest.get() + c, channels);
+
+	const auto end = Clock::now();
+
+	for (unsigned c = 0; c < channels; ++c)
+		dsd2pcm_destroy(ctx[c]);
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+static double
+RunPcmDsd(const uint8_t *src, size_t size, unsigned channels)
+{
+	PcmDsd dsd;
+
+	const auto start = Clock::now();
+
+	for (size_t i = 0; i < size; i += BLOCK_SIZE)
+		dsd.ToFloat(channels, {src + i, BLOCK_SIZE});
+
+	const auto end = Clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_dsd2pcm [SECONDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned seconds = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 5;
+
+	static constexpr unsigned rates[] = { 64, 128, 256, 512 };
+	static constexpr unsigned channel_counts[] = { 2, 6 };
+
+	std::minstd_rand random;
+
+	for (const unsigned rate : rates) {
+		for (const unsigned channels : channel_counts) {
+			/* DSD64 is 64 * 44.1 kHz = 352800 octets per
+			   second and channel */
+			size_t size = size_t(seconds) * rate / 8 * 44100 *
+				channels;
+			size -= size % BLOCK_SIZE;
+
+			std::unique_ptr<uint8_t[]> src(new uint8_t[size]);
+			std::generate_n(src.get(), size, random);
+
+			const double a = RunDsd2pcm(src.get(), size, channels);
+			const double b = RunPcmDsd(src.get(), size, channels);
+
+			printf("DSD%-4u %uch  dsd2pcm %8.2f ms/s  PcmDsd %8.2f ms/s  %5.2fx\n",
+			       rate, channels,
+			       a * 1000. / seconds, b * 1000. / seconds,
+			       a / b);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
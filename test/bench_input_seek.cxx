@@ -0,0 +1,172 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program opens an input stream and accesses it like a decoder
+ * which probes the file: it reads the header, looks for tags at the
+ * end, seeks back and reads on; then it does a number of random
+ * seeks.  It reports how long each phase takes, which is mostly
+ * latency for remote streams.
+ *
+ */
+
+#include "config.h"
+#include "config/ConfigGlobal.hxx"
+#include "input/InputStream.hxx"
+#include "input/Init.hxx"
+#include "ScopeIOThread.hxx"
+#include "fs/Path.hxx"
+#include "thread/Cond.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of bytes read after each seek.
+ */
+static constexpr size_t READ_SIZE = 16384;
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+Milliseconds(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void
+SeekAndRead(InputStream &is, offset_type offset, size_t length)
+{
+	is.Seek(offset);
+
+	static char buffer[READ_SIZE];
+	while (length > 0 && !is.IsEOF()) {
+		size_t nbytes = is.Read(buffer,
+					std::min(length, sizeof(buffer)));
+		if (nbytes == 0)
+			break;
+
+		length -= nbytes;
+	}
+}
+
+static void
+Run(InputStream &is, unsigned n_seeks)
+{
+	const ScopeLock protect(is.mutex);
+
+	if (!is.IsSeekable() || !is.KnownSize())
+		throw std::runtime_error("Stream is not seekable");
+
+	const offset_type size = is.GetSize();
+	if (size < offset_type(4 * READ_SIZE))
+		throw std::runtime_error("Stream is too small");
+
+	/* what decoder plugins do while probing a file: header,
+	   ID3v1 tag, APE tag footer, back to the audio data */
+
+	auto start = Clock::now();
+	SeekAndRead(is, 0, 4096);
+	const double header = Milliseconds(start);
+
+	start = Clock::now();
+	SeekAndRead(is, size - 128, 128);
+	SeekAndRead(is, size - 160, 32);
+	const double tail = Milliseconds(start);
+
+	start = Clock::now();
+	SeekAndRead(is, 4096, READ_SIZE);
+	const double back = Milliseconds(start);
+
+	printf("header %8.1f ms\n"
+	       "tail   %8.1f ms\n"
+	       "back   %8.1f ms\n",
+	       header, tail, back);
+
+	/* random seeks, like a user dragging the position slider */
+
+	if (n_seeks == 0)
+		return;
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<offset_type> dist(0, size - READ_SIZE);
+
+	double total = 0, worst = 0;
+	for (unsigned i = 0; i < n_seeks; ++i) {
+		start = Clock::now();
+		SeekAndRead(is, dist(rng), READ_SIZE);
+		const double t = Milliseconds(start);
+		total += t;
+		worst = std::max(worst, t);
+	}
+
+	printf("seek   %8.1f ms average, %.1f ms worst (%u seeks)\n",
+	       total / n_seeks, worst, n_seeks);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr,
+			"Usage: bench_input_seek URI [SEEKS] [CONFIG]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_seeks = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: 20;
+
+	/* initialize MPD */
+
+	config_global_init();
+	if (argc > 3)
+		ReadConfigFile(Path::FromFS(argv[3]));
+
+	const ScopeIOThread io_thread;
+
+	input_stream_global_init();
+
+	{
+		Mutex mutex;
+		Cond cond;
+
+		const auto start = Clock::now();
+		auto is = InputStream::OpenReady(argv[1], mutex, cond);
+		printf("open   %8.1f ms\n", Milliseconds(start));
+
+		Run(*is, n_seeks);
+	}
+
+	/* deinitialize everything */
+
+	input_stream_global_finish();
+	config_global_finish();
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
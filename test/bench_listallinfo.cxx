@@ -0,0 +1,272 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program loads a database (like DumpDatabase) and generates
+ * the "listallinfo" response for it, writing into a
+ * #FullyBufferedSocket which is drained by another thread.  It
+ * compares formatting each line into a temporary heap allocation
+ * (the old client_printf() implementation) with formatting right
+ * into the socket's output buffer.
+ */
+
+#include "config.h"
+#include "db/Registry.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/Interface.hxx"
+#include "db/Selection.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/LightDirectory.hxx"
+#include "db/LightSong.hxx"
+#include "db/PlaylistVector.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/Param.hxx"
+#include "config/Block.hxx"
+#include "tag/TagConfig.hxx"
+#include "tag/Tag.hxx"
+#include "event/Loop.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "fs/Path.hxx"
+#include "util/FormatString.hxx"
+#include "util/AllocatedString.hxx"
+#include "util/ScopeExit.hxx"
+#include "Log.hxx"
+#include "Compiler.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#ifdef ENABLE_UPNP
+#include "input/InputStream.hxx"
+size_t
+InputStream::LockRead(void *, size_t)
+{
+	return 0;
+}
+#endif
+
+class DummyDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const char *) override {}
+};
+
+/**
+ * A socket which is flushed explicitly by the benchmark instead of
+ * the #EventLoop.  The peer is a blocking socket, so each Flush()
+ * call sends all of the contiguous data.
+ */
+class BenchSocket final : public FullyBufferedSocket {
+	const bool allocate;
+
+public:
+	unsigned long lines = 0;
+
+	BenchSocket(int _fd, EventLoop &_loop, bool _allocate)
+		:FullyBufferedSocket(_fd, _loop, 16384, 8 * 1024 * 1024),
+		 allocate(_allocate) {}
+
+	gcc_printf(2, 3)
+	void Format(const char *fmt, ...) {
+		va_list args;
+		va_start(args, fmt);
+
+		if (allocate) {
+			const auto s = FormatStringV(fmt, args);
+			Write(s.c_str(), strlen(s.c_str()));
+		} else
+			FormatV(fmt, args);
+
+		va_end(args);
+		++lines;
+	}
+
+	void FlushAll() {
+		/* the normal buffer and then the peak buffer */
+		Flush();
+		Flush();
+	}
+
+	using FullyBufferedSocket::Close;
+
+protected:
+	virtual InputResult OnSocketInput(void *, size_t) override {
+		return InputResult::MORE;
+	}
+
+	virtual void OnSocketError(std::exception_ptr ep) override {
+		std::rethrow_exception(ep);
+	}
+
+	virtual void OnSocketClosed() override {
+		throw std::runtime_error("Socket closed");
+	}
+};
+
+/**
+ * Print a song like song_print_info() does for "listallinfo".
+ */
+static void
+PrintSong(BenchSocket &s, const LightSong &song)
+{
+	if (song.directory != nullptr)
+		s.Format("file: %s/%s\n", song.directory, song.uri);
+	else
+		s.Format("file: %s\n", song.uri);
+
+	if (song.mtime > 0) {
+		struct tm tm;
+		if (gmtime_r(&song.mtime, &tm) != nullptr) {
+			char buffer[32];
+			strftime(buffer, sizeof(buffer), "%FT%TZ", &tm);
+			s.Format("%s: %s\n", "Last-Modified", buffer);
+		}
+	}
+
+	const Tag &tag = *song.tag;
+	if (!tag.duration.IsNegative())
+		s.Format("Time: %i\n"
+			 "duration: %1.3f\n",
+			 tag.duration.RoundS(),
+			 tag.duration.ToDoubleS());
+
+	for (const auto &i : tag)
+		s.Format("%s: %s\n", tag_item_names[i.type], i.value);
+}
+
+struct Result {
+	unsigned long songs = 0, lines = 0;
+	size_t bytes = 0;
+	double seconds;
+};
+
+static Result
+Run(EventLoop &event_loop, const Database &db, bool allocate)
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+		throw std::runtime_error("socketpair() failed");
+
+	Result result;
+
+	std::thread reader([fd = fds[1], &result](){
+			char buffer[65536];
+			ssize_t nbytes;
+			while ((nbytes = read(fd, buffer, sizeof(buffer))) > 0)
+				result.bytes += nbytes;
+			close(fd);
+		});
+
+	BenchSocket s(fds[0], event_loop, allocate);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	const DatabaseSelection selection("", true);
+	db.Visit(selection,
+		 [&s](const LightDirectory &directory){
+			 s.Format("directory: %s\n", directory.GetPath());
+		 },
+		 [&s, &result](const LightSong &song){
+			 PrintSong(s, song);
+
+			 if (++result.songs % 64 == 0)
+				 s.FlushAll();
+		 },
+		 [&s](const PlaylistInfo &playlist, const LightDirectory &){
+			 s.Format("playlist: %s\n", playlist.name.c_str());
+		 });
+
+	s.Format("OK\n");
+	s.FlushAll();
+	s.Close();
+	reader.join();
+
+	const auto end = std::chrono::steady_clock::now();
+	result.seconds = std::chrono::duration<double>(end - start).count();
+	result.lines = s.lines;
+	return result;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "Usage: bench_listallinfo CONFIG PLUGIN [ROUNDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path config_path = Path::FromFS(argv[1]);
+	const char *const plugin_name = argv[2];
+	const unsigned rounds = argc > 3 ? strtoul(argv[3], nullptr, 10) : 5;
+
+	const DatabasePlugin *plugin = GetDatabasePluginByName(plugin_name);
+	if (plugin == NULL) {
+		fprintf(stderr, "No such database plugin: %s\n", plugin_name);
+		return EXIT_FAILURE;
+	}
+
+	config_global_init();
+	AtScopeExit() { config_global_finish(); };
+
+	ReadConfigFile(config_path);
+
+	TagLoadConfig();
+
+	EventLoop event_loop;
+	DummyDatabaseListener database_listener;
+
+	const auto *path = config_get_param(ConfigOption::DB_FILE);
+	ConfigBlock block(path != nullptr ? path->line : -1);
+	if (path != nullptr)
+		block.AddBlockParam("path", path->value.c_str(), path->line);
+
+	Database *db = plugin->create(event_loop, database_listener, block);
+
+	AtScopeExit(db) { delete db; };
+
+	db->Open();
+
+	AtScopeExit(db) { db->Close(); };
+
+	for (unsigned i = 0; i < rounds; ++i) {
+		for (const bool allocate : {true, false}) {
+			const auto result = Run(event_loop, *db, allocate);
+			printf("%-9s %8lu songs %10lu lines %11zu bytes"
+			       " %8.3f s %12.0f lines/s\n",
+			       allocate ? "allocate" : "direct",
+			       result.songs, result.lines, result.bytes,
+			       result.seconds,
+			       result.lines / result.seconds);
+		}
+	}
+
+	return EXIT_SUCCESS;
+ } catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+ }
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program simulates the decoder and output threads passing
+ * audio through #MusicBuffer and #MusicPipe, and reports how many
+ * synchronized operations each second of audio costs for several
+ * audio formats and chunk sizes.
+ *
+ */
+
+#include "config.h"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "Chrono.hxx"
+#include "util/WritableBuffer.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of chunks in the #MusicBuffer; the pipe is drained
+ * whenever it is full.
+ */
+static constexpr unsigned BUFFER_CHUNKS = 64;
+
+/**
+ * The number of frames submitted by one simulated decoder call.
+ */
+static constexpr size_t DECODER_FRAMES = 1152;
+
+struct Result {
+	/**
+	 * Number of synchronized operations on #MusicBuffer and
+	 * #MusicPipe.
+	 */
+	unsigned long locks = 0;
+
+	double seconds;
+};
+
+static void
+Drain(MusicBuffer &buffer, MusicPipe &pipe, Result &result)
+{
+	MusicChunk *chunk;
+	while (++result.locks, (chunk = pipe.Shift()) != nullptr) {
+		buffer.Return(chunk);
+		++result.locks;
+	}
+}
+
+static Result
+Run(const AudioFormat af, size_t chunk_size, unsigned audio_seconds)
+{
+	MusicBuffer buffer(BUFFER_CHUNKS, chunk_size);
+	MusicPipe pipe;
+	Result result;
+
+	/* large enough for stereo with 32 bit samples */
+	static uint8_t source[DECODER_FRAMES * 2 * sizeof(int32_t)];
+	const size_t frame_size = af.GetFrameSize();
+	const size_t total = size_t(audio_seconds) * af.GetTimeToSize();
+
+	MusicChunk *chunk = nullptr;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t done = 0; done < total;) {
+		size_t nbytes = DECODER_FRAMES * frame_size;
+		if (nbytes > total - done)
+			nbytes = total - done;
+
+		const uint8_t *p = source;
+		while (nbytes > 0) {
+			if (chunk == nullptr) {
+				++result.locks;
+				chunk = buffer.Allocate();
+				if (chunk == nullptr) {
+					Drain(buffer, pipe, result);
+					continue;
+				}
+			}
+
+			auto w = chunk->Write(af, SongTime::zero(), 0);
+			size_t n = std::min(w.size, nbytes);
+			memcpy(w.data, p, n);
+			p += n;
+			nbytes -= n;
+			done += n;
+
+			if (chunk->Expand(af, n)) {
+				++result.locks;
+				pipe.Push(chunk);
+				chunk = nullptr;
+			}
+		}
+	}
+
+	if (chunk != nullptr) {
+		++result.locks;
+		pipe.Push(chunk);
+	}
+
+	Drain(buffer, pipe, result);
+
+	const auto end = std::chrono::steady_clock::now();
+	result.seconds = std::chrono::duration<double>(end - start).count();
+	return result;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_music_pipe [SECONDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned audio_seconds = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 60;
+
+	static const AudioFormat formats[] = {
+		AudioFormat(44100, SampleFormat::S16, 2),
+		AudioFormat(96000, SampleFormat::S24_P32, 2),
+		AudioFormat(192000, SampleFormat::S32, 2),
+		AudioFormat(384000, SampleFormat::S32, 2),
+	};
+
+	static constexpr size_t chunk_sizes[] = {
+		DEFAULT_CHUNK_SIZE, 16384, 65536, 262144,
+	};
+
+	for (const auto &af : formats) {
+		for (auto chunk_size : chunk_sizes) {
+			const auto r = Run(af, chunk_size, audio_seconds);
+
+			struct audio_format_string af_string;
+			printf("%-12s chunk=%-7u %10.1f locks/s of audio"
+			       " %8.3f ms CPU/s of audio\n",
+			       audio_format_to_string(af, &af_string),
+			       unsigned(chunk_size),
+			       double(r.locks) / audio_seconds,
+			       r.seconds * 1000. / audio_seconds);
+		}
+	}
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
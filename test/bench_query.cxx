@@ -0,0 +1,282 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program loads a database three times: with a single query
+ * thread, with the default "query_threads" and with the "tag_index"
+ * option.  It compares the time it takes to run typical client
+ * queries on them: browsing the albums of an artist, expanding an
+ * album into its songs and case-insensitive searches (the "any" one
+ * being the most filter-heavy).  It verifies that all of them
+ * produce the same results.
+ */
+
+#include "config.h"
+#include "db/Registry.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/Interface.hxx"
+#include "db/Selection.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/LightSong.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/Param.hxx"
+#include "config/Block.hxx"
+#include "tag/TagConfig.hxx"
+#include "tag/Tag.hxx"
+#include "event/Loop.hxx"
+#include "fs/Path.hxx"
+#include "SongFilter.hxx"
+#include "util/ScopeExit.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ENABLE_UPNP
+#include "input/InputStream.hxx"
+size_t
+InputStream::LockRead(void *, size_t)
+{
+	return 0;
+}
+#endif
+
+class DummyDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const char *) override {}
+};
+
+/**
+ * A checksum of query results, to compare them.
+ */
+struct Digest {
+	unsigned long n = 0;
+	size_t hash = 2166136261u;
+
+	void Update(const char *s) {
+		++n;
+
+		/* FNV-1a */
+		while (*s != 0)
+			hash = (hash ^ (unsigned char)*s++) * 16777619u;
+		hash *= 16777619u;
+	}
+
+	bool operator==(const Digest &other) const {
+		return n == other.n && hash == other.hash;
+	}
+};
+
+/**
+ * Collect every n-th value of the given tag.
+ */
+static std::vector<std::string>
+Sample(const Database &db, TagType type, unsigned n)
+{
+	std::vector<std::string> result;
+	unsigned i = 0;
+
+	db.VisitUniqueTags(DatabaseSelection("", true), type, 0,
+			   [type, n, &i, &result](const Tag &tag){
+				   if (i++ % n == 0)
+					   result.emplace_back(tag.GetValue(type));
+			   });
+
+	return result;
+}
+
+/**
+ * "list album artist X"
+ */
+static void
+ListAlbums(const Database &db, const char *artist, Digest &digest)
+{
+	const SongFilter filter(TAG_ARTIST, artist);
+	db.VisitUniqueTags(DatabaseSelection("", true, &filter),
+			   TAG_ALBUM, 0,
+			   [&digest](const Tag &tag){
+				   digest.Update(tag.GetValue(TAG_ALBUM));
+			   });
+}
+
+static void
+VisitFilter(const Database &db, const SongFilter &filter, Digest &digest)
+{
+	db.Visit(DatabaseSelection("", true, &filter),
+		 [&digest](const LightSong &song){
+			 digest.Update(song.uri);
+		 });
+}
+
+/**
+ * "find album X"
+ */
+static void
+FindAlbum(const Database &db, const char *album, Digest &digest)
+{
+	VisitFilter(db, SongFilter(TAG_ALBUM, album), digest);
+}
+
+/**
+ * "search artist X"
+ */
+static void
+SearchArtist(const Database &db, const char *artist, Digest &digest)
+{
+	VisitFilter(db, SongFilter(TAG_ARTIST, artist, true), digest);
+}
+
+/**
+ * "search any X"
+ */
+static void
+SearchAny(const Database &db, const char *value, Digest &digest)
+{
+	VisitFilter(db, SongFilter(LOCATE_TAG_ANY_TYPE, value, true), digest);
+}
+
+typedef void (*Query)(const Database &db, const char *value,
+		      Digest &digest);
+
+static Digest
+Run(const char *name, const char *mode, const Database &db,
+    Query query, const std::vector<std::string> &values)
+{
+	Digest digest;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto &value : values)
+		query(db, value.c_str(), digest);
+	const auto end = std::chrono::steady_clock::now();
+
+	const double seconds = std::chrono::duration<double>(end - start).count();
+	printf("%-13s %-5s %6zu queries %9lu results %9.3f ms/query\n",
+	       name, mode, values.size(), digest.n,
+	       seconds * 1000 / values.size());
+	return digest;
+}
+
+static void
+Compare(const char *name, const Database &scan, const Database &parallel,
+	const Database &index,
+	Query query, const std::vector<std::string> &values)
+{
+	/* warm up (e.g. the case-folded values cached by the
+	   TagPool), so the first database doesn't pay for it */
+	Digest dummy;
+	query(scan, values.front().c_str(), dummy);
+
+	const auto a = Run(name, "scan", scan, query, values);
+	const auto b = Run(name, "par", parallel, query, values);
+	const auto c = Run(name, "index", index, query, values);
+	if (!(a == b) || !(a == c))
+		throw std::runtime_error("Mismatch");
+}
+
+static Database *
+OpenDatabase(const DatabasePlugin &plugin, EventLoop &event_loop,
+	     DatabaseListener &listener, const char *path, bool tag_index,
+	     const char *query_threads)
+{
+	ConfigBlock block;
+	block.AddBlockParam("path", path);
+	block.AddBlockParam("tag_index", tag_index ? "yes" : "no");
+	block.AddBlockParam("query_threads", query_threads);
+
+	std::unique_ptr<Database> db(plugin.create(event_loop, listener,
+						   block));
+	db->Open();
+	return db.release();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "Usage: bench_query CONFIG [SAMPLE_INTERVAL] [QUERY_THREADS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path config_path = Path::FromFS(argv[1]);
+	const unsigned interval = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20;
+	const char *const query_threads = argc > 3 ? argv[3] : "0";
+
+	config_global_init();
+	AtScopeExit() { config_global_finish(); };
+
+	ReadConfigFile(config_path);
+
+	TagLoadConfig();
+
+	const auto *path = config_get_param(ConfigOption::DB_FILE);
+	if (path == nullptr)
+		throw std::runtime_error("No db_file configured");
+
+	EventLoop event_loop;
+	DummyDatabaseListener database_listener;
+
+	const DatabasePlugin &plugin = *GetDatabasePluginByName("simple");
+
+	Database *scan = OpenDatabase(plugin, event_loop, database_listener,
+				      path->value.c_str(), false, "1");
+	AtScopeExit(scan) { scan->Close(); delete scan; };
+
+	Database *parallel = OpenDatabase(plugin, event_loop,
+					  database_listener,
+					  path->value.c_str(), false,
+					  query_threads);
+	AtScopeExit(parallel) { parallel->Close(); delete parallel; };
+
+	Database *index = OpenDatabase(plugin, event_loop, database_listener,
+				       path->value.c_str(), true, "1");
+	AtScopeExit(index) { index->Close(); delete index; };
+
+	const auto artists = Sample(*scan, TAG_ARTIST, interval);
+	const auto albums = Sample(*scan, TAG_ALBUM, interval);
+
+	/* a case-insensitive substring of each artist name */
+	std::vector<std::string> searches;
+	for (const auto &artist : artists) {
+		std::string s = artist.substr(artist.length() / 2);
+		for (auto &ch : s)
+			ch = toupper(ch);
+		searches.emplace_back(std::move(s));
+	}
+
+	Compare("list album", *scan, *parallel, *index, ListAlbums, artists);
+	Compare("find album", *scan, *parallel, *index, FindAlbum, albums);
+	Compare("search artist", *scan, *parallel, *index,
+		SearchArtist, searches);
+	Compare("search any", *scan, *parallel, *index,
+		SearchAny, searches);
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
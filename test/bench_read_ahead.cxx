@@ -0,0 +1,231 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program simulates a decoder which consumes a file at a
+ * constant rate from slow storage (e.g. a spun-down disk or a
+ * network mount) which stalls now and then.  It compares reading
+ * directly with reading through a #ThreadInputStream with various
+ * buffer sizes, and reports how long the decoder was blocked in
+ * Read().
+ *
+ */
+
+#include "config.h"
+#include "input/ThreadInputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * The size of the simulated file.
+ */
+static constexpr offset_type FILE_SIZE = 8 * 1024 * 1024;
+
+/**
+ * The number of bytes the simulated decoder reads at a time.
+ */
+static constexpr size_t CHUNK_SIZE = 8192;
+
+/**
+ * The storage delivers this many bytes per second when it is not
+ * stalled.
+ */
+static constexpr double STORAGE_RATE = 16 * 1024 * 1024;
+
+/**
+ * The storage stalls for #STALL_DURATION after each #STALL_INTERVAL
+ * bytes.
+ */
+static constexpr offset_type STALL_INTERVAL = 2 * 1024 * 1024;
+static constexpr std::chrono::milliseconds STALL_DURATION(300);
+
+/**
+ * The simulated decoder consumes this many bytes per second.
+ */
+static constexpr double CONSUME_RATE = 2 * 1024 * 1024;
+
+/**
+ * Block the calling thread like slow storage would when reading the
+ * given range.
+ */
+static void
+SimulateStorage(offset_type offset, size_t size)
+{
+	if ((offset + size) / STALL_INTERVAL != offset / STALL_INTERVAL)
+		std::this_thread::sleep_for(STALL_DURATION);
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(size / STORAGE_RATE));
+}
+
+/**
+ * Reads from the simulated storage in the caller's thread, like
+ * the "file" input plugin does by default.
+ */
+class DirectInputStream final : public InputStream {
+public:
+	DirectInputStream(Mutex &_mutex, Cond &_cond)
+		:InputStream("slow://direct", _mutex, _cond) {
+		size = FILE_SIZE;
+		seekable = true;
+		SetReady();
+	}
+
+	bool IsEOF() override {
+		return offset >= FILE_SIZE;
+	}
+
+	size_t Read(gcc_unused void *ptr, size_t read_size) override {
+		read_size = std::min<offset_type>(read_size, FILE_SIZE - offset);
+
+		{
+			const ScopeUnlock unlock(mutex);
+			SimulateStorage(offset, read_size);
+		}
+
+		offset += read_size;
+		return read_size;
+	}
+};
+
+/**
+ * Reads from the simulated storage in a separate thread.
+ */
+class ReadAheadInputStream final : public ThreadInputStream {
+	offset_type position = 0;
+
+public:
+	ReadAheadInputStream(Mutex &_mutex, Cond &_cond, size_t _buffer_size)
+		:ThreadInputStream("slow", "slow://read_ahead",
+				   _mutex, _cond, _buffer_size) {
+		size = FILE_SIZE;
+		seekable = true;
+		SetReady();
+	}
+
+	~ReadAheadInputStream() {
+		Stop();
+	}
+
+protected:
+	size_t ThreadRead(gcc_unused void *ptr, size_t read_size) override {
+		read_size = std::min<offset_type>(read_size,
+						  FILE_SIZE - position);
+		SimulateStorage(position, read_size);
+		position += read_size;
+		return read_size;
+	}
+
+	void ThreadSeek(offset_type new_offset) override {
+		position = new_offset;
+	}
+};
+
+/**
+ * Consume the whole stream at #CONSUME_RATE and print how long
+ * Read() blocked.
+ */
+static void
+Consume(const char *name, InputStream &is)
+{
+	static char buffer[CHUNK_SIZE];
+
+	const auto start = Clock::now();
+	Clock::duration total_stall = Clock::duration::zero();
+	Clock::duration max_stall = Clock::duration::zero();
+	unsigned n_stalls = 0;
+	offset_type position = 0;
+
+	while (true) {
+		const auto before = Clock::now();
+		size_t nbytes = is.LockRead(buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		const auto stall = Clock::now() - before;
+		total_stall += stall;
+		max_stall = std::max(max_stall, stall);
+
+		/* a decoder can hide small delays in the output
+		   buffer; only count what it would notice */
+		if (stall > std::chrono::milliseconds(10))
+			++n_stalls;
+
+		position += nbytes;
+
+		/* wait until the (simulated) output plugin needs
+		   more data */
+		std::this_thread::sleep_until(start +
+					      std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(position / CONSUME_RATE)));
+	}
+
+	typedef std::chrono::duration<double, std::milli> Milliseconds;
+	printf("%-20s blocked %8.1f ms  max %7.1f ms  stalls %3u  total %6.1f s\n",
+	       name,
+	       Milliseconds(total_stall).count(),
+	       Milliseconds(max_stall).count(),
+	       n_stalls,
+	       std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+int
+main(int argc, gcc_unused char **argv)
+try {
+	if (argc != 1) {
+		fprintf(stderr, "Usage: bench_read_ahead\n");
+		return EXIT_FAILURE;
+	}
+
+	Mutex mutex;
+	Cond cond;
+
+	{
+		DirectInputStream is(mutex, cond);
+		Consume("direct", is);
+	}
+
+	static constexpr size_t buffer_sizes[] = {
+		256 * 1024,
+		1024 * 1024,
+		4 * 1024 * 1024,
+	};
+
+	for (size_t buffer_size : buffer_sizes) {
+		char name[32];
+		snprintf(name, sizeof(name), "read_ahead %zu KiB",
+			 buffer_size / 1024);
+
+		ReadAheadInputStream is(mutex, cond, buffer_size);
+		is.Start();
+		Consume(name, is);
+	}
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program fills an in-memory database with many synthetic songs
+ * and measures a case-insensitive "search any" on it.  The first
+ * round has to case-fold each tag value, the following rounds use
+ * the folded values cached by the #TagPool.  For comparison, it also
+ * runs a matcher which folds each tag value again for each song (the
+ * old SongFilter implementation), and verifies that both find the
+ * same songs.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/LightSong.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "lib/icu/Collate.hxx"
+#include "util/AllocatedString.hxx"
+#include "util/ScopeExit.hxx"
+#include "SongFilter.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr unsigned SONGS_PER_ALBUM = 12;
+
+static const char *const genres[] = {
+	"Rock", "Pop", "Jazz", "Classical", "Electronic", "Hip-Hop",
+	"Folk", "Metal", "Blues", "Soundtrack",
+};
+
+static const char *const words[] = {
+	"Love", "Night", "Dream", "Fire", "Rain", "Heart", "Blue",
+	"Summer", "Ghost", "River", "Light", "Shadow", "Gold", "Stone",
+	"Über", "Straße", "Ωmega", "Café",
+};
+
+static constexpr unsigned N_WORDS = sizeof(words) / sizeof(words[0]);
+
+static void
+Fill(Directory &root, unsigned n_songs)
+{
+	const ScopeDatabaseLock protect;
+
+	char buffer[256];
+	TagBuilder tag;
+
+	Directory *album_directory = nullptr;
+	for (unsigned i = 0; i < n_songs; ++i) {
+		const unsigned album = i / SONGS_PER_ALBUM;
+		const unsigned artist = album / 8;
+
+		if (i % SONGS_PER_ALBUM == 0) {
+			snprintf(buffer, sizeof(buffer), "artist%05u", artist);
+			Directory *artist_directory = root.MakeChild(buffer);
+
+			snprintf(buffer, sizeof(buffer), "album%06u", album);
+			album_directory = artist_directory->MakeChild(buffer);
+		}
+
+		snprintf(buffer, sizeof(buffer), "Artist %s %u",
+			 words[artist % N_WORDS], artist);
+		tag.AddItem(TAG_ARTIST, buffer);
+
+		snprintf(buffer, sizeof(buffer), "%s %s No. %u",
+			 words[album % N_WORDS],
+			 words[(album / N_WORDS) % N_WORDS], album);
+		tag.AddItem(TAG_ALBUM, buffer);
+
+		snprintf(buffer, sizeof(buffer), "%s of the %s (Part %u)",
+			 words[(i * 7) % N_WORDS],
+			 words[(i / N_WORDS) % N_WORDS], i);
+		tag.AddItem(TAG_TITLE, buffer);
+
+		snprintf(buffer, sizeof(buffer), "%u",
+			 i % SONGS_PER_ALBUM + 1);
+		tag.AddItem(TAG_TRACK, buffer);
+
+		tag.AddItem(TAG_GENRE, genres[album % 10]);
+
+		snprintf(buffer, sizeof(buffer), "%02u.flac",
+			 i % SONGS_PER_ALBUM + 1);
+		Song *song = Song::NewFile(buffer, *album_directory);
+		tag.Commit(song->tag);
+		album_directory->AddSong(song);
+	}
+}
+
+/**
+ * The old SongFilter::Item::StringMatch() for LOCATE_TAG_ANY_TYPE:
+ * fold each tag value again for each song.
+ */
+gcc_pure
+static bool
+LegacyMatch(const LightSong &song, const char *needle)
+{
+	for (const auto &item : *song.tag) {
+		const auto folded = IcuCaseFold(item.value);
+		if (strstr(folded.c_str(), needle) != nullptr)
+			return true;
+	}
+
+	return false;
+}
+
+struct Result {
+	unsigned long hits = 0;
+	double seconds;
+};
+
+template<typename F>
+static Result
+Run(const Directory &root, const SongFilter *filter, F &&f)
+{
+	Result result;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	const ScopeDatabaseSharedLock protect;
+	root.Walk(true, filter, nullptr,
+		  [&result, &f](const LightSong &song){
+			  if (f(song))
+				  ++result.hits;
+		  }, nullptr);
+
+	const auto end = std::chrono::steady_clock::now();
+	result.seconds = std::chrono::duration<double>(end - start).count();
+	return result;
+}
+
+static void
+Print(const char *label, const Result &result)
+{
+	printf("%-8s %8lu hits %8.3f s\n", label, result.hits, result.seconds);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "Usage: bench_search NEEDLE [SONGS] [ROUNDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *const needle = argv[1];
+	const unsigned n_songs = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: 500000;
+	const unsigned rounds = argc > 3
+		? strtoul(argv[3], nullptr, 10)
+		: 5;
+
+	IcuCollateInit();
+	AtScopeExit() { IcuCollateFinish(); };
+
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+	AtScopeExit(&root) {
+		const ScopeDatabaseLock protect;
+		root.reset();
+	};
+
+	Fill(*root, n_songs);
+
+	const SongFilter filter(LOCATE_TAG_ANY_TYPE, needle, true);
+	const auto folded_needle = IcuCaseFold(needle);
+
+	unsigned long hits = 0;
+	for (unsigned i = 0; i < rounds; ++i) {
+		const auto result = Run(*root, &filter,
+					[](const LightSong &){ return true; });
+		Print(i == 0 ? "cold" : "cached", result);
+		hits = result.hits;
+	}
+
+	for (unsigned i = 0; i < rounds; ++i) {
+		const auto result = Run(*root, nullptr,
+					[&folded_needle](const LightSong &song){
+						return LegacyMatch(song, folded_needle.c_str());
+					});
+		Print("legacy", result);
+
+		if (result.hits != hits)
+			throw std::runtime_error("Results differ");
+	}
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program creates a synthetic music directory with small DSF
+ * files, and then scans it with #UpdateWalk (like "update" and
+ * "rescan" do), once for each number of tag scanner threads.  The
+ * latency of a network file system can be simulated with a delay
+ * in each Storage::GetInfo() call.
+ */
+
+#include "config.h"
+#include "db/update/Walk.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "storage/StorageInterface.hxx"
+#include "storage/FileInfo.hxx"
+#include "storage/plugins/LocalStorage.hxx"
+#include "decoder/DecoderList.hxx"
+#include "input/Init.hxx"
+#include "playlist/PlaylistRegistry.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "tag/TagConfig.hxx"
+#include "event/Loop.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/Path.hxx"
+#include "system/ByteOrder.hxx"
+#include "util/ScopeExit.hxx"
+#include "ScopeIOThread.hxx"
+#include "Log.hxx"
+#include "LogBackend.hxx"
+
+#ifdef ENABLE_ARCHIVE
+#include "archive/ArchiveList.hxx"
+#endif
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+class DummyDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const char *) override {}
+};
+
+/**
+ * A #Storage wrapper which sleeps in each GetInfo() call.
+ */
+class SlowStorage final : public Storage {
+	Storage &storage;
+	const std::chrono::microseconds latency;
+
+public:
+	SlowStorage(Storage &_storage, std::chrono::microseconds _latency)
+		:storage(_storage), latency(_latency) {}
+
+	virtual StorageFileInfo GetInfo(const char *uri_utf8,
+					bool follow) override {
+		if (latency.count() > 0)
+			std::this_thread::sleep_for(latency);
+		return storage.GetInfo(uri_utf8, follow);
+	}
+
+	virtual StorageDirectoryReader *OpenDirectory(const char *uri_utf8) override {
+		return storage.OpenDirectory(uri_utf8);
+	}
+
+	virtual std::string MapUTF8(const char *uri_utf8) const override {
+		return storage.MapUTF8(uri_utf8);
+	}
+
+	virtual AllocatedPath MapFS(const char *uri_utf8) const override {
+		return storage.MapFS(uri_utf8);
+	}
+
+	virtual const char *MapToRelativeUTF8(const char *uri_utf8) const override {
+		return storage.MapToRelativeUTF8(uri_utf8);
+	}
+};
+
+static void
+Store64(uint8_t *p, uint64_t value)
+{
+	value = ToLE64(value);
+	memcpy(p, &value, sizeof(value));
+}
+
+static void
+Store32(uint8_t *p, uint32_t value)
+{
+	value = ToLE32(value);
+	memcpy(p, &value, sizeof(value));
+}
+
+/**
+ * Write a DSF file with one block of silence per channel.
+ */
+static void
+WriteDsf(const char *path)
+{
+	static constexpr size_t BLOCK_SIZE = 4096;
+	static constexpr unsigned CHANNELS = 2;
+	static constexpr size_t HEADER_SIZE = 28 + 52 + 12;
+	static constexpr size_t DATA_SIZE = BLOCK_SIZE * CHANNELS;
+
+	static uint8_t buffer[HEADER_SIZE + DATA_SIZE];
+	if (buffer[0] == 0) {
+		uint8_t *p = buffer;
+		memcpy(p, "DSD ", 4);
+		Store64(p + 4, 28);
+		Store64(p + 12, sizeof(buffer));
+		Store64(p + 20, 0);
+		p += 28;
+
+		memcpy(p, "fmt ", 4);
+		Store64(p + 4, 52);
+		Store32(p + 12, 1); /* version */
+		Store32(p + 16, 0); /* format id */
+		Store32(p + 20, CHANNELS); /* channel type: stereo */
+		Store32(p + 24, CHANNELS);
+		Store32(p + 28, 2822400);
+		Store32(p + 32, 1);
+		Store64(p + 36, BLOCK_SIZE * 8);
+		Store32(p + 44, BLOCK_SIZE);
+		Store32(p + 48, 0);
+		p += 52;
+
+		memcpy(p, "data", 4);
+		Store64(p + 4, 12 + DATA_SIZE);
+		p += 12;
+
+		memset(p, 0x69, DATA_SIZE);
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr ||
+	    fwrite(buffer, sizeof(buffer), 1, file) != 1 ||
+	    fclose(file) != 0)
+		throw std::runtime_error(std::string("Failed to write ") + path);
+}
+
+static void
+MakeDirectory(const std::string &path)
+{
+	if (mkdir(path.c_str(), 0777) < 0 && errno != EEXIST)
+		throw std::runtime_error("Failed to create " + path);
+}
+
+/**
+ * Create a tree of 10 songs per album and 10 albums per artist.
+ */
+static void
+CreateTree(const std::string &base, unsigned n_songs)
+{
+	MakeDirectory(base);
+
+	for (unsigned i = 0; i < n_songs; ++i) {
+		std::string path = base + "/artist" + std::to_string(i / 100);
+		if (i % 100 == 0)
+			MakeDirectory(path);
+
+		path += "/album" + std::to_string(i / 10 % 10);
+		if (i % 10 == 0)
+			MakeDirectory(path);
+
+		path += "/track" + std::to_string(i % 10) + ".dsf";
+		WriteDsf(path.c_str());
+	}
+}
+
+gcc_pure
+static unsigned
+CountSongs(const Directory &directory)
+{
+	unsigned n = 0;
+	for (const auto &song : directory.songs) {
+		(void)song;
+		++n;
+	}
+
+	for (const auto &child : directory.children)
+		n += CountSongs(child);
+
+	return n;
+}
+
+static double
+RunWalk(EventLoop &event_loop, DatabaseListener &listener,
+	Storage &storage, Directory &root, bool discard,
+	unsigned n_threads)
+{
+	UpdateWalk walk(event_loop, listener, storage, n_threads, nullptr,
+			nullptr, nullptr);
+
+	const auto start = std::chrono::steady_clock::now();
+	walk.Walk(root, nullptr, discard);
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "Usage: bench_update DIRECTORY [SONGS [LATENCY_US]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const std::string base = argv[1];
+	const unsigned n_songs = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: 2000;
+	const std::chrono::microseconds latency(argc > 3
+						? strtoul(argv[3], nullptr, 10)
+						: 0);
+
+	CreateTree(base, n_songs);
+
+	/* don't log each song */
+	SetLogThreshold(LogLevel::WARNING);
+
+	config_global_init();
+	AtScopeExit() { config_global_finish(); };
+
+	TagLoadConfig();
+
+	const ScopeIOThread io_thread;
+
+	input_stream_global_init();
+	AtScopeExit() { input_stream_global_finish(); };
+
+#ifdef ENABLE_ARCHIVE
+	archive_plugin_init_all();
+	AtScopeExit() { archive_plugin_deinit_all(); };
+#endif
+
+	decoder_plugin_init_all();
+	AtScopeExit() { decoder_plugin_deinit_all(); };
+
+	playlist_list_global_init();
+	AtScopeExit() { playlist_list_global_finish(); };
+
+	EventLoop event_loop;
+	DummyDatabaseListener listener;
+
+	std::unique_ptr<Storage> local_storage(CreateLocalStorage(Path::FromFS(base.c_str())));
+	SlowStorage storage(*local_storage, latency);
+
+	for (const unsigned n_threads : {0, 1, 2, 4, 8, 16}) {
+		std::unique_ptr<Directory> root(Directory::NewRoot());
+
+		const double scan = RunWalk(event_loop, listener, storage,
+					    *root, false, n_threads);
+		const double rescan = RunWalk(event_loop, listener, storage,
+					      *root, true, n_threads);
+
+		const unsigned n = CountSongs(*root);
+		printf("%2u threads %8u songs  update %8.3f s %10.0f songs/s"
+		       "  rescan %8.3f s %10.0f songs/s\n",
+		       n_threads, n,
+		       scan, n / scan, rescan, n / rescan);
+	}
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of MPD's software volume
+ * library for each sample format.
+ *
+ */
+
+#include "config.h"
+#include "pcm/Volume.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <random>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The size of one input buffer; roughly the size of a #MusicChunk.
+ */
+static constexpr size_t BUFFER_SIZE = 4096;
+
+static void
+BenchmarkFormat(SampleFormat format, unsigned iterations)
+{
+	static uint8_t buffer[BUFFER_SIZE];
+
+	std::minstd_rand engine;
+	for (auto &i : buffer)
+		i = engine();
+
+	if (format == SampleFormat::S24_P32) {
+		/* sign-extend to valid 24 bit samples */
+		int32_t *p = (int32_t *)buffer;
+		for (size_t i = 0; i < BUFFER_SIZE / sizeof(*p); ++i)
+			p[i] = (p[i] << 8) >> 8;
+	} else if (format == SampleFormat::FLOAT) {
+		float *p = (float *)buffer;
+		for (size_t i = 0; i < BUFFER_SIZE / sizeof(*p); ++i)
+			p[i] = float(int16_t(engine())) / 32768.f;
+	}
+
+	PcmVolume pv;
+	pv.Open(format, 2);
+
+	const ConstBuffer<void> src(buffer, sizeof(buffer));
+
+	/* consume the output, or the compiler may optimize the
+	   Apply() call away (it is declared "pure") */
+	unsigned checksum = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < iterations; ++i) {
+		pv.SetVolume(PCM_VOLUME_1 / 2 + (i & 1));
+		const auto dest = pv.Apply(src);
+		checksum += ((const uint8_t *)dest.data)[i % dest.size];
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	pv.Close();
+
+	const double seconds =
+		std::chrono::duration<double>(end - start).count();
+	const double samples = double(iterations) *
+		(BUFFER_SIZE / sample_format_size(format));
+
+	printf("%-8s %12.0f samples/s (checksum %u)\n",
+	       sample_format_to_string(format), samples / seconds,
+	       checksum);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_volume [ITERATIONS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 100000;
+
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S8,
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+		SampleFormat::DSD,
+	};
+
+	for (auto format : formats)
+		BenchmarkFormat(format, iterations);
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
@@ -33,6 +33,7 @@
 #include "pcm/PcmConvert.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "player/Control.hxx"
+#include "MusicChunk.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/ScopeExit.hxx"
 #include "Log.hxx"
@@ -53,12 +54,18 @@ filter_plugin_by_name(gcc_unused const char *name)
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
+			     size_t _chunk_size,
 			     unsigned _buffered_before_play,
+			     unsigned _lookahead,
+			     unsigned _history_chunks,
 			     AudioFormat _configured_audio_format,
 			     const ReplayGainConfig &_replay_gain_config)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 chunk_size(_chunk_size),
 	 buffered_before_play(_buffered_before_play),
+	 lookahead(_lookahead),
+	 history_chunks(_history_chunks),
 	 configured_audio_format(_configured_audio_format),
 	 replay_gain_config(_replay_gain_config) {}
 PlayerControl::~PlayerControl() {}
@@ -74,7 +81,7 @@ load_audio_output(EventLoop &event_loop, const char *name)
 
 	static struct PlayerControl dummy_player_control(*(PlayerListener *)nullptr,
 							 *(MultipleOutputs *)nullptr,
-							 32, 4,
+							 32, DEFAULT_CHUNK_SIZE, 4, 0, 0,
 							 AudioFormat::Undefined(),
 							 ReplayGainConfig());
 
@@ -51,7 +51,7 @@ try {
 		audio_format = ParseAudioFormat(argv[1], false);
 
 	PcmVolume pv;
-	pv.Open(audio_format.format);
+	pv.Open(audio_format.format, audio_format.channels);
 
 	while ((nbytes = read(0, buffer, sizeof(buffer))) > 0) {
 		auto dest = pv.Apply({buffer, size_t(nbytes)});
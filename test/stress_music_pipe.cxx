@@ -0,0 +1,291 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program runs a decoder stand-in which pushes numbered chunks
+ * into a #MusicPipe, against consumer threads which verify the
+ * order, and reports the latency of MusicPipe::Shift().
+ *
+ * In the first pass, a player stand-in shifts every chunk as soon
+ * as it appears (like the decoder's pipe).  In the second pass,
+ * several output stand-ins walk the pipe with #MusicChunk::next,
+ * and the player only shifts chunks all of them have passed (like
+ * the outputs' pipe).
+ *
+ */
+
+#include "config.h"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "Chrono.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+static constexpr unsigned BUFFER_CHUNKS = 64;
+
+static std::atomic<bool> failed(false);
+
+static void
+Fail(const char *msg, uint32_t expected, uint32_t actual)
+{
+	fprintf(stderr, "%s: expected %u, got %u\n", msg,
+		unsigned(expected), unsigned(actual));
+	failed = true;
+}
+
+static uint32_t
+GetSerial(const MusicChunk &chunk)
+{
+	uint32_t serial;
+	memcpy(&serial, chunk.data, sizeof(serial));
+	return serial;
+}
+
+/**
+ * The decoder stand-in: push chunks with the serial numbers
+ * 1..n.
+ */
+static void
+Produce(MusicBuffer &buffer, MusicPipe &pipe, uint32_t n)
+{
+	for (uint32_t serial = 1; serial <= n && !failed;) {
+		MusicChunk *chunk = buffer.Allocate();
+		if (chunk == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+		memcpy(w.data, &serial, sizeof(serial));
+		chunk->Expand(audio_format, audio_format.GetFrameSize());
+		pipe.Push(chunk);
+		++serial;
+	}
+}
+
+typedef std::vector<std::chrono::steady_clock::duration> Latencies;
+
+static MusicChunk *
+TimedShift(MusicPipe &pipe, Latencies &latencies)
+{
+	const auto start = std::chrono::steady_clock::now();
+	MusicChunk *chunk = pipe.Shift();
+	latencies.push_back(std::chrono::steady_clock::now() - start);
+	return chunk;
+}
+
+/**
+ * The player stand-in for the decoder's pipe: shift everything,
+ * including the tail.
+ */
+static void
+ShiftAll(MusicBuffer &buffer, MusicPipe &pipe, uint32_t n,
+	 Latencies &latencies)
+{
+	for (uint32_t expected = 1; expected <= n && !failed;) {
+		if (pipe.IsEmpty()) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		MusicChunk *chunk = TimedShift(pipe, latencies);
+		if (chunk == nullptr) {
+			Fail("Shift() on non-empty pipe", expected, 0);
+			break;
+		}
+
+		const uint32_t serial = GetSerial(*chunk);
+		if (serial != expected)
+			Fail("Shift() out of order", expected, serial);
+
+		buffer.Return(chunk);
+		++expected;
+	}
+}
+
+struct Reader {
+	/**
+	 * The serial number of the chunk this reader is currently
+	 * looking at.
+	 */
+	std::atomic<uint32_t> position;
+
+	Reader():position(0) {}
+};
+
+/**
+ * The output stand-in: walk the pipe like AudioOutput::Play().
+ */
+static void
+Read(const MusicPipe &pipe, Reader &reader, uint32_t n)
+{
+	const MusicChunk *current = nullptr;
+	for (uint32_t expected = 1; expected <= n && !failed;) {
+		const MusicChunk *next = current != nullptr
+			? current->next.load()
+			: pipe.Peek();
+		if (next == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		const uint32_t serial = GetSerial(*next);
+		if (serial != expected)
+			Fail("next out of order", expected, serial);
+
+		current = next;
+		reader.position = serial;
+		++expected;
+	}
+}
+
+/**
+ * The player stand-in for the outputs' pipe: shift the chunks
+ * which all readers have passed.
+ */
+static void
+ShiftConsumed(MusicBuffer &buffer, MusicPipe &pipe,
+	      const std::vector<Reader> &readers, uint32_t n,
+	      Latencies &latencies)
+{
+	for (uint32_t expected = 1; expected < n && !failed;) {
+		uint32_t min_position = n;
+		for (const auto &r : readers)
+			min_position = std::min(min_position,
+						r.position.load());
+
+		if (expected >= min_position) {
+			/* a reader may still be looking at this
+			   chunk */
+			std::this_thread::yield();
+			continue;
+		}
+
+		MusicChunk *chunk = TimedShift(pipe, latencies);
+		if (chunk == nullptr) {
+			Fail("Shift() on consumed chunk", expected, 0);
+			break;
+		}
+
+		const uint32_t serial = GetSerial(*chunk);
+		if (serial != expected)
+			Fail("Shift() out of order", expected, serial);
+
+		buffer.Return(chunk);
+		++expected;
+	}
+}
+
+static void
+Report(const char *name, Latencies &latencies)
+{
+	if (latencies.empty())
+		return;
+
+	std::sort(latencies.begin(), latencies.end());
+
+	auto ns = [&latencies](double quantile){
+		const size_t i = size_t(quantile * (latencies.size() - 1));
+		return (unsigned long)
+			std::chrono::duration_cast<std::chrono::nanoseconds>(latencies[i]).count();
+	};
+
+	printf("%-28s %8zu shifts  p50 %6lu ns  p99 %6lu ns  max %8lu ns\n",
+	       name, latencies.size(), ns(0.5), ns(0.99), ns(1.0));
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 3) {
+		fprintf(stderr, "Usage: stress_music_pipe [CHUNKS [READERS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const uint32_t n = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 200000;
+	const unsigned n_readers = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: 4;
+
+	MusicBuffer buffer(BUFFER_CHUNKS);
+
+	{
+		MusicPipe pipe;
+		Latencies latencies;
+		latencies.reserve(n);
+
+		std::thread producer(Produce, std::ref(buffer), std::ref(pipe),
+				     n);
+		ShiftAll(buffer, pipe, n, latencies);
+		producer.join();
+
+		pipe.Clear(buffer);
+		Report("decoder -> player", latencies);
+	}
+
+	{
+		MusicPipe pipe;
+		Latencies latencies;
+		latencies.reserve(n);
+
+		std::vector<Reader> readers(n_readers);
+		std::vector<std::thread> threads;
+		for (auto &r : readers)
+			threads.emplace_back(Read, std::cref(pipe), std::ref(r),
+					     n);
+
+		std::thread producer(Produce, std::ref(buffer), std::ref(pipe),
+				     n);
+		ShiftConsumed(buffer, pipe, readers, n, latencies);
+		producer.join();
+		for (auto &t : threads)
+			t.join();
+
+		pipe.Clear(buffer);
+
+		char name[32];
+		snprintf(name, sizeof(name), "decoder -> %u outputs",
+			 n_readers);
+		Report(name, latencies);
+	}
+
+#ifndef NDEBUG
+	if (!buffer.IsEmptyUnsafe()) {
+		fprintf(stderr, "chunks leaked\n");
+		failed = true;
+	}
+#endif
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
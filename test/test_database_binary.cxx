@@ -0,0 +1,252 @@
+/*
+ * Unit tests for the binary database format (DatabaseBinary.hxx).
+ */
+
+#include "config.h"
+#include "db/plugins/simple/DatabaseBinary.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "tag/TagBuilder.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/Path.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	virtual void Write(const void *data, size_t size) override {
+		value.append((const char *)data, size);
+	}
+};
+
+/**
+ * A temporary file which is deleted by the destructor.
+ */
+class TempFile {
+	char path[32];
+
+public:
+	TempFile() {
+		strcpy(path, "/tmp/test_dbXXXXXX");
+		int fd = mkstemp(path);
+		CPPUNIT_ASSERT(fd >= 0);
+		close(fd);
+	}
+
+	~TempFile() {
+		unlink(path);
+	}
+
+	Path GetPath() const {
+		return Path::FromFS(path);
+	}
+};
+
+/**
+ * Serialize the tree in the text format, for comparing.
+ */
+static std::string
+ToText(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_internal(bos, root);
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+static void
+AddSong(Directory &directory, const char *name, const char *artist,
+	const char *title, unsigned track)
+{
+	Song *song = Song::NewFile(name, directory);
+	song->mtime = 1400000000 + track;
+
+	TagBuilder tag;
+	tag.SetDuration(SignedSongTime::FromMS(180000 + track * 1001));
+	tag.AddItem(TAG_ARTIST, artist);
+	tag.AddItem(TAG_ALBUM, "Album");
+	tag.AddItem(TAG_TITLE, title);
+	tag.AddItem(TAG_TRACK, std::to_string(track).c_str());
+	tag.Commit(song->tag);
+
+	directory.AddSong(song);
+}
+
+/**
+ * Build a tree which uses all features of the format: nested and
+ * special directories, shared and multi-value tag items, songs
+ * without tags, CUE tracks and playlists.
+ */
+static Directory *
+BuildTree()
+{
+	Directory *root = Directory::NewRoot();
+
+	Directory *a = root->CreateChild("a");
+	a->mtime = 1300000000;
+	AddSong(*a, "1.flac", "Artist", "One", 1);
+	AddSong(*a, "2.flac", "Artist", "Two", 2);
+	a->playlists.push_back(PlaylistInfo("a.m3u", 1300000001));
+
+	Directory *b = a->CreateChild("b");
+	b->mtime = 1300000002;
+	AddSong(*b, "3.flac", "Other Artist", "Three", 3);
+
+	Song *untagged = Song::NewFile("untagged.wav", *b);
+	untagged->mtime = 1300000003;
+	b->AddSong(untagged);
+
+	Directory *archive = root->CreateChild("x.zip");
+	archive->device = DEVICE_INARCHIVE;
+	AddSong(*archive, "in.ogg", "Artist", "Archived", 4);
+
+	Directory *cue = root->CreateChild("image.flac");
+	cue->device = DEVICE_CONTAINER;
+	for (unsigned i = 1; i <= 3; ++i) {
+		const std::string name = "track" + std::to_string(i);
+
+		Song *song = Song::NewFile(name.c_str(), *cue);
+		song->mtime = 1300000004;
+		song->start_time = SongTime::FromMS((i - 1) * 60000);
+		song->end_time = SongTime::FromMS(i * 60000);
+
+		TagBuilder tag;
+		tag.AddItem(TAG_ARTIST, "Artist");
+		tag.AddItem(TAG_ARTIST, "Guest");
+		tag.AddItem(TAG_TITLE, name.c_str());
+		tag.SetHasPlaylist(true);
+		tag.Commit(song->tag);
+
+		cue->AddSong(song);
+	}
+
+	root->playlists.push_back(PlaylistInfo("root.m3u", 1300000005));
+	return root;
+}
+
+static void
+WriteFile(Path path, const std::string &value)
+{
+	FileOutputStream fos(path);
+	fos.Write(value.data(), value.size());
+	fos.Commit();
+}
+
+static void
+SaveBinary(Path path, const Directory &root)
+{
+	FileOutputStream fos(path);
+	db_save_binary(fos, root);
+	fos.Commit();
+}
+
+class DatabaseBinaryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DatabaseBinaryTest);
+	CPPUNIT_TEST(TestRoundTrip);
+	CPPUNIT_TEST(TestDetect);
+	CPPUNIT_TEST(TestTruncated);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestRoundTrip() {
+		std::string expected;
+
+		{
+			std::unique_ptr<Directory> root(BuildTree());
+			expected = ToText(*root);
+		}
+
+		/* text -> tree */
+
+		TempFile text_file;
+		WriteFile(text_file.GetPath(), expected);
+
+		std::unique_ptr<Directory> root(Directory::NewRoot());
+
+		{
+			TextFile file(text_file.GetPath());
+			db_load_internal(file, *root);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(expected, ToText(*root));
+
+		/* tree -> binary -> tree -> text */
+
+		TempFile binary_file;
+		SaveBinary(binary_file.GetPath(), *root);
+		root.reset();
+
+		std::unique_ptr<Directory> loaded(Directory::NewRoot());
+		db_load_binary(binary_file.GetPath(), *loaded);
+		CPPUNIT_ASSERT_EQUAL(expected, ToText(*loaded));
+	}
+
+	void TestDetect() {
+		std::unique_ptr<Directory> root(BuildTree());
+
+		TempFile text_file, binary_file;
+		WriteFile(text_file.GetPath(), ToText(*root));
+		SaveBinary(binary_file.GetPath(), *root);
+
+		CPPUNIT_ASSERT(!db_is_binary(text_file.GetPath()));
+		CPPUNIT_ASSERT(db_is_binary(binary_file.GetPath()));
+	}
+
+	void TestTruncated() {
+		std::string binary;
+
+		{
+			std::unique_ptr<Directory> root(BuildTree());
+			StringOutputStream sos;
+			db_save_binary(sos, *root);
+			binary = std::move(sos.value);
+		}
+
+		/* every table must be inside the file; cutting off
+		   the end must be detected, and not crash */
+		TempFile binary_file;
+		for (size_t size : {binary.size() / 2, binary.size() - 1}) {
+			WriteFile(binary_file.GetPath(), binary.substr(0, size));
+
+			std::unique_ptr<Directory> root(Directory::NewRoot());
+			bool failed = false;
+			try {
+				db_load_binary(binary_file.GetPath(), *root);
+			} catch (const std::runtime_error &) {
+				failed = true;
+			}
+
+			CPPUNIT_ASSERT(failed);
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DatabaseBinaryTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
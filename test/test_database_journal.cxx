@@ -0,0 +1,317 @@
+/*
+ * Unit tests for class DatabaseJournal.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/DatabaseJournal.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "config/Block.hxx"
+#include "event/Loop.hxx"
+#include "tag/TagBuilder.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+class DummyDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const char *) override {}
+};
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	virtual void Write(const void *data, size_t size) override {
+		value.append((const char *)data, size);
+	}
+};
+
+/**
+ * Serialize the tree in the text format, for comparing.
+ */
+static std::string
+ToText(Directory &root)
+{
+	{
+		const ScopeDatabaseLock protect;
+		root.Sort();
+	}
+
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_internal(bos, root);
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+static void
+AddSong(Directory &directory, const char *name, const char *title)
+{
+	Song *song = Song::NewFile(name, directory);
+	song->mtime = 1400000000;
+
+	TagBuilder tag;
+	tag.AddItem(TAG_ARTIST, "Artist");
+	tag.AddItem(TAG_TITLE, title);
+	tag.Commit(song->tag);
+
+	directory.AddSong(song);
+}
+
+/**
+ * The tree which is "loaded from the database file".
+ */
+static Directory *
+BuildTree()
+{
+	Directory *root = Directory::NewRoot();
+
+	Directory *a = root->CreateChild("a");
+	a->mtime = 1300000000;
+	AddSong(*a, "1.flac", "One");
+
+	Directory *b = root->CreateChild("b");
+	b->mtime = 1300000001;
+	AddSong(*b, "2.flac", "Two");
+
+	Directory *c = b->CreateChild("c");
+	c->mtime = 1300000002;
+	AddSong(*c, "3.flac", "Three");
+
+	return root;
+}
+
+class DatabaseJournalTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DatabaseJournalTest);
+	CPPUNIT_TEST(TestReplay);
+	CPPUNIT_TEST(TestStale);
+	CPPUNIT_TEST(TestDamaged);
+	CPPUNIT_TEST_SUITE_END();
+
+	char dir[32];
+	AllocatedPath db_path = AllocatedPath::Null();
+
+public:
+	void setUp() override {
+		strcpy(dir, "/tmp/test_journalXXXXXX");
+		CPPUNIT_ASSERT(mkdtemp(dir) != nullptr);
+
+		db_path = AllocatedPath::Build(Path::FromFS(dir), "db");
+		WriteDatabaseFile("dummy database\n");
+	}
+
+	void tearDown() override {
+		const DatabaseJournal journal(db_path);
+		unlink(journal.GetPath().c_str());
+		unlink(db_path.c_str());
+		rmdir(dir);
+	}
+
+	void TestReplay() {
+		DatabaseJournal journal(db_path);
+		const FileInfo db_info(db_path);
+
+		std::unique_ptr<Directory> root(BuildTree());
+
+		/* commit 1: a new song and a new directory */
+		{
+			const ScopeDatabaseLock protect;
+			Directory &a = *root->LookupDirectory("a").directory;
+			AddSong(a, "4.flac", "Four");
+			a.mtime = 1300000010;
+
+			Directory *d = a.CreateChild("d");
+			d->mtime = 1300000011;
+			AddSong(*d, "5.flac", "Five");
+
+			journal.MarkModified(a);
+			journal.MarkModified(*d);
+		}
+
+		journal.Write(*root, db_info);
+		CPPUNIT_ASSERT(!journal.IsDirty());
+
+		/* commit 2: delete a directory with a child, modify a
+		   song */
+		{
+			const ScopeDatabaseLock protect;
+			Directory &b = *root->LookupDirectory("b").directory;
+			journal.MarkDeleted(b);
+			b.Delete();
+
+			Directory &a = *root->LookupDirectory("a").directory;
+			a.FindSong("1.flac")->mtime = 1400000020;
+			journal.MarkModified(a);
+		}
+
+		journal.Write(*root, db_info);
+
+		const std::string expected = ToText(*root);
+		const off_t complete_size = FileInfo(journal.GetPath()).GetSize();
+
+		/* commit 3 is cut off, as if MPD had crashed while
+		   writing it */
+		{
+			const ScopeDatabaseLock protect;
+			Directory &a = *root->LookupDirectory("a").directory;
+			AddSong(a, "6.flac", "Six");
+			journal.MarkModified(a);
+		}
+
+		journal.Write(*root, db_info);
+
+		const off_t size = FileInfo(journal.GetPath()).GetSize();
+		CPPUNIT_ASSERT(size > complete_size);
+		CPPUNIT_ASSERT(truncate(journal.GetPath().c_str(),
+					(complete_size + size) / 2) == 0);
+
+		/* replay on top of the original tree */
+		std::unique_ptr<Directory> replayed(BuildTree());
+
+		{
+			const ScopeDatabaseLock protect;
+			CPPUNIT_ASSERT(!journal.Replay(*replayed, db_info));
+		}
+
+		CPPUNIT_ASSERT_EQUAL(expected, ToText(*replayed));
+
+		/* a damaged journal is kept until it is compacted */
+		CPPUNIT_ASSERT(FileExists(journal.GetPath()));
+	}
+
+	void TestStale() {
+		DatabaseJournal journal(db_path);
+
+		std::unique_ptr<Directory> root(BuildTree());
+		const std::string original = ToText(*root);
+
+		{
+			const ScopeDatabaseLock protect;
+			Directory &a = *root->LookupDirectory("a").directory;
+			AddSong(a, "4.flac", "Four");
+			journal.MarkModified(a);
+		}
+
+		journal.Write(*root, FileInfo(db_path));
+
+		/* the database file is rewritten: the journal's header
+		   doesn't match anymore */
+		WriteDatabaseFile("another dummy database\n");
+
+		std::unique_ptr<Directory> replayed(BuildTree());
+
+		{
+			const ScopeDatabaseLock protect;
+			CPPUNIT_ASSERT(journal.Replay(*replayed,
+						      FileInfo(db_path)));
+		}
+
+		CPPUNIT_ASSERT_EQUAL(original, ToText(*replayed));
+		CPPUNIT_ASSERT(!FileExists(journal.GetPath()));
+	}
+
+	void TestDamaged() {
+		std::unique_ptr<Directory> root(BuildTree());
+		const std::string original = ToText(*root);
+		WriteDatabaseFile(original.c_str());
+
+		/* a good commit, followed by a complete commit with a
+		   malformed line */
+		DatabaseJournal journal(db_path);
+
+		{
+			const ScopeDatabaseLock protect;
+			Directory &a = *root->LookupDirectory("a").directory;
+			AddSong(a, "4.flac", "Four");
+			journal.MarkModified(a);
+		}
+
+		journal.Write(*root, FileInfo(db_path));
+
+		{
+			FileOutputStream fos(journal.GetPath(),
+					     FileOutputStream::Mode::APPEND_EXISTING);
+			static constexpr char damaged[] =
+				"commit_begin\nfoo: bar\ncommit_end\n";
+			fos.Write(damaged, sizeof(damaged) - 1);
+			fos.Commit();
+		}
+
+		/* the database file is loaded without the journal,
+		   which is deleted */
+		EventLoop event_loop;
+		DummyDatabaseListener listener;
+
+		ConfigBlock block;
+		block.AddBlockParam("path", db_path.c_str());
+		block.AddBlockParam("journal", "yes");
+
+		std::unique_ptr<Database> db(simple_db_plugin.create(event_loop,
+								     listener,
+								     block));
+		db->Open();
+
+		auto &simple = static_cast<SimpleDatabase &>(*db);
+		CPPUNIT_ASSERT_EQUAL(original, ToText(simple.GetRoot()));
+		CPPUNIT_ASSERT(!FileExists(journal.GetPath()));
+
+		db->Close();
+
+		/* the database file has been rewritten */
+		std::unique_ptr<Directory> loaded(Directory::NewRoot());
+		{
+			TextFile file(db_path);
+			db_load_internal(file, *loaded);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(original, ToText(*loaded));
+	}
+
+private:
+	void WriteDatabaseFile(const char *contents) {
+		FileOutputStream fos(db_path);
+		fos.Write(contents, strlen(contents));
+		fos.Commit();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DatabaseJournalTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	/* Directory::Sort() needs the collator */
+	IcuInit();
+
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	const bool success = runner.run();
+
+	IcuFinish();
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,408 @@
+/*
+ * Unit tests for the query paths of class SimpleDatabase: the plain
+ * tree walk, the parallel Visit() ("query_threads"), the #TagIndex
+ * ("tag_index") and the #AggregateCache must produce the same results,
+ * also after the #DatabaseEditor has modified the tree.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/update/Editor.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/Selection.hxx"
+#include "db/LightSong.hxx"
+#include "db/Stats.hxx"
+#include "SongFilter.hxx"
+#include "config/Block.hxx"
+#include "event/Loop.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Mask.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The synthetic tree: "artistNN/albumN/NN.flac".  It has more than
+ * twice the minimum number of songs which SimpleDatabase splits among
+ * its query threads.
+ */
+static constexpr unsigned N_ARTISTS = 48;
+static constexpr unsigned N_ALBUMS = 8;
+static constexpr unsigned N_TRACKS = 32;
+
+class DummyDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const char *) override {}
+};
+
+static void
+MakeTag(Tag &tag, const char *artist, const char *album,
+	const char *album_artist, const char *title, unsigned seconds)
+{
+	TagBuilder builder;
+	builder.SetDuration(SignedSongTime::FromS(seconds));
+	builder.AddItem(TAG_ARTIST, artist);
+	builder.AddItem(TAG_ALBUM, album);
+	if (album_artist != nullptr)
+		builder.AddItem(TAG_ALBUM_ARTIST, album_artist);
+	builder.AddItem(TAG_TITLE, title);
+	builder.Commit(tag);
+}
+
+static Directory *
+BuildTree()
+{
+	Directory *root = Directory::NewRoot();
+
+	char name[64], artist[64], album[64], album_artist[64], title[64];
+	for (unsigned a = 0; a < N_ARTISTS; ++a) {
+		snprintf(name, sizeof(name), "artist%02u", a);
+		Directory *artist_dir = root->CreateChild(name);
+		artist_dir->mtime = 1300000000;
+
+		snprintf(artist, sizeof(artist), "Artist %02u", a);
+		/* every third artist has an "album artist", the
+		   others rely on the "artist" fallback */
+		snprintf(album_artist, sizeof(album_artist),
+			 "Various %u", a % 2);
+
+		for (unsigned b = 0; b < N_ALBUMS; ++b) {
+			snprintf(name, sizeof(name), "album%u", b);
+			Directory *album_dir = artist_dir->CreateChild(name);
+			album_dir->mtime = 1300000000;
+
+			/* album names are shared by several artists */
+			snprintf(album, sizeof(album), "Album %u", (a + b) % 12);
+
+			for (unsigned t = 0; t < N_TRACKS; ++t) {
+				snprintf(name, sizeof(name), "%02u.flac", t);
+				snprintf(title, sizeof(title), "Track %u", t);
+
+				Song *song = Song::NewFile(name, *album_dir);
+				song->mtime = 1400000000;
+				MakeTag(song->tag, artist, album,
+					a % 3 == 0 ? album_artist : nullptr,
+					title, 60 + a + b + t);
+				album_dir->AddSong(song);
+			}
+		}
+	}
+
+	return root;
+}
+
+static void
+WriteDatabaseFile(Path path, Directory &root)
+{
+	FileOutputStream fos(path);
+	BufferedOutputStream bos(fos);
+	db_save_internal(bos, root);
+	bos.Flush();
+	fos.Commit();
+}
+
+static void
+VisitFilter(const Database &db, const char *base, const SongFilter &filter,
+	    std::vector<std::string> &result)
+{
+	db.Visit(DatabaseSelection(base, true, &filter),
+		 [&result](const LightSong &song){
+			 result.emplace_back(song.GetURI());
+		 });
+}
+
+static void
+ListTags(const Database &db, const char *base, const SongFilter *filter,
+	 TagType type, tag_mask_t group_mask,
+	 std::vector<std::string> &result)
+{
+	db.VisitUniqueTags(DatabaseSelection(base, true, filter),
+			   type, group_mask,
+			   [type, &result](const Tag &tag){
+				   std::string s = tag.GetValue(type);
+				   for (const auto &item : tag)
+					   if (item.type != type)
+						   s.append("|").append(item.value);
+				   result.emplace_back(std::move(s));
+			   });
+}
+
+static std::string
+ToString(const DatabaseStats &stats)
+{
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer), "%u %llu %u %u",
+		 stats.song_count,
+		 (unsigned long long)stats.total_duration.count(),
+		 stats.artist_count, stats.album_count);
+	return buffer;
+}
+
+/**
+ * Run a set of typical client queries, and return their results.
+ * Each query begins with a header line.
+ */
+static std::vector<std::string>
+Query(const Database &db)
+{
+	std::vector<std::string> result;
+
+	result.emplace_back("# find album");
+	VisitFilter(db, "", SongFilter(TAG_ALBUM, "Album 3"), result);
+
+	result.emplace_back("# find albumartist");
+	VisitFilter(db, "", SongFilter(TAG_ALBUM_ARTIST, "Artist 01"),
+		    result);
+
+	result.emplace_back("# find albumartist various");
+	VisitFilter(db, "", SongFilter(TAG_ALBUM_ARTIST, "Various 1"),
+		    result);
+
+	result.emplace_back("# search artist");
+	VisitFilter(db, "", SongFilter(TAG_ARTIST, "IST 1", true), result);
+
+	result.emplace_back("# search any");
+	VisitFilter(db, "", SongFilter(LOCATE_TAG_ANY_TYPE, "new", true),
+		    result);
+
+	result.emplace_back("# find title, base");
+	VisitFilter(db, "artist02", SongFilter(TAG_TITLE, "Track 7"), result);
+
+	result.emplace_back("# list album");
+	ListTags(db, "", nullptr, TAG_ALBUM, 0, result);
+
+	result.emplace_back("# list album group artist");
+	ListTags(db, "", nullptr, TAG_ALBUM,
+		 tag_mask_t(1) << TAG_ARTIST, result);
+
+	result.emplace_back("# list title, base");
+	ListTags(db, "artist03/album1", nullptr, TAG_TITLE, 0, result);
+
+	result.emplace_back("# list artist, filter");
+	const SongFilter album_filter(TAG_ALBUM, "Album 5");
+	ListTags(db, "", &album_filter, TAG_ARTIST, 0, result);
+
+	result.emplace_back("# count group artist");
+	db.VisitGroupCounts(DatabaseSelection("", true), TAG_ARTIST,
+			    [&result](const char *value,
+				      const DatabaseStats &stats){
+				    result.emplace_back(std::string(value) + " " +
+							ToString(stats));
+			    });
+
+	result.emplace_back("# stats");
+	result.emplace_back(ToString(db.GetStats(DatabaseSelection("", true))));
+	result.emplace_back(ToString(db.GetStats(DatabaseSelection("artist06",
+								   true))));
+
+	return result;
+}
+
+static void
+CheckEqual(const std::vector<std::string> &expected,
+	   const std::vector<std::string> &actual)
+{
+	const size_t n = std::min(expected.size(), actual.size());
+	for (size_t i = 0; i < n; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], actual[i]);
+
+	CPPUNIT_ASSERT_EQUAL(expected.size(), actual.size());
+}
+
+/**
+ * Like CheckEqual(), but ignore the order of the results.
+ */
+static void
+CheckSame(std::vector<std::string> expected, std::vector<std::string> actual)
+{
+	std::sort(expected.begin(), expected.end());
+	std::sort(actual.begin(), actual.end());
+	CheckEqual(expected, actual);
+}
+
+class DatabaseQueryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DatabaseQueryTest);
+	CPPUNIT_TEST(TestQuery);
+	CPPUNIT_TEST(TestEdit);
+	CPPUNIT_TEST_SUITE_END();
+
+	char dir[32];
+	AllocatedPath db_path = AllocatedPath::Null();
+
+	EventLoop event_loop;
+	DummyDatabaseListener listener;
+
+	/**
+	 * The same database, loaded with a single query thread,
+	 * several query threads, and the #TagIndex.
+	 */
+	std::unique_ptr<Database> scan, parallel, index;
+
+public:
+	void setUp() override {
+		strcpy(dir, "/tmp/test_queryXXXXXX");
+		CPPUNIT_ASSERT(mkdtemp(dir) != nullptr);
+
+		db_path = AllocatedPath::Build(Path::FromFS(dir), "db");
+
+		{
+			std::unique_ptr<Directory> root(BuildTree());
+			WriteDatabaseFile(db_path, *root);
+		}
+
+		scan.reset(Open(false, "1"));
+		parallel.reset(Open(false, "4"));
+		index.reset(Open(true, "1"));
+	}
+
+	void tearDown() override {
+		scan->Close();
+		parallel->Close();
+		index->Close();
+
+		unlink(db_path.c_str());
+		rmdir(dir);
+	}
+
+	void TestQuery() {
+		const auto expected = Query(*scan);
+		CPPUNIT_ASSERT(expected.size() > N_ARTISTS * N_TRACKS);
+
+		CheckEqual(expected, Query(*parallel));
+		CheckEqual(expected, Query(*index));
+
+		/* again, from the #AggregateCache */
+		CheckEqual(expected, Query(*scan));
+		CheckEqual(expected, Query(*index));
+	}
+
+	void TestEdit() {
+		/* fill the caches */
+		Query(*scan);
+		Query(*parallel);
+		Query(*index);
+
+		Edit([](DatabaseEditor &editor, Directory &root){
+				Directory &album =
+					*root.LookupDirectory("artist04/album2").directory;
+				Song *song = Song::NewFile("new.flac", album);
+				MakeTag(song->tag, "New Artist", "Album 3",
+					nullptr, "New", 100);
+				editor.AddSong(album, song);
+			});
+
+		Edit([](DatabaseEditor &editor, Directory &root){
+				Directory &album =
+					*root.LookupDirectory("artist01/album1").directory;
+				Tag tag;
+				MakeTag(tag, "Artist 17", "Album 5",
+					"Artist 01", "Renamed", 90);
+				editor.UpdateSongTag(*album.FindSong("07.flac"),
+						     std::move(tag));
+			});
+
+		Edit([](DatabaseEditor &editor, Directory &root){
+				Directory &album =
+					*root.LookupDirectory("artist03/album1").directory;
+				editor.DeleteSong(album, album.FindSong("00.flac"));
+			});
+
+		Edit([](DatabaseEditor &editor, Directory &root){
+				editor.DeleteDirectory(root.LookupDirectory("artist05").directory);
+			});
+	}
+
+private:
+	Database *Open(bool tag_index, const char *query_threads) {
+		ConfigBlock block;
+		block.AddBlockParam("path", db_path.c_str());
+		block.AddBlockParam("tag_index", tag_index ? "yes" : "no");
+		block.AddBlockParam("query_threads", query_threads);
+
+		std::unique_ptr<Database> db(simple_db_plugin.create(event_loop,
+								     listener,
+								     block));
+		db->Open();
+		return db.release();
+	}
+
+	static void EditOne(SimpleDatabase &db, EventLoop &event_loop,
+			    DatabaseListener &listener,
+			    void (*f)(DatabaseEditor &editor,
+				      Directory &root)) {
+		DatabaseEditor editor(event_loop, listener,
+				      db.GetTagIndex(), db.GetJournal(),
+				      db.GetAggregateCache());
+
+		const ScopeDatabaseLock protect;
+		f(editor, db.GetRoot());
+	}
+
+	/**
+	 * Apply the same modification to all three databases, and
+	 * compare their results with each other and with a database
+	 * which is loaded from scratch.
+	 */
+	void Edit(void (*f)(DatabaseEditor &editor, Directory &root)) {
+		EditOne(static_cast<SimpleDatabase &>(*scan), event_loop,
+			listener, f);
+		EditOne(static_cast<SimpleDatabase &>(*parallel), event_loop,
+			listener, f);
+		EditOne(static_cast<SimpleDatabase &>(*index), event_loop,
+			listener, f);
+
+		const auto expected = Query(*scan);
+		CheckEqual(expected, Query(*parallel));
+		CheckEqual(expected, Query(*index));
+
+		{
+			const ScopeDatabaseLock protect;
+			WriteDatabaseFile(db_path,
+					  static_cast<SimpleDatabase &>(*scan).GetRoot());
+		}
+
+		std::unique_ptr<Database> fresh(Open(false, "1"));
+		CheckSame(Query(*fresh), expected);
+		fresh->Close();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DatabaseQueryTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	/* Directory::Sort() and case-folding need ICU */
+	IcuInit();
+
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	const bool success = runner.run();
+
+	IcuFinish();
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,231 @@
+/*
+ * Unit tests for class OutputFilterGroup.
+ */
+
+#include "config.h"
+#include "output/FilterGroup.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "mixer/MixerControl.hxx"
+#include "MusicChunk.hxx"
+#include "ReplayGainConfig.hxx"
+#include "tag/Tag.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <vector>
+
+#include <string.h>
+#include <stdlib.h>
+
+void
+mixer_set_volume(gcc_unused Mixer *mixer,
+		 gcc_unused unsigned volume)
+{
+}
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+static constexpr size_t CHUNK_SIZE = 4096;
+
+/**
+ * A #MusicChunk with its own buffer, filled with a test signal.
+ */
+struct TestChunk : MusicChunk {
+	int16_t buffer[CHUNK_SIZE / sizeof(int16_t)];
+
+	TestChunk(unsigned seed, size_t size, unsigned serial, float gain)
+		:MusicChunk((uint8_t *)buffer, sizeof(buffer)) {
+		for (size_t i = 0; i < size / sizeof(int16_t); ++i)
+			buffer[i] = int16_t((i * 7919 + seed * 104729) % 60000) - 30000;
+
+		length = size;
+		replay_gain_info.Clear();
+		replay_gain_info.track.gain = gain;
+		replay_gain_serial = serial;
+#ifndef NDEBUG
+		audio_format = ::audio_format;
+#endif
+	}
+};
+
+/**
+ * Processes chunks with private filters, like an output which is not
+ * a member of an #OutputFilterGroup does (see ao_mix_chunk()).
+ */
+class UngroupedOutput {
+	std::unique_ptr<PreparedFilter> prepared, prepared_other;
+	std::unique_ptr<Filter> filter, other_filter;
+	unsigned serial = 0, other_serial = 0;
+	PcmDither dither;
+	std::vector<uint8_t> cross_fade_buffer;
+
+public:
+	explicit UngroupedOutput(const ReplayGainConfig &config)
+		:prepared(NewReplayGainFilter(config)),
+		 prepared_other(NewReplayGainFilter(config)) {
+		AudioFormat format = audio_format;
+		filter.reset(prepared->Open(format));
+		format = audio_format;
+		other_filter.reset(prepared_other->Open(format));
+	}
+
+	std::vector<uint8_t> Process(const MusicChunk &chunk) {
+		ConstBuffer<void> data = Apply(chunk, *filter, serial);
+		if (data.IsEmpty())
+			return {};
+
+		if (chunk.other != nullptr) {
+			ConstBuffer<void> other_data =
+				Apply(*chunk.other, *other_filter,
+				      other_serial);
+			if (!other_data.IsEmpty()) {
+				if (data.size > other_data.size)
+					data.size = other_data.size;
+
+				float mix_ratio = chunk.mix_ratio;
+				if (mix_ratio >= 0)
+					mix_ratio = 1.0 - mix_ratio;
+
+				const auto *p = (const uint8_t *)other_data.data;
+				cross_fade_buffer.assign(p, p + other_data.size);
+				CPPUNIT_ASSERT(pcm_mix(dither,
+						       &cross_fade_buffer.front(),
+						       data.data, data.size,
+						       audio_format.format,
+						       mix_ratio));
+				return cross_fade_buffer;
+			}
+		}
+
+		const auto *p = (const uint8_t *)data.data;
+		return std::vector<uint8_t>(p, p + data.size);
+	}
+
+private:
+	static ConstBuffer<void> Apply(const MusicChunk &chunk,
+				       Filter &f, unsigned &_serial) {
+		ConstBuffer<void> data(chunk.data, chunk.length);
+		if (data.IsEmpty())
+			return data;
+
+		replay_gain_filter_set_mode(f, ReplayGainMode::TRACK);
+		if (chunk.replay_gain_serial != _serial) {
+			replay_gain_filter_set_info(f,
+						    chunk.replay_gain_serial != 0
+						    ? &chunk.replay_gain_info
+						    : nullptr);
+			_serial = chunk.replay_gain_serial;
+		}
+
+		return f.FilterPCM(data);
+	}
+};
+
+static std::vector<uint8_t>
+ToVector(const FilteredChunkPtr &result)
+{
+	CPPUNIT_ASSERT(result != nullptr);
+	const auto *p = (const uint8_t *)result->data.data;
+	return std::vector<uint8_t>(p, p + result->data.size);
+}
+
+class FilterGroupTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FilterGroupTest);
+	CPPUNIT_TEST(TestReplayGain);
+	CPPUNIT_TEST(TestCrossFade);
+	CPPUNIT_TEST(TestTagOnly);
+	CPPUNIT_TEST_SUITE_END();
+
+	ReplayGainConfig config;
+
+public:
+	void TestReplayGain() {
+		OutputFilterGroup group(&config);
+		group.Open(audio_format);
+		group.SetReplayGainMode(ReplayGainMode::TRACK);
+
+		UngroupedOutput reference(config);
+
+		/* the gain changes between chunks, and the last one
+		   has no replay gain info at all */
+		TestChunk a(1, CHUNK_SIZE, 1, -6);
+		TestChunk b(2, CHUNK_SIZE, 1, -6);
+		TestChunk c(3, CHUNK_SIZE, 2, 3);
+		TestChunk d(4, CHUNK_SIZE / 2, 0, 0);
+
+		for (const MusicChunk *chunk : {&a, &b, &c, &d}) {
+			const auto expected = reference.Process(*chunk);
+			const auto result = group.Get(*chunk);
+			CPPUNIT_ASSERT(expected == ToVector(result));
+
+			/* the second member gets the same result */
+			CPPUNIT_ASSERT(group.Get(*chunk) == result);
+			group.Release(*chunk);
+		}
+	}
+
+	void TestCrossFade() {
+		OutputFilterGroup group(&config);
+		group.Open(audio_format);
+		group.SetReplayGainMode(ReplayGainMode::TRACK);
+
+		UngroupedOutput reference(config);
+
+		TestChunk a(1, CHUNK_SIZE, 1, -3), other_a(5, CHUNK_SIZE, 1, 2);
+		a.other = &other_a;
+		a.mix_ratio = 0.25;
+
+		/* the "other" chunk is shorter: the rest of "b" is
+		   not mixed */
+		TestChunk b(2, CHUNK_SIZE, 1, -3), other_b(6, CHUNK_SIZE / 4, 1, 2);
+		b.other = &other_b;
+		b.mix_ratio = 0.75;
+
+		for (const MusicChunk *chunk : {&a, &b}) {
+			const auto expected = reference.Process(*chunk);
+			CPPUNIT_ASSERT(expected == ToVector(group.Get(*chunk)));
+			group.Release(*chunk);
+		}
+
+		a.other = b.other = nullptr;
+	}
+
+	void TestTagOnly() {
+		OutputFilterGroup group(&config);
+		group.Open(audio_format);
+		group.SetReplayGainMode(ReplayGainMode::TRACK);
+
+		UngroupedOutput reference(config);
+
+		/* a chunk which carries only a tag yields no data,
+		   and doesn't disturb the following chunks */
+		TestChunk tag_chunk(1, 0, 1, -6);
+		tag_chunk.tag = new Tag();
+
+		const auto result = group.Get(tag_chunk);
+		CPPUNIT_ASSERT(result != nullptr);
+		CPPUNIT_ASSERT(result->data.IsEmpty());
+		CPPUNIT_ASSERT(reference.Process(tag_chunk).empty());
+
+		/* the following chunk still matches */
+		TestChunk a(2, CHUNK_SIZE, 1, -6);
+		CPPUNIT_ASSERT(reference.Process(a) == ToVector(group.Get(a)));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FilterGroupTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,263 @@
+/*
+ * Unit tests for class InputCacheManager.
+ */
+
+#include "config.h"
+#include "input/cache/Manager.hxx"
+#include "input/cache/Item.hxx"
+#include "fs/AllocatedPath.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <string>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr char URI_A[] = "http://example.com/a.flac";
+static constexpr char URI_B[] = "http://example.com/b.flac";
+static constexpr char URI_C[] = "http://example.com/c.flac";
+static constexpr char URI_D[] = "http://example.com/d.flac";
+
+static constexpr offset_type ITEM_SIZE = 100;
+
+class InputCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(InputCacheTest);
+	CPPUNIT_TEST(TestSaveLoad);
+	CPPUNIT_TEST(TestChanged);
+	CPPUNIT_TEST(TestMaxAge);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST(TestEvictInUse);
+	CPPUNIT_TEST_SUITE_END();
+
+	char directory[32];
+
+public:
+	void setUp() override {
+		strcpy(directory, "/tmp/test_cacheXXXXXX");
+		CPPUNIT_ASSERT(mkdtemp(directory) != nullptr);
+	}
+
+	void tearDown() override {
+		DIR *dir = opendir(directory);
+		CPPUNIT_ASSERT(dir != nullptr);
+
+		const struct dirent *ent;
+		while ((ent = readdir(dir)) != nullptr)
+			if (ent->d_name[0] != '.')
+				unlink((std::string(directory) + "/" +
+					ent->d_name).c_str());
+
+		closedir(dir);
+		rmdir(directory);
+	}
+
+	void TestSaveLoad() {
+		char data[ITEM_SIZE];
+		for (unsigned i = 0; i < sizeof(data); ++i)
+			data[i] = char(i * 7);
+
+		{
+			auto manager = NewManager();
+
+			/* a complete item */
+			auto *item = manager->Get(URI_A, ITEM_SIZE,
+						  "audio/flac", "etag \"1\"");
+			CPPUNIT_ASSERT(item != nullptr);
+			item->Write(0, data, sizeof(data));
+			CPPUNIT_ASSERT(item->IsComplete());
+			manager->Release(*item);
+
+			/* a partial item without MIME type and
+			   validator */
+			item = manager->Get(URI_B, ITEM_SIZE,
+					    nullptr, nullptr);
+			CPPUNIT_ASSERT(item != nullptr);
+			item->Write(10, data + 10, 20);
+			item->Write(50, data + 50, 10);
+			manager->Release(*item);
+		}
+
+		/* load both from disk */
+
+		auto manager = NewManager();
+
+		auto *item = manager->GetComplete(URI_A);
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT_EQUAL(ITEM_SIZE, item->GetSize());
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/flac"),
+				     std::string(item->GetMimeType()));
+
+		char buffer[ITEM_SIZE];
+		CPPUNIT_ASSERT_EQUAL(sizeof(buffer),
+				     item->Read(0, buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(memcmp(buffer, data, sizeof(data)) == 0);
+		manager->Release(*item);
+
+		/* the validator has been saved */
+		item = manager->Get(URI_A, ITEM_SIZE,
+				    "audio/flac", "etag \"1\"");
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT(item->IsComplete());
+		manager->Release(*item);
+
+		CPPUNIT_ASSERT(manager->GetComplete(URI_B) == nullptr);
+
+		item = manager->Get(URI_B, ITEM_SIZE, nullptr, nullptr);
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT(item->GetMimeType() == nullptr);
+		CPPUNIT_ASSERT_EQUAL(offset_type(30), item->GetCachedSize());
+		CPPUNIT_ASSERT(!item->IsCached(9));
+		CPPUNIT_ASSERT(item->IsCached(10));
+		CPPUNIT_ASSERT(item->IsCached(29));
+		CPPUNIT_ASSERT(!item->IsCached(30));
+		CPPUNIT_ASSERT(item->IsCached(59));
+		CPPUNIT_ASSERT(!item->IsCached(60));
+
+		/* reads stop at the end of the cached range */
+		CPPUNIT_ASSERT_EQUAL(size_t(10),
+				     item->Read(20, buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(memcmp(buffer, data + 20, 10) == 0);
+		CPPUNIT_ASSERT_EQUAL(size_t(0),
+				     item->Read(30, buffer, sizeof(buffer)));
+		manager->Release(*item);
+	}
+
+	void TestChanged() {
+		auto manager = NewManager();
+
+		AddComplete(*manager, URI_A, "etag \"1\"");
+
+		/* same size and MIME type, but a new validator: the
+		   resource has been replaced */
+		auto *item = manager->Get(URI_A, ITEM_SIZE,
+					  "audio/flac", "etag \"2\"");
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT_EQUAL(offset_type(0), item->GetCachedSize());
+		manager->Release(*item);
+
+		CPPUNIT_ASSERT(manager->GetComplete(URI_A) == nullptr);
+
+		/* the server doesn't send a validator anymore */
+		AddComplete(*manager, URI_B, "last-modified x");
+		item = manager->Get(URI_B, ITEM_SIZE, "audio/flac", nullptr);
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT_EQUAL(offset_type(0), item->GetCachedSize());
+		manager->Release(*item);
+	}
+
+	void TestMaxAge() {
+		{
+			auto manager = NewManager();
+			AddComplete(*manager, URI_A, "etag \"1\"");
+		}
+
+		/* with a maximum age of 0, a complete item is never
+		   served without asking the server */
+		auto manager = NewManager(1 << 20, 0);
+		CPPUNIT_ASSERT(manager->GetComplete(URI_A) == nullptr);
+
+		/* if the resource is unchanged, the data is kept */
+		auto *item = manager->Get(URI_A, ITEM_SIZE,
+					  "audio/flac", "etag \"1\"");
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT(item->IsComplete());
+		manager->Release(*item);
+	}
+
+	void TestEvict() {
+		auto manager = NewManager(3 * ITEM_SIZE);
+
+		AddComplete(*manager, URI_A, nullptr);
+		AddComplete(*manager, URI_B, nullptr);
+		AddComplete(*manager, URI_C, nullptr);
+
+		/* "a" becomes the most recently used one, and "b" the
+		   least recently used one */
+		auto *item = manager->GetComplete(URI_A);
+		CPPUNIT_ASSERT(item != nullptr);
+		manager->Release(*item);
+
+		AddComplete(*manager, URI_D, nullptr);
+		CPPUNIT_ASSERT(!Has(*manager, URI_B));
+		CPPUNIT_ASSERT(Has(*manager, URI_A));
+		CPPUNIT_ASSERT(Has(*manager, URI_C));
+		CPPUNIT_ASSERT(Has(*manager, URI_D));
+
+		/* the eviction has deleted the files */
+		manager.reset();
+		manager = NewManager(3 * ITEM_SIZE);
+		CPPUNIT_ASSERT(!Has(*manager, URI_B));
+		CPPUNIT_ASSERT(Has(*manager, URI_A));
+		CPPUNIT_ASSERT(Has(*manager, URI_C));
+		CPPUNIT_ASSERT(Has(*manager, URI_D));
+	}
+
+	void TestEvictInUse() {
+		auto manager = NewManager(ITEM_SIZE);
+
+		AddComplete(*manager, URI_A, nullptr);
+
+		/* "a" is in use; it is not evicted, even though it is
+		   the least recently used item, and the new one has to
+		   go instead */
+		auto *in_use = manager->GetComplete(URI_A);
+		CPPUNIT_ASSERT(in_use != nullptr);
+
+		AddComplete(*manager, URI_B, nullptr);
+		CPPUNIT_ASSERT(!Has(*manager, URI_B));
+
+		manager->Release(*in_use);
+		CPPUNIT_ASSERT(Has(*manager, URI_A));
+	}
+
+private:
+	std::unique_ptr<InputCacheManager> NewManager(offset_type max_size=1 << 20,
+						      unsigned max_age=3600) {
+		return std::unique_ptr<InputCacheManager>
+			(new InputCacheManager(AllocatedPath::FromFS(directory),
+					       max_size, max_age));
+	}
+
+	static void AddComplete(InputCacheManager &manager, const char *uri,
+				const char *validator) {
+		auto *item = manager.Get(uri, ITEM_SIZE, "audio/flac",
+					 validator);
+		CPPUNIT_ASSERT(item != nullptr);
+
+		char data[ITEM_SIZE];
+		memset(data, 0x42, sizeof(data));
+		item->Write(0, data, sizeof(data));
+		manager.Release(*item);
+	}
+
+	/**
+	 * Is the given resource stored completely?  This makes it
+	 * the most recently used item.
+	 */
+	bool Has(InputCacheManager &manager, const char *uri) {
+		auto *item = manager.GetComplete(uri);
+		if (item == nullptr)
+			return false;
+
+		manager.Release(*item);
+		return true;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InputCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
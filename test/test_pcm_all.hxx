@@ -62,7 +62,10 @@ class PcmVolumeTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestVolume16);
 	CPPUNIT_TEST(TestVolume24);
 	CPPUNIT_TEST(TestVolume32);
+	CPPUNIT_TEST(TestVolumeExact);
+	CPPUNIT_TEST(TestVolumeNoise);
 	CPPUNIT_TEST(TestVolumeFloat);
+	CPPUNIT_TEST(TestVolumeDsd);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -70,7 +73,10 @@ public:
 	void TestVolume16();
 	void TestVolume24();
 	void TestVolume32();
+	void TestVolumeExact();
+	void TestVolumeNoise();
 	void TestVolumeFloat();
+	void TestVolumeDsd();
 };
 
 class PcmFormatTest : public CppUnit::TestFixture {
@@ -94,6 +100,8 @@ class PcmMixTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestMix16);
 	CPPUNIT_TEST(TestMix24);
 	CPPUNIT_TEST(TestMix32);
+	CPPUNIT_TEST(TestMixExact);
+	CPPUNIT_TEST(TestMixFloat);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -101,6 +109,8 @@ public:
 	void TestMix16();
 	void TestMix24();
 	void TestMix32();
+	void TestMixExact();
+	void TestMixFloat();
 };
 
 class PcmInterleaveTest : public CppUnit::TestFixture {
@@ -120,6 +130,19 @@ public:
 	void TestInterleave64();
 };
 
+#ifdef ENABLE_DSD
+class PcmDsdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmDsdTest);
+	CPPUNIT_TEST(TestSimd);
+	CPPUNIT_TEST(TestReference);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSimd();
+	void TestReference();
+};
+#endif
+
 class PcmExportTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmExportTest);
 	CPPUNIT_TEST(TestShift8);
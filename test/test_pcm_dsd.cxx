@@ -0,0 +1,88 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/DsdSimd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <math.h>
+
+void
+PcmDsdTest::TestSimd()
+{
+	static constexpr size_t N = 509;
+	const TestDataBuffer<uint8_t, N + DSD_HISTORY> src;
+
+	const auto &tables = GetDsdTables();
+
+	float dest[N];
+	const size_t done = DsdToFloatSimd(tables, dest, src, N);
+	CPPUNIT_ASSERT(done <= N);
+
+	for (size_t i = 0; i < done; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(DsdToFloatSample(tables, src + i),
+					     dest[i], 1e-6);
+}
+
+/**
+ * Compare #PcmDsd with the original dsd2pcm implementation, feeding
+ * it blocks of various sizes; the large ones are split among worker
+ * threads.
+ */
+void
+PcmDsdTest::TestReference()
+{
+	static constexpr unsigned channels = 6;
+	static constexpr size_t sizes[] = { 1, 3, 64, 4099, 17, 65536, 8 };
+
+	dsd2pcm_ctx *ctx[channels];
+	for (auto &i : ctx)
+		i = dsd2pcm_init();
+
+	PcmDsd dsd;
+	RandomInt<uint8_t> random;
+
+	for (const size_t frames : sizes) {
+		const size_t n = frames * channels;
+		std::unique_ptr<uint8_t[]> src(new uint8_t[n]);
+		std::generate_n(src.get(), n, random);
+
+		std::unique_ptr<float[]> expected(new float[n]);
+		for (unsigned c = 0; c < channels; ++c)
+			dsd2pcm_translate(ctx[c], frames, src.get() + c,
+					  channels, false,
+					  expected.get() + c, channels);
+
+		const auto dest = dsd.ToFloat(channels, {src.get(), n});
+		CPPUNIT_ASSERT_EQUAL(n, dest.size);
+
+		/* dsd2pcm sums in double precision */
+		for (size_t i = 0; i < n; ++i)
+			CPPUNIT_ASSERT(fabsf(dest[i] - expected[i]) < 1e-6f);
+	}
+
+	for (auto i : ctx)
+		dsd2pcm_destroy(i);
+}
@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "test_pcm_all.hxx"
 #include "Compiler.h"
 
@@ -32,6 +33,9 @@ CPPUNIT_TEST_SUITE_REGISTRATION(PcmVolumeTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmFormatTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmMixTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmInterleaveTest);
+#ifdef ENABLE_DSD
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmDsdTest);
+#endif
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmExportTest);
 
 int
@@ -21,7 +21,11 @@
 #include "test_pcm_all.hxx"
 #include "test_pcm_util.hxx"
 #include "pcm/PcmMix.hxx"
-#include "pcm/PcmDither.hxx"
+#include "pcm/PcmDither.cxx"
+#include "pcm/Volume.hxx"
+#include "pcm/Traits.hxx"
+
+#include <math.h>
 
 template<typename T, SampleFormat format, typename G=RandomInt<T>>
 static void
@@ -61,6 +65,118 @@ TestPcmMix(G g=G())
 	AssertEqualWithTolerance(result, expected, 3);
 }
 
+/**
+ * Verify that pcm_mix() (which may use vectorized kernels) produces
+ * exactly the same output as the portable code.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>,
+	 typename G=RandomInt<typename Traits::value_type>>
+static void
+TestPcmMixExact(G g=G())
+{
+	typedef typename Traits::value_type value_type;
+	typedef typename Traits::long_type long_type;
+	constexpr unsigned SBITS = Traits::BITS + PCM_VOLUME_BITS;
+	constexpr unsigned LANES = PcmDither::LANES;
+
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<value_type, N>(g);
+	const auto src2 = TestDataBuffer<value_type, N>(g);
+
+	/* cross-fade: compare with the block dither */
+
+	constexpr float portion1 = 0.3;
+	float s = sin(M_PI_2 * portion1);
+	s *= s;
+	const int vol1 = s * PCM_VOLUME_1S + 0.5;
+	const int vol2 = PCM_VOLUME_1S - vol1;
+
+	PcmDither dither, expected_dither;
+
+	/* run twice to verify that the dither state is carried
+	   over */
+	for (unsigned run = 0; run < 2; ++run) {
+		auto result = src1;
+		CPPUNIT_ASSERT(pcm_mix(dither, result.begin(), src2.begin(),
+				       sizeof(result), F, portion1));
+
+		/* lane j dithers the run of samples starting at
+		   j*RUN */
+		constexpr unsigned RUN = N / LANES;
+		for (unsigned k = 0; k < RUN; ++k) {
+			long_type block[LANES];
+			for (unsigned j = 0; j < LANES; ++j)
+				block[j] = long_type(src1[j * RUN + k]) * vol1 +
+					long_type(src2[j * RUN + k]) * vol2;
+
+			expected_dither.DitherShift<long_type, SBITS,
+						    Traits::BITS>(block);
+
+			for (unsigned j = 0; j < LANES; ++j)
+				CPPUNIT_ASSERT_EQUAL(value_type(block[j]),
+						     result[j * RUN + k]);
+		}
+
+		for (unsigned i = RUN * LANES; i < N; ++i) {
+			const long_type c = long_type(src1[i]) * vol1 +
+				long_type(src2[i]) * vol2;
+			CPPUNIT_ASSERT_EQUAL(value_type(expected_dither.DitherShift<long_type, SBITS, Traits::BITS>(c)),
+					     result[i]);
+		}
+	}
+
+	/* MixRamp: compare with the plain clamped addition */
+
+	auto result = src1;
+	CPPUNIT_ASSERT(pcm_mix(dither, result.begin(), src2.begin(),
+			       sizeof(result), F, -1));
+
+	for (unsigned i = 0; i < N; ++i) {
+		int64_t sum = int64_t(src1[i]) + int64_t(src2[i]);
+		if (sum > Traits::MAX)
+			sum = Traits::MAX;
+		else if (sum < Traits::MIN)
+			sum = Traits::MIN;
+
+		CPPUNIT_ASSERT_EQUAL(value_type(sum), result[i]);
+	}
+}
+
+void
+PcmMixTest::TestMixExact()
+{
+	TestPcmMixExact<SampleFormat::S8>();
+	TestPcmMixExact<SampleFormat::S16>();
+	TestPcmMixExact<SampleFormat::S24_P32>(RandomInt24());
+	TestPcmMixExact<SampleFormat::S32>();
+}
+
+void
+PcmMixTest::TestMixFloat()
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	PcmDither dither;
+
+	auto result = src1;
+	CPPUNIT_ASSERT(pcm_mix(dither, result.begin(), src2.begin(),
+			       sizeof(result), SampleFormat::FLOAT, 0.5));
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL((src1[i] + src2[i]) / 2,
+					     result[i], 0.001);
+
+	result = src1;
+	CPPUNIT_ASSERT(pcm_mix(dither, result.begin(), src2.begin(),
+			       sizeof(result), SampleFormat::FLOAT, -1));
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(src1[i] + src2[i],
+					     result[i], 0.0001);
+}
+
 void
 PcmMixTest::TestMix8()
 {
@@ -21,11 +21,20 @@
 #include "test_pcm_all.hxx"
 #include "pcm/Volume.hxx"
 #include "pcm/Traits.hxx"
+#include "pcm/PcmDither.cxx"
 #include "util/ConstBuffer.hxx"
 #include "test_pcm_util.hxx"
 
+#ifdef ENABLE_DSD
+#include "pcm/PcmDsd.hxx"
+#endif
+
 #include <algorithm>
+#include <array>
+#include <functional>
+#include <vector>
 
+#include <math.h>
 #include <string.h>
 
 template<SampleFormat F, class Traits=SampleTraits<F>,
@@ -36,7 +45,7 @@ TestVolume(G g=G())
 	typedef typename Traits::value_type value_type;
 
 	PcmVolume pv;
-	pv.Open(F);
+	pv.Open(F, 2);
 
 	constexpr size_t N = 509;
 	static value_type zero[N];
@@ -91,11 +100,162 @@ PcmVolumeTest::TestVolume32()
 	TestVolume<SampleFormat::S32>();
 }
 
+/**
+ * Verify that PcmVolume (which may use a vectorized kernel) produces
+ * exactly the same output as the portable dither code.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>,
+	 typename G=RandomInt<typename Traits::value_type>>
+static void
+TestVolumeExactT(G g=G())
+{
+	typedef typename Traits::value_type value_type;
+	typedef typename Traits::long_type long_type;
+	constexpr unsigned SBITS = Traits::BITS + PCM_VOLUME_BITS;
+	constexpr unsigned LANES = PcmDither::LANES;
+
+	PcmVolume pv;
+	pv.Open(F, 2);
+	pv.SetVolume(PCM_VOLUME_1 / 3);
+
+	PcmDither dither;
+
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<value_type, N>(g);
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	/* run twice to verify that the dither state is carried
+	   over */
+	for (unsigned run = 0; run < 2; ++run) {
+		const auto dest =
+			ConstBuffer<value_type>::FromVoid(pv.Apply(src));
+		CPPUNIT_ASSERT_EQUAL(N, dest.size);
+
+		/* lane j dithers the run of samples starting at
+		   j*RUN */
+		constexpr size_t RUN = N / LANES;
+		for (size_t k = 0; k < RUN; ++k) {
+			long_type block[LANES];
+			for (unsigned j = 0; j < LANES; ++j)
+				block[j] = long_type(_src[j * RUN + k]) * pv.GetVolume();
+
+			dither.DitherShift<long_type, SBITS,
+					   Traits::BITS>(block);
+
+			for (unsigned j = 0; j < LANES; ++j)
+				CPPUNIT_ASSERT_EQUAL(value_type(block[j]),
+						     dest[j * RUN + k]);
+		}
+
+		for (size_t i = RUN * LANES; i < N; ++i) {
+			const long_type sample =
+				long_type(_src[i]) * pv.GetVolume();
+			CPPUNIT_ASSERT_EQUAL(value_type(dither.DitherShift<long_type, SBITS, Traits::BITS>(sample)),
+					     dest[i]);
+		}
+	}
+
+	pv.Close();
+}
+
+void
+PcmVolumeTest::TestVolumeExact()
+{
+	TestVolumeExactT<SampleFormat::S8>();
+	TestVolumeExactT<SampleFormat::S16>();
+	TestVolumeExactT<SampleFormat::S24_P32>(RandomInt24());
+	TestVolumeExactT<SampleFormat::S32>();
+}
+
+/**
+ * Determine the power spectrum of the quantization error (including
+ * the dither) in #NOISE_BANDS bands of equal width, averaged over
+ * segments of #NOISE_SEGMENT samples.
+ */
+static constexpr size_t NOISE_SEGMENT = 256;
+static constexpr unsigned NOISE_BANDS = 8;
+
+static std::array<double, NOISE_BANDS>
+NoiseSpectrum(const std::vector<double> &error)
+{
+	std::array<double, NOISE_BANDS> result{};
+
+	for (size_t s = 0; s + NOISE_SEGMENT <= error.size();
+	     s += NOISE_SEGMENT) {
+		for (size_t bin = 1; bin < NOISE_SEGMENT / 2; ++bin) {
+			double re = 0, im = 0;
+			for (size_t i = 0; i < NOISE_SEGMENT; ++i) {
+				const double phi = 2 * M_PI * bin * i
+					/ NOISE_SEGMENT;
+				re += error[s + i] * cos(phi);
+				im += error[s + i] * sin(phi);
+			}
+
+			result[bin * NOISE_BANDS * 2 / NOISE_SEGMENT] +=
+				re * re + im * im;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * Verify that the noise shaping of PcmVolume (which dithers several
+ * runs in parallel) has the same spectrum as dithering all samples
+ * one after another.
+ */
+void
+PcmVolumeTest::TestVolumeNoise()
+{
+	constexpr unsigned SBITS = 16 + PCM_VOLUME_BITS;
+	constexpr size_t N = 1024, CHUNKS = 64;
+	constexpr int volume = PCM_VOLUME_1 / 3;
+
+	PcmVolume pv;
+	pv.Open(SampleFormat::S16, 2);
+	pv.SetVolume(volume);
+
+	PcmDither dither;
+	RandomInt<int16_t> g;
+
+	std::vector<double> error, expected_error;
+
+	for (size_t c = 0; c < CHUNKS; ++c) {
+		int16_t _src[N];
+		std::generate_n(_src, N, std::ref(g));
+		const ConstBuffer<void> src(_src, sizeof(_src));
+
+		const auto dest =
+			ConstBuffer<int16_t>::FromVoid(pv.Apply(src));
+		CPPUNIT_ASSERT_EQUAL(N, dest.size);
+
+		for (size_t i = 0; i < N; ++i) {
+			const int32_t sample = int32_t(_src[i]) * volume;
+			const double exact = double(sample) / PCM_VOLUME_1;
+
+			error.push_back(dest[i] - exact);
+
+			const int32_t expected =
+				dither.DitherShift<int32_t, SBITS, 16>(sample);
+			expected_error.push_back(expected - exact);
+		}
+	}
+
+	pv.Close();
+
+	const auto spectrum = NoiseSpectrum(error);
+	const auto expected = NoiseSpectrum(expected_error);
+	for (unsigned i = 0; i < NOISE_BANDS; ++i) {
+		CPPUNIT_ASSERT(spectrum[i] < expected[i] * 1.5);
+		CPPUNIT_ASSERT(spectrum[i] > expected[i] / 1.5);
+	}
+}
+
 void
 PcmVolumeTest::TestVolumeFloat()
 {
 	PcmVolume pv;
-	pv.Open(SampleFormat::FLOAT);
+	pv.Open(SampleFormat::FLOAT, 2);
 
 	constexpr size_t N = 509;
 	static float zero[N];
@@ -122,3 +282,118 @@ PcmVolumeTest::TestVolumeFloat()
 
 	pv.Close();
 }
+
+/**
+ * Generate a DSD64 sine wave with a simple 2nd order sigma-delta
+ * modulator.
+ */
+static std::vector<uint8_t>
+GenerateDsdSine(unsigned channels, size_t n_frames, double frequency,
+		double amplitude)
+{
+	static constexpr double rate = 64 * 44100;
+
+	std::vector<uint8_t> result;
+	result.reserve(n_frames * channels);
+
+	double i1 = 0, i2 = 0;
+	for (size_t i = 0; i < n_frames; ++i) {
+		uint8_t octet = 0;
+		for (unsigned bit = 0; bit < 8; ++bit) {
+			const double u = amplitude *
+				sin(2 * M_PI * frequency * (i * 8 + bit) / rate);
+			const double y = i2 >= 0 ? 1 : -1;
+			i1 += u - y;
+			i2 += i1 - 2 * y;
+			octet = (octet << 1) | (y > 0);
+		}
+
+		/* all channels get the same signal */
+		for (unsigned c = 0; c < channels; ++c)
+			result.push_back(octet);
+	}
+
+	return result;
+}
+
+#ifdef ENABLE_DSD
+
+/**
+ * Convert one channel to PCM and determine the amplitude of the
+ * given frequency.
+ */
+static double
+DsdAmplitude(ConstBuffer<uint8_t> src, unsigned channels, unsigned channel,
+	     double frequency)
+{
+	static constexpr double rate = 64 * 44100 / 8;
+
+	PcmDsd dsd;
+	const auto pcm = dsd.ToFloat(channels, src);
+	const size_t n_frames = pcm.size / channels;
+
+	/* skip the filter's settling time */
+	const size_t start = n_frames / 10;
+
+	double re = 0, im = 0;
+	for (size_t i = start; i < n_frames; ++i) {
+		const double phase = 2 * M_PI * frequency * i / rate;
+		re += pcm[i * channels + channel] * cos(phase);
+		im += pcm[i * channels + channel] * sin(phase);
+	}
+
+	return 2 * sqrt(re * re + im * im) / (n_frames - start);
+}
+
+#endif
+
+void
+PcmVolumeTest::TestVolumeDsd()
+{
+	static constexpr unsigned channels = 2;
+	static constexpr double frequency = 1000;
+
+	/* 0.2 seconds, a whole number of periods of the 1 kHz sine
+	   wave after the first 10% */
+	static constexpr size_t n_frames = 64 * 44100 / 8 / 5;
+
+	const auto _src = GenerateDsdSine(channels, n_frames, frequency, 0.5);
+	const ConstBuffer<uint8_t> src(_src.data(), _src.size());
+
+	PcmVolume pv;
+	pv.Open(SampleFormat::DSD, channels);
+
+	pv.SetVolume(PCM_VOLUME_1);
+	auto dest = pv.Apply(src.ToVoid());
+	CPPUNIT_ASSERT_EQUAL(src.size, dest.size);
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(dest.data, src.data, src.size));
+
+	pv.SetVolume(0);
+	dest = pv.Apply(src.ToVoid());
+	CPPUNIT_ASSERT_EQUAL(src.size, dest.size);
+	const auto _dest = ConstBuffer<uint8_t>::FromVoid(dest);
+	CPPUNIT_ASSERT(std::all_of(_dest.begin(), _dest.end(),
+				   [](uint8_t i){ return i == 0x69; }));
+
+#ifdef ENABLE_DSD
+	const double reference = DsdAmplitude(src, channels, 0, frequency);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, reference, 0.01);
+
+	for (const unsigned volume : {PCM_VOLUME_1 / 2, PCM_VOLUME_1 / 10}) {
+		pv.SetVolume(volume);
+		dest = pv.Apply(src.ToVoid());
+		CPPUNIT_ASSERT_EQUAL(src.size, dest.size);
+
+		const auto result = ConstBuffer<uint8_t>::FromVoid(dest);
+		const double expected =
+			reference * pcm_volume_to_float(volume);
+		for (unsigned c = 0; c < channels; ++c)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected,
+						     DsdAmplitude(result, channels,
+								  c, frequency),
+						     expected * 0.005);
+	}
+#endif
+
+	pv.Close();
+}
@@ -0,0 +1,252 @@
+/*
+ * Unit tests for class ThreadInputStream.
+ */
+
+#include "config.h"
+#include "input/ThreadInputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr size_t BUFFER_SIZE = 4096;
+static constexpr offset_type DATA_SIZE = 4 * BUFFER_SIZE;
+
+static constexpr uint8_t
+DataAt(offset_type offset)
+{
+	return uint8_t(offset * 7 + (offset >> 8));
+}
+
+/**
+ * Serves #DATA_SIZE bytes generated by DataAt(), and counts the
+ * calls to ThreadSeek().  If #block_reads is set, ThreadRead() waits
+ * until #fail_reads is set, and then throws.
+ */
+class MemoryInputStream final : public ThreadInputStream {
+	offset_type position = 0;
+
+public:
+	unsigned n_seeks = 0;
+	bool closed = false;
+
+	bool block_reads = false, reading = false, fail_reads = false;
+
+	MemoryInputStream(Mutex &_mutex, Cond &_cond, bool _seekable)
+		:ThreadInputStream("memory", "memory://", _mutex, _cond,
+				   BUFFER_SIZE) {
+		size = DATA_SIZE;
+		seekable = _seekable;
+		SetReady();
+	}
+
+	~MemoryInputStream() {
+		Stop();
+	}
+
+protected:
+	size_t ThreadRead(void *ptr, size_t read_size) override {
+		if (block_reads) {
+			const ScopeLock protect(mutex);
+			reading = true;
+			cond.broadcast();
+
+			while (!fail_reads)
+				cond.wait(mutex);
+
+			throw std::runtime_error("Read error");
+		}
+
+		read_size = std::min<offset_type>(read_size,
+						  DATA_SIZE - position);
+
+		uint8_t *p = (uint8_t *)ptr;
+		for (size_t i = 0; i < read_size; ++i)
+			p[i] = DataAt(position + i);
+
+		position += read_size;
+		return read_size;
+	}
+
+	void ThreadSeek(offset_type new_offset) override {
+		position = new_offset;
+		++n_seeks;
+	}
+
+	void Close() override {
+		/* called with the mutex locked */
+		closed = true;
+		cond.broadcast();
+	}
+};
+
+/**
+ * Read a few bytes and check them against DataAt().
+ */
+static void
+CheckRead(InputStream &is, offset_type offset)
+{
+	CPPUNIT_ASSERT_EQUAL(offset, is.GetOffset());
+
+	uint8_t buffer[64];
+	const size_t nbytes = is.LockRead(buffer, sizeof(buffer));
+	CPPUNIT_ASSERT(nbytes > 0);
+
+	for (size_t i = 0; i < nbytes; ++i)
+		CPPUNIT_ASSERT_EQUAL(DataAt(offset + i), buffer[i]);
+}
+
+/**
+ * Read until the end of the stream.
+ */
+static void
+ReadAll(InputStream &is)
+{
+	uint8_t buffer[1024];
+	while (is.LockRead(buffer, sizeof(buffer)) > 0) {}
+
+	CPPUNIT_ASSERT_EQUAL(DATA_SIZE, is.GetOffset());
+}
+
+class ThreadInputStreamTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ThreadInputStreamTest);
+	CPPUNIT_TEST(TestSeekInBuffer);
+	CPPUNIT_TEST(TestSeekOutsideBuffer);
+	CPPUNIT_TEST(TestEOF);
+	CPPUNIT_TEST(TestSeekAfterEOF);
+	CPPUNIT_TEST(TestReadErrorDuringSeek);
+	CPPUNIT_TEST_SUITE_END();
+
+	Mutex mutex;
+	Cond cond;
+
+public:
+	void TestSeekInBuffer() {
+		MemoryInputStream is(mutex, cond, true);
+		is.Start();
+
+		/* the first portion (a quarter of the buffer) has
+		   been read when this returns */
+		CheckRead(is, 0);
+		const offset_type offset = is.GetOffset();
+
+		/* a forward seek within the buffer skips the data
+		   without waking up the thread */
+		is.LockSeek(offset + 100);
+		CheckRead(is, offset + 100);
+
+		const ScopeLock protect(mutex);
+		CPPUNIT_ASSERT_EQUAL(0u, is.n_seeks);
+	}
+
+	void TestSeekOutsideBuffer() {
+		MemoryInputStream is(mutex, cond, true);
+		is.Start();
+
+		CheckRead(is, 0);
+
+		/* backwards: the data has already been consumed */
+		is.LockSeek(10);
+		CheckRead(is, 10);
+
+		{
+			const ScopeLock protect(mutex);
+			CPPUNIT_ASSERT_EQUAL(1u, is.n_seeks);
+		}
+
+		/* beyond what fits into the buffer */
+		is.LockSeek(DATA_SIZE - 1000);
+		CheckRead(is, DATA_SIZE - 1000);
+
+		{
+			const ScopeLock protect(mutex);
+			CPPUNIT_ASSERT_EQUAL(2u, is.n_seeks);
+		}
+
+		ReadAll(is);
+	}
+
+	void TestEOF() {
+		MemoryInputStream is(mutex, cond, false);
+		is.Start();
+
+		ReadAll(is);
+		CPPUNIT_ASSERT(is.LockIsEOF());
+
+		/* the thread of a stream which is not seekable exits
+		   at the end */
+		const ScopeLock protect(mutex);
+		while (!is.closed)
+			cond.wait(mutex);
+
+		bool failed = false;
+		try {
+			is.Seek(0);
+		} catch (const std::runtime_error &) {
+			failed = true;
+		}
+
+		CPPUNIT_ASSERT(failed);
+	}
+
+	void TestSeekAfterEOF() {
+		MemoryInputStream is(mutex, cond, true);
+		is.Start();
+
+		ReadAll(is);
+		CPPUNIT_ASSERT(is.LockIsEOF());
+
+		/* the thread of a seekable stream is still there */
+		is.LockSeek(100);
+		CPPUNIT_ASSERT(!is.LockIsEOF());
+		CheckRead(is, 100);
+		ReadAll(is);
+
+		const ScopeLock protect(mutex);
+		CPPUNIT_ASSERT(!is.closed);
+	}
+
+	void TestReadErrorDuringSeek() {
+		MemoryInputStream is(mutex, cond, true);
+		is.block_reads = true;
+		is.Start();
+
+		const ScopeLock protect(mutex);
+		while (!is.reading)
+			cond.wait(mutex);
+
+		/* the read fails only after Seek() has unlocked the
+		   mutex, i.e. while it waits for the thread */
+		is.fail_reads = true;
+		cond.broadcast();
+
+		bool failed = false;
+		try {
+			is.Seek(DATA_SIZE / 2);
+		} catch (const std::runtime_error &) {
+			failed = true;
+		}
+
+		CPPUNIT_ASSERT(failed);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ThreadInputStreamTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -8,6 +8,8 @@
 #include "UriUtilTest.hxx"
 #include "MimeTypeTest.hxx"
 #include "TestCircularBuffer.hxx"
+#include "TestPeakBuffer.hxx"
+#include "TestRangeSet.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -21,6 +23,8 @@ CPPUNIT_TEST_SUITE_REGISTRATION(SplitStringTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(UriUtilTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(MimeTypeTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(TestCircularBuffer);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPeakBuffer);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestRangeSet);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)